@@ -0,0 +1,221 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Throughput of shared priority queues under contention. Each thread
+ * repeatedly pops an item, gives it a new random priority, and pushes
+ * it back, so the queue size stays constant. The same workload runs
+ * against a PQueue behind a single mutex and against both modes of
+ * CPQueue, from 1 to 64 threads.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libcore/concurrent_pqueue.h>
+#include <libcore/priority_queue.h>
+
+#define NUM_ITEMS       65536UL
+#define TOTAL_OPS       4000000UL
+#define MAX_THREADS     64
+
+struct locked_pqueue {
+    pthread_mutex_t lock;
+    PQueue *pq;
+};
+
+struct worker {
+    pthread_t thread;
+    unsigned long seed;
+    unsigned long ops;
+    void *queue;
+    void* (*pop)(void *queue);
+    void (*push)(void *queue, void *data);
+};
+
+static unsigned long items[NUM_ITEMS];
+
+/* a is greater than b if a is numerically smaller than b */
+static int ulong_compare(const void *a, const void *b)
+{
+    unsigned long ua = *(const unsigned long *)a;
+    unsigned long ub = *(const unsigned long *)b;
+
+    return (ua < ub) ? 1 : ((ua > ub) ? -1 : 0);
+}
+
+static unsigned long xorshift(unsigned long *state)
+{
+    unsigned long x = *state;
+
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+
+    return (*state = x);
+}
+
+static void* locked_pop(void *queue)
+{
+    struct locked_pqueue *lpq = queue;
+    void *data;
+
+    pthread_mutex_lock(&lpq->lock);
+    data = pqueue_pop(lpq->pq);
+    pthread_mutex_unlock(&lpq->lock);
+
+    return data;
+}
+
+static void locked_push(void *queue, void *data)
+{
+    struct locked_pqueue *lpq = queue;
+
+    pthread_mutex_lock(&lpq->lock);
+    pqueue_push(lpq->pq, data);
+    pthread_mutex_unlock(&lpq->lock);
+}
+
+static void* cpq_pop(void *queue)
+{
+    return cpqueue_pop(queue);
+}
+
+static void cpq_push(void *queue, void *data)
+{
+    cpqueue_push(queue, data);
+}
+
+static void* run_worker(void *arg)
+{
+    struct worker *w = arg;
+    unsigned long i, *item;
+
+    for(i = 0; i < w->ops; i++) {
+        item = w->pop(w->queue);
+        if(item != NULL) {
+            /* Items only ever move later, as in an event scheduler */
+            *item += xorshift(&w->seed) % 1024;
+            w->push(w->queue, item);
+        }
+    }
+
+    return NULL;
+}
+
+static double run(void *queue, void* (*pop)(void *),
+        void (*push)(void *, void *), unsigned int nthreads)
+{
+    struct worker workers[MAX_THREADS];
+    struct timespec start, end;
+    unsigned int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i = 0; i < nthreads; i++) {
+        workers[i].seed = 2463534242UL + i;
+        workers[i].ops = TOTAL_OPS / nthreads;
+        workers[i].queue = queue;
+        workers[i].pop = pop;
+        workers[i].push = push;
+        if(pthread_create(&workers[i].thread, NULL, run_worker,
+                    &workers[i]) != 0) {
+            fprintf(stderr, "Failed to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for(i = 0; i < nthreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Millions of pop and push pairs per second */
+    return (double)TOTAL_OPS / 1e6 /
+        ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+static void fill_items(void)
+{
+    unsigned long i;
+
+    for(i = 0; i < NUM_ITEMS; i++) {
+        items[i] = (unsigned long)rand() % NUM_ITEMS;
+    }
+}
+
+int main(void)
+{
+    struct locked_pqueue lpq;
+    CPQueue *cpq;
+    unsigned int nthreads;
+    unsigned long i;
+    double locked, strict, relaxed;
+
+    srand(42);
+    pthread_mutex_init(&lpq.lock, NULL);
+
+    printf("%8s %16s %16s %16s   (Mops/s)\n", "threads",
+            "mutex+pqueue", "cpqueue strict", "cpqueue relaxed");
+
+    for(nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+        fill_items();
+        lpq.pq = pqueue_create(ulong_compare);
+        for(i = 0; i < NUM_ITEMS; i++) {
+            pqueue_push(lpq.pq, &items[i]);
+        }
+        locked = run(&lpq, locked_pop, locked_push, nthreads);
+        pqueue_free(lpq.pq);
+
+        fill_items();
+        cpq = cpqueue_create(ulong_compare, CPQUEUE_STRICT, 0);
+        for(i = 0; i < NUM_ITEMS; i++) {
+            cpqueue_push(cpq, &items[i]);
+        }
+        strict = run(cpq, cpq_pop, cpq_push, nthreads);
+        cpqueue_free(cpq);
+
+        fill_items();
+        cpq = cpqueue_create(ulong_compare, CPQUEUE_RELAXED, 2 * nthreads);
+        for(i = 0; i < NUM_ITEMS; i++) {
+            cpqueue_push(cpq, &items[i]);
+        }
+        relaxed = run(cpq, cpq_pop, cpq_push, nthreads);
+        cpqueue_free(cpq);
+
+        printf("%8u %16.2f %16.2f %16.2f\n", nthreads, locked, strict,
+                relaxed);
+    }
+
+    pthread_mutex_destroy(&lpq.lock);
+
+    return 0;
+}
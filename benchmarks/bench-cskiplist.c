@@ -0,0 +1,260 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Throughput of shared ordered maps under a mixed workload. Each thread
+ * looks up, inserts and removes random keys, with the map kept around
+ * half full. The same workload runs against a Map behind a single mutex
+ * and against a CSkipList, from 1 to 64 threads, with 90% and with 50%
+ * of the operations being lookups.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libcore/concurrent_skiplist.h>
+#include <libcore/map.h>
+
+#define NUM_KEYS        (1UL << 18)
+#define TOTAL_OPS       4000000UL
+#define MAX_THREADS     64
+
+struct locked_map {
+    pthread_mutex_t lock;
+    Map *map;
+};
+
+struct map_ops {
+    void* (*get)(void *map, const void *key);
+    int (*insert)(void *map, const void *key, void *value);
+    void* (*remove)(void *map, const void *key);
+};
+
+struct worker {
+    pthread_t thread;
+    unsigned long seed;
+    unsigned long ops;
+    unsigned int read_percent;
+    void *map;
+    const struct map_ops *map_ops;
+};
+
+static unsigned long keys[NUM_KEYS];
+
+static int ulong_compare(const void *a, const void *b)
+{
+    unsigned long ua = *(const unsigned long *)a;
+    unsigned long ub = *(const unsigned long *)b;
+
+    return (ua > ub) ? 1 : ((ua < ub) ? -1 : 0);
+}
+
+static unsigned long xorshift(unsigned long *state)
+{
+    unsigned long x = *state;
+
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+
+    return (*state = x);
+}
+
+static void* locked_get(void *map, const void *key)
+{
+    struct locked_map *lm = map;
+    MapIterator *it;
+    void *value = NULL;
+
+    pthread_mutex_lock(&lm->lock);
+    it = map_find(lm->map, key);
+    if(it != NULL) {
+        value = map_get_value(it);
+    }
+    pthread_mutex_unlock(&lm->lock);
+
+    return value;
+}
+
+static int locked_insert(void *map, const void *key, void *value)
+{
+    struct locked_map *lm = map;
+    int ret;
+
+    pthread_mutex_lock(&lm->lock);
+    ret = map_insert(lm->map, key, value);
+    pthread_mutex_unlock(&lm->lock);
+
+    return ret;
+}
+
+static void* locked_remove(void *map, const void *key)
+{
+    struct locked_map *lm = map;
+    void *value;
+
+    pthread_mutex_lock(&lm->lock);
+    value = map_remove(lm->map, key);
+    pthread_mutex_unlock(&lm->lock);
+
+    return value;
+}
+
+static void* csl_get(void *map, const void *key)
+{
+    return cskiplist_get(map, key);
+}
+
+static int csl_insert(void *map, const void *key, void *value)
+{
+    return cskiplist_insert(map, key, value);
+}
+
+static void* csl_remove(void *map, const void *key)
+{
+    return cskiplist_remove(map, key);
+}
+
+static const struct map_ops locked_ops = {
+    locked_get, locked_insert, locked_remove
+};
+
+static const struct map_ops csl_ops = {
+    csl_get, csl_insert, csl_remove
+};
+
+static void* run_worker(void *arg)
+{
+    struct worker *w = arg;
+    unsigned long i, r, *key;
+
+    for(i = 0; i < w->ops; i++) {
+        r = xorshift(&w->seed);
+        key = &keys[(r >> 8) % NUM_KEYS];
+
+        if(r % 100 < w->read_percent) {
+            w->map_ops->get(w->map, key);
+        } else if(r & 0x80) {
+            w->map_ops->insert(w->map, key, key);
+        } else {
+            w->map_ops->remove(w->map, key);
+        }
+    }
+
+    return NULL;
+}
+
+static double run(void *map, const struct map_ops *map_ops,
+        unsigned int read_percent, unsigned int nthreads)
+{
+    struct worker workers[MAX_THREADS];
+    struct timespec start, end;
+    unsigned long i;
+
+    /* Start half full, which inserts and removes then keep it at */
+    for(i = 0; i < NUM_KEYS; i += 2) {
+        map_ops->insert(map, &keys[i], &keys[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i = 0; i < nthreads; i++) {
+        workers[i].seed = 2463534242UL + i;
+        workers[i].ops = TOTAL_OPS / nthreads;
+        workers[i].read_percent = read_percent;
+        workers[i].map = map;
+        workers[i].map_ops = map_ops;
+        if(pthread_create(&workers[i].thread, NULL, run_worker,
+                    &workers[i]) != 0) {
+            fprintf(stderr, "Failed to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for(i = 0; i < nthreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Millions of operations per second */
+    return (double)TOTAL_OPS / 1e6 /
+        ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+static double run_locked(unsigned int read_percent, unsigned int nthreads)
+{
+    struct locked_map lm;
+    double mops;
+
+    pthread_mutex_init(&lm.lock, NULL);
+    lm.map = map_create(ulong_compare);
+
+    mops = run(&lm, &locked_ops, read_percent, nthreads);
+
+    map_free(lm.map);
+    pthread_mutex_destroy(&lm.lock);
+
+    return mops;
+}
+
+static double run_cskiplist(unsigned int read_percent, unsigned int nthreads)
+{
+    CSkipList *list;
+    double mops;
+
+    list = cskiplist_create(ulong_compare);
+    mops = run(list, &csl_ops, read_percent, nthreads);
+    cskiplist_free(list);
+
+    return mops;
+}
+
+int main(void)
+{
+    unsigned int nthreads;
+    unsigned long i;
+
+    for(i = 0; i < NUM_KEYS; i++) {
+        keys[i] = i;
+    }
+
+    printf("%8s %16s %16s %16s %16s   (Mops/s)\n", "threads",
+            "mutex 90% reads", "cskiplist 90%", "mutex 50% reads",
+            "cskiplist 50%");
+
+    for(nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+        printf("%8u %16.2f %16.2f %16.2f %16.2f\n", nthreads,
+                run_locked(90, nthreads), run_cskiplist(90, nthreads),
+                run_locked(50, nthreads), run_cskiplist(50, nthreads));
+    }
+
+    return 0;
+}
@@ -0,0 +1,359 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Map backends, and the hash tables, compared on a large map of random
+ * keys: insertion, lookups of present and absent keys, one at a time
+ * and for the maps in batches with map_find_many, iteration (in order,
+ * except for the hash tables) and removal. Keys are compared through a
+ * pointer, as with any Map, so tree lookups pay for one cache miss per
+ * node visited. The typed map, for comparison, holds keys by value and
+ * compares them inline, and the radix tree never compares keys at all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libcore/art.h>
+#include <libcore/hashtable.h>
+#include <libcore/map.h>
+#include <libcore/swiss_table.h>
+#include <libcore/typed_map.h>
+#include <libcore/utilities.h>
+
+#define MAP_SIZE    1000000UL
+#define LOOKUPS     4000000UL
+#define BATCH       256UL
+
+static unsigned long *keys;
+
+#define ulong_cmp(a, b)     (((a) > (b)) - ((a) < (b)))
+
+LIBCORE_DEFINE_MAP(ULongMap, unsigned long, unsigned long, ulong_cmp)
+
+static int ulong_compare(const void *a, const void *b)
+{
+    unsigned long ua = *(const unsigned long *)a;
+    unsigned long ub = *(const unsigned long *)b;
+
+    return (ua > ub) ? 1 : ((ua < ub) ? -1 : 0);
+}
+
+/* xorshift, for a repeatable sequence of keys */
+static unsigned long next_random(unsigned long *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static double seconds_since(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void run(const char *name, Map* (*create)(CompareFn))
+{
+    static unsigned long batch[BATCH];
+    static const void *batch_ptrs[BATCH];
+    static MapIterator *its[BATCH];
+    double insert, lookup, batched, iterate, remove;
+    unsigned long i, j, found, batch_found, state, key, sum;
+    MapIterator *it;
+    clock_t start;
+    Map *map;
+
+    map = create(ulong_compare);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        map_insert(map, &keys[i], &keys[i]);
+    }
+    insert = seconds_since(start);
+
+    /* Half of the lookups miss */
+    state = 88675123UL;
+    start = clock();
+    for(i = 0, found = 0; i < LOOKUPS; i++) {
+        key = keys[next_random(&state) % MAP_SIZE] + (i & 1);
+        if(map_find(map, &key) != NULL) {
+            found++;
+        }
+    }
+    lookup = seconds_since(start);
+
+    /* The same lookups, BATCH at a time */
+    for(j = 0; j < BATCH; j++) {
+        batch_ptrs[j] = &batch[j];
+    }
+    state = 88675123UL;
+    start = clock();
+    for(i = 0, batch_found = 0; i < LOOKUPS; i += BATCH) {
+        for(j = 0; j < BATCH; j++) {
+            batch[j] = keys[next_random(&state) % MAP_SIZE] + ((i + j) & 1);
+        }
+        batch_found += map_find_many(map, batch_ptrs, BATCH, its);
+    }
+    batched = seconds_since(start);
+
+    start = clock();
+    for(it = map_begin(map), sum = 0; it != NULL; it = map_next(it)) {
+        sum += *(const unsigned long *)map_get_key(it);
+    }
+    iterate = seconds_since(start);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        map_remove(map, &keys[i]);
+    }
+    remove = seconds_since(start);
+
+    if(batch_found != found) {
+        fprintf(stderr, "%s: batched lookups found %lu keys, not %lu\n",
+                name, batch_found, found);
+    }
+
+    printf("%-10s %8.3f s %8.3f s %8.3f s %8.3f s %8.3f s  "
+            "(%lu found, sum %lu)\n", name, insert, lookup, batched, iterate,
+            remove, found, sum);
+
+    map_free(map);
+}
+
+static void run_hashtable(void)
+{
+    double insert, lookup, iterate, remove;
+    unsigned long i, found, state, key, sum;
+    HashTableIterator *it;
+    HashTable *table;
+    clock_t start;
+
+    table = hashtable_create(util_hash_ulong, ulong_compare);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        hashtable_insert(table, &keys[i], &keys[i]);
+    }
+    insert = seconds_since(start);
+
+    state = 88675123UL;
+    start = clock();
+    for(i = 0, found = 0; i < LOOKUPS; i++) {
+        key = keys[next_random(&state) % MAP_SIZE] + (i & 1);
+        if(hashtable_find(table, &key) != NULL) {
+            found++;
+        }
+    }
+    lookup = seconds_since(start);
+
+    start = clock();
+    for(it = hashtable_begin(table), sum = 0; it != NULL;
+            it = hashtable_next(it)) {
+        sum += *(const unsigned long *)hashtable_get_key(it);
+    }
+    iterate = seconds_since(start);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        hashtable_remove(table, &keys[i]);
+    }
+    remove = seconds_since(start);
+
+    printf("%-10s %8.3f s %8.3f s %10s %8.3f s %8.3f s  "
+            "(%lu found, sum %lu)\n", "hashtable", insert, lookup, "-",
+            iterate, remove, found, sum);
+
+    hashtable_free(table);
+}
+
+static void run_swiss_table(void)
+{
+    double insert, lookup, iterate, remove;
+    unsigned long i, found, state, key, sum;
+    SwissTableIterator *it;
+    SwissTable *table;
+    clock_t start;
+
+    table = swiss_table_create(util_hash_ulong, ulong_compare);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        swiss_table_insert(table, &keys[i], &keys[i]);
+    }
+    insert = seconds_since(start);
+
+    state = 88675123UL;
+    start = clock();
+    for(i = 0, found = 0; i < LOOKUPS; i++) {
+        key = keys[next_random(&state) % MAP_SIZE] + (i & 1);
+        if(swiss_table_find(table, &key) != NULL) {
+            found++;
+        }
+    }
+    lookup = seconds_since(start);
+
+    start = clock();
+    for(it = swiss_table_begin(table), sum = 0; it != NULL;
+            it = swiss_table_next(it)) {
+        sum += *(const unsigned long *)swiss_table_get_key(it);
+    }
+    iterate = seconds_since(start);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        swiss_table_remove(table, &keys[i]);
+    }
+    remove = seconds_since(start);
+
+    printf("%-10s %8.3f s %8.3f s %10s %8.3f s %8.3f s  "
+            "(%lu found, sum %lu)\n", "swisstable", insert, lookup, "-",
+            iterate, remove, found, sum);
+
+    swiss_table_free(table);
+}
+
+static void run_typed_map(void)
+{
+    double insert, lookup, iterate, remove;
+    unsigned long i, found, state, key, sum;
+    ULongMap_node *it;
+    ULongMap *map;
+    clock_t start;
+
+    map = ULongMap_create();
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        ULongMap_insert(map, keys[i], keys[i]);
+    }
+    insert = seconds_since(start);
+
+    state = 88675123UL;
+    start = clock();
+    for(i = 0, found = 0; i < LOOKUPS; i++) {
+        key = keys[next_random(&state) % MAP_SIZE] + (i & 1);
+        if(ULongMap_find(map, key) != NULL) {
+            found++;
+        }
+    }
+    lookup = seconds_since(start);
+
+    start = clock();
+    for(it = ULongMap_begin(map), sum = 0; it != NULL;
+            it = ULongMap_next(it)) {
+        sum += it->key;
+    }
+    iterate = seconds_since(start);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        ULongMap_remove(map, keys[i], NULL);
+    }
+    remove = seconds_since(start);
+
+    printf("%-10s %8.3f s %8.3f s %10s %8.3f s %8.3f s  "
+            "(%lu found, sum %lu)\n", "typed map", insert, lookup, "-",
+            iterate, remove, found, sum);
+
+    ULongMap_free(map);
+}
+
+static void run_art(void)
+{
+    double insert, lookup, iterate, remove;
+    unsigned long i, found, state, key, sum;
+    ARTIterator *it;
+    clock_t start;
+    ART *art;
+
+    art = art_create();
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        art_insert_ulong(art, keys[i], &keys[i]);
+    }
+    insert = seconds_since(start);
+
+    state = 88675123UL;
+    start = clock();
+    for(i = 0, found = 0; i < LOOKUPS; i++) {
+        key = keys[next_random(&state) % MAP_SIZE] + (i & 1);
+        if(art_find_ulong(art, key) != NULL) {
+            found++;
+        }
+    }
+    lookup = seconds_since(start);
+
+    start = clock();
+    for(it = art_begin(art), sum = 0; it != NULL; it = art_next(it)) {
+        sum += *(unsigned long *)art_get_value(it);
+    }
+    iterate = seconds_since(start);
+
+    start = clock();
+    for(i = 0; i < MAP_SIZE; i++) {
+        art_remove_ulong(art, keys[i]);
+    }
+    remove = seconds_since(start);
+
+    printf("%-10s %8.3f s %8.3f s %10s %8.3f s %8.3f s  "
+            "(%lu found, sum %lu)\n", "art", insert, lookup, "-",
+            iterate, remove, found, sum);
+
+    art_free(art);
+}
+
+int main(void)
+{
+    unsigned long i, state;
+
+    /* Even keys, so that odd ones always miss */
+    keys = malloc(sizeof(unsigned long) * MAP_SIZE);
+    if(NULL == keys) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    state = 2463534242UL;
+    for(i = 0; i < MAP_SIZE; i++) {
+        keys[i] = 2 * (next_random(&state) >> 1);
+    }
+
+    printf("%-10s %10s %10s %10s %10s %10s\n", "backend", "insert", "lookup",
+            "batched", "iterate", "remove");
+    run("rbtree", map_create);
+    run("btree", map_create_btree);
+    run_typed_map();
+    run_art();
+    run_hashtable();
+    run_swiss_table();
+
+    free(keys);
+
+    return 0;
+}
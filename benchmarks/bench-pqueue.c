@@ -0,0 +1,237 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Dijkstra-like workload: single-source shortest paths over a random
+ * sparse graph with integer edge weights, using lazy deletion (a
+ * vertex is pushed once per successful relaxation and stale entries
+ * are skipped when popped). Every priority queue backend runs the
+ * same search and must produce the same distances.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libcore/keyheap.h>
+#include <libcore/priority_queue.h>
+
+#define NUM_VERTICES    1000000UL
+#define OUT_DEGREE      8UL
+#define MAX_WEIGHT      1000UL
+
+struct item {
+    unsigned long dist;
+    unsigned long vertex;
+};
+
+/* Compressed sparse row adjacency */
+static unsigned long *edge_target;
+static unsigned long *edge_weight;
+static unsigned long *dist;
+
+static struct item *pool;
+static unsigned long pool_next;
+
+/* a is greater than b if its distance is smaller */
+static int item_compare(const void *a, const void *b)
+{
+    unsigned long da = ((const struct item *)a)->dist;
+    unsigned long db = ((const struct item *)b)->dist;
+
+    return (da < db) ? 1 : ((da > db) ? -1 : 0);
+}
+
+static void build_graph(void)
+{
+    unsigned long i, nedges;
+
+    nedges = NUM_VERTICES * OUT_DEGREE;
+
+    edge_target = malloc(sizeof(unsigned long) * nedges);
+    edge_weight = malloc(sizeof(unsigned long) * nedges);
+    dist = malloc(sizeof(unsigned long) * NUM_VERTICES);
+    pool = malloc(sizeof(struct item) * (nedges + 1));
+
+    if(!edge_target || !edge_weight || !dist || !pool) {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for(i = 0; i < nedges; i++) {
+        edge_target[i] = (unsigned long)rand() % NUM_VERTICES;
+        edge_weight[i] = 1 + (unsigned long)rand() % MAX_WEIGHT;
+    }
+}
+
+static void reset_dist(void)
+{
+    unsigned long i;
+
+    for(i = 0; i < NUM_VERTICES; i++) {
+        dist[i] = ULONG_MAX;
+    }
+
+    pool_next = 0;
+}
+
+static unsigned long checksum(void)
+{
+    unsigned long i, sum = 0;
+
+    for(i = 0; i < NUM_VERTICES; i++) {
+        if(dist[i] != ULONG_MAX) {
+            sum += dist[i];
+        }
+    }
+
+    return sum;
+}
+
+static void relax_edges(unsigned long v, unsigned long d,
+        void (*push)(void *q, unsigned long d, unsigned long w), void *q)
+{
+    unsigned long e, w, nd;
+
+    for(e = v * OUT_DEGREE; e < (v + 1) * OUT_DEGREE; e++) {
+        w = edge_target[e];
+        nd = d + edge_weight[e];
+        if(nd < dist[w]) {
+            dist[w] = nd;
+            push(q, nd, w);
+        }
+    }
+}
+
+static struct item* make_item(unsigned long d, unsigned long w)
+{
+    struct item *it = &pool[pool_next++];
+
+    it->dist = d;
+    it->vertex = w;
+
+    return it;
+}
+
+static void push_pqueue(void *q, unsigned long d, unsigned long w)
+{
+    pqueue_push((PQueue *)q, make_item(d, w));
+}
+
+static void push_radix(void *q, unsigned long d, unsigned long w)
+{
+    pqueue_push_key((PQueue *)q, d, make_item(d, w));
+}
+
+static void push_keyheap(void *q, unsigned long d, unsigned long w)
+{
+    keyheap_push((KeyHeap *)q, (double)d, make_item(d, w));
+}
+
+static void dijkstra_pqueue(PQueue *pq,
+        void (*push)(void *q, unsigned long d, unsigned long w))
+{
+    struct item *it;
+
+    reset_dist();
+    dist[0] = 0;
+    push(pq, 0, 0);
+
+    while((it = pqueue_pop(pq)) != NULL) {
+        /* Skip entries made stale by a later relaxation */
+        if(it->dist == dist[it->vertex]) {
+            relax_edges(it->vertex, it->dist, push, pq);
+        }
+    }
+}
+
+static void dijkstra_keyheap(KeyHeap *kh)
+{
+    struct item *it;
+    double d;
+
+    reset_dist();
+    dist[0] = 0;
+    push_keyheap(kh, 0, 0);
+
+    while((it = keyheap_pop(kh, &d)) != NULL) {
+        if((unsigned long)d == dist[it->vertex]) {
+            relax_edges(it->vertex, it->dist, push_keyheap, kh);
+        }
+    }
+}
+
+static void report(const char *name, clock_t start)
+{
+    printf("%-24s %8.3f s   checksum %lu\n", name,
+            (double)(clock() - start) / CLOCKS_PER_SEC, checksum());
+}
+
+int main(void)
+{
+    PQueue *pq;
+    KeyHeap *kh;
+    clock_t start;
+
+    srand(42);
+    build_graph();
+
+    printf("Dijkstra, %lu vertices, %lu edges, weights 1..%lu\n\n",
+            NUM_VERTICES, NUM_VERTICES * OUT_DEGREE, MAX_WEIGHT);
+
+    pq = pqueue_create((CompareFn)item_compare);
+    start = clock();
+    dijkstra_pqueue(pq, push_pqueue);
+    report("pqueue (binary heap)", start);
+    pqueue_free(pq);
+
+    pq = pqueue_create_dary((CompareFn)item_compare, 4);
+    start = clock();
+    dijkstra_pqueue(pq, push_pqueue);
+    report("pqueue (4-ary heap)", start);
+    pqueue_free(pq);
+
+    pq = pqueue_create_dary((CompareFn)item_compare, 8);
+    start = clock();
+    dijkstra_pqueue(pq, push_pqueue);
+    report("pqueue (8-ary heap)", start);
+    pqueue_free(pq);
+
+    kh = keyheap_create();
+    start = clock();
+    dijkstra_keyheap(kh);
+    report("keyheap", start);
+    keyheap_free(kh);
+
+    pq = pqueue_create_radix();
+    start = clock();
+    dijkstra_pqueue(pq, push_radix);
+    report("pqueue (radix heap)", start);
+    pqueue_free(pq);
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Set algebra on two large sets. Sets that share a comparator are
+ * combined by a linear merge; giving the second set a distinct (but
+ * equivalent) comparator forces the lookup-and-insert paths, for
+ * comparison. The destructive, join-based parallel versions are then
+ * timed (wall clock) against equal sizes and against a small second set.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libcore/set.h>
+
+#define SET_SIZE    1000000UL
+
+static unsigned long *values;
+
+static int ulong_compare(const void *a, const void *b)
+{
+    unsigned long ua = *(const unsigned long *)a;
+    unsigned long ub = *(const unsigned long *)b;
+
+    return (ua > ub) ? 1 : ((ua < ub) ? -1 : 0);
+}
+
+static int ulong_compare_other(const void *a, const void *b)
+{
+    return ulong_compare(a, b);
+}
+
+static Set* make_set(CompareFn comparefn, unsigned long first,
+        unsigned long size)
+{
+    unsigned long i;
+    Set *set;
+
+    set = set_create(comparefn);
+    for(i = first; i < first + size; i++) {
+        set_insert(set, &values[i]);
+    }
+
+    return set;
+}
+
+static void run(const char *name, Set* (*op)(Set *, Set *), Set *set1,
+        Set *set2, Set *set2_other)
+{
+    clock_t start;
+    double merged, looked_up;
+    Set *result;
+
+    start = clock();
+    result = op(set1, set2);
+    merged = (double)(clock() - start) / CLOCKS_PER_SEC;
+    set_free(result);
+
+    start = clock();
+    result = op(set1, set2_other);
+    looked_up = (double)(clock() - start) / CLOCKS_PER_SEC;
+    set_free(result);
+
+    printf("%-12s %10.3f s %12.3f s\n", name, merged, looked_up);
+}
+
+static void run_parallel(const char *name,
+        Set* (*op)(Set *, Set *, unsigned int, FreeFn), unsigned long size2)
+{
+    struct timespec start, end;
+    unsigned int nthreads;
+    Set *set1, *set2, *result;
+
+    printf("%-12s %8lu", name, size2);
+
+    for(nthreads = 1; nthreads <= 8; nthreads *= 2) {
+        /* The operation consumes its inputs */
+        set1 = make_set(ulong_compare, 0, SET_SIZE);
+        set2 = make_set(ulong_compare, SET_SIZE / 2, size2);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result = op(set1, set2, nthreads, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        printf(" %8.3f s", (end.tv_sec - start.tv_sec) +
+                (end.tv_nsec - start.tv_nsec) / 1e9);
+        set_free(result);
+    }
+
+    printf("\n");
+}
+
+int main(void)
+{
+    Set *set1, *set2, *set2_other;
+    unsigned long i;
+
+    /* Even values, so that the two sets half overlap */
+    values = malloc(sizeof(unsigned long) * 2 * SET_SIZE);
+    if(NULL == values) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for(i = 0; i < 2 * SET_SIZE; i++) {
+        values[i] = 2 * i;
+    }
+
+    set1 = make_set(ulong_compare, 0, SET_SIZE);
+    set2 = make_set(ulong_compare, SET_SIZE / 2, SET_SIZE);
+    set2_other = make_set(ulong_compare_other, SET_SIZE / 2, SET_SIZE);
+
+    printf("%-12s %12s %14s\n", "operation", "merge", "lookup");
+    run("union", set_union, set1, set2, set2_other);
+    run("intersect", set_intersect, set1, set2, set2_other);
+    run("diff", set_diff, set1, set2, set2_other);
+    run("symdiff", set_symdiff, set1, set2, set2_other);
+
+    set_free(set1);
+    set_free(set2);
+    set_free(set2_other);
+
+    printf("\n%-12s %8s %10s %10s %10s %10s\n", "parallel", "|set2|",
+            "1 thread", "2 threads", "4 threads", "8 threads");
+    run_parallel("union", set_union_parallel, SET_SIZE);
+    run_parallel("union", set_union_parallel, 1000);
+    run_parallel("intersect", set_intersect_parallel, SET_SIZE);
+    run_parallel("intersect", set_intersect_parallel, 1000);
+    run_parallel("diff", set_diff_parallel, SET_SIZE);
+    run_parallel("diff", set_diff_parallel, 1000);
+
+    free(values);
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_ART_H__
+#define __LIBCORE_ART_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* An adaptive radix tree: an ordered map keyed by byte strings, which
+ * are compared as by memcmp, a key that is a prefix of another coming
+ * first. Lookups take time in the length of the key, not in the number
+ * of entries, and never call a comparison function. Keys are copied
+ * into the tree, so the caller's copy need not outlive the call.
+ *
+ * The _ulong functions take unsigned long keys, stored most significant
+ * byte first so that they iterate in numerical order. Such keys should
+ * not be mixed with byte strings in the same tree.
+ */
+
+/* Opaque forward declarations */
+typedef struct _art ART;
+typedef struct _art_leaf ARTIterator;
+
+ART*    art_create      (void);
+void    art_free        (ART *art);
+void    art_free_all    (ART *art, FreeFn freefn);
+int     art_insert      (ART *art, const void *key, unsigned long key_len,
+                         void *value);
+void*   art_remove      (ART *art, const void *key, unsigned long key_len);
+int     art_insert_ulong(ART *art, unsigned long key, void *value);
+void*   art_remove_ulong(ART *art, unsigned long key);
+int     art_is_empty    (ART *art);
+int     art_is_valid    (ART *art);
+
+unsigned long   art_size(ART *art);
+
+/* Iterators */
+void*           art_remove_at   (ART *art, ARTIterator *it);
+ARTIterator*    art_find        (ART *art, const void *key,
+                                 unsigned long key_len);
+ARTIterator*    art_find_ulong  (ART *art, unsigned long key);
+ARTIterator*    art_begin       (ART *art);
+ARTIterator*    art_end         (ART *art);
+ARTIterator*    art_next        (ARTIterator *it);
+ARTIterator*    art_prev        (ARTIterator *it);
+
+/* Range queries. An iterator of NULL stands for the end of the tree.
+ * The entries whose keys start with prefix are [*first, *last).
+ */
+ARTIterator*    art_lower_bound (ART *art, const void *key,
+                                 unsigned long key_len);
+ARTIterator*    art_lower_bound_ulong   (ART *art, unsigned long key);
+ARTIterator*    art_upper_bound (ART *art, const void *key,
+                                 unsigned long key_len);
+void            art_prefix_range(ART *art, const void *prefix,
+                                 unsigned long prefix_len,
+                                 ARTIterator **first, ARTIterator **last);
+
+const void*     art_get_key     (ARTIterator *it);
+unsigned long   art_get_key_len (ARTIterator *it);
+unsigned long   art_get_key_ulong   (ARTIterator *it);
+void*           art_get_value   (ARTIterator *it);
+void*           art_set_value   (ARTIterator *it, void *value);
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,82 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_BTREE_H__
+#define __LIBCORE_BTREE_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* Opaque forward declarations */
+typedef struct _btree BTree;
+typedef struct _btree_iterator BTreeIterator;
+
+BTree*  btree_create        (CompareFn comparefn);
+void    btree_free          (BTree *btree);
+void    btree_free_all      (BTree *btree, FreeFn freefn);
+int     btree_insert        (BTree *btree, const void *key, void *value);
+void*   btree_remove        (BTree *btree, const void *key);
+int     btree_is_empty      (BTree *btree);
+int     btree_is_valid      (BTree *btree);
+
+unsigned long   btree_size          (BTree *btree);
+unsigned long   btree_rank          (BTree *btree, const void *key);
+
+CompareFn       btree_get_comparefn (BTree *btree);
+
+/* Iterators, invalidated by any insertion or removal */
+BTreeIterator*  btree_find_or_insert (BTree *btree, const void *key,
+                                      void *value, int *inserted);
+void*           btree_remove_at (BTree *btree, BTreeIterator *it);
+BTreeIterator*  btree_find      (BTree *btree, const void *key);
+BTreeIterator*  btree_begin     (BTree *btree);
+BTreeIterator*  btree_end       (BTree *btree);
+BTreeIterator*  btree_next      (BTreeIterator *it);
+BTreeIterator*  btree_prev      (BTreeIterator *it);
+BTreeIterator*  btree_select    (BTree *btree, unsigned long index);
+
+/* Range queries, as for RBTree */
+BTreeIterator*  btree_lower_bound   (BTree *btree, const void *key);
+BTreeIterator*  btree_upper_bound   (BTree *btree, const void *key);
+void            btree_equal_range   (BTree *btree, const void *key,
+                                     BTreeIterator **first,
+                                     BTreeIterator **last);
+unsigned long   btree_count_range   (BTree *btree, const void *lo,
+                                     const void *hi);
+
+const void*     btree_get_key   (BTreeIterator *it);
+void*           btree_get_value (BTreeIterator *it);
+void*           btree_set_value (BTreeIterator *it, void *value);
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_CONCURRENT_HASHMAP_H__
+#define __LIBCORE_CONCURRENT_HASHMAP_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* A hash map that may be shared between threads. All operations are
+ * thread-safe.
+ *
+ * Lookups take no lock and write nothing shared, so any number of them
+ * proceed in parallel. Insertions and removals lock one of a fixed set
+ * of stripes, chosen by the key's hash, so writers only contend when
+ * their keys fall in the same stripe. Growing the table never blocks
+ * everything at once: buckets are moved to the larger table one at a
+ * time, by whichever writers come along.
+ *
+ * As with any map, a key or value that one thread removes may still be
+ * in use by another thread that looked it up just before; freeing it is
+ * up to the caller, once no other thread can be using it.
+ */
+
+/* Opaque forward declaration */
+typedef struct _chashmap CHashMap;
+
+CHashMap*   chashmap_create     (HashFn hashfn, CompareFn comparefn);
+void        chashmap_free       (CHashMap *map);
+void        chashmap_free_all   (CHashMap *map, FreeFn freefn);
+int         chashmap_insert     (CHashMap *map, const void *key,
+                                 void *value);
+void*       chashmap_remove     (CHashMap *map, const void *key);
+void*       chashmap_get        (CHashMap *map, const void *key);
+int         chashmap_is_empty   (CHashMap *map);
+
+unsigned long   chashmap_size   (CHashMap *map);
+
+#if __cplusplus
+}
+#endif
+
+#endif
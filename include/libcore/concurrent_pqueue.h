@@ -0,0 +1,75 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_CONCURRENT_PQUEUE_H__
+#define __LIBCORE_CONCURRENT_PQUEUE_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* A priority queue that may be shared between threads. All operations
+ * are thread-safe.
+ *
+ * CPQUEUE_STRICT is a single heap behind a lock: pops always return the
+ * highest priority item, but every operation is serialized.
+ *
+ * CPQUEUE_RELAXED is a MultiQueue: items are spread over several
+ * independently locked heaps, and a pop takes the better of the tops
+ * of two randomly chosen heaps. Pops return an item close to, but not
+ * necessarily exactly, the highest priority one, in exchange for
+ * throughput that scales with the number of threads. A pop returns
+ * NULL only after finding every heap empty; with concurrent pushes and
+ * pops, items may still have been moving between heaps meanwhile.
+ */
+
+typedef enum {
+    CPQUEUE_STRICT,
+    CPQUEUE_RELAXED
+} CPQUEUE_MODE;
+
+/* Opaque forward declaration */
+typedef struct _cpqueue CPQueue;
+
+CPQueue* cpqueue_create     (CompareFn comparefn, CPQUEUE_MODE mode,
+                             unsigned int nqueues);
+void    cpqueue_free        (CPQueue *cpqueue);
+void    cpqueue_free_all    (CPQueue *cpqueue, FreeFn freefn);
+int     cpqueue_push        (CPQueue *cpqueue, void *data);
+void*   cpqueue_pop         (CPQueue *cpqueue);
+
+int     cpqueue_is_empty    (CPQueue *cpqueue);
+
+unsigned long cpqueue_size  (CPQueue *cpqueue);
+
+#if __cplusplus
+}
+#endif
+
+#endif
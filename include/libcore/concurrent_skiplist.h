@@ -0,0 +1,78 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_CONCURRENT_SKIPLIST_H__
+#define __LIBCORE_CONCURRENT_SKIPLIST_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* An ordered map of unique keys that may be shared between threads. All
+ * operations are thread-safe, and none of them takes a lock: a thread
+ * that stalls never holds up the others.
+ *
+ * Removed nodes are only freed once no thread can still be reading
+ * them. As with any map, the key and value of a removed entry may still
+ * be in use by another thread that looked them up just before; freeing
+ * them is up to the caller, once no other thread can be using them.
+ */
+
+/* Opaque forward declaration */
+typedef struct _cskiplist CSkipList;
+
+/* Called by cskiplist_scan for each entry in the range, in order.
+ * Returning non-zero stops the scan.
+ */
+typedef int (*CSkipListVisitFn)(const void *key, void *value, void *data);
+
+CSkipList*  cskiplist_create    (CompareFn comparefn);
+void        cskiplist_free      (CSkipList *list);
+void        cskiplist_free_all  (CSkipList *list, FreeFn freefn);
+int         cskiplist_insert    (CSkipList *list, const void *key,
+                                 void *value);
+void*       cskiplist_remove    (CSkipList *list, const void *key);
+void*       cskiplist_get       (CSkipList *list, const void *key);
+int         cskiplist_is_empty  (CSkipList *list);
+
+unsigned long   cskiplist_size  (CSkipList *list);
+
+/* Visits the entries with keys in [lo, hi), where a lo or hi of NULL
+ * leaves that end open. Entries inserted or removed during the scan
+ * may or may not be visited. Returns the number of entries visited.
+ */
+unsigned long   cskiplist_scan  (CSkipList *list, const void *lo,
+                                 const void *hi, CSkipListVisitFn fn,
+                                 void *data);
+
+#if __cplusplus
+}
+#endif
+
+#endif
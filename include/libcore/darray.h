@@ -47,6 +47,7 @@ int     darray_insert       (DArray *darray, unsigned long index,
                              void *data);
 void*   darray_remove       (DArray *darray, unsigned long index);
 void*   darray_index        (const DArray *darray, unsigned long index);
+void**  darray_data         (const DArray *darray);
 int     darray_replace      (DArray *darray, unsigned long index,
                              void *data);
 int     darray_swap         (DArray *darray, unsigned long index1,
@@ -0,0 +1,67 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_HASHTABLE_H__
+#define __LIBCORE_HASHTABLE_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* Opaque forward declarations */
+typedef struct _hashtable HashTable;
+typedef struct _hashtable_slot HashTableIterator;
+
+HashTable*  hashtable_create    (HashFn hashfn, CompareFn comparefn);
+void        hashtable_free      (HashTable *table);
+void        hashtable_free_all  (HashTable *table, FreeFn freefn);
+int         hashtable_insert    (HashTable *table, const void *key,
+                                 void *value);
+void*       hashtable_remove    (HashTable *table, const void *key);
+int         hashtable_is_empty  (HashTable *table);
+
+unsigned long   hashtable_size  (HashTable *table);
+
+/* Iterators, in no particular order, invalidated by any insertion or
+ * removal
+ */
+void*               hashtable_remove_at (HashTable *table,
+                                         HashTableIterator *it);
+HashTableIterator*  hashtable_find      (HashTable *table, const void *key);
+HashTableIterator*  hashtable_begin     (HashTable *table);
+HashTableIterator*  hashtable_next      (HashTableIterator *it);
+
+const void*     hashtable_get_key   (HashTableIterator *it);
+void*           hashtable_get_value (HashTableIterator *it);
+
+#if __cplusplus
+}
+#endif
+
+#endif
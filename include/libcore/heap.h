@@ -32,24 +32,31 @@
 extern "C" {
 #endif
 
+#include <libcore/darray.h>
 #include <libcore/types.h>
 
 /* Opaque forward declaration */
 typedef struct _heap Heap;
 
 Heap*   heap_create     (CompareFn comparefn);
+Heap*   heap_create_dary(CompareFn comparefn, unsigned int arity);
+Heap*   heap_create_from_darray(CompareFn comparefn, unsigned int arity,
+                                DArray *darray);
 void    heap_free       (Heap *heap);
 void    heap_free_all   (Heap *heap, FreeFn freefn);
 int     heap_push       (Heap *heap, void *data);
+int     heap_push_many  (Heap *heap, DArray *items);
 void*   heap_pop        (Heap *heap);
 void*   heap_top        (Heap *heap);
 int     heap_remove     (Heap *heap, const void *data);
 int     heap_merge      (Heap *heap1, Heap* heap2);
+int     heap_sort       (DArray *darray, CompareFn comparefn);
 
 int     heap_is_valid   (Heap *heap);
 int     heap_is_empty   (Heap *heap);
 
 unsigned long heap_size (Heap *heap);
+unsigned int  heap_arity(Heap *heap);
 
 #if __cplusplus
 }
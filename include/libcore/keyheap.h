@@ -0,0 +1,62 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_KEYHEAP_H__
+#define __LIBCORE_KEYHEAP_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* A min-heap ordered on a numeric key stored inline next to each data
+ * pointer. Unlike Heap, no CompareFn is involved: comparisons read
+ * only the heap array, never the user's objects.
+ */
+
+/* Opaque forward declaration */
+typedef struct _keyheap KeyHeap;
+
+KeyHeap* keyheap_create     (void);
+void     keyheap_free       (KeyHeap *keyheap);
+void     keyheap_free_all   (KeyHeap *keyheap, FreeFn freefn);
+int      keyheap_push       (KeyHeap *keyheap, double key, void *data);
+void*    keyheap_pop        (KeyHeap *keyheap, double *key);
+void*    keyheap_top        (KeyHeap *keyheap, double *key);
+int      keyheap_remove     (KeyHeap *keyheap, const void *data);
+
+int      keyheap_is_valid   (KeyHeap *keyheap);
+int      keyheap_is_empty   (KeyHeap *keyheap);
+
+unsigned long keyheap_size  (KeyHeap *keyheap);
+
+#if __cplusplus
+}
+#endif
+
+#endif
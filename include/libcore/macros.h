@@ -35,6 +35,24 @@ extern "C" {
 #define MAX(a,b)    ((a) > (b) ? (a) : (b))
 #define MIN(a,b)    ((a) < (b) ? (a) : (b))
 
+/* Marks functions defined in headers, like those of the typed
+ * containers, for inlining. C89 has no inline keyword of its own.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define LIBCORE_INLINE  inline
+#elif defined(__GNUC__)
+#define LIBCORE_INLINE  __inline__
+#else
+#define LIBCORE_INLINE
+#endif
+
+/* Hints that the memory at addr is about to be read */
+#if defined(__GNUC__)
+#define LIBCORE_PREFETCH(addr)  __builtin_prefetch(addr)
+#else
+#define LIBCORE_PREFETCH(addr)  ((void)(addr))
+#endif
+
 #ifdef __cplusplus
 }
 #endif
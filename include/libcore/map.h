@@ -32,32 +32,69 @@
 extern "C" {
 #endif
 
+#include <libcore/darray.h>
 #include <libcore/types.h>
 
 /* Opaque forward declarations */
 typedef struct _map Map;
 typedef struct _map_iterator MapIterator;
 
+/* Given the current value of a key, or NULL if the key is new, returns
+ * the value to store. See map_upsert.
+ */
+typedef void* (*MapUpsertFn)(void *value, void *data);
+
 Map*    map_create      (CompareFn comparefn);
+Map*    map_create_btree        (CompareFn comparefn);
+Map*    map_create_inline       (CompareFn comparefn,
+                                 unsigned long value_size);
+
+/* The nodes of a map built from sorted input are allocated in one
+ * block, which is only freed with the last map holding any of them.
+ * Nodes removed before then are reused by later insertions.
+ */
+Map*    map_create_from_sorted  (CompareFn comparefn, const DArray *keys,
+                                 const DArray *values);
+
 void    map_free        (Map *map);
 void    map_free_all    (Map *map, FreeFn freefn);
 int     map_insert      (Map *map, const void *key, void *value);
 void*   map_remove      (Map *map, const void *key);
 
+/* Lookups that insert on a miss, in a single descent */
+void*   map_get_or_insert   (Map *map, const void *key, void *value,
+                             int *inserted);
+int     map_upsert          (Map *map, const void *key, MapUpsertFn fn,
+                             void *data);
+int     map_insert_or_assign(Map *map, const void *key, void *value,
+                             void **old_value);
+
 unsigned long   map_size            (Map *map);
+unsigned long   map_rank            (Map *map, const void *key);
 
 CompareFn       map_get_comparefn   (Map *map);
 
 /* Iterators */
 void*           map_remove_at   (Map *map, MapIterator *it);
 MapIterator*    map_find        (Map *map, const void *key);
+unsigned long   map_find_many   (Map *map, const void **keys, unsigned long n,
+                                 MapIterator **its);
 MapIterator*    map_begin       (Map *map);
 MapIterator*    map_end         (Map *map);
 MapIterator*    map_next        (MapIterator *it);
 MapIterator*    map_prev        (MapIterator *it);
+MapIterator*    map_select      (Map *map, unsigned long index);
+
+/* Range queries. An iterator of NULL stands for the end of the map. */
+MapIterator*    map_lower_bound (Map *map, const void *key);
+MapIterator*    map_upper_bound (Map *map, const void *key);
+void            map_equal_range (Map *map, const void *key,
+                                 MapIterator **first, MapIterator **last);
+unsigned long   map_count_range (Map *map, const void *lo, const void *hi);
 
 const void*     map_get_key     (MapIterator *it);
 void*           map_get_value   (MapIterator *it);
+void*           map_set_value   (Map *map, MapIterator *it, void *value);
 
 #if __cplusplus
 }
@@ -0,0 +1,62 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_MINMAX_HEAP_H__
+#define __LIBCORE_MINMAX_HEAP_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* A double-ended priority queue. Both the highest and the lowest
+ * priority items are available in O(1) and removable in O(log n).
+ */
+
+/* Opaque forward declaration */
+typedef struct _mmheap MinMaxHeap;
+
+MinMaxHeap* mmheap_create   (CompareFn comparefn);
+void    mmheap_free         (MinMaxHeap *mmheap);
+void    mmheap_free_all     (MinMaxHeap *mmheap, FreeFn freefn);
+int     mmheap_push         (MinMaxHeap *mmheap, void *data);
+void*   mmheap_pop_min      (MinMaxHeap *mmheap);
+void*   mmheap_pop_max      (MinMaxHeap *mmheap);
+void*   mmheap_top_min      (MinMaxHeap *mmheap);
+void*   mmheap_top_max      (MinMaxHeap *mmheap);
+
+int     mmheap_is_valid     (MinMaxHeap *mmheap);
+int     mmheap_is_empty     (MinMaxHeap *mmheap);
+
+unsigned long mmheap_size   (MinMaxHeap *mmheap);
+
+#if __cplusplus
+}
+#endif
+
+#endif
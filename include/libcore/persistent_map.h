@@ -0,0 +1,90 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_PERSISTENT_MAP_H__
+#define __LIBCORE_PERSISTENT_MAP_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* An ordered map whose versions can be kept for free. pmap_snapshot
+ * returns, in O(1), a new PMap holding the current contents; later
+ * insertions and removals through either one leave the other as it
+ * was. The two share every node that neither has changed since.
+ *
+ * A snapshot may be handed to other threads and read there without any
+ * locking, while the writer goes on changing its own PMap. Each PMap
+ * must only be used by one thread at a time, but snapshots may be taken
+ * and freed from any thread.
+ *
+ * Keys and values are only referenced, never freed by the map, as any
+ * of them may still be in other versions.
+ */
+
+/* Opaque forward declaration */
+typedef struct _pmap PMap;
+
+/* Called by pmap_scan for each entry in the range, in order. Returning
+ * non-zero stops the scan.
+ */
+typedef int (*PMapVisitFn)(const void *key, void *value, void *data);
+
+PMap*   pmap_create     (CompareFn comparefn);
+PMap*   pmap_snapshot   (PMap *map);
+void    pmap_free       (PMap *map);
+int     pmap_insert     (PMap *map, const void *key, void *value);
+void*   pmap_remove     (PMap *map, const void *key);
+void*   pmap_get        (PMap *map, const void *key);
+int     pmap_contains   (PMap *map, const void *key);
+int     pmap_is_empty   (PMap *map);
+int     pmap_is_valid   (PMap *map);
+
+unsigned long   pmap_size   (PMap *map);
+unsigned long   pmap_rank   (PMap *map, const void *key);
+
+/* Stores the key and value at index, in key order, in *key and *value
+ * if not NULL. Returns -1 if index is out of range.
+ */
+int     pmap_select     (PMap *map, unsigned long index, const void **key,
+                         void **value);
+
+/* Visits the entries with keys in [lo, hi), where a lo or hi of NULL
+ * leaves that end open. fn must not change map; to go on changing a
+ * map while its entries are visited, scan a snapshot of it instead.
+ * Returns the number of entries visited.
+ */
+unsigned long   pmap_scan   (PMap *map, const void *lo, const void *hi,
+                             PMapVisitFn fn, void *data);
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -32,15 +32,20 @@
 extern "C" {
 #endif
 
+#include <libcore/darray.h>
 #include <libcore/types.h>
 
 /* Opaque forward declaration */
 typedef struct _pqueue PQueue;
 
 PQueue* pqueue_create        (CompareFn comparefn);
+PQueue* pqueue_create_dary   (CompareFn comparefn, unsigned int arity);
+PQueue* pqueue_create_radix  (void);
 void    pqueue_free          (PQueue *pqueue);
 void    pqueue_free_all      (PQueue *pqueue, FreeFn freefn);
 int     pqueue_push          (PQueue *pqueue, void *data);
+int     pqueue_push_many     (PQueue *pqueue, DArray *items);
+int     pqueue_push_key      (PQueue *pqueue, unsigned long key, void *data);
 void*   pqueue_pop           (PQueue *pqueue);
 void*   pqueue_top           (PQueue *pqueue);
 
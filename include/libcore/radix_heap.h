@@ -0,0 +1,64 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_RADIX_HEAP_H__
+#define __LIBCORE_RADIX_HEAP_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* A monotone min-priority queue for integer keys. The key of every
+ * push must be no smaller than the key most recently popped, which
+ * holds for Dijkstra's algorithm and discrete-event simulation. In
+ * return, push is O(1) and pop is amortized O(log C), where C is the
+ * largest key, with no comparisons between user objects.
+ */
+
+/* Opaque forward declaration */
+typedef struct _radix_heap RadixHeap;
+
+RadixHeap*  radix_heap_create   (void);
+void        radix_heap_free     (RadixHeap *rheap);
+void        radix_heap_free_all (RadixHeap *rheap, FreeFn freefn);
+int         radix_heap_push     (RadixHeap *rheap, unsigned long key,
+                                 void *data);
+void*       radix_heap_pop      (RadixHeap *rheap, unsigned long *key);
+void*       radix_heap_top      (RadixHeap *rheap, unsigned long *key);
+
+int         radix_heap_is_empty (RadixHeap *rheap);
+
+unsigned long radix_heap_size   (RadixHeap *rheap);
+unsigned long radix_heap_last   (RadixHeap *rheap);
+
+#if __cplusplus
+}
+#endif
+
+#endif
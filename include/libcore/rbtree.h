@@ -32,6 +32,7 @@
 extern "C" {
 #endif
 
+#include <libcore/darray.h>
 #include <libcore/types.h>
 
 /* Opaque forward declarations */
@@ -39,6 +40,16 @@ typedef struct _rbtree RBTree;
 typedef struct _rbtree_node RBTreeIterator;
 
 RBTree* rbtree_create       (CompareFn comparefn);
+RBTree* rbtree_create_inline(CompareFn comparefn, unsigned long value_size);
+
+/* The nodes of a tree built from sorted input are allocated in one
+ * block, which is only freed with the last tree holding any of them.
+ * Nodes removed before then are reused by later insertions.
+ */
+RBTree* rbtree_create_from_sorted   (CompareFn comparefn, const DArray *keys,
+                                     const DArray *values,
+                                     int duplicates_allowed);
+
 void    rbtree_free         (RBTree *rbtree);
 void    rbtree_free_all     (RBTree *rbtree, FreeFn freefn);
 int     rbtree_insert_equal (RBTree *rbtree, const void *key, void *value);
@@ -48,6 +59,7 @@ int     rbtree_is_empty     (RBTree *rbtree);
 int     rbtree_is_valid     (RBTree *rbtree);
 
 unsigned long   rbtree_size         (RBTree *rbtree);
+unsigned long   rbtree_rank         (RBTree *rbtree, const void *key);
 
 CompareFn       rbtree_get_comparefn(RBTree *rbtree);
 
@@ -58,15 +70,45 @@ RBTreeIterator* rbtree_insert_equal_at  (RBTree *rbtree, RBTreeIterator *it,
 RBTreeIterator* rbtree_insert_unique_at (RBTree *rbtree, RBTreeIterator *it,
                                          const void *key, void *value,
                                          int *success);
+RBTreeIterator* rbtree_find_or_insert   (RBTree *rbtree, const void *key,
+                                         void *value, int *inserted);
 void*           rbtree_remove_at    (RBTree *rbtree, RBTreeIterator *it);
 RBTreeIterator* rbtree_find         (RBTree *rbtree, const void *key);
+unsigned long   rbtree_find_many    (RBTree *rbtree, const void **keys,
+                                     unsigned long n, RBTreeIterator **its);
 RBTreeIterator* rbtree_begin        (RBTree *rbtree);
 RBTreeIterator* rbtree_end          (RBTree *rbtree);
 RBTreeIterator* rbtree_next         (RBTreeIterator *it);
 RBTreeIterator* rbtree_prev         (RBTreeIterator *it);
+RBTreeIterator* rbtree_select       (RBTree *rbtree, unsigned long index);
+
+/* Range queries. An iterator of NULL stands for the end of the tree.
+ * The range of keys equal to key is [*first, *last).
+ */
+RBTreeIterator* rbtree_lower_bound  (RBTree *rbtree, const void *key);
+RBTreeIterator* rbtree_upper_bound  (RBTree *rbtree, const void *key);
+void            rbtree_equal_range  (RBTree *rbtree, const void *key,
+                                     RBTreeIterator **first,
+                                     RBTreeIterator **last);
+unsigned long   rbtree_count_range  (RBTree *rbtree, const void *lo,
+                                     const void *hi);
+
+/* Join, split and set operations consume the trees passed in */
+RBTree* rbtree_join         (RBTree *less, const void *key, void *value,
+                             RBTree *greater);
+int     rbtree_split        (RBTree *rbtree, const void *key, RBTree **less,
+                             RBTree **greater, void **value);
+RBTree* rbtree_union        (RBTree *rbtree1, RBTree *rbtree2,
+                             unsigned int nthreads, FreeFn freefn);
+RBTree* rbtree_intersect    (RBTree *rbtree1, RBTree *rbtree2,
+                             unsigned int nthreads, FreeFn freefn);
+RBTree* rbtree_diff         (RBTree *rbtree1, RBTree *rbtree2,
+                             unsigned int nthreads, FreeFn freefn);
 
 const void* rbtree_get_key      (RBTreeIterator *it);
 void*       rbtree_get_value    (RBTreeIterator *it);
+void*       rbtree_set_value    (RBTree *rbtree, RBTreeIterator *it,
+                                 void *value);
 
 #if __cplusplus
 }
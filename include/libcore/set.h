@@ -32,6 +32,7 @@
 extern "C" {
 #endif
 
+#include <libcore/darray.h>
 #include <libcore/types.h>
 
 /* Opaque forward declarations */
@@ -39,6 +40,14 @@ typedef struct _set Set;
 typedef struct _set_iterator SetIterator;
 
 Set*    set_create      (CompareFn comparefn);
+Set*    set_create_btree        (CompareFn comparefn);
+
+/* The nodes of a set built from sorted input are allocated in one
+ * block, which is only freed with the last set holding any of them.
+ * Nodes removed before then are reused by later insertions.
+ */
+Set*    set_create_from_sorted  (CompareFn comparefn, const DArray *values);
+
 void    set_free        (Set *set);
 void    set_free_all    (Set *set, FreeFn freefn);
 int     set_insert      (Set *set, void *value);
@@ -49,12 +58,21 @@ Set*    set_intersect   (Set *set1, Set *set2);
 Set*    set_diff        (Set *set1, Set *set2);
 Set*    set_symdiff     (Set *set1, Set *set2);
 
+/* Consume both sets */
+Set*    set_union_parallel      (Set *set1, Set *set2, unsigned int nthreads,
+                                 FreeFn freefn);
+Set*    set_intersect_parallel  (Set *set1, Set *set2, unsigned int nthreads,
+                                 FreeFn freefn);
+Set*    set_diff_parallel       (Set *set1, Set *set2, unsigned int nthreads,
+                                 FreeFn freefn);
+
 int     set_is_equal    (Set *set1, Set *set2);
 int     set_is_subset   (Set *set1, Set *set2);
 int     set_is_member   (Set *set, void *value);
 int     set_is_empty    (Set *set);
 
 unsigned long set_size  (Set *set);
+unsigned long set_rank  (Set *set, const void *value);
 
 /* Iterators */
 void*           set_remove_at    (Set *set, SetIterator *it);
@@ -63,6 +81,14 @@ SetIterator*    set_begin        (Set *set);
 SetIterator*    set_end          (Set *set);
 SetIterator*    set_next         (SetIterator *it);
 SetIterator*    set_prev         (SetIterator *it);
+SetIterator*    set_select       (Set *set, unsigned long index);
+
+/* Range queries. An iterator of NULL stands for the end of the set. */
+SetIterator*    set_lower_bound  (Set *set, const void *value);
+SetIterator*    set_upper_bound  (Set *set, const void *value);
+void            set_equal_range  (Set *set, const void *value,
+                                  SetIterator **first, SetIterator **last);
+unsigned long   set_count_range  (Set *set, const void *lo, const void *hi);
 
 void*           set_get_value    (SetIterator *it);
 
@@ -0,0 +1,79 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_SKIPLIST_H__
+#define __LIBCORE_SKIPLIST_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* An ordered map of unique keys, kept as a skip list. Lookups and
+ * updates take O(log n) expected time, and iterating in either
+ * direction is O(1) per step. See concurrent_skiplist.h for a version
+ * that may be shared between threads.
+ */
+
+/* Opaque forward declarations */
+typedef struct _skiplist SkipList;
+typedef struct _skiplist_node SkipListIterator;
+
+SkipList*   skiplist_create     (CompareFn comparefn);
+void        skiplist_free       (SkipList *list);
+void        skiplist_free_all   (SkipList *list, FreeFn freefn);
+int         skiplist_insert     (SkipList *list, const void *key,
+                                 void *value);
+void*       skiplist_remove     (SkipList *list, const void *key);
+int         skiplist_is_empty   (SkipList *list);
+int         skiplist_is_valid   (SkipList *list);
+
+unsigned long   skiplist_size   (SkipList *list);
+
+/* Iterators */
+void*               skiplist_remove_at  (SkipList *list,
+                                         SkipListIterator *it);
+SkipListIterator*   skiplist_find       (SkipList *list, const void *key);
+SkipListIterator*   skiplist_begin      (SkipList *list);
+SkipListIterator*   skiplist_end        (SkipList *list);
+SkipListIterator*   skiplist_next       (SkipListIterator *it);
+SkipListIterator*   skiplist_prev       (SkipListIterator *it);
+
+/* Range queries. An iterator of NULL stands for the end of the list. */
+SkipListIterator*   skiplist_lower_bound(SkipList *list, const void *key);
+SkipListIterator*   skiplist_upper_bound(SkipList *list, const void *key);
+
+const void*         skiplist_get_key    (SkipListIterator *it);
+void*               skiplist_get_value  (SkipListIterator *it);
+void*               skiplist_set_value  (SkipListIterator *it, void *value);
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_SWISS_TABLE_H__
+#define __LIBCORE_SWISS_TABLE_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* Opaque forward declarations */
+typedef struct _swiss_table SwissTable;
+typedef struct _swiss_table_slot SwissTableIterator;
+
+SwissTable* swiss_table_create      (HashFn hashfn, CompareFn comparefn);
+void        swiss_table_free        (SwissTable *table);
+void        swiss_table_free_all    (SwissTable *table, FreeFn freefn);
+int         swiss_table_insert      (SwissTable *table, const void *key,
+                                     void *value);
+void*       swiss_table_remove      (SwissTable *table, const void *key);
+int         swiss_table_is_empty    (SwissTable *table);
+
+unsigned long   swiss_table_size    (SwissTable *table);
+
+/* Iterators, in no particular order, invalidated by any insertion or
+ * removal
+ */
+void*               swiss_table_remove_at   (SwissTable *table,
+                                             SwissTableIterator *it);
+SwissTableIterator* swiss_table_find        (SwissTable *table,
+                                             const void *key);
+SwissTableIterator* swiss_table_begin       (SwissTable *table);
+SwissTableIterator* swiss_table_next        (SwissTableIterator *it);
+
+const void*     swiss_table_get_key     (SwissTableIterator *it);
+void*           swiss_table_get_value   (SwissTableIterator *it);
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_TIMER_WHEEL_H__
+#define __LIBCORE_TIMER_WHEEL_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/types.h>
+
+/* A hierarchical timing wheel. Timers are scheduled at an absolute
+ * deadline, measured in ticks of whatever unit the caller chooses,
+ * and fire once the wheel has been advanced past their deadline.
+ * Scheduling, cancelling and rescheduling are O(1); advancing costs
+ * O(1) per fired timer plus O(1) per level a timer cascades through,
+ * and skips over idle stretches of time.
+ *
+ * This is an alternative to a PQueue keyed on deadline for timeouts
+ * that are often cancelled or pushed back before they fire.
+ */
+
+/* Opaque forward declarations */
+typedef struct _timer_wheel TimerWheel;
+typedef struct _timer_wheel_timer TimerWheelTimer;
+
+/* Called for each timer that fires. The timer has already been
+ * released, so its handle must not be used any more.
+ */
+typedef void (*TimerWheelExpireFn)(void *data, unsigned long deadline,
+        void *userdata);
+
+TimerWheel* timer_wheel_create      (unsigned long now);
+void    timer_wheel_free            (TimerWheel *wheel);
+void    timer_wheel_free_all        (TimerWheel *wheel, FreeFn freefn);
+
+TimerWheelTimer* timer_wheel_schedule   (TimerWheel *wheel,
+                                         unsigned long deadline,
+                                         void *data);
+void*   timer_wheel_cancel          (TimerWheel *wheel, TimerWheelTimer *timer);
+void    timer_wheel_reschedule      (TimerWheel *wheel, TimerWheelTimer *timer,
+                                     unsigned long deadline);
+unsigned long timer_wheel_advance   (TimerWheel *wheel, unsigned long now,
+                                     TimerWheelExpireFn expire_fn,
+                                     void *userdata);
+
+int     timer_wheel_is_empty        (TimerWheel *wheel);
+
+unsigned long timer_wheel_now       (TimerWheel *wheel);
+unsigned long timer_wheel_size      (TimerWheel *wheel);
+
+void*   timer_wheel_get_data        (TimerWheelTimer *timer);
+unsigned long timer_wheel_get_deadline  (TimerWheelTimer *timer);
+
+#if __cplusplus
+}
+#endif
+
+#endif
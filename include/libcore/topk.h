@@ -0,0 +1,65 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_TOPK_H__
+#define __LIBCORE_TOPK_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/darray.h>
+#include <libcore/types.h>
+
+/* Keeps the k highest-priority items seen in a stream, using the same
+ * CompareFn convention as Heap (a > b means a has higher priority).
+ * Memory is O(k) regardless of the stream length. Once the collection
+ * is full, an item that can't qualify is rejected with one comparison.
+ */
+
+/* Opaque forward declaration */
+typedef struct _topk TopK;
+
+TopK*   topk_create     (CompareFn comparefn, unsigned long k);
+void    topk_free       (TopK *topk);
+void    topk_free_all   (TopK *topk, FreeFn freefn);
+void*   topk_push       (TopK *topk, void *data);
+int     topk_push_many  (TopK *topk, DArray *items, DArray *rejected);
+void*   topk_threshold  (TopK *topk);
+DArray* topk_to_darray  (TopK *topk);
+
+int     topk_is_full    (TopK *topk);
+int     topk_is_empty   (TopK *topk);
+
+unsigned long topk_size     (TopK *topk);
+unsigned long topk_capacity (TopK *topk);
+
+#if __cplusplus
+}
+#endif
+
+#endif
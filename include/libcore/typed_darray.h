@@ -0,0 +1,233 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __LIBCORE_TYPED_DARRAY_H__
+#define __LIBCORE_TYPED_DARRAY_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcore/macros.h>
+#include <libcore/utilities.h>
+
+/* Type-specialized dynamic arrays. LIBCORE_DEFINE_DARRAY(name, type),
+ * invoked at file scope without a trailing semicolon, defines the type
+ * name, an array of elements of type stored by value, and inline
+ * functions on it named name_create, name_append and so on. They grow
+ * and shrink the array as darray.c does.
+ *
+ *     LIBCORE_DEFINE_DARRAY(ULongArray, unsigned long)
+ *
+ *     ULongArray *a = ULongArray_create();
+ *     ULongArray_append(a, 42);
+ *
+ * The fields of the type may be read directly; data holds size
+ * elements.
+ */
+
+#define LIBCORE_DARRAY_MIN_SIZE     32
+
+#define LIBCORE_DEFINE_DARRAY(name, type)                                    \
+                                                                             \
+typedef struct {                                                             \
+    type *data;                                                              \
+    unsigned long size;                                                      \
+    unsigned long capacity;                                                  \
+} name;                                                                      \
+                                                                             \
+/* nitems is > 0 if adding items, < 0 if removing them */                    \
+static LIBCORE_INLINE int name##_resize(name *darray, long nitems)           \
+{                                                                            \
+    type *new_data;                                                          \
+    unsigned long new_capacity, pow2;                                        \
+                                                                             \
+    new_capacity = 0;                                                        \
+    if(nitems > 0) {                                                         \
+        pow2 = util_pow2_next(darray->capacity + nitems);                    \
+        if((darray->size + nitems) >= darray->capacity) {                    \
+            new_capacity = MAX(pow2, LIBCORE_DARRAY_MIN_SIZE);               \
+        }                                                                    \
+    } else {                                                                 \
+        pow2 = util_pow2_prev(darray->capacity - 1);                         \
+        if((darray->size + nitems) < (pow2 >> 1)) {                          \
+            new_capacity = MAX(pow2, LIBCORE_DARRAY_MIN_SIZE);               \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    /* No need to resize */                                                  \
+    if(0 == new_capacity || new_capacity == darray->capacity) {              \
+        return 0;                                                            \
+    }                                                                        \
+                                                                             \
+    new_data = realloc(darray->data, sizeof(type) * new_capacity);           \
+    if(NULL == new_data) {                                                   \
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FILE__, __LINE__);      \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    darray->data = new_data;                                                 \
+    darray->capacity = new_capacity;                                         \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE name* name##_create(void)                              \
+{                                                                            \
+    name *darray;                                                            \
+                                                                             \
+    darray = malloc(sizeof(name));                                           \
+    if(NULL == darray) {                                                     \
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FILE__, __LINE__);      \
+        return NULL;                                                         \
+    }                                                                        \
+                                                                             \
+    darray->data = NULL;                                                     \
+    darray->size = 0;                                                        \
+    darray->capacity = 0;                                                    \
+                                                                             \
+    return darray;                                                           \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE void name##_free(name *darray)                         \
+{                                                                            \
+    if(darray != NULL) {                                                     \
+        free(darray->data);                                                  \
+        free(darray);                                                        \
+    }                                                                        \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) amortized */                                             \
+static LIBCORE_INLINE int name##_append(name *darray, type item)             \
+{                                                                            \
+    assert(darray != NULL);                                                  \
+                                                                             \
+    if(name##_resize(darray, 1) < 0) {                                       \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    darray->data[darray->size++] = item;                                     \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+/* Complexity: O(n), worst-case */                                           \
+static LIBCORE_INLINE int name##_insert(name *darray, unsigned long index,   \
+        type item)                                                           \
+{                                                                            \
+    assert(darray != NULL);                                                  \
+    assert(index <= darray->size);                                           \
+                                                                             \
+    if(name##_resize(darray, 1) < 0) {                                       \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    memmove(&darray->data[index + 1], &darray->data[index],                  \
+            sizeof(type) * (darray->size - index));                          \
+    darray->data[index] = item;                                              \
+    darray->size++;                                                          \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+/* Complexity: O(n), worst-case */                                           \
+static LIBCORE_INLINE type name##_remove(name *darray, unsigned long index)  \
+{                                                                            \
+    type ret;                                                                \
+                                                                             \
+    assert(darray != NULL);                                                  \
+    assert(index < darray->size);                                            \
+                                                                             \
+    ret = darray->data[index];                                               \
+                                                                             \
+    memmove(&darray->data[index], &darray->data[index + 1],                  \
+            sizeof(type) * (darray->size - index - 1));                      \
+    darray->size--;                                                          \
+                                                                             \
+    if(name##_resize(darray, -1) < 0) {                                      \
+        fprintf(stderr, "DArray resize failed (%s:%d)\n", __FILE__,          \
+                __LINE__);                                                   \
+    }                                                                        \
+                                                                             \
+    return ret;                                                              \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE type name##_index(const name *darray,                  \
+        unsigned long index)                                                 \
+{                                                                            \
+    assert(darray != NULL);                                                  \
+    assert(index < darray->size);                                            \
+                                                                             \
+    return darray->data[index];                                              \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE void name##_replace(name *darray, unsigned long index, \
+        type item)                                                           \
+{                                                                            \
+    assert(darray != NULL);                                                  \
+    assert(index < darray->size);                                            \
+                                                                             \
+    darray->data[index] = item;                                              \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE type* name##_data(const name *darray)                  \
+{                                                                            \
+    assert(darray != NULL);                                                  \
+                                                                             \
+    return darray->data;                                                     \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE unsigned long name##_size(const name *darray)          \
+{                                                                            \
+    assert(darray != NULL);                                                  \
+                                                                             \
+    return darray->size;                                                     \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE int name##_is_empty(const name *darray)                \
+{                                                                            \
+    assert(darray != NULL);                                                  \
+                                                                             \
+    return (0 == darray->size);                                              \
+}
+
+#if __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,264 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __LIBCORE_TYPED_HEAP_H__
+#define __LIBCORE_TYPED_HEAP_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <libcore/typed_darray.h>
+
+/* Type-specialized d-ary heaps. LIBCORE_DEFINE_HEAP(name, type, cmp),
+ * invoked at file scope without a trailing semicolon, defines the type
+ * name, a heap of elements of type stored by value, and inline
+ * functions on it named name_create, name_push and so on. cmp(a, b),
+ * a function or macro, compares two elements like a CompareFn, and
+ * the greatest element is at the top, as with heap.c, whose algorithms
+ * these are. The elements are kept in a name_darray; see
+ * typed_darray.h.
+ *
+ *     #define ulong_cmp(a, b)  (((a) > (b)) - ((a) < (b)))
+ *     LIBCORE_DEFINE_HEAP(ULongHeap, unsigned long, ulong_cmp)
+ */
+
+#define LIBCORE_DEFINE_HEAP(name, type, cmp)                                 \
+                                                                             \
+LIBCORE_DEFINE_DARRAY(name##_darray, type)                                   \
+                                                                             \
+typedef struct {                                                             \
+    name##_darray *h;                                                        \
+    unsigned long arity_shift;  /* arity == 1 << arity_shift */              \
+} name;                                                                      \
+                                                                             \
+/* Complexity: O(log n) */                                                   \
+static LIBCORE_INLINE void name##_heapify_up(name *heap,                     \
+        unsigned long index)                                                 \
+{                                                                            \
+    type *data, item;                                                        \
+    unsigned long parent;                                                    \
+                                                                             \
+    data = heap->h->data;                                                    \
+    item = data[index];                                                      \
+                                                                             \
+    while(index > 0) {                                                       \
+        parent = (index - 1) >> heap->arity_shift;                           \
+        if(cmp(item, data[parent]) <= 0) {                                   \
+            break;                                                           \
+        }                                                                    \
+                                                                             \
+        data[index] = data[parent];                                          \
+        index = parent;                                                      \
+    }                                                                        \
+                                                                             \
+    data[index] = item;                                                      \
+}                                                                            \
+                                                                             \
+/* Complexity: O(d log n / log d) */                                         \
+static LIBCORE_INLINE void name##_heapify_down(name *heap,                   \
+        unsigned long index)                                                 \
+{                                                                            \
+    type *data, item;                                                        \
+    unsigned long size, child, last, largest;                                \
+                                                                             \
+    data = heap->h->data;                                                    \
+    size = heap->h->size;                                                    \
+    item = data[index];                                                      \
+                                                                             \
+    for(;;) {                                                                \
+        child = (index << heap->arity_shift) + 1;                            \
+        if(child >= size) {                                                  \
+            break;                                                           \
+        }                                                                    \
+                                                                             \
+        last = child + (1UL << heap->arity_shift);                           \
+        if(last > size) {                                                    \
+            last = size;                                                     \
+        }                                                                    \
+                                                                             \
+        for(largest = child++; child < last; child++) {                      \
+            if(cmp(data[child], data[largest]) > 0) {                        \
+                largest = child;                                             \
+            }                                                                \
+        }                                                                    \
+                                                                             \
+        if(cmp(data[largest], item) <= 0) {                                  \
+            break;                                                           \
+        }                                                                    \
+                                                                             \
+        data[index] = data[largest];                                         \
+        index = largest;                                                     \
+    }                                                                        \
+                                                                             \
+    data[index] = item;                                                      \
+}                                                                            \
+                                                                             \
+/* Supported arities are 2, 4, and 8 */                                      \
+static LIBCORE_INLINE name* name##_create_dary(unsigned int arity)           \
+{                                                                            \
+    name *heap;                                                              \
+    unsigned long shift;                                                     \
+                                                                             \
+    switch(arity) {                                                          \
+        case 2: shift = 1; break;                                            \
+        case 4: shift = 2; break;                                            \
+        case 8: shift = 3; break;                                            \
+        default:                                                             \
+            fprintf(stderr, "Unsupported heap arity %u (%s:%d)\n",           \
+                    arity, __FILE__, __LINE__);                              \
+            return NULL;                                                     \
+    }                                                                        \
+                                                                             \
+    heap = malloc(sizeof(name));                                             \
+    if(NULL == heap) {                                                       \
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FILE__, __LINE__);      \
+        return NULL;                                                         \
+    }                                                                        \
+                                                                             \
+    heap->h = name##_darray_create();                                        \
+    if(NULL == heap->h) {                                                    \
+        free(heap);                                                          \
+        return NULL;                                                         \
+    }                                                                        \
+    heap->arity_shift = shift;                                               \
+                                                                             \
+    return heap;                                                             \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE name* name##_create(void)                              \
+{                                                                            \
+    return name##_create_dary(2);                                            \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE void name##_free(name *heap)                           \
+{                                                                            \
+    assert(heap != NULL);                                                    \
+                                                                             \
+    name##_darray_free(heap->h);                                             \
+    free(heap);                                                              \
+}                                                                            \
+                                                                             \
+/* Complexity: O(log n), worst-case */                                       \
+static LIBCORE_INLINE int name##_push(name *heap, type item)                 \
+{                                                                            \
+    assert(heap != NULL);                                                    \
+                                                                             \
+    if(name##_darray_append(heap->h, item) < 0) {                            \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    name##_heapify_up(heap, heap->h->size - 1);                              \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+/* Stores the top element in *item, if item is not NULL, and removes         \
+ * it. Returns -1 if the heap is empty.                                      \
+ *                                                                           \
+ * Complexity: O(log n)                                                      \
+ */                                                                          \
+static LIBCORE_INLINE int name##_pop(name *heap, type *item)                 \
+{                                                                            \
+    type last;                                                               \
+                                                                             \
+    assert(heap != NULL);                                                    \
+                                                                             \
+    if(0 == heap->h->size) {                                                 \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    if(item != NULL) {                                                       \
+        *item = heap->h->data[0];                                            \
+    }                                                                        \
+                                                                             \
+    last = name##_darray_remove(heap->h, heap->h->size - 1);                 \
+    if(heap->h->size > 0) {                                                  \
+        heap->h->data[0] = last;                                             \
+        name##_heapify_down(heap, 0);                                        \
+    }                                                                        \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+/* Stores the top element in *item. Returns -1 if the heap is empty.         \
+ *                                                                           \
+ * Complexity: O(1)                                                          \
+ */                                                                          \
+static LIBCORE_INLINE int name##_top(name *heap, type *item)                 \
+{                                                                            \
+    assert(heap != NULL);                                                    \
+    assert(item != NULL);                                                    \
+                                                                             \
+    if(0 == heap->h->size) {                                                 \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    *item = heap->h->data[0];                                                \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+/* Complexity: O(n) */                                                       \
+static LIBCORE_INLINE int name##_is_valid(name *heap)                        \
+{                                                                            \
+    unsigned long i;                                                         \
+                                                                             \
+    assert(heap != NULL);                                                    \
+                                                                             \
+    for(i = 1; i < heap->h->size; i++) {                                     \
+        if(cmp(heap->h->data[i],                                             \
+                    heap->h->data[(i - 1) >> heap->arity_shift]) > 0) {      \
+            return 0;                                                        \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    return 1;                                                                \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE int name##_is_empty(name *heap)                        \
+{                                                                            \
+    assert(heap != NULL);                                                    \
+                                                                             \
+    return (0 == heap->h->size);                                             \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE unsigned long name##_size(name *heap)                  \
+{                                                                            \
+    assert(heap != NULL);                                                    \
+                                                                             \
+    return heap->h->size;                                                    \
+}
+
+#if __cplusplus
+}
+#endif
+
+#endif
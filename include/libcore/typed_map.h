@@ -0,0 +1,612 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __LIBCORE_TYPED_MAP_H__
+#define __LIBCORE_TYPED_MAP_H__
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/macros.h>
+
+/* Type-specialized ordered maps. LIBCORE_DEFINE_MAP(name, key_t, val_t,
+ * cmp), invoked at file scope without a trailing semicolon, defines
+ * the type name, a red-black tree with keys of key_t and values of
+ * val_t stored by value in its nodes, and inline functions on it named
+ * name_create, name_insert and so on. cmp(a, b), a function or macro,
+ * compares two keys like a CompareFn; a macro saves the call
+ * altogether. Keys are unique, as with map.h.
+ *
+ *     #define ulong_cmp(a, b)  (((a) > (b)) - ((a) < (b)))
+ *     LIBCORE_DEFINE_MAP(ULongMap, unsigned long, double, ulong_cmp)
+ *
+ * Iterators are pointers to name_node, whose key may be read, and
+ * whose value may be read and written, directly. The insert and
+ * delete algorithms are those of rbtree.c, without subtree sizes.
+ */
+
+#define LIBCORE_MAP_RED     0
+#define LIBCORE_MAP_BLACK   1
+
+/* NULL leaves count as black */
+#define LIBCORE_MAP_IS_BLACK(x) ((x) == NULL || LIBCORE_MAP_BLACK == (x)->color)
+
+#define LIBCORE_DEFINE_MAP(name, key_t, val_t, cmp)                          \
+                                                                             \
+typedef struct name##_node {                                                 \
+    struct name##_node *parent, *left, *right;                               \
+    int color;                                                               \
+    key_t key;                                                               \
+    val_t value;                                                             \
+} name##_node;                                                               \
+                                                                             \
+typedef struct {                                                             \
+    name##_node *root;                                                       \
+    unsigned long size;                                                      \
+} name;                                                                      \
+                                                                             \
+static LIBCORE_INLINE void name##_rotate_left(name *map, name##_node *x)     \
+{                                                                            \
+    name##_node *y;                                                          \
+                                                                             \
+    y = x->right;                                                            \
+                                                                             \
+    x->right = y->left;                                                      \
+    if(y->left != NULL) {                                                    \
+        y->left->parent = x;                                                 \
+    }                                                                        \
+                                                                             \
+    y->parent = x->parent;                                                   \
+    if(x == map->root) {                                                     \
+        map->root = y;                                                       \
+    } else if(x == x->parent->left) {                                        \
+        x->parent->left = y;                                                 \
+    } else {                                                                 \
+        x->parent->right = y;                                                \
+    }                                                                        \
+                                                                             \
+    y->left = x;                                                             \
+    x->parent = y;                                                           \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE void name##_rotate_right(name *map, name##_node *y)    \
+{                                                                            \
+    name##_node *x;                                                          \
+                                                                             \
+    x = y->left;                                                             \
+                                                                             \
+    y->left = x->right;                                                      \
+    if(x->right != NULL) {                                                   \
+        x->right->parent = y;                                                \
+    }                                                                        \
+                                                                             \
+    x->parent = y->parent;                                                   \
+    if(y == map->root) {                                                     \
+        map->root = x;                                                       \
+    } else if(y == y->parent->left) {                                        \
+        y->parent->left = x;                                                 \
+    } else {                                                                 \
+        y->parent->right = x;                                                \
+    }                                                                        \
+                                                                             \
+    x->right = y;                                                            \
+    y->parent = x;                                                           \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE void name##_insert_fixup(name *map,                    \
+        name##_node *node)                                                   \
+{                                                                            \
+    name##_node *uncle, *grandparent;                                        \
+                                                                             \
+    while(node != map->root && LIBCORE_MAP_RED == node->parent->color) {     \
+        grandparent = node->parent->parent;                                  \
+        if(node->parent == grandparent->left) {                              \
+            uncle = grandparent->right;                                      \
+            if(!LIBCORE_MAP_IS_BLACK(uncle)) {                               \
+                /* Case 1 */                                                 \
+                node->parent->color = LIBCORE_MAP_BLACK;                     \
+                uncle->color = LIBCORE_MAP_BLACK;                            \
+                grandparent->color = LIBCORE_MAP_RED;                        \
+                node = grandparent;                                          \
+            } else {                                                         \
+                if(node == node->parent->right) {                            \
+                    /* Case 2 */                                             \
+                    node = node->parent;                                     \
+                    name##_rotate_left(map, node);                           \
+                }                                                            \
+                                                                             \
+                /* Case 3 */                                                 \
+                node->parent->color = LIBCORE_MAP_BLACK;                     \
+                grandparent->color = LIBCORE_MAP_RED;                        \
+                name##_rotate_right(map, grandparent);                       \
+            }                                                                \
+        } else {                                                             \
+            uncle = grandparent->left;                                       \
+            if(!LIBCORE_MAP_IS_BLACK(uncle)) {                               \
+                /* Case 1 */                                                 \
+                node->parent->color = LIBCORE_MAP_BLACK;                     \
+                uncle->color = LIBCORE_MAP_BLACK;                            \
+                grandparent->color = LIBCORE_MAP_RED;                        \
+                node = grandparent;                                          \
+            } else {                                                         \
+                if(node == node->parent->left) {                             \
+                    /* Case 2 */                                             \
+                    node = node->parent;                                     \
+                    name##_rotate_right(map, node);                          \
+                }                                                            \
+                                                                             \
+                /* Case 3 */                                                 \
+                node->parent->color = LIBCORE_MAP_BLACK;                     \
+                grandparent->color = LIBCORE_MAP_RED;                        \
+                name##_rotate_left(map, grandparent);                        \
+            }                                                                \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    map->root->color = LIBCORE_MAP_BLACK;                                    \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE void name##_remove_fixup(name *map,                    \
+        name##_node *node, name##_node *node_parent)                         \
+{                                                                            \
+    name##_node *w;                                                          \
+                                                                             \
+    while(node != map->root && LIBCORE_MAP_IS_BLACK(node)) {                 \
+        if(node == node_parent->left) {                                      \
+            w = node_parent->right;                                          \
+            if(LIBCORE_MAP_RED == w->color) {                                \
+                /* Case 1 */                                                 \
+                w->color = LIBCORE_MAP_BLACK;                                \
+                node_parent->color = LIBCORE_MAP_RED;                        \
+                name##_rotate_left(map, node_parent);                        \
+                w = node_parent->right;                                      \
+            }                                                                \
+                                                                             \
+            if(LIBCORE_MAP_IS_BLACK(w->left) &&                              \
+                    LIBCORE_MAP_IS_BLACK(w->right)) {                        \
+                /* Case 2 */                                                 \
+                w->color = LIBCORE_MAP_RED;                                  \
+                node = node_parent;                                          \
+                node_parent = node_parent->parent;                           \
+            } else {                                                         \
+                if(LIBCORE_MAP_IS_BLACK(w->right)) {                         \
+                    /* Case 3 */                                             \
+                    w->left->color = LIBCORE_MAP_BLACK;                      \
+                    w->color = LIBCORE_MAP_RED;                              \
+                    name##_rotate_right(map, w);                             \
+                    w = node_parent->right;                                  \
+                }                                                            \
+                                                                             \
+                /* Case 4 */                                                 \
+                w->color = node_parent->color;                               \
+                node_parent->color = LIBCORE_MAP_BLACK;                      \
+                if(w->right != NULL) {                                       \
+                    w->right->color = LIBCORE_MAP_BLACK;                     \
+                }                                                            \
+                name##_rotate_left(map, node_parent);                        \
+                node = map->root;                                            \
+            }                                                                \
+        } else {                                                             \
+            w = node_parent->left;                                           \
+            if(LIBCORE_MAP_RED == w->color) {                                \
+                /* Case 1 */                                                 \
+                w->color = LIBCORE_MAP_BLACK;                                \
+                node_parent->color = LIBCORE_MAP_RED;                        \
+                name##_rotate_right(map, node_parent);                       \
+                w = node_parent->left;                                       \
+            }                                                                \
+                                                                             \
+            if(LIBCORE_MAP_IS_BLACK(w->left) &&                              \
+                    LIBCORE_MAP_IS_BLACK(w->right)) {                        \
+                /* Case 2 */                                                 \
+                w->color = LIBCORE_MAP_RED;                                  \
+                node = node_parent;                                          \
+                node_parent = node_parent->parent;                           \
+            } else {                                                         \
+                if(LIBCORE_MAP_IS_BLACK(w->left)) {                          \
+                    /* Case 3 */                                             \
+                    w->right->color = LIBCORE_MAP_BLACK;                     \
+                    w->color = LIBCORE_MAP_RED;                              \
+                    name##_rotate_left(map, w);                              \
+                    w = node_parent->left;                                   \
+                }                                                            \
+                                                                             \
+                /* Case 4 */                                                 \
+                w->color = node_parent->color;                               \
+                node_parent->color = LIBCORE_MAP_BLACK;                      \
+                if(w->left != NULL) {                                        \
+                    w->left->color = LIBCORE_MAP_BLACK;                      \
+                }                                                            \
+                name##_rotate_right(map, node_parent);                       \
+                node = map->root;                                            \
+            }                                                                \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    if(node != NULL) {                                                       \
+        node->color = LIBCORE_MAP_BLACK;                                     \
+    }                                                                        \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE void name##_free_nodes(name##_node *node)              \
+{                                                                            \
+    if(node != NULL) {                                                       \
+        name##_free_nodes(node->left);                                       \
+        name##_free_nodes(node->right);                                      \
+        free(node);                                                          \
+    }                                                                        \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE name* name##_create(void)                              \
+{                                                                            \
+    name *map;                                                               \
+                                                                             \
+    map = malloc(sizeof(name));                                              \
+    if(NULL == map) {                                                        \
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FILE__, __LINE__);      \
+        return NULL;                                                         \
+    }                                                                        \
+                                                                             \
+    map->root = NULL;                                                        \
+    map->size = 0;                                                           \
+                                                                             \
+    return map;                                                              \
+}                                                                            \
+                                                                             \
+/* Complexity: O(n) in time, O(log n) in space */                            \
+static LIBCORE_INLINE void name##_free(name *map)                            \
+{                                                                            \
+    assert(map != NULL);                                                     \
+                                                                             \
+    name##_free_nodes(map->root);                                            \
+    free(map);                                                               \
+}                                                                            \
+                                                                             \
+/* Returns -1 if key is already in the map, or if out of memory.             \
+ *                                                                           \
+ * Complexity: O(log n)                                                      \
+ */                                                                          \
+static LIBCORE_INLINE int name##_insert(name *map, key_t key, val_t value)   \
+{                                                                            \
+    name##_node *node, *x, *y;                                               \
+    int result;                                                              \
+                                                                             \
+    assert(map != NULL);                                                     \
+                                                                             \
+    y = NULL;                                                                \
+    result = 0;                                                              \
+    for(x = map->root; x != NULL; ) {                                        \
+        y = x;                                                               \
+        result = cmp(key, x->key);                                           \
+        if(result < 0) {                                                     \
+            x = x->left;                                                     \
+        } else if(result > 0) {                                              \
+            x = x->right;                                                    \
+        } else {                                                             \
+            return -1;                                                       \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    node = malloc(sizeof(name##_node));                                      \
+    if(NULL == node) {                                                       \
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FILE__, __LINE__);      \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    node->parent = y;                                                        \
+    node->left = node->right = NULL;                                         \
+    node->color = LIBCORE_MAP_RED;                                           \
+    node->key = key;                                                         \
+    node->value = value;                                                     \
+                                                                             \
+    if(NULL == y) {                                                          \
+        map->root = node;                                                    \
+    } else if(result < 0) {                                                  \
+        y->left = node;                                                      \
+    } else {                                                                 \
+        y->right = node;                                                     \
+    }                                                                        \
+                                                                             \
+    name##_insert_fixup(map, node);                                          \
+    map->size++;                                                             \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+/* Complexity: O(log n) */                                                   \
+static LIBCORE_INLINE name##_node* name##_find(name *map, key_t key)         \
+{                                                                            \
+    name##_node *node;                                                       \
+    int result;                                                              \
+                                                                             \
+    assert(map != NULL);                                                     \
+                                                                             \
+    node = map->root;                                                        \
+    while(node != NULL) {                                                    \
+        result = cmp(key, node->key);                                        \
+        if(result < 0) {                                                     \
+            node = node->left;                                               \
+        } else if(result > 0) {                                              \
+            node = node->right;                                              \
+        } else {                                                             \
+            break;                                                           \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    return node;                                                             \
+}                                                                            \
+                                                                             \
+/* Returns the address of the value of key, or NULL if there is none.        \
+ *                                                                           \
+ * Complexity: O(log n)                                                      \
+ */                                                                          \
+static LIBCORE_INLINE val_t* name##_get(name *map, key_t key)                \
+{                                                                            \
+    name##_node *node;                                                       \
+                                                                             \
+    node = name##_find(map, key);                                            \
+                                                                             \
+    return (node != NULL) ? &node->value : NULL;                             \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE name##_node* name##_begin(name *map)                   \
+{                                                                            \
+    name##_node *node;                                                       \
+                                                                             \
+    assert(map != NULL);                                                     \
+                                                                             \
+    node = map->root;                                                        \
+    while(node != NULL && node->left != NULL) {                              \
+        node = node->left;                                                   \
+    }                                                                        \
+                                                                             \
+    return node;                                                             \
+}                                                                            \
+                                                                             \
+static LIBCORE_INLINE name##_node* name##_end(name *map)                     \
+{                                                                            \
+    name##_node *node;                                                       \
+                                                                             \
+    assert(map != NULL);                                                     \
+                                                                             \
+    node = map->root;                                                        \
+    while(node != NULL && node->right != NULL) {                             \
+        node = node->right;                                                  \
+    }                                                                        \
+                                                                             \
+    return node;                                                             \
+}                                                                            \
+                                                                             \
+/* Complexity: O(log n), O(1) amortized over a whole iteration */            \
+static LIBCORE_INLINE name##_node* name##_next(name##_node *it)              \
+{                                                                            \
+    name##_node *node;                                                       \
+                                                                             \
+    assert(it != NULL);                                                      \
+                                                                             \
+    if(it->right != NULL) {                                                  \
+        for(it = it->right; it->left != NULL; it = it->left);                \
+        return it;                                                           \
+    }                                                                        \
+                                                                             \
+    node = it->parent;                                                       \
+    while(node != NULL && it == node->right) {                               \
+        it = node;                                                           \
+        node = node->parent;                                                 \
+    }                                                                        \
+                                                                             \
+    return node;                                                             \
+}                                                                            \
+                                                                             \
+/* Complexity: O(log n), O(1) amortized over a whole iteration */            \
+static LIBCORE_INLINE name##_node* name##_prev(name##_node *it)              \
+{                                                                            \
+    name##_node *node;                                                       \
+                                                                             \
+    assert(it != NULL);                                                      \
+                                                                             \
+    if(it->left != NULL) {                                                   \
+        for(it = it->left; it->right != NULL; it = it->right);               \
+        return it;                                                           \
+    }                                                                        \
+                                                                             \
+    node = it->parent;                                                       \
+    while(node != NULL && it == node->left) {                                \
+        it = node;                                                           \
+        node = node->parent;                                                 \
+    }                                                                        \
+                                                                             \
+    return node;                                                             \
+}                                                                            \
+                                                                             \
+/* Removes the node of it, storing its value in *value if value is not       \
+ * NULL. Only iterators to that node are invalidated.                        \
+ *                                                                           \
+ * Complexity: O(log n)                                                      \
+ */                                                                          \
+static LIBCORE_INLINE void name##_remove_at(name *map, name##_node *z,       \
+        val_t *value)                                                        \
+{                                                                            \
+    name##_node *x, *y, *x_parent;                                           \
+    int y_color;                                                             \
+                                                                             \
+    assert(map != NULL);                                                     \
+    assert(z != NULL);                                                       \
+                                                                             \
+    if(value != NULL) {                                                      \
+        *value = z->value;                                                   \
+    }                                                                        \
+                                                                             \
+    /* y is z if it has at most one child, and else its successor,           \
+     * which has no left child. x is the child of y.                         \
+     */                                                                      \
+    if(NULL == z->left || NULL == z->right) {                                \
+        y = z;                                                               \
+    } else {                                                                 \
+        for(y = z->right; y->left != NULL; y = y->left);                     \
+    }                                                                        \
+    x = (y->left != NULL) ? y->left : y->right;                              \
+                                                                             \
+    /* Splice out y */                                                       \
+    x_parent = y->parent;                                                    \
+    if(x != NULL) {                                                          \
+        x->parent = y->parent;                                               \
+    }                                                                        \
+    if(NULL == y->parent) {                                                  \
+        map->root = x;                                                       \
+    } else if(y == y->parent->left) {                                        \
+        y->parent->left = x;                                                 \
+    } else {                                                                 \
+        y->parent->right = x;                                                \
+    }                                                                        \
+                                                                             \
+    /* Relink y in place of z, rather than copying its contents */           \
+    if(y != z) {                                                             \
+        if(x_parent == z) {                                                  \
+            x_parent = y;                                                    \
+        }                                                                    \
+                                                                             \
+        y->parent = z->parent;                                               \
+        y->left = z->left;                                                   \
+        y->right = z->right;                                                 \
+        if(y->left != NULL) {                                                \
+            y->left->parent = y;                                             \
+        }                                                                    \
+        if(y->right != NULL) {                                               \
+            y->right->parent = y;                                            \
+        }                                                                    \
+                                                                             \
+        if(NULL == z->parent) {                                              \
+            map->root = y;                                                   \
+        } else if(z == z->parent->left) {                                    \
+            z->parent->left = y;                                             \
+        } else {                                                             \
+            z->parent->right = y;                                            \
+        }                                                                    \
+                                                                             \
+        y_color = y->color;                                                  \
+        y->color = z->color;                                                 \
+        z->color = y_color;                                                  \
+    }                                                                        \
+                                                                             \
+    if(LIBCORE_MAP_BLACK == z->color) {                                      \
+        name##_remove_fixup(map, x, x_parent);                               \
+    }                                                                        \
+                                                                             \
+    free(z);                                                                 \
+    map->size--;                                                             \
+}                                                                            \
+                                                                             \
+/* Removes key, storing its value in *value if value is not NULL.            \
+ * Returns -1 if key is not in the map.                                      \
+ *                                                                           \
+ * Complexity: O(log n)                                                      \
+ */                                                                          \
+static LIBCORE_INLINE int name##_remove(name *map, key_t key, val_t *value)  \
+{                                                                            \
+    name##_node *node;                                                       \
+                                                                             \
+    node = name##_find(map, key);                                            \
+    if(NULL == node) {                                                       \
+        return -1;                                                           \
+    }                                                                        \
+                                                                             \
+    name##_remove_at(map, node, value);                                      \
+                                                                             \
+    return 0;                                                                \
+}                                                                            \
+                                                                             \
+/* Complexity: O(1) */                                                       \
+static LIBCORE_INLINE unsigned long name##_size(name *map)                   \
+{                                                                            \
+    assert(map != NULL);                                                     \
+                                                                             \
+    return map->size;                                                        \
+}                                                                            \
+                                                                             \
+/* Returns the black height of the subtree at node, or 0 if it breaks        \
+ * a red-black or ordering property.                                         \
+ */                                                                          \
+static LIBCORE_INLINE unsigned long name##_check(name##_node *node)          \
+{                                                                            \
+    unsigned long left, right;                                               \
+                                                                             \
+    if(NULL == node) {                                                       \
+        return 1;                                                            \
+    }                                                                        \
+                                                                             \
+    left = name##_check(node->left);                                         \
+    right = name##_check(node->right);                                       \
+    if(0 == left || left != right) {                                         \
+        return 0;                                                            \
+    }                                                                        \
+                                                                             \
+    if(node->left != NULL && (node->left->parent != node ||                  \
+                cmp(node->left->key, node->key) >= 0)) {                     \
+        return 0;                                                            \
+    }                                                                        \
+    if(node->right != NULL && (node->right->parent != node ||                \
+                cmp(node->right->key, node->key) <= 0)) {                    \
+        return 0;                                                            \
+    }                                                                        \
+                                                                             \
+    if(LIBCORE_MAP_RED == node->color) {                                     \
+        if(!LIBCORE_MAP_IS_BLACK(node->left) ||                              \
+                !LIBCORE_MAP_IS_BLACK(node->right)) {                        \
+            return 0;                                                        \
+        }                                                                    \
+        return left;                                                         \
+    }                                                                        \
+                                                                             \
+    return left + 1;                                                         \
+}                                                                            \
+                                                                             \
+/* Complexity: O(n) */                                                       \
+static LIBCORE_INLINE int name##_is_valid(name *map)                         \
+{                                                                            \
+    assert(map != NULL);                                                     \
+                                                                             \
+    if(NULL == map->root) {                                                  \
+        return (0 == map->size);                                             \
+    }                                                                        \
+                                                                             \
+    return (NULL == map->root->parent &&                                     \
+            LIBCORE_MAP_BLACK == map->root->color &&                         \
+            name##_check(map->root) != 0);                                   \
+}
+
+#if __cplusplus
+}
+#endif
+
+#endif
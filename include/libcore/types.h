@@ -34,6 +34,7 @@ extern "C" {
 
 typedef int     (*CompareFn)    (const void *, const void *);
 typedef void    (*FreeFn)       (void *);
+typedef unsigned long   (*HashFn)   (const void *);
 
 #ifdef __cplusplus
 }
@@ -40,6 +40,11 @@ unsigned long util_pow2_next(unsigned long x);
 /* Calculate the next lowest power of 2 <= x */
 unsigned long util_pow2_prev(unsigned long x);
 
+/* Hash functions, usable as HashFn */
+unsigned long util_hash_pointer(const void *p);
+unsigned long util_hash_ulong(const void *x);
+unsigned long util_hash_string(const void *s);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,1553 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* An adaptive radix tree, after Leis, Kemper and Neumann.
+ *
+ * Each inner node branches on one byte of the key, and is one of four
+ * types, grown and shrunk as children come and go:
+ *   - Node4 and Node16 keep up to 4 and 16 key bytes, sorted, with the
+ *     children in the same order. Node16 is searched with SSE2 where
+ *     available, and otherwise with a loop. Defining LIBCORE_NO_SSE2
+ *     forces the loop.
+ *   - Node48 maps each of the 256 byte values to one of 48 child slots.
+ *   - Node256 has a child slot for every byte value.
+ *
+ * Paths are compressed: a node skips the bytes that all keys below it
+ * share, and records them as its prefix. Only the first ART_MAX_PREFIX
+ * bytes of a prefix are stored. Lookups skip the rest, as they compare
+ * the whole key at the leaf anyway; where the other bytes are needed,
+ * they are read from the key of any leaf below the node.
+ *
+ * Leaves hold a copy of the whole key, and are told apart from inner
+ * nodes by the low bit of the pointers to them. A leaf hangs from the
+ * first node where no other key shares its path, or from the leaf field
+ * of the node where its key ends, if other keys go on from there.
+ * Leaves are also linked in order, both ways, so that iterators step in
+ * O(1).
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(LIBCORE_NO_SSE2)
+#include <emmintrin.h>
+#define ART_SSE2
+#endif
+
+#include <libcore/art.h>
+
+#define ART_MAX_PREFIX  8
+
+#define NODE4       0
+#define NODE16      1
+#define NODE48      2
+#define NODE256     3
+
+/* Children that are leaves have the low bit of their pointer set */
+#define IS_LEAF(p)  ((unsigned long)(p) & 1UL)
+#define TAG_LEAF(l) ((struct _art_node *)((unsigned long)(l) | 1UL))
+#define LEAF(p)     ((struct _art_leaf *)((unsigned long)(p) & ~1UL))
+
+#define min(a, b)   (((a) < (b)) ? (a) : (b))
+
+struct _art_leaf {
+    struct _art_leaf *prev;
+    struct _art_leaf *next;
+    void *value;
+    unsigned long key_len;
+
+    /* Allocated with key_len bytes */
+    unsigned char key[1];
+};
+
+struct _art_node {
+    unsigned char type;
+    unsigned short num_children;
+    unsigned int prefix_len;
+    unsigned char prefix[ART_MAX_PREFIX];
+
+    /* The entry whose key ends at this node, if any */
+    struct _art_leaf *leaf;
+};
+
+struct _art_node4 {
+    struct _art_node n;
+    unsigned char keys[4];
+    struct _art_node *children[4];
+};
+
+struct _art_node16 {
+    struct _art_node n;
+    unsigned char keys[16];
+    struct _art_node *children[16];
+};
+
+/* index holds one more than the slot of each byte's child, or 0 */
+struct _art_node48 {
+    struct _art_node n;
+    unsigned char index[256];
+    struct _art_node *children[48];
+};
+
+struct _art_node256 {
+    struct _art_node n;
+    struct _art_node *children[256];
+};
+
+struct _art {
+    struct _art_node *root;
+    struct _art_leaf *first;
+    struct _art_leaf *last;
+    unsigned long size;
+};
+
+static const size_t node_sizes[] = {
+    sizeof(struct _art_node4),
+    sizeof(struct _art_node16),
+    sizeof(struct _art_node48),
+    sizeof(struct _art_node256)
+};
+
+static struct _art_node* _node_create(unsigned char type)
+{
+    struct _art_node *node;
+
+    node = calloc(1, node_sizes[type]);
+    if(NULL == node) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    node->type = type;
+
+    return node;
+}
+
+/* Copies all but the type and the children */
+static void _copy_header(struct _art_node *dst, const struct _art_node *src)
+{
+    dst->num_children = src->num_children;
+    dst->prefix_len = src->prefix_len;
+    memcpy(dst->prefix, src->prefix, ART_MAX_PREFIX);
+    dst->leaf = src->leaf;
+}
+
+static struct _art_leaf* _leaf_create(const unsigned char *key,
+        unsigned long key_len, void *value)
+{
+    struct _art_leaf *leaf;
+
+    leaf = malloc(sizeof(struct _art_leaf) + key_len);
+    if(NULL == leaf) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    leaf->prev = NULL;
+    leaf->next = NULL;
+    leaf->value = value;
+    leaf->key_len = key_len;
+    memcpy(leaf->key, key, key_len);
+
+    return leaf;
+}
+
+static int _leaf_matches(const struct _art_leaf *leaf,
+        const unsigned char *key, unsigned long key_len)
+{
+    return (leaf->key_len == key_len &&
+            memcmp(leaf->key, key, key_len) == 0);
+}
+
+/* Compares as memcmp, a key that is a prefix of another coming first */
+static int _compare_keys(const unsigned char *a, unsigned long a_len,
+        const unsigned char *b, unsigned long b_len)
+{
+    int c;
+
+    c = memcmp(a, b, min(a_len, b_len));
+    if(c != 0) {
+        return c;
+    }
+
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+static void _encode_ulong(unsigned long key, unsigned char *buf)
+{
+    unsigned int i;
+
+    for(i = sizeof(unsigned long); i-- > 0;) {
+        buf[i] = (unsigned char)(key & UCHAR_MAX);
+        key >>= CHAR_BIT;
+    }
+}
+
+/* Node16 search. Both return a mask with bit i set for each key i of
+ * node that matches.
+ */
+#ifdef ART_SSE2
+
+/* Index of the lowest set bit of x, which must not be 0 */
+static unsigned int _ctz(unsigned int x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    unsigned int n = 0;
+
+    while(0 == (x & 1)) {
+        x >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+static unsigned int _node16_equal(const struct _art_node16 *node,
+        unsigned char c)
+{
+    __m128i keys = _mm_loadu_si128((const __m128i *)node->keys);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8((char)c))) &
+        ((1U << node->n.num_children) - 1);
+}
+
+/* SSE2 only compares signed bytes, so flipping the high bit of both
+ * sides maps unsigned order onto signed order.
+ */
+static unsigned int _node16_greater(const struct _art_node16 *node,
+        unsigned char c)
+{
+    __m128i flip = _mm_set1_epi8((char)0x80);
+    __m128i keys;
+
+    keys = _mm_xor_si128(_mm_loadu_si128((const __m128i *)node->keys), flip);
+
+    return _mm_movemask_epi8(_mm_cmpgt_epi8(keys,
+                _mm_set1_epi8((char)(c ^ 0x80)))) &
+        ((1U << node->n.num_children) - 1);
+}
+
+#endif
+
+/* Index of the first of the n sorted keys that is greater than c, or n */
+static unsigned int _first_greater(const struct _art_node *node,
+        unsigned char c)
+{
+    const unsigned char *keys;
+    unsigned int i;
+
+#ifdef ART_SSE2
+    unsigned int mask;
+
+    if(NODE16 == node->type) {
+        mask = _node16_greater((const struct _art_node16 *)node, c);
+        return (mask != 0) ? _ctz(mask) : node->num_children;
+    }
+#endif
+
+    if(NODE4 == node->type) {
+        keys = ((const struct _art_node4 *)node)->keys;
+    } else {
+        keys = ((const struct _art_node16 *)node)->keys;
+    }
+
+    for(i = 0; i < node->num_children && keys[i] <= c; i++) {
+        continue;
+    }
+
+    return i;
+}
+
+/* Returns the slot of the child of node for byte c, or NULL.
+ *
+ * Complexity: O(1)
+ */
+static struct _art_node** _find_child(struct _art_node *node, unsigned char c)
+{
+    struct _art_node4 *n4;
+    struct _art_node16 *n16;
+    struct _art_node48 *n48;
+    struct _art_node256 *n256;
+    unsigned int i;
+
+    switch(node->type) {
+    case NODE4:
+        n4 = (struct _art_node4 *)node;
+        for(i = 0; i < node->num_children; i++) {
+            if(n4->keys[i] == c) {
+                return &n4->children[i];
+            }
+        }
+        return NULL;
+
+    case NODE16:
+        n16 = (struct _art_node16 *)node;
+#ifdef ART_SSE2
+        i = _node16_equal(n16, c);
+        return (i != 0) ? &n16->children[_ctz(i)] : NULL;
+#else
+        for(i = 0; i < node->num_children; i++) {
+            if(n16->keys[i] == c) {
+                return &n16->children[i];
+            }
+        }
+        return NULL;
+#endif
+
+    case NODE48:
+        n48 = (struct _art_node48 *)node;
+        return (n48->index[c] != 0) ? &n48->children[n48->index[c] - 1] :
+            NULL;
+
+    default:
+        n256 = (struct _art_node256 *)node;
+        return (n256->children[c] != NULL) ? &n256->children[c] : NULL;
+    }
+}
+
+/* Returns the child of node for byte b, or NULL */
+static struct _art_node* _child_at(struct _art_node *node, unsigned int b)
+{
+    struct _art_node **child;
+
+    child = _find_child(node, (unsigned char)b);
+
+    return (child != NULL) ? *child : NULL;
+}
+
+/* Returns the child of node for the least byte greater than c, or NULL.
+ *
+ * Complexity: O(1)
+ */
+static struct _art_node* _next_child(struct _art_node *node, unsigned char c)
+{
+    struct _art_node *child;
+    unsigned int i;
+
+    switch(node->type) {
+    case NODE4:
+        i = _first_greater(node, c);
+        return (i < node->num_children) ?
+            ((struct _art_node4 *)node)->children[i] : NULL;
+
+    case NODE16:
+        i = _first_greater(node, c);
+        return (i < node->num_children) ?
+            ((struct _art_node16 *)node)->children[i] : NULL;
+
+    default:
+        for(i = (unsigned int)c + 1; i < 256; i++) {
+            child = _child_at(node, i);
+            if(child != NULL) {
+                return child;
+            }
+        }
+        return NULL;
+    }
+}
+
+static struct _art_node* _first_child(struct _art_node *node)
+{
+    struct _art_node *child;
+    unsigned int i;
+
+    switch(node->type) {
+    case NODE4:
+        return ((struct _art_node4 *)node)->children[0];
+
+    case NODE16:
+        return ((struct _art_node16 *)node)->children[0];
+
+    default:
+        for(i = 0; i < 256; i++) {
+            child = _child_at(node, i);
+            if(child != NULL) {
+                return child;
+            }
+        }
+        return NULL;
+    }
+}
+
+static struct _art_node* _last_child(struct _art_node *node)
+{
+    struct _art_node *child;
+    unsigned int i;
+
+    switch(node->type) {
+    case NODE4:
+        return ((struct _art_node4 *)node)->children[node->num_children - 1];
+
+    case NODE16:
+        return ((struct _art_node16 *)node)->children[node->num_children - 1];
+
+    default:
+        for(i = 256; i-- > 0;) {
+            child = _child_at(node, i);
+            if(child != NULL) {
+                return child;
+            }
+        }
+        return NULL;
+    }
+}
+
+/* Returns the first leaf below node, which may be a leaf or NULL.
+ *
+ * Complexity: O(k), for keys of length k
+ */
+static struct _art_leaf* _minimum(struct _art_node *node)
+{
+    while(node != NULL && !IS_LEAF(node)) {
+        if(node->leaf != NULL) {
+            return node->leaf;
+        }
+        node = _first_child(node);
+    }
+
+    return LEAF(node);
+}
+
+/* Complexity: O(k) */
+static struct _art_leaf* _maximum(struct _art_node *node)
+{
+    while(node != NULL && !IS_LEAF(node)) {
+        node = _last_child(node);
+    }
+
+    return LEAF(node);
+}
+
+/* Returns the whole prefix of node, whose keys are at depth there.
+ *
+ * Complexity: O(1), O(k) if only part of the prefix is stored
+ */
+static const unsigned char* _full_prefix(struct _art_node *node,
+        unsigned long depth)
+{
+    if(node->prefix_len <= ART_MAX_PREFIX) {
+        return node->prefix;
+    }
+
+    return _minimum(node)->key + depth;
+}
+
+/* Returns the number of leading bytes of prefix that key shares */
+static unsigned long _mismatch(const unsigned char *prefix,
+        unsigned long prefix_len, const unsigned char *key,
+        unsigned long key_len)
+{
+    unsigned long i, n = min(prefix_len, key_len);
+
+    for(i = 0; i < n && prefix[i] == key[i]; i++) {
+        continue;
+    }
+
+    return i;
+}
+
+/* Checks the stored bytes of the prefix of node only, for lookups that
+ * compare the whole key at the leaf.
+ */
+static int _prefix_matches(const struct _art_node *node,
+        const unsigned char *key, unsigned long key_len)
+{
+    unsigned long n = min(node->prefix_len, ART_MAX_PREFIX);
+
+    return (node->prefix_len <= key_len && memcmp(node->prefix, key, n) == 0);
+}
+
+/* Adds child for byte c to node, which is stored in *ref and is moved to
+ * a larger type when full. Returns -1 if out of memory.
+ *
+ * Complexity: O(1)
+ */
+static int _add_child(struct _art_node **ref, struct _art_node *node,
+        unsigned char c, struct _art_node *child)
+{
+    struct _art_node4 *n4;
+    struct _art_node16 *n16;
+    struct _art_node48 *n48;
+    struct _art_node256 *n256;
+    struct _art_node *new_node;
+    unsigned int i, n = node->num_children;
+
+    switch(node->type) {
+    case NODE4:
+        n4 = (struct _art_node4 *)node;
+        if(n < 4) {
+            i = _first_greater(node, c);
+            memmove(n4->keys + i + 1, n4->keys + i, n - i);
+            memmove(n4->children + i + 1, n4->children + i,
+                    (n - i) * sizeof(struct _art_node *));
+            n4->keys[i] = c;
+            n4->children[i] = child;
+            break;
+        }
+
+        new_node = _node_create(NODE16);
+        if(NULL == new_node) {
+            return -1;
+        }
+        _copy_header(new_node, node);
+        memcpy(((struct _art_node16 *)new_node)->keys, n4->keys, 4);
+        memcpy(((struct _art_node16 *)new_node)->children, n4->children,
+                4 * sizeof(struct _art_node *));
+        *ref = new_node;
+        free(node);
+        return _add_child(ref, new_node, c, child);
+
+    case NODE16:
+        n16 = (struct _art_node16 *)node;
+        if(n < 16) {
+            i = _first_greater(node, c);
+            memmove(n16->keys + i + 1, n16->keys + i, n - i);
+            memmove(n16->children + i + 1, n16->children + i,
+                    (n - i) * sizeof(struct _art_node *));
+            n16->keys[i] = c;
+            n16->children[i] = child;
+            break;
+        }
+
+        new_node = _node_create(NODE48);
+        if(NULL == new_node) {
+            return -1;
+        }
+        _copy_header(new_node, node);
+        n48 = (struct _art_node48 *)new_node;
+        for(i = 0; i < 16; i++) {
+            n48->children[i] = n16->children[i];
+            n48->index[n16->keys[i]] = i + 1;
+        }
+        *ref = new_node;
+        free(node);
+        return _add_child(ref, new_node, c, child);
+
+    case NODE48:
+        n48 = (struct _art_node48 *)node;
+        if(n < 48) {
+            /* Removals may have left any slot free */
+            for(i = 0; n48->children[i] != NULL; i++) {
+                continue;
+            }
+            n48->children[i] = child;
+            n48->index[c] = i + 1;
+            break;
+        }
+
+        new_node = _node_create(NODE256);
+        if(NULL == new_node) {
+            return -1;
+        }
+        _copy_header(new_node, node);
+        n256 = (struct _art_node256 *)new_node;
+        for(i = 0; i < 256; i++) {
+            if(n48->index[i] != 0) {
+                n256->children[i] = n48->children[n48->index[i] - 1];
+            }
+        }
+        *ref = new_node;
+        free(node);
+        return _add_child(ref, new_node, c, child);
+
+    default:
+        ((struct _art_node256 *)node)->children[c] = child;
+        break;
+    }
+
+    node->num_children++;
+
+    return 0;
+}
+
+/* Removes the child for byte c, which is in slot, from node */
+static void _remove_child(struct _art_node *node, unsigned char c,
+        struct _art_node **slot)
+{
+    struct _art_node4 *n4;
+    struct _art_node16 *n16;
+    struct _art_node48 *n48;
+    unsigned int i, n = node->num_children;
+
+    switch(node->type) {
+    case NODE4:
+        n4 = (struct _art_node4 *)node;
+        i = slot - n4->children;
+        memmove(n4->keys + i, n4->keys + i + 1, n - i - 1);
+        memmove(n4->children + i, n4->children + i + 1,
+                (n - i - 1) * sizeof(struct _art_node *));
+        break;
+
+    case NODE16:
+        n16 = (struct _art_node16 *)node;
+        i = slot - n16->children;
+        memmove(n16->keys + i, n16->keys + i + 1, n - i - 1);
+        memmove(n16->children + i, n16->children + i + 1,
+                (n - i - 1) * sizeof(struct _art_node *));
+        break;
+
+    case NODE48:
+        n48 = (struct _art_node48 *)node;
+        n48->index[c] = 0;
+        *slot = NULL;
+        break;
+
+    default:
+        *slot = NULL;
+        break;
+    }
+
+    node->num_children--;
+}
+
+/* Replaces the Node4 in *ref, which has one child and no leaf, by that
+ * child, whose prefix grows by the node's prefix and the child's byte.
+ */
+static void _merge_child(struct _art_node **ref, struct _art_node4 *node)
+{
+    struct _art_node *child = node->children[0];
+    unsigned char prefix[ART_MAX_PREFIX];
+    unsigned long n;
+
+    if(!IS_LEAF(child)) {
+        n = min(node->n.prefix_len, ART_MAX_PREFIX);
+        memcpy(prefix, node->n.prefix, n);
+        if(n < ART_MAX_PREFIX) {
+            prefix[n++] = node->keys[0];
+        }
+        if(n < ART_MAX_PREFIX) {
+            memcpy(prefix + n, child->prefix,
+                    min(child->prefix_len, ART_MAX_PREFIX - n));
+        }
+
+        memcpy(child->prefix, prefix, ART_MAX_PREFIX);
+        child->prefix_len += node->n.prefix_len + 1;
+    }
+
+    *ref = child;
+    free(node);
+}
+
+/* Restores the invariants of the node in *ref after it lost a child or
+ * its leaf. A node left with a single entry is replaced by it, and one
+ * that has become sparse enough by a node of a smaller type. The sizes
+ * shrunk at are below those grown at, so that a node on the boundary
+ * is not reallocated at every change.
+ *
+ * Complexity: O(1)
+ */
+static void _compact(struct _art_node **ref)
+{
+    struct _art_node *node = *ref, *new_node = NULL;
+    struct _art_node16 *n16;
+    struct _art_node48 *n48;
+    struct _art_node256 *n256;
+    unsigned int i, j;
+
+    switch(node->type) {
+    case NODE4:
+        if(0 == node->num_children) {
+            *ref = TAG_LEAF(node->leaf);
+            free(node);
+        } else if(1 == node->num_children && NULL == node->leaf) {
+            _merge_child(ref, (struct _art_node4 *)node);
+        }
+        return;
+
+    case NODE16:
+        if(node->num_children > 3) {
+            return;
+        }
+        new_node = _node_create(NODE4);
+        if(NULL == new_node) {
+            return;
+        }
+        n16 = (struct _art_node16 *)node;
+        memcpy(((struct _art_node4 *)new_node)->keys, n16->keys, 3);
+        memcpy(((struct _art_node4 *)new_node)->children, n16->children,
+                3 * sizeof(struct _art_node *));
+        break;
+
+    case NODE48:
+        if(node->num_children > 12) {
+            return;
+        }
+        new_node = _node_create(NODE16);
+        if(NULL == new_node) {
+            return;
+        }
+        n48 = (struct _art_node48 *)node;
+        n16 = (struct _art_node16 *)new_node;
+        for(i = 0, j = 0; i < 256; i++) {
+            if(n48->index[i] != 0) {
+                n16->keys[j] = (unsigned char)i;
+                n16->children[j++] = n48->children[n48->index[i] - 1];
+            }
+        }
+        break;
+
+    default:
+        if(node->num_children > 37) {
+            return;
+        }
+        new_node = _node_create(NODE48);
+        if(NULL == new_node) {
+            return;
+        }
+        n256 = (struct _art_node256 *)node;
+        n48 = (struct _art_node48 *)new_node;
+        for(i = 0, j = 0; i < 256; i++) {
+            if(n256->children[i] != NULL) {
+                n48->children[j] = n256->children[i];
+                n48->index[i] = ++j;
+            }
+        }
+        break;
+    }
+
+    _copy_header(new_node, node);
+    *ref = new_node;
+    free(node);
+}
+
+/* Links leaf into the list of leaves, before successor, or last if
+ * successor is NULL.
+ */
+static void _link_leaf(ART *art, struct _art_leaf *leaf,
+        struct _art_leaf *successor)
+{
+    leaf->next = successor;
+    leaf->prev = (successor != NULL) ? successor->prev : art->last;
+
+    if(leaf->prev != NULL) {
+        leaf->prev->next = leaf;
+    } else {
+        art->first = leaf;
+    }
+
+    if(successor != NULL) {
+        successor->prev = leaf;
+    } else {
+        art->last = leaf;
+    }
+}
+
+/* Unlinks and frees leaf, which must already be out of the tree,
+ * returning its value.
+ */
+static void* _drop_leaf(ART *art, struct _art_leaf *leaf)
+{
+    void *value = leaf->value;
+
+    if(leaf->prev != NULL) {
+        leaf->prev->next = leaf->next;
+    } else {
+        art->first = leaf->next;
+    }
+
+    if(leaf->next != NULL) {
+        leaf->next->prev = leaf->prev;
+    } else {
+        art->last = leaf->prev;
+    }
+
+    art->size--;
+    free(leaf);
+
+    return value;
+}
+
+/* Puts leaf, whose key is at depth in node, into node, which is a new
+ * Node4 with room for it.
+ */
+static void _place_leaf(struct _art_node *node, struct _art_leaf *leaf,
+        unsigned long depth)
+{
+    if(leaf->key_len == depth) {
+        node->leaf = leaf;
+    } else {
+        _add_child(&node, node, leaf->key[depth], TAG_LEAF(leaf));
+    }
+}
+
+/* Replaces the leaf old in *ref by a Node4 holding both it and leaf,
+ * whose keys differ and are both at depth there.
+ */
+static int _split_leaf(struct _art_node **ref, struct _art_leaf *old,
+        struct _art_leaf *leaf, unsigned long depth)
+{
+    struct _art_node *node;
+    unsigned long n;
+
+    node = _node_create(NODE4);
+    if(NULL == node) {
+        return -1;
+    }
+
+    n = _mismatch(old->key + depth, old->key_len - depth,
+            leaf->key + depth, leaf->key_len - depth);
+    node->prefix_len = n;
+    memcpy(node->prefix, leaf->key + depth, min(n, ART_MAX_PREFIX));
+
+    _place_leaf(node, old, depth + n);
+    _place_leaf(node, leaf, depth + n);
+    *ref = node;
+
+    return 0;
+}
+
+/* Splits the prefix of the node in *ref, whose whole prefix is prefix,
+ * at the first n bytes, which are all that the key of leaf shares. A
+ * new Node4 takes those bytes, and holds both the node and leaf.
+ */
+static int _split_prefix(struct _art_node **ref, const unsigned char *prefix,
+        unsigned long n, struct _art_leaf *leaf, unsigned long depth)
+{
+    struct _art_node *node = *ref, *parent;
+    unsigned char c = prefix[n];
+
+    parent = _node_create(NODE4);
+    if(NULL == parent) {
+        return -1;
+    }
+
+    parent->prefix_len = n;
+    memcpy(parent->prefix, prefix, min(n, ART_MAX_PREFIX));
+
+    /* prefix may be the node's own, which is only overwritten from the
+     * front
+     */
+    node->prefix_len -= n + 1;
+    memmove(node->prefix, prefix + n + 1,
+            min(node->prefix_len, ART_MAX_PREFIX));
+
+    _add_child(&parent, parent, c, node);
+    _place_leaf(parent, leaf, depth + n);
+    *ref = parent;
+
+    return 0;
+}
+
+/* Returns the first leaf whose key is not less than key, or if strict
+ * is set, greater than key.
+ *
+ * Complexity: O(k)
+ */
+static struct _art_leaf* _lower_bound(ART *art, const unsigned char *key,
+        unsigned long key_len, int strict)
+{
+    struct _art_node *node, **child, *next, *after = NULL;
+    const unsigned char *prefix;
+    struct _art_leaf *leaf;
+    unsigned long depth = 0, n;
+    int c;
+
+    /* after is the nearest subtree seen so far that comes right after
+     * the path taken, where to go if the path leads nowhere
+     */
+    for(node = art->root; node != NULL; node = *child, depth++) {
+        if(IS_LEAF(node)) {
+            leaf = LEAF(node);
+            c = _compare_keys(leaf->key, leaf->key_len, key, key_len);
+            return (c > 0 || (0 == c && !strict)) ? leaf : _minimum(after);
+        }
+
+        if(node->prefix_len > 0) {
+            prefix = _full_prefix(node, depth);
+            n = _mismatch(prefix, node->prefix_len, key + depth,
+                    key_len - depth);
+            if(n < node->prefix_len) {
+                if(depth + n == key_len || key[depth + n] < prefix[n]) {
+                    return _minimum(node);
+                }
+                return _minimum(after);
+            }
+            depth += node->prefix_len;
+        }
+
+        if(depth == key_len) {
+            if(node->leaf != NULL && !strict) {
+                return node->leaf;
+            }
+            return _minimum(_first_child(node));
+        }
+
+        next = _next_child(node, key[depth]);
+        if(next != NULL) {
+            after = next;
+        }
+
+        child = _find_child(node, key[depth]);
+        if(NULL == child) {
+            return _minimum(after);
+        }
+    }
+
+    return NULL;
+}
+
+static void _free_node(struct _art_node *node)
+{
+    unsigned int i;
+
+    if(NULL == node || IS_LEAF(node)) {
+        return;
+    }
+
+    for(i = 0; i < 256; i++) {
+        _free_node(_child_at(node, i));
+    }
+
+    free(node);
+}
+
+static void art_destroy(ART *art, FreeFn freefn)
+{
+    struct _art_leaf *leaf, *next;
+
+    _free_node(art->root);
+
+    for(leaf = art->first; leaf != NULL; leaf = next) {
+        next = leaf->next;
+        if(freefn != NULL) {
+            freefn(leaf->value);
+        }
+        free(leaf);
+    }
+
+    free(art);
+}
+
+/* Complexity: O(1) */
+ART* art_create(void)
+{
+    ART *new_art;
+
+    new_art = malloc(sizeof(struct _art));
+    if(NULL == new_art) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_art->root = NULL;
+    new_art->first = NULL;
+    new_art->last = NULL;
+    new_art->size = 0;
+
+    return new_art;
+}
+
+/* Complexity: O(n) */
+void art_free(ART *art)
+{
+    assert(art != NULL);
+
+    /* Only free the containers, not the data stored in the tree */
+    art_destroy(art, NULL);
+}
+
+/* Complexity: O(n) */
+void art_free_all(ART *art, FreeFn freefn)
+{
+    assert(art != NULL);
+
+    if(NULL == freefn) {
+        /* Default to free */
+        freefn = (FreeFn)free;
+    }
+
+    art_destroy(art, freefn);
+}
+
+/* Returns -1 if key is already in the tree, or out of memory.
+ *
+ * Complexity: O(k)
+ */
+int art_insert(ART *art, const void *key, unsigned long key_len, void *value)
+{
+    const unsigned char *k = key, *prefix;
+    struct _art_node **ref, **child, *node, *next, *after = NULL;
+    struct _art_leaf *leaf, *old, *successor;
+    unsigned long depth = 0, n;
+    int c;
+
+    assert(art != NULL);
+    assert(key != NULL);
+    assert(key_len <= UINT_MAX);
+
+    leaf = _leaf_create(k, key_len, value);
+    if(NULL == leaf) {
+        return -1;
+    }
+
+    /* The leaf that will follow the new one is found on the way down,
+     * as with _lower_bound
+     */
+    for(ref = &art->root;; ref = child, depth++) {
+        node = *ref;
+        if(NULL == node) {
+            *ref = TAG_LEAF(leaf);
+            successor = NULL;
+            break;
+        }
+
+        if(IS_LEAF(node)) {
+            old = LEAF(node);
+            c = _compare_keys(old->key, old->key_len, k, key_len);
+            if(0 == c || _split_leaf(ref, old, leaf, depth) != 0) {
+                free(leaf);
+                return -1;
+            }
+            successor = (c > 0) ? old : _minimum(after);
+            break;
+        }
+
+        if(node->prefix_len > 0) {
+            prefix = _full_prefix(node, depth);
+            n = _mismatch(prefix, node->prefix_len, k + depth,
+                    key_len - depth);
+            if(n < node->prefix_len) {
+                if(depth + n == key_len || k[depth + n] < prefix[n]) {
+                    successor = _minimum(node);
+                } else {
+                    successor = _minimum(after);
+                }
+                if(_split_prefix(ref, prefix, n, leaf, depth) != 0) {
+                    free(leaf);
+                    return -1;
+                }
+                break;
+            }
+            depth += node->prefix_len;
+        }
+
+        if(depth == key_len) {
+            if(node->leaf != NULL) {
+                free(leaf);
+                return -1;
+            }
+            successor = _minimum(_first_child(node));
+            node->leaf = leaf;
+            break;
+        }
+
+        next = _next_child(node, k[depth]);
+        if(next != NULL) {
+            after = next;
+        }
+
+        child = _find_child(node, k[depth]);
+        if(NULL == child) {
+            successor = _minimum(after);
+            if(_add_child(ref, node, k[depth], TAG_LEAF(leaf)) != 0) {
+                free(leaf);
+                return -1;
+            }
+            break;
+        }
+    }
+
+    _link_leaf(art, leaf, successor);
+    art->size++;
+
+    return 0;
+}
+
+/* Returns the value of the removed entry, or NULL if key was not found.
+ *
+ * Complexity: O(k)
+ */
+void* art_remove(ART *art, const void *key, unsigned long key_len)
+{
+    const unsigned char *k = key;
+    struct _art_node **ref, **child, *node;
+    struct _art_leaf *leaf;
+    unsigned long depth = 0;
+
+    assert(art != NULL);
+    assert(key != NULL);
+
+    if(NULL == art->root) {
+        return NULL;
+    }
+
+    if(IS_LEAF(art->root)) {
+        leaf = LEAF(art->root);
+        if(!_leaf_matches(leaf, k, key_len)) {
+            return NULL;
+        }
+        art->root = NULL;
+        return _drop_leaf(art, leaf);
+    }
+
+    /* Leaves are removed from their parent, which may then change */
+    for(ref = &art->root;; ref = child, depth++) {
+        node = *ref;
+        if(!_prefix_matches(node, k + depth, key_len - depth)) {
+            return NULL;
+        }
+        depth += node->prefix_len;
+
+        if(depth == key_len) {
+            leaf = node->leaf;
+            if(NULL == leaf || !_leaf_matches(leaf, k, key_len)) {
+                return NULL;
+            }
+            node->leaf = NULL;
+            _compact(ref);
+            return _drop_leaf(art, leaf);
+        }
+
+        child = _find_child(node, k[depth]);
+        if(NULL == child) {
+            return NULL;
+        }
+
+        if(IS_LEAF(*child)) {
+            leaf = LEAF(*child);
+            if(!_leaf_matches(leaf, k, key_len)) {
+                return NULL;
+            }
+            _remove_child(node, k[depth], child);
+            _compact(ref);
+            return _drop_leaf(art, leaf);
+        }
+    }
+}
+
+/* Complexity: O(1) */
+int art_insert_ulong(ART *art, unsigned long key, void *value)
+{
+    unsigned char buf[sizeof(unsigned long)];
+
+    _encode_ulong(key, buf);
+
+    return art_insert(art, buf, sizeof(buf), value);
+}
+
+/* Complexity: O(1) */
+void* art_remove_ulong(ART *art, unsigned long key)
+{
+    unsigned char buf[sizeof(unsigned long)];
+
+    _encode_ulong(key, buf);
+
+    return art_remove(art, buf, sizeof(buf));
+}
+
+/* Complexity: O(1) */
+int art_is_empty(ART *art)
+{
+    assert(art != NULL);
+
+    return (0 == art->size);
+}
+
+/* Checks node, whose keys are at depth there, and its subtree, against
+ * the list of leaves, from *expected on. The subtree's leaves must come
+ * in the same order as the list, which *expected is moved along.
+ */
+static int _check_node(struct _art_node *node, unsigned long depth,
+        struct _art_leaf **expected, unsigned long *count)
+{
+    struct _art_node48 *n48;
+    struct _art_node *child;
+    struct _art_leaf *min_leaf;
+    const unsigned char *keys;
+    unsigned int i, n, last;
+
+    if(IS_LEAF(node)) {
+        if(LEAF(node) != *expected || LEAF(node)->key_len < depth) {
+            return 0;
+        }
+        *expected = LEAF(node)->next;
+        (*count)++;
+        return 1;
+    }
+
+    /* Every node has a child, and at least one other entry */
+    if(0 == node->num_children ||
+            (1 == node->num_children && NULL == node->leaf)) {
+        return 0;
+    }
+
+    min_leaf = _minimum(node);
+    if(min_leaf->key_len < depth + node->prefix_len ||
+            memcmp(min_leaf->key + depth, node->prefix,
+                min(node->prefix_len, ART_MAX_PREFIX)) != 0) {
+        return 0;
+    }
+    depth += node->prefix_len;
+
+    if(node->leaf != NULL) {
+        if(node->leaf->key_len != depth || node->leaf != *expected) {
+            return 0;
+        }
+        *expected = node->leaf->next;
+        (*count)++;
+    }
+
+    if(NODE4 == node->type || NODE16 == node->type) {
+        if(NODE4 == node->type) {
+            keys = ((struct _art_node4 *)node)->keys;
+            last = 4;
+        } else {
+            keys = ((struct _art_node16 *)node)->keys;
+            last = 16;
+        }
+        if(node->num_children > last) {
+            return 0;
+        }
+        for(i = 1; i < node->num_children; i++) {
+            if(keys[i - 1] >= keys[i]) {
+                return 0;
+            }
+        }
+    } else if(NODE48 == node->type) {
+        n48 = (struct _art_node48 *)node;
+        for(i = 0; i < 256; i++) {
+            if(n48->index[i] > 48 || (n48->index[i] != 0 &&
+                        NULL == n48->children[n48->index[i] - 1])) {
+                return 0;
+            }
+        }
+    }
+
+    for(i = 0, n = 0; i < 256; i++) {
+        child = _child_at(node, i);
+        if(NULL == child) {
+            continue;
+        }
+
+        min_leaf = _minimum(child);
+        if(min_leaf->key_len <= depth || min_leaf->key[depth] != i ||
+                !_check_node(child, depth + 1, expected, count)) {
+            return 0;
+        }
+        n++;
+    }
+
+    return (n == node->num_children);
+}
+
+/* Checks the tree's nodes, and that its leaves are linked in order.
+ *
+ * Complexity: O(n)
+ */
+int art_is_valid(ART *art)
+{
+    struct _art_leaf *leaf, *prev = NULL, *expected;
+    unsigned long n = 0;
+
+    assert(art != NULL);
+
+    for(leaf = art->first; leaf != NULL; prev = leaf, leaf = leaf->next) {
+        if(leaf->prev != prev || (prev != NULL &&
+                    _compare_keys(prev->key, prev->key_len, leaf->key,
+                        leaf->key_len) >= 0)) {
+            return 0;
+        }
+        n++;
+    }
+
+    if(n != art->size || art->last != prev) {
+        return 0;
+    }
+
+    if(NULL == art->root) {
+        return (0 == n);
+    }
+
+    expected = art->first;
+    n = 0;
+
+    return (_check_node(art->root, 0, &expected, &n) &&
+            NULL == expected && n == art->size);
+}
+
+/* Complexity: O(1) */
+unsigned long art_size(ART *art)
+{
+    assert(art != NULL);
+
+    return art->size;
+}
+
+/* Complexity: O(k) */
+void* art_remove_at(ART *art, ARTIterator *it)
+{
+    assert(art != NULL);
+    assert(it != NULL);
+
+    return art_remove(art, it->key, it->key_len);
+}
+
+/* Complexity: O(k) */
+ARTIterator* art_find(ART *art, const void *key, unsigned long key_len)
+{
+    const unsigned char *k = key;
+    struct _art_node *node, **child;
+    struct _art_leaf *leaf;
+    unsigned long depth = 0;
+
+    assert(art != NULL);
+    assert(key != NULL);
+
+    for(node = art->root; node != NULL && !IS_LEAF(node);
+            node = *child, depth++) {
+        if(!_prefix_matches(node, k + depth, key_len - depth)) {
+            return NULL;
+        }
+        depth += node->prefix_len;
+
+        if(depth == key_len) {
+            leaf = node->leaf;
+            return (leaf != NULL && _leaf_matches(leaf, k, key_len)) ?
+                leaf : NULL;
+        }
+
+        child = _find_child(node, k[depth]);
+        if(NULL == child) {
+            return NULL;
+        }
+    }
+
+    leaf = LEAF(node);
+
+    return (leaf != NULL && _leaf_matches(leaf, k, key_len)) ? leaf : NULL;
+}
+
+/* Complexity: O(1) */
+ARTIterator* art_find_ulong(ART *art, unsigned long key)
+{
+    unsigned char buf[sizeof(unsigned long)];
+
+    _encode_ulong(key, buf);
+
+    return art_find(art, buf, sizeof(buf));
+}
+
+/* Complexity: O(1) */
+ARTIterator* art_begin(ART *art)
+{
+    assert(art != NULL);
+
+    return art->first;
+}
+
+/* Complexity: O(1) */
+ARTIterator* art_end(ART *art)
+{
+    assert(art != NULL);
+
+    return art->last;
+}
+
+/* Complexity: O(1) */
+ARTIterator* art_next(ARTIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->next;
+}
+
+/* Complexity: O(1) */
+ARTIterator* art_prev(ARTIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->prev;
+}
+
+/* Returns the first entry whose key is not less than key.
+ *
+ * Complexity: O(k)
+ */
+ARTIterator* art_lower_bound(ART *art, const void *key,
+        unsigned long key_len)
+{
+    assert(art != NULL);
+    assert(key != NULL);
+
+    return _lower_bound(art, key, key_len, 0);
+}
+
+/* Complexity: O(1) */
+ARTIterator* art_lower_bound_ulong(ART *art, unsigned long key)
+{
+    unsigned char buf[sizeof(unsigned long)];
+
+    assert(art != NULL);
+
+    _encode_ulong(key, buf);
+
+    return _lower_bound(art, buf, sizeof(buf), 0);
+}
+
+/* Returns the first entry whose key is greater than key.
+ *
+ * Complexity: O(k)
+ */
+ARTIterator* art_upper_bound(ART *art, const void *key,
+        unsigned long key_len)
+{
+    assert(art != NULL);
+    assert(key != NULL);
+
+    return _lower_bound(art, key, key_len, 1);
+}
+
+/* All the keys with a given prefix are below one node, or in a single
+ * leaf, found by following the prefix down. If there are none, both
+ * ends of the range are where the prefix would go.
+ *
+ * Complexity: O(k)
+ */
+void art_prefix_range(ART *art, const void *prefix, unsigned long prefix_len,
+        ARTIterator **first, ARTIterator **last)
+{
+    const unsigned char *p = prefix;
+    struct _art_node *node, **child;
+    struct _art_leaf *leaf;
+    unsigned long depth = 0, n;
+
+    assert(art != NULL);
+    assert(prefix != NULL);
+    assert(first != NULL);
+    assert(last != NULL);
+
+    for(node = art->root; node != NULL && !IS_LEAF(node) &&
+            depth < prefix_len; node = *child, depth++) {
+        n = min(node->prefix_len, prefix_len - depth);
+        if(memcmp(_full_prefix(node, depth), p + depth, n) != 0) {
+            node = NULL;
+            break;
+        }
+
+        depth += n;
+        if(depth == prefix_len) {
+            break;
+        }
+
+        child = _find_child(node, p[depth]);
+        if(NULL == child) {
+            node = NULL;
+            break;
+        }
+    }
+
+    if(node != NULL && IS_LEAF(node)) {
+        leaf = LEAF(node);
+        if(leaf->key_len < prefix_len ||
+                memcmp(leaf->key, p, prefix_len) != 0) {
+            node = NULL;
+        }
+    }
+
+    if(NULL == node) {
+        *first = *last = _lower_bound(art, p, prefix_len, 0);
+        return;
+    }
+
+    *first = _minimum(node);
+    *last = _maximum(node)->next;
+}
+
+/* Complexity: O(1) */
+const void* art_get_key(ARTIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->key;
+}
+
+/* Complexity: O(1) */
+unsigned long art_get_key_len(ARTIterator *it)
+{
+    if(NULL == it) {
+        return 0;
+    }
+
+    return it->key_len;
+}
+
+/* Complexity: O(1) */
+unsigned long art_get_key_ulong(ARTIterator *it)
+{
+    unsigned long key = 0;
+    unsigned int i;
+
+    if(NULL == it) {
+        return 0;
+    }
+
+    assert(sizeof(unsigned long) == it->key_len);
+
+    for(i = 0; i < sizeof(unsigned long); i++) {
+        key = (key << CHAR_BIT) | it->key[i];
+    }
+
+    return key;
+}
+
+/* Complexity: O(1) */
+void* art_get_value(ARTIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->value;
+}
+
+/* Replaces the value of it, returning the old one.
+ *
+ * Complexity: O(1)
+ */
+void* art_set_value(ARTIterator *it, void *value)
+{
+    void *old_value;
+
+    assert(it != NULL);
+
+    old_value = it->value;
+    it->value = value;
+
+    return old_value;
+}
@@ -0,0 +1,52 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBCORE_ATOMIC_H__
+#define __LIBCORE_ATOMIC_H__
+
+/* Thin wrappers over the GCC atomic builtins, which are available with
+ * -ansi as well. Loads and stores of shared words that may race must go
+ * through these, with the weakest ordering that is still correct.
+ */
+
+#define atomic_load(p)              __atomic_load_n((p), __ATOMIC_RELAXED)
+#define atomic_load_acquire(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomic_store(p, v)          __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define atomic_store_release(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/* All three return the old value, and are full barriers */
+#define atomic_fetch_add(p, v)      __sync_fetch_and_add((p), (v))
+#define atomic_fetch_sub(p, v)      __sync_fetch_and_sub((p), (v))
+#define atomic_cas(p, old, new)     __sync_bool_compare_and_swap((p), (old), (new))
+
+#define atomic_fence_acquire()      __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define atomic_fence_release()      __atomic_thread_fence(__ATOMIC_RELEASE)
+
+/* Also orders earlier stores before later loads */
+#define atomic_fence()              __sync_synchronize()
+
+#endif
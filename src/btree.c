@@ -0,0 +1,1118 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A B+ tree: keys and values live in the leaves, which are linked in
+ * order, and the inner nodes hold only separator keys. Each separator
+ * is the smallest key of the subtree to its right, so every separator
+ * is also a key in the tree, and removing a key updates the separator
+ * that refers to it before the caller gets a chance to free it.
+ *
+ * All nodes span BTREE_NODE_SIZE bytes, a few cache lines, so that a
+ * search touches one node per level rather than one per comparison.
+ * Leaves are also aligned to that size: an iterator points at a key
+ * slot of its leaf, and the leaf is found by masking the low bits.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcore/btree.h>
+
+#define BTREE_NODE_SIZE     512
+
+#define BTREE_LEAF_MAX      ((BTREE_NODE_SIZE - 3 * sizeof(void *)) / \
+                             (2 * sizeof(void *)))
+#define BTREE_LEAF_MIN      (BTREE_LEAF_MAX / 2)
+#define BTREE_INNER_MAX     ((BTREE_NODE_SIZE - 2 * sizeof(void *)) / \
+                             (2 * sizeof(void *)))
+#define BTREE_INNER_MIN     (BTREE_INNER_MAX / 2)
+
+/* Enough levels for any tree that fits in memory, given that every
+ * node but the root has at least BTREE_INNER_MIN + 1 children.
+ */
+#define BTREE_MAX_HEIGHT    24
+
+struct _btree_leaf {
+    /* keys must come first; see leaf_of */
+    const void *keys[BTREE_LEAF_MAX];
+    void *values[BTREE_LEAF_MAX];
+    struct _btree_leaf *prev, *next;
+    unsigned long count;
+};
+
+struct _btree_inner {
+    const void *keys[BTREE_INNER_MAX];
+    void *children[BTREE_INNER_MAX + 1];
+    unsigned long count;
+};
+
+struct _btree {
+    /* A leaf when height is 0, an inner node otherwise */
+    void *root;
+    unsigned long height;
+    unsigned long size;
+    CompareFn comparefn;
+};
+
+/* Iterators point at a key slot in a leaf */
+#define leaf_of(it)     ((struct _btree_leaf *)((unsigned long)(it) & \
+                         ~(unsigned long)(BTREE_NODE_SIZE - 1)))
+#define index_of(it)    ((unsigned long)((const void **)(it) - \
+                         leaf_of(it)->keys))
+#define iterator(leaf, i)   ((BTreeIterator *)&(leaf)->keys[(i)])
+
+static struct _btree_leaf* _leaf_create(void)
+{
+    struct _btree_leaf *leaf;
+    void *mem;
+
+    if(posix_memalign(&mem, BTREE_NODE_SIZE, sizeof(struct _btree_leaf))) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    leaf = mem;
+    leaf->prev = leaf->next = NULL;
+    leaf->count = 0;
+
+    return leaf;
+}
+
+static struct _btree_inner* _inner_create(void)
+{
+    struct _btree_inner *inner;
+
+    inner = malloc(sizeof(struct _btree_inner));
+    if(NULL == inner) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    inner->count = 0;
+
+    return inner;
+}
+
+/* Index of the first of keys[0, count) not less than key.
+ *
+ * Complexity: O(log count)
+ */
+static unsigned long _lower_bound(CompareFn comparefn, const void **keys,
+        unsigned long count, const void *key)
+{
+    unsigned long lo = 0, hi = count, mid;
+
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(comparefn(keys[mid], key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/* Index of the first of keys[0, count) greater than key, which is the
+ * child of an inner node to descend into.
+ *
+ * Complexity: O(log count)
+ */
+static unsigned long _upper_bound(CompareFn comparefn, const void **keys,
+        unsigned long count, const void *key)
+{
+    unsigned long lo = 0, hi = count, mid;
+
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(comparefn(keys[mid], key) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/* Descends to the leaf that holds or would hold key, recording the
+ * inner nodes and child indexes on the way if path is not NULL.
+ *
+ * Complexity: O(log n)
+ */
+static struct _btree_leaf* _descend(BTree *btree, const void *key,
+        struct _btree_inner **path, unsigned long *slots)
+{
+    struct _btree_inner *inner;
+    void *node;
+    unsigned long h, i;
+
+    node = btree->root;
+    for(h = 0; h < btree->height; h++) {
+        inner = node;
+        i = _upper_bound(btree->comparefn, inner->keys, inner->count, key);
+        if(path != NULL) {
+            path[h] = inner;
+            slots[h] = i;
+        }
+        node = inner->children[i];
+    }
+
+    return node;
+}
+
+static void _leaf_insert(struct _btree_leaf *leaf, unsigned long pos,
+        const void *key, void *value)
+{
+    memmove(&leaf->keys[pos + 1], &leaf->keys[pos],
+            (leaf->count - pos) * sizeof(void *));
+    memmove(&leaf->values[pos + 1], &leaf->values[pos],
+            (leaf->count - pos) * sizeof(void *));
+    leaf->keys[pos] = key;
+    leaf->values[pos] = value;
+    leaf->count++;
+}
+
+static void _leaf_remove(struct _btree_leaf *leaf, unsigned long pos)
+{
+    leaf->count--;
+    memmove(&leaf->keys[pos], &leaf->keys[pos + 1],
+            (leaf->count - pos) * sizeof(void *));
+    memmove(&leaf->values[pos], &leaf->values[pos + 1],
+            (leaf->count - pos) * sizeof(void *));
+}
+
+/* Inserts key, with child to its right, at pos */
+static void _inner_insert(struct _btree_inner *inner, unsigned long pos,
+        const void *key, void *child)
+{
+    memmove(&inner->keys[pos + 1], &inner->keys[pos],
+            (inner->count - pos) * sizeof(void *));
+    memmove(&inner->children[pos + 2], &inner->children[pos + 1],
+            (inner->count - pos) * sizeof(void *));
+    inner->keys[pos] = key;
+    inner->children[pos + 1] = child;
+    inner->count++;
+}
+
+/* Removes the key at pos, with the child to its right */
+static void _inner_remove(struct _btree_inner *inner, unsigned long pos)
+{
+    inner->count--;
+    memmove(&inner->keys[pos], &inner->keys[pos + 1],
+            (inner->count - pos) * sizeof(void *));
+    memmove(&inner->children[pos + 1], &inner->children[pos + 2],
+            (inner->count - pos) * sizeof(void *));
+}
+
+/* Splits a full leaf, inserting key at pos on the way. Returns the new
+ * right half.
+ */
+static struct _btree_leaf* _leaf_split(struct _btree_leaf *leaf,
+        struct _btree_leaf *right, unsigned long pos, const void *key,
+        void *value)
+{
+    unsigned long half, from;
+
+    half = (BTREE_LEAF_MAX + 1) / 2;
+    from = (pos < half) ? half - 1 : half;
+
+    memcpy(right->keys, &leaf->keys[from],
+            (leaf->count - from) * sizeof(void *));
+    memcpy(right->values, &leaf->values[from],
+            (leaf->count - from) * sizeof(void *));
+    right->count = leaf->count - from;
+    leaf->count = from;
+
+    if(pos < half) {
+        _leaf_insert(leaf, pos, key, value);
+    } else {
+        _leaf_insert(right, pos - half, key, value);
+    }
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    if(right->next != NULL) {
+        right->next->prev = right;
+    }
+    leaf->next = right;
+
+    return right;
+}
+
+/* Splits a full inner node, inserting key and child at pos on the way.
+ * The middle key, which moves up to the parent, is stored in *up_key.
+ */
+static void _inner_split(struct _btree_inner *inner,
+        struct _btree_inner *right, unsigned long pos, const void *key,
+        void *child, const void **up_key)
+{
+    const void *keys[BTREE_INNER_MAX + 1];
+    void *children[BTREE_INNER_MAX + 2];
+    unsigned long i, j, mid;
+
+    /* Lay out all keys and children in order, then deal them out */
+    for(i = 0, j = 0; i <= inner->count; i++) {
+        if(i == pos) {
+            keys[j++] = key;
+        }
+        if(i < inner->count) {
+            keys[j++] = inner->keys[i];
+        }
+    }
+    for(i = 0, j = 0; i <= inner->count; i++) {
+        children[j++] = inner->children[i];
+        if(i == pos) {
+            children[j++] = child;
+        }
+    }
+
+    mid = (BTREE_INNER_MAX + 1) / 2;
+
+    memcpy(inner->keys, keys, mid * sizeof(void *));
+    memcpy(inner->children, children, (mid + 1) * sizeof(void *));
+    inner->count = mid;
+
+    *up_key = keys[mid];
+
+    right->count = BTREE_INNER_MAX - mid;
+    memcpy(right->keys, &keys[mid + 1], right->count * sizeof(void *));
+    memcpy(right->children, &children[mid + 1],
+            (right->count + 1) * sizeof(void *));
+}
+
+static void _btree_free_all(void *node, unsigned long height, FreeFn freefn)
+{
+    struct _btree_inner *inner;
+    struct _btree_leaf *leaf;
+    unsigned long i;
+
+    if(height > 0) {
+        inner = node;
+        for(i = 0; i <= inner->count; i++) {
+            _btree_free_all(inner->children[i], height - 1, freefn);
+        }
+        free(inner);
+    } else {
+        leaf = node;
+        if(freefn != NULL) {
+            for(i = 0; i < leaf->count; i++) {
+                freefn(leaf->values[i]);
+            }
+        }
+        free(leaf);
+    }
+}
+
+/* Rebalances a leaf that fell below BTREE_LEAF_MIN entries, borrowing
+ * from a sibling or merging with one. Returns 1 if a merge took an
+ * entry out of parent, which may then need rebalancing in turn.
+ */
+static int _leaf_rebalance(struct _btree_leaf *leaf,
+        struct _btree_inner *parent, unsigned long slot)
+{
+    struct _btree_leaf *left, *right;
+
+    left = (slot > 0) ? parent->children[slot - 1] : NULL;
+    right = (slot < parent->count) ? parent->children[slot + 1] : NULL;
+
+    if(left != NULL && left->count > BTREE_LEAF_MIN) {
+        _leaf_insert(leaf, 0, left->keys[left->count - 1],
+                left->values[left->count - 1]);
+        left->count--;
+        parent->keys[slot - 1] = leaf->keys[0];
+        return 0;
+    }
+
+    if(right != NULL && right->count > BTREE_LEAF_MIN) {
+        leaf->keys[leaf->count] = right->keys[0];
+        leaf->values[leaf->count] = right->values[0];
+        leaf->count++;
+        _leaf_remove(right, 0);
+        parent->keys[slot] = right->keys[0];
+        return 0;
+    }
+
+    /* Merge the right one of the pair into the left */
+    if(left != NULL) {
+        right = leaf;
+        slot--;
+    } else {
+        left = leaf;
+    }
+
+    memcpy(&left->keys[left->count], right->keys,
+            right->count * sizeof(void *));
+    memcpy(&left->values[left->count], right->values,
+            right->count * sizeof(void *));
+    left->count += right->count;
+
+    left->next = right->next;
+    if(left->next != NULL) {
+        left->next->prev = left;
+    }
+    free(right);
+
+    _inner_remove(parent, slot);
+
+    return 1;
+}
+
+/* The same as _leaf_rebalance, for inner nodes */
+static int _inner_rebalance(struct _btree_inner *inner,
+        struct _btree_inner *parent, unsigned long slot)
+{
+    struct _btree_inner *left, *right;
+
+    left = (slot > 0) ? parent->children[slot - 1] : NULL;
+    right = (slot < parent->count) ? parent->children[slot + 1] : NULL;
+
+    if(left != NULL && left->count > BTREE_INNER_MIN) {
+        memmove(&inner->keys[1], inner->keys, inner->count * sizeof(void *));
+        memmove(&inner->children[1], inner->children,
+                (inner->count + 1) * sizeof(void *));
+        inner->keys[0] = parent->keys[slot - 1];
+        inner->children[0] = left->children[left->count];
+        inner->count++;
+        parent->keys[slot - 1] = left->keys[left->count - 1];
+        left->count--;
+        return 0;
+    }
+
+    if(right != NULL && right->count > BTREE_INNER_MIN) {
+        inner->keys[inner->count] = parent->keys[slot];
+        inner->children[inner->count + 1] = right->children[0];
+        inner->count++;
+        parent->keys[slot] = right->keys[0];
+        right->count--;
+        memmove(right->keys, &right->keys[1], right->count * sizeof(void *));
+        memmove(right->children, &right->children[1],
+                (right->count + 1) * sizeof(void *));
+        return 0;
+    }
+
+    if(left != NULL) {
+        right = inner;
+        slot--;
+    } else {
+        left = inner;
+    }
+
+    /* The separator comes down between the two halves */
+    left->keys[left->count] = parent->keys[slot];
+    memcpy(&left->keys[left->count + 1], right->keys,
+            right->count * sizeof(void *));
+    memcpy(&left->children[left->count + 1], right->children,
+            (right->count + 1) * sizeof(void *));
+    left->count += right->count + 1;
+    free(right);
+
+    _inner_remove(parent, slot);
+
+    return 1;
+}
+
+/* Checks the subtree rooted at node, whose keys must all lie in
+ * [lo, hi) (either may be NULL, for no bound). Stores the smallest key
+ * in *min, and checks the leaf links against *last, the previous leaf
+ * in order. Returns the number of entries, or -1.
+ */
+static long _btree_is_valid(BTree *btree, void *node, unsigned long height,
+        const void *lo, const void *hi, const void **min,
+        struct _btree_leaf **last)
+{
+    struct _btree_inner *inner;
+    struct _btree_leaf *leaf;
+    const void *child_min;
+    unsigned long i, count;
+    long n, total;
+    int is_root;
+
+    is_root = (node == btree->root);
+
+    if(0 == height) {
+        leaf = node;
+        count = leaf->count;
+        if(count > BTREE_LEAF_MAX || (!is_root && count < BTREE_LEAF_MIN)) {
+            assert(0);
+            return -1;
+        }
+        if(leaf->prev != *last || (*last != NULL && (*last)->next != leaf)) {
+            assert(0);
+            return -1;
+        }
+        for(i = 0; i < count; i++) {
+            if((i > 0 && btree->comparefn(leaf->keys[i - 1],
+                            leaf->keys[i]) >= 0) ||
+                    (lo != NULL && btree->comparefn(leaf->keys[i], lo) < 0) ||
+                    (hi != NULL && btree->comparefn(leaf->keys[i], hi) >= 0)) {
+                assert(0);
+                return -1;
+            }
+        }
+        *min = (count > 0) ? leaf->keys[0] : NULL;
+        *last = leaf;
+
+        return count;
+    }
+
+    inner = node;
+    count = inner->count;
+    if(count > BTREE_INNER_MAX || count < (is_root ? 1 : BTREE_INNER_MIN)) {
+        assert(0);
+        return -1;
+    }
+
+    total = 0;
+    for(i = 0; i <= count; i++) {
+        n = _btree_is_valid(btree, inner->children[i], height - 1,
+                (i > 0) ? inner->keys[i - 1] : lo,
+                (i < count) ? inner->keys[i] : hi, &child_min, last);
+        if(n < 0) {
+            return -1;
+        }
+
+        /* Each separator is the smallest key to its right */
+        if(i > 0 && child_min != inner->keys[i - 1]) {
+            assert(0);
+            return -1;
+        }
+        if(0 == i) {
+            *min = child_min;
+        }
+        total += n;
+    }
+
+    return total;
+}
+
+/* Complexity: O(1) */
+BTree* btree_create(CompareFn comparefn)
+{
+    BTree *btree;
+
+    assert(comparefn != NULL);
+    assert(sizeof(struct _btree_leaf) <= BTREE_NODE_SIZE);
+
+    btree = malloc(sizeof(BTree));
+    if(NULL == btree) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    btree->root = _leaf_create();
+    if(NULL == btree->root) {
+        free(btree);
+        return NULL;
+    }
+
+    btree->height = 0;
+    btree->size = 0;
+    btree->comparefn = comparefn;
+
+    return btree;
+}
+
+/* Complexity: O(n / b), with b the number of entries per node */
+void btree_free(BTree *btree)
+{
+    assert(btree != NULL);
+
+    _btree_free_all(btree->root, btree->height, NULL);
+    free(btree);
+}
+
+/* Complexity: O(n) */
+void btree_free_all(BTree *btree, FreeFn freefn)
+{
+    assert(btree != NULL);
+
+    if(NULL == freefn) {
+        /* Default to free */
+        freefn = (FreeFn)free;
+    }
+
+    _btree_free_all(btree->root, btree->height, freefn);
+    free(btree);
+}
+
+/* Inserts key, unless it is already present. Returns 1 if inserted, 0
+ * if present, and -1 if out of memory. Unless out of memory, *it is set
+ * to the key's slot.
+ *
+ * Complexity: O(log n)
+ */
+static int _btree_insert(BTree *btree, const void *key, void *value,
+        BTreeIterator **it)
+{
+    struct _btree_inner *path[BTREE_MAX_HEIGHT];
+    struct _btree_inner *spare[BTREE_MAX_HEIGHT + 1];
+    unsigned long slots[BTREE_MAX_HEIGHT];
+    struct _btree_leaf *leaf, *new_leaf;
+    struct _btree_inner *inner, *root;
+    const void *up_key;
+    void *up_child;
+    unsigned long pos, h, nspare, i;
+
+    assert(btree != NULL);
+    assert(btree->height < BTREE_MAX_HEIGHT);
+
+    leaf = _descend(btree, key, path, slots);
+
+    pos = _lower_bound(btree->comparefn, leaf->keys, leaf->count, key);
+    if(pos < leaf->count && btree->comparefn(leaf->keys[pos], key) == 0) {
+        *it = iterator(leaf, pos);
+        return 0;
+    }
+
+    if(leaf->count < BTREE_LEAF_MAX) {
+        _leaf_insert(leaf, pos, key, value);
+        btree->size++;
+        *it = iterator(leaf, pos);
+        return 1;
+    }
+
+    /* Allocate every node the split will need up front, so that running
+     * out of memory leaves the tree as it was.
+     */
+    for(h = btree->height, nspare = 0; h > 0; h--, nspare++) {
+        if(path[h - 1]->count < BTREE_INNER_MAX) {
+            break;
+        }
+    }
+    if(0 == h) {
+        /* A new root */
+        nspare++;
+    }
+
+    new_leaf = _leaf_create();
+    if(NULL == new_leaf) {
+        return -1;
+    }
+    for(i = 0; i < nspare; i++) {
+        spare[i] = _inner_create();
+        if(NULL == spare[i]) {
+            while(i > 0) {
+                free(spare[--i]);
+            }
+            free(new_leaf);
+            return -1;
+        }
+    }
+
+    up_child = _leaf_split(leaf, new_leaf, pos, key, value);
+    up_key = new_leaf->keys[0];
+
+    /* Inner splits move no leaves, so this stays valid */
+    if(pos < (BTREE_LEAF_MAX + 1) / 2) {
+        *it = iterator(leaf, pos);
+    } else {
+        *it = iterator(new_leaf, pos - (BTREE_LEAF_MAX + 1) / 2);
+    }
+
+    for(h = btree->height; h > 0; h--) {
+        inner = path[h - 1];
+        if(inner->count < BTREE_INNER_MAX) {
+            _inner_insert(inner, slots[h - 1], up_key, up_child);
+            btree->size++;
+            return 1;
+        }
+
+        _inner_split(inner, spare[--nspare], slots[h - 1], up_key, up_child,
+                &up_key);
+        up_child = spare[nspare];
+    }
+
+    /* The root split */
+    assert(1 == nspare);
+    root = spare[0];
+    root->keys[0] = up_key;
+    root->children[0] = btree->root;
+    root->children[1] = up_child;
+    root->count = 1;
+
+    btree->root = root;
+    btree->height++;
+    btree->size++;
+
+    return 1;
+}
+
+/* Keys are unique: returns -1 if key is already present, as well as
+ * when out of memory.
+ *
+ * Complexity: O(log n)
+ */
+int btree_insert(BTree *btree, const void *key, void *value)
+{
+    BTreeIterator *it;
+
+    return (_btree_insert(btree, key, value, &it) == 1) ? 0 : -1;
+}
+
+/* Returns the slot of key, inserting it with value first if it is not
+ * present, in a single descent. *inserted, if not NULL, tells which
+ * happened. Returns NULL if out of memory.
+ *
+ * Complexity: O(log n)
+ */
+BTreeIterator* btree_find_or_insert(BTree *btree, const void *key,
+        void *value, int *inserted)
+{
+    BTreeIterator *it = NULL;
+    int ret;
+
+    ret = _btree_insert(btree, key, value, &it);
+    if(inserted != NULL) {
+        *inserted = (1 == ret);
+    }
+
+    return (ret < 0) ? NULL : it;
+}
+
+/* Complexity: O(log n) */
+void* btree_remove(BTree *btree, const void *key)
+{
+    struct _btree_inner *path[BTREE_MAX_HEIGHT];
+    unsigned long slots[BTREE_MAX_HEIGHT];
+    struct _btree_leaf *leaf;
+    struct _btree_inner *root;
+    unsigned long pos, h;
+    void *value;
+
+    assert(btree != NULL);
+
+    leaf = _descend(btree, key, path, slots);
+
+    pos = _lower_bound(btree->comparefn, leaf->keys, leaf->count, key);
+    if(pos == leaf->count || btree->comparefn(leaf->keys[pos], key) != 0) {
+        return NULL;
+    }
+
+    value = leaf->values[pos];
+    _leaf_remove(leaf, pos);
+    btree->size--;
+
+    /* The separator naming the removed key, if any, is the one to the
+     * left of the lowest ancestor not reached through its first child.
+     */
+    if(0 == pos && leaf->count > 0) {
+        for(h = btree->height; h > 0; h--) {
+            if(slots[h - 1] > 0) {
+                path[h - 1]->keys[slots[h - 1] - 1] = leaf->keys[0];
+                break;
+            }
+        }
+    }
+
+    if(0 == btree->height || leaf->count >= BTREE_LEAF_MIN) {
+        return value;
+    }
+
+    h = btree->height;
+    if(_leaf_rebalance(leaf, path[h - 1], slots[h - 1])) {
+        for(h--; h > 0 && path[h]->count < BTREE_INNER_MIN; h--) {
+            if(!_inner_rebalance(path[h], path[h - 1], slots[h - 1])) {
+                break;
+            }
+        }
+    }
+
+    /* Collapse a root left with a single child */
+    root = btree->root;
+    if(0 == root->count) {
+        btree->root = root->children[0];
+        btree->height--;
+        free(root);
+    }
+
+    return value;
+}
+
+/* Complexity: O(1) */
+int btree_is_empty(BTree *btree)
+{
+    assert(btree != NULL);
+
+    return (btree->size == 0);
+}
+
+/* Complexity: O(n) */
+int btree_is_valid(BTree *btree)
+{
+    struct _btree_leaf *last;
+    const void *min;
+    long n;
+
+    assert(btree != NULL);
+
+    last = NULL;
+    n = _btree_is_valid(btree, btree->root, btree->height, NULL, NULL, &min,
+            &last);
+    if(n < 0) {
+        return 0;
+    }
+
+    if((unsigned long)n != btree->size || last->next != NULL) {
+        assert(0);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Complexity: O(1) */
+unsigned long btree_size(BTree *btree)
+{
+    assert(btree != NULL);
+
+    return btree->size;
+}
+
+/* Returns the number of keys that compare less than key. Inner nodes
+ * do not keep counts, so this walks the leaves.
+ *
+ * Complexity: O(n / b), with b the number of entries per node
+ */
+unsigned long btree_rank(BTree *btree, const void *key)
+{
+    struct _btree_leaf *leaf;
+    unsigned long rank = 0;
+
+    assert(btree != NULL);
+
+    for(leaf = leaf_of(btree_begin(btree)); leaf != NULL; leaf = leaf->next) {
+        if(btree->comparefn(leaf->keys[leaf->count - 1], key) >= 0) {
+            return rank + _lower_bound(btree->comparefn, leaf->keys,
+                    leaf->count, key);
+        }
+        rank += leaf->count;
+    }
+
+    return rank;
+}
+
+/* Complexity: O(1) */
+CompareFn btree_get_comparefn(BTree *btree)
+{
+    assert(btree != NULL);
+
+    return btree->comparefn;
+}
+
+/* Complexity: O(log n) */
+void* btree_remove_at(BTree *btree, BTreeIterator *it)
+{
+    assert(btree != NULL);
+    assert(it != NULL);
+
+    return btree_remove(btree, btree_get_key(it));
+}
+
+/* Complexity: O(log n) */
+BTreeIterator* btree_find(BTree *btree, const void *key)
+{
+    struct _btree_leaf *leaf;
+    unsigned long pos;
+
+    assert(btree != NULL);
+
+    leaf = _descend(btree, key, NULL, NULL);
+
+    pos = _lower_bound(btree->comparefn, leaf->keys, leaf->count, key);
+    if(pos < leaf->count && btree->comparefn(leaf->keys[pos], key) == 0) {
+        return iterator(leaf, pos);
+    }
+
+    return NULL;
+}
+
+/* Complexity: O(log n) */
+BTreeIterator* btree_begin(BTree *btree)
+{
+    struct _btree_inner *inner;
+    struct _btree_leaf *leaf;
+    void *node;
+    unsigned long h;
+
+    assert(btree != NULL);
+
+    node = btree->root;
+    for(h = 0; h < btree->height; h++) {
+        inner = node;
+        node = inner->children[0];
+    }
+
+    leaf = node;
+    if(0 == leaf->count) {
+        return NULL;
+    }
+
+    return iterator(leaf, 0);
+}
+
+/* Complexity: O(log n) */
+BTreeIterator* btree_end(BTree *btree)
+{
+    struct _btree_inner *inner;
+    struct _btree_leaf *leaf;
+    void *node;
+    unsigned long h;
+
+    assert(btree != NULL);
+
+    node = btree->root;
+    for(h = 0; h < btree->height; h++) {
+        inner = node;
+        node = inner->children[inner->count];
+    }
+
+    leaf = node;
+    if(0 == leaf->count) {
+        return NULL;
+    }
+
+    return iterator(leaf, leaf->count - 1);
+}
+
+/* Complexity: O(1) */
+BTreeIterator* btree_next(BTreeIterator *it)
+{
+    struct _btree_leaf *leaf;
+    unsigned long i;
+
+    if(NULL == it) {
+        return NULL;
+    }
+
+    leaf = leaf_of(it);
+    i = index_of(it) + 1;
+    if(i < leaf->count) {
+        return iterator(leaf, i);
+    }
+
+    /* Only the root may be an empty leaf */
+    leaf = leaf->next;
+    if(NULL == leaf) {
+        return NULL;
+    }
+
+    return iterator(leaf, 0);
+}
+
+/* Complexity: O(1) */
+BTreeIterator* btree_prev(BTreeIterator *it)
+{
+    struct _btree_leaf *leaf;
+    unsigned long i;
+
+    if(NULL == it) {
+        return NULL;
+    }
+
+    leaf = leaf_of(it);
+    i = index_of(it);
+    if(i > 0) {
+        return iterator(leaf, i - 1);
+    }
+
+    leaf = leaf->prev;
+    if(NULL == leaf) {
+        return NULL;
+    }
+
+    return iterator(leaf, leaf->count - 1);
+}
+
+/* Returns the index-th entry in iteration order, or NULL. Like
+ * btree_rank, this walks the leaves.
+ *
+ * Complexity: O(n / b), with b the number of entries per node
+ */
+BTreeIterator* btree_select(BTree *btree, unsigned long index)
+{
+    struct _btree_leaf *leaf;
+
+    assert(btree != NULL);
+
+    if(index >= btree->size) {
+        return NULL;
+    }
+
+    for(leaf = leaf_of(btree_begin(btree)); index >= leaf->count;
+            leaf = leaf->next) {
+        index -= leaf->count;
+    }
+
+    return iterator(leaf, index);
+}
+
+/* Returns the first key not less than key, or NULL if there is none.
+ *
+ * Complexity: O(log n)
+ */
+BTreeIterator* btree_lower_bound(BTree *btree, const void *key)
+{
+    struct _btree_leaf *leaf;
+    unsigned long pos;
+
+    assert(btree != NULL);
+
+    leaf = _descend(btree, key, NULL, NULL);
+
+    /* Past the end of its leaf, the bound is the next leaf's first key */
+    pos = _lower_bound(btree->comparefn, leaf->keys, leaf->count, key);
+    if(pos < leaf->count) {
+        return iterator(leaf, pos);
+    }
+
+    leaf = leaf->next;
+    if(NULL == leaf) {
+        return NULL;
+    }
+
+    return iterator(leaf, 0);
+}
+
+/* Returns the first key greater than key, or NULL if there is none.
+ *
+ * Complexity: O(log n)
+ */
+BTreeIterator* btree_upper_bound(BTree *btree, const void *key)
+{
+    struct _btree_leaf *leaf;
+    unsigned long pos;
+
+    assert(btree != NULL);
+
+    leaf = _descend(btree, key, NULL, NULL);
+
+    pos = _upper_bound(btree->comparefn, leaf->keys, leaf->count, key);
+    if(pos < leaf->count) {
+        return iterator(leaf, pos);
+    }
+
+    leaf = leaf->next;
+    if(NULL == leaf) {
+        return NULL;
+    }
+
+    return iterator(leaf, 0);
+}
+
+/* Keys are unique, so the range holds at most one key.
+ *
+ * Complexity: O(log n)
+ */
+void btree_equal_range(BTree *btree, const void *key,
+        BTreeIterator **first, BTreeIterator **last)
+{
+    assert(first != NULL);
+    assert(last != NULL);
+
+    *first = btree_lower_bound(btree, key);
+    *last = *first;
+    if(*first != NULL && btree->comparefn(btree_get_key(*first), key) == 0) {
+        *last = btree_next(*first);
+    }
+}
+
+/* Returns the number of keys in [lo, hi). Whole leaves are counted at
+ * once, so this takes O(log n + k/b) time for k keys in the range,
+ * rather than the O(n/b) of two ranks.
+ */
+unsigned long btree_count_range(BTree *btree, const void *lo,
+        const void *hi)
+{
+    struct _btree_leaf *leaf;
+    unsigned long pos, count = 0;
+
+    assert(btree != NULL);
+    assert(lo != NULL);
+    assert(hi != NULL);
+
+    if(btree->comparefn(lo, hi) >= 0) {
+        return 0;
+    }
+
+    leaf = _descend(btree, lo, NULL, NULL);
+    pos = _lower_bound(btree->comparefn, leaf->keys, leaf->count, lo);
+
+    for(; leaf != NULL; leaf = leaf->next, pos = 0) {
+        if(leaf->count > 0 &&
+                btree->comparefn(leaf->keys[leaf->count - 1], hi) >= 0) {
+            return count + _lower_bound(btree->comparefn, leaf->keys,
+                    leaf->count, hi) - pos;
+        }
+        count += leaf->count - pos;
+    }
+
+    return count;
+}
+
+/* Complexity: O(1) */
+const void* btree_get_key(BTreeIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return *(const void **)it;
+}
+
+/* Complexity: O(1) */
+void* btree_get_value(BTreeIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return leaf_of(it)->values[index_of(it)];
+}
+
+/* Replaces the value of it, returning the old one.
+ *
+ * Complexity: O(1)
+ */
+void* btree_set_value(BTreeIterator *it, void *value)
+{
+    struct _btree_leaf *leaf;
+    void *old_value;
+
+    assert(it != NULL);
+
+    leaf = leaf_of(it);
+    old_value = leaf->values[index_of(it)];
+    leaf->values[index_of(it)] = value;
+
+    return old_value;
+}
@@ -0,0 +1,630 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A chained hash map with lock-free lookups and lock-striped updates.
+ *
+ * Every bucket belongs to one of CHASHMAP_STRIPES stripes, picked by
+ * the low bits of the hash. Writers lock the stripe of their key, and
+ * bump the stripe's sequence number to odd before changing anything and
+ * back to even afterwards. Readers take no lock: they note the sequence
+ * number, walk the bucket, and start over if the number has changed
+ * meanwhile, so they never act on a bucket that was being changed
+ * under them.
+ *
+ * A reader may still be walking a node that a writer has just unlinked,
+ * so nodes are never freed while the map is in use. Removed nodes go on
+ * their stripe's free list and are reused by later insertions into the
+ * same stripe, which always bump the sequence number that such a reader
+ * is checking.
+ *
+ * Growing allocates a table of twice the size, and then moves buckets
+ * into it one at a time, each under the lock of its stripe. As both
+ * tables have at least CHASHMAP_STRIPES buckets, a bucket and the two
+ * it splits into all belong to the same stripe. Writers move their own
+ * bucket before touching it, and then help with a few more; whoever
+ * moves the last bucket makes the new table current. A moved bucket is
+ * left pointing at MOVED, which sends readers and writers on to the
+ * newer table. Old tables stay allocated until the map is freed, as
+ * readers may still be looking at them.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/concurrent_hashmap.h>
+
+#include "atomic.h"
+
+#define CACHE_LINE_SIZE 64
+
+/* A power of two. It is also the size of the initial table. */
+#define CHASHMAP_STRIPES        64
+#define CHASHMAP_STRIPE_MASK    (CHASHMAP_STRIPES - 1)
+
+/* Buckets moved by each insertion or removal while the table grows */
+#define CHASHMAP_MIGRATE_STEPS  4
+
+struct _chashmap_node {
+    unsigned long hash;
+    const void *key;
+    void *value;
+    struct _chashmap_node *next;
+};
+
+struct _chashmap_table {
+    struct _chashmap_node **buckets;
+    unsigned long nbuckets;
+
+    /* The table being grown into, or NULL */
+    struct _chashmap_table *next;
+
+    /* Next bucket for helpers to move, and buckets moved so far */
+    unsigned long claimed;
+    unsigned long moved;
+
+    /* Tables this one replaced, freed with the map */
+    struct _chashmap_table *retired;
+};
+
+/* Each stripe sits in its own cache line, so that writers on different
+ * stripes do not contend, and readers only ever see the line change
+ * when their own stripe is written to.
+ */
+struct _chashmap_stripe {
+    pthread_mutex_t lock;
+    unsigned long seq;
+    unsigned long count;
+    struct _chashmap_node *free_nodes;
+    char pad[CACHE_LINE_SIZE -
+        (sizeof(pthread_mutex_t) + 2 * sizeof(unsigned long) +
+         sizeof(struct _chashmap_node *)) % CACHE_LINE_SIZE];
+};
+
+struct _chashmap {
+    struct _chashmap_table *table;
+    struct _chashmap_stripe *stripes;
+
+    HashFn hashfn;
+    CompareFn comparefn;
+};
+
+static struct _chashmap_node moved_marker;
+#define MOVED (&moved_marker)
+
+static struct _chashmap_table* _table_create(unsigned long nbuckets)
+{
+    struct _chashmap_table *table;
+
+    table = malloc(sizeof(struct _chashmap_table));
+    if(NULL == table) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    table->buckets = calloc(nbuckets, sizeof(struct _chashmap_node *));
+    if(NULL == table->buckets) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        free(table);
+        return NULL;
+    }
+
+    table->nbuckets = nbuckets;
+    table->next = NULL;
+    table->claimed = 0;
+    table->moved = 0;
+    table->retired = NULL;
+
+    return table;
+}
+
+static void _table_free(struct _chashmap_table *table)
+{
+    free(table->buckets);
+    free(table);
+}
+
+static struct _chashmap_stripe* _stripe(CHashMap *map, unsigned long hash)
+{
+    return &map->stripes[hash & CHASHMAP_STRIPE_MASK];
+}
+
+/* Must be called with the stripe locked */
+static void _write_begin(struct _chashmap_stripe *stripe)
+{
+    atomic_store(&stripe->seq, stripe->seq + 1);
+    atomic_fence_release();
+}
+
+static void _write_end(struct _chashmap_stripe *stripe)
+{
+    atomic_store_release(&stripe->seq, stripe->seq + 1);
+}
+
+/* Moves every node of bucket i of table into table->next. Must be
+ * called with the bucket's stripe locked and being written.
+ *
+ * Complexity: O(1) expected
+ */
+static void _move_bucket(struct _chashmap_table *table, unsigned long i)
+{
+    struct _chashmap_table *next = table->next;
+    struct _chashmap_node *node, *following;
+    unsigned long j;
+
+    for(node = table->buckets[i]; node != NULL; node = following) {
+        following = node->next;
+        j = node->hash & (next->nbuckets - 1);
+        atomic_store(&node->next, next->buckets[j]);
+        atomic_store_release(&next->buckets[j], node);
+    }
+
+    atomic_store_release(&table->buckets[i], MOVED);
+}
+
+/* Counts one more bucket of table as moved, and makes the new table
+ * current once they all are.
+ */
+static void _bucket_moved(CHashMap *map, struct _chashmap_table *table)
+{
+    if(atomic_fetch_add(&table->moved, 1) + 1 == table->nbuckets) {
+        table->next->retired = table;
+        atomic_store_release(&map->table, table->next);
+    }
+}
+
+/* Returns the bucket that hash belongs in, in the newest table, which
+ * is stored in *table. Buckets still to be moved on the way there are
+ * moved first. Must be called with the stripe of hash locked and being
+ * written.
+ *
+ * Complexity: O(1)
+ */
+static struct _chashmap_node** _locate(CHashMap *map, unsigned long hash,
+        struct _chashmap_table **table)
+{
+    struct _chashmap_table *t, *next;
+    unsigned long i;
+
+    t = atomic_load_acquire(&map->table);
+    for(;;) {
+        i = hash & (t->nbuckets - 1);
+        if(MOVED == t->buckets[i]) {
+            t = t->next;
+            continue;
+        }
+
+        next = atomic_load_acquire(&t->next);
+        if(NULL == next) {
+            break;
+        }
+
+        _move_bucket(t, i);
+        _bucket_moved(map, t);
+        t = next;
+    }
+
+    *table = t;
+    return &t->buckets[i];
+}
+
+/* Starts growing the table, unless it is already growing */
+static void _grow(CHashMap *map)
+{
+    struct _chashmap_table *table, *new_table;
+
+    table = atomic_load_acquire(&map->table);
+    if(atomic_load_acquire(&table->next) != NULL) {
+        return;
+    }
+
+    /* On failure, the table is simply left more loaded */
+    new_table = _table_create(table->nbuckets * 2);
+    if(NULL == new_table) {
+        return;
+    }
+
+    if(!atomic_cas(&table->next, NULL, new_table)) {
+        _table_free(new_table);
+    }
+}
+
+/* Moves up to CHASHMAP_MIGRATE_STEPS buckets if the table is growing.
+ * Must be called with no stripe locked.
+ */
+static void _help_grow(CHashMap *map)
+{
+    struct _chashmap_table *table;
+    struct _chashmap_stripe *stripe;
+    unsigned long i, steps;
+
+    table = atomic_load_acquire(&map->table);
+    if(NULL == atomic_load_acquire(&table->next)) {
+        return;
+    }
+
+    for(steps = 0; steps < CHASHMAP_MIGRATE_STEPS; steps++) {
+        i = atomic_fetch_add(&table->claimed, 1);
+        if(i >= table->nbuckets) {
+            return;
+        }
+
+        stripe = _stripe(map, i);
+        pthread_mutex_lock(&stripe->lock);
+        if(table->buckets[i] != MOVED) {
+            _write_begin(stripe);
+            _move_bucket(table, i);
+            _write_end(stripe);
+            _bucket_moved(map, table);
+        }
+        pthread_mutex_unlock(&stripe->lock);
+    }
+}
+
+static void _free_nodes(struct _chashmap_node *node, FreeFn freefn)
+{
+    struct _chashmap_node *next;
+
+    for(; node != NULL; node = next) {
+        next = node->next;
+        if(freefn != NULL) {
+            freefn(node->value);
+        }
+        free(node);
+    }
+}
+
+static void _free_table_nodes(struct _chashmap_table *table, FreeFn freefn)
+{
+    unsigned long i;
+
+    for(i = 0; i < table->nbuckets; i++) {
+        if(table->buckets[i] != MOVED) {
+            _free_nodes(table->buckets[i], freefn);
+        }
+    }
+}
+
+static void chashmap_destroy(CHashMap *map, FreeFn freefn)
+{
+    struct _chashmap_table *table, *retired;
+    unsigned int i;
+
+    table = map->table;
+    _free_table_nodes(table, freefn);
+    if(table->next != NULL) {
+        _free_table_nodes(table->next, freefn);
+        _table_free(table->next);
+    }
+
+    for(; table != NULL; table = retired) {
+        retired = table->retired;
+        _table_free(table);
+    }
+
+    for(i = 0; i < CHASHMAP_STRIPES; i++) {
+        _free_nodes(map->stripes[i].free_nodes, NULL);
+        pthread_mutex_destroy(&map->stripes[i].lock);
+    }
+
+    free(map->stripes);
+    free(map);
+}
+
+/* Complexity: O(1) */
+CHashMap* chashmap_create(HashFn hashfn, CompareFn comparefn)
+{
+    CHashMap *new_map;
+    void *stripes;
+    unsigned int i;
+
+    assert(hashfn != NULL);
+    assert(comparefn != NULL);
+
+    new_map = malloc(sizeof(struct _chashmap));
+    if(NULL == new_map) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    if(posix_memalign(&stripes, CACHE_LINE_SIZE,
+                sizeof(struct _chashmap_stripe) * CHASHMAP_STRIPES)) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        free(new_map);
+        return NULL;
+    }
+
+    new_map->table = _table_create(CHASHMAP_STRIPES);
+    if(NULL == new_map->table) {
+        free(stripes);
+        free(new_map);
+        return NULL;
+    }
+
+    new_map->stripes = stripes;
+    for(i = 0; i < CHASHMAP_STRIPES; i++) {
+        pthread_mutex_init(&new_map->stripes[i].lock, NULL);
+        new_map->stripes[i].seq = 0;
+        new_map->stripes[i].count = 0;
+        new_map->stripes[i].free_nodes = NULL;
+    }
+
+    new_map->hashfn = hashfn;
+    new_map->comparefn = comparefn;
+
+    return new_map;
+}
+
+/* Complexity: O(n)
+ *
+ * Must not be called while other threads are still using the map.
+ */
+void chashmap_free(CHashMap *map)
+{
+    assert(map != NULL);
+
+    /* Only free the containers, not the data stored in the map */
+    chashmap_destroy(map, NULL);
+}
+
+/* Complexity: O(n)
+ *
+ * Must not be called while other threads are still using the map.
+ */
+void chashmap_free_all(CHashMap *map, FreeFn freefn)
+{
+    assert(map != NULL);
+
+    if(NULL == freefn) {
+        /* Default to free */
+        freefn = (FreeFn)free;
+    }
+
+    chashmap_destroy(map, freefn);
+}
+
+/* Returns -1 if key is already in the map, or out of memory.
+ *
+ * Complexity: O(1) expected
+ */
+int chashmap_insert(CHashMap *map, const void *key, void *value)
+{
+    struct _chashmap_table *table;
+    struct _chashmap_node **bucket, *node;
+    struct _chashmap_stripe *stripe;
+    unsigned long hash;
+    int grow;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    hash = map->hashfn(key);
+    stripe = _stripe(map, hash);
+
+    pthread_mutex_lock(&stripe->lock);
+    _write_begin(stripe);
+
+    bucket = _locate(map, hash, &table);
+    for(node = *bucket; node != NULL; node = node->next) {
+        if(node->hash == hash && map->comparefn(node->key, key) == 0) {
+            _write_end(stripe);
+            pthread_mutex_unlock(&stripe->lock);
+            return -1;
+        }
+    }
+
+    node = stripe->free_nodes;
+    if(node != NULL) {
+        stripe->free_nodes = node->next;
+    } else {
+        node = malloc(sizeof(struct _chashmap_node));
+        if(NULL == node) {
+            fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+            _write_end(stripe);
+            pthread_mutex_unlock(&stripe->lock);
+            return -1;
+        }
+    }
+
+    atomic_store(&node->hash, hash);
+    atomic_store(&node->key, key);
+    atomic_store(&node->value, value);
+    atomic_store(&node->next, *bucket);
+    atomic_store_release(bucket, node);
+
+    atomic_store(&stripe->count, stripe->count + 1);
+
+    /* Each stripe owns an equal share of the buckets */
+    grow = (stripe->count > table->nbuckets / CHASHMAP_STRIPES);
+
+    _write_end(stripe);
+    pthread_mutex_unlock(&stripe->lock);
+
+    if(grow) {
+        _grow(map);
+    }
+    _help_grow(map);
+
+    return 0;
+}
+
+/* Returns the value of the removed entry, or NULL if key was not found.
+ *
+ * Complexity: O(1) expected
+ */
+void* chashmap_remove(CHashMap *map, const void *key)
+{
+    struct _chashmap_table *table;
+    struct _chashmap_node **link, *node;
+    struct _chashmap_stripe *stripe;
+    unsigned long hash;
+    void *value = NULL;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    hash = map->hashfn(key);
+    stripe = _stripe(map, hash);
+
+    pthread_mutex_lock(&stripe->lock);
+    _write_begin(stripe);
+
+    for(link = _locate(map, hash, &table); *link != NULL;
+            link = &(*link)->next) {
+        node = *link;
+        if(node->hash == hash && map->comparefn(node->key, key) == 0) {
+            value = node->value;
+            atomic_store(link, node->next);
+
+            atomic_store(&node->next, stripe->free_nodes);
+            stripe->free_nodes = node;
+
+            atomic_store(&stripe->count, stripe->count - 1);
+            break;
+        }
+    }
+
+    _write_end(stripe);
+    pthread_mutex_unlock(&stripe->lock);
+
+    _help_grow(map);
+
+    return value;
+}
+
+/* Looks key up in the bucket of hash, storing its value, or NULL, in
+ * *value. Returns 0 if the stripe was written to since seq was read, in
+ * which case the lookup must be retried.
+ *
+ * Complexity: O(1) expected
+ */
+static int _read_bucket(CHashMap *map, struct _chashmap_stripe *stripe,
+        unsigned long seq, unsigned long hash, const void *key,
+        void **value)
+{
+    struct _chashmap_table *table;
+    struct _chashmap_node *node, *next;
+    unsigned long node_hash;
+    const void *node_key;
+    void *node_value;
+
+    table = atomic_load_acquire(&map->table);
+    node = atomic_load_acquire(&table->buckets[hash & (table->nbuckets - 1)]);
+    while(MOVED == node) {
+        table = atomic_load_acquire(&table->next);
+        node = atomic_load_acquire(
+                &table->buckets[hash & (table->nbuckets - 1)]);
+    }
+
+    for(; node != NULL; node = next) {
+        node_hash = atomic_load(&node->hash);
+        node_key = atomic_load(&node->key);
+        node_value = atomic_load(&node->value);
+        next = atomic_load(&node->next);
+
+        /* Only look at the key once the node is known to hold it */
+        atomic_fence_acquire();
+        if(atomic_load(&stripe->seq) != seq) {
+            return 0;
+        }
+
+        if(node_hash == hash && map->comparefn(node_key, key) == 0) {
+            *value = node_value;
+            return 1;
+        }
+    }
+
+    atomic_fence_acquire();
+    if(atomic_load(&stripe->seq) != seq) {
+        return 0;
+    }
+
+    *value = NULL;
+    return 1;
+}
+
+/* Returns the value stored with key, or NULL if key was not found.
+ * Takes no lock, and only retries if the key's stripe was written to
+ * during the lookup.
+ *
+ * Complexity: O(1) expected
+ */
+void* chashmap_get(CHashMap *map, const void *key)
+{
+    struct _chashmap_stripe *stripe;
+    unsigned long hash, seq;
+    void *value;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    hash = map->hashfn(key);
+    stripe = _stripe(map, hash);
+
+    for(;;) {
+        seq = atomic_load_acquire(&stripe->seq);
+        if(seq & 1) {
+            /* A writer holds the stripe, and may not be running */
+            sched_yield();
+            continue;
+        }
+
+        if(_read_bucket(map, stripe, seq, hash, key, &value)) {
+            return value;
+        }
+    }
+}
+
+/* Complexity: O(1)
+ *
+ * The result is a snapshot: other threads may change it at any time.
+ */
+unsigned long chashmap_size(CHashMap *map)
+{
+    unsigned long size = 0;
+    unsigned int i;
+
+    assert(map != NULL);
+
+    for(i = 0; i < CHASHMAP_STRIPES; i++) {
+        size += atomic_load(&map->stripes[i].count);
+    }
+
+    return size;
+}
+
+/* Complexity: O(1) */
+int chashmap_is_empty(CHashMap *map)
+{
+    assert(map != NULL);
+
+    return (chashmap_size(map) == 0);
+}
@@ -0,0 +1,341 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/concurrent_pqueue.h>
+#include <libcore/heap.h>
+
+#define CACHE_LINE_SIZE 64
+
+/* Blocking lock used for a push once this many trylocks have failed */
+#define MAX_PUSH_ATTEMPTS(cpq) ((cpq)->nqueues)
+
+/* Two-choice pop attempts before falling back to a full scan */
+#define MAX_POP_ATTEMPTS(cpq) (2 * (cpq)->nqueues)
+
+/* Each lock and heap pair sits in its own cache line so that threads
+ * working on neighbouring queues do not contend on the same line. The
+ * array is allocated on a cache line boundary for this.
+ */
+struct cpq_queue {
+    pthread_mutex_t lock;
+    Heap *heap;
+    char pad[CACHE_LINE_SIZE -
+        (sizeof(pthread_mutex_t) + sizeof(Heap *)) % CACHE_LINE_SIZE];
+};
+
+struct _cpqueue {
+    CPQUEUE_MODE mode;
+    CompareFn comparefn;
+    unsigned int nqueues;
+    struct cpq_queue *queues;
+
+    /* Per-thread random state, stored directly in the key's value */
+    pthread_key_t rng;
+};
+
+/* 32-bit xorshift, seeded per thread on first use. The state is kept
+ * in the thread-specific value itself, so nothing is allocated and
+ * nothing needs freeing when a thread exits.
+ */
+static unsigned long cpqueue_random(CPQueue *cpqueue)
+{
+    unsigned long x;
+
+    x = (unsigned long)pthread_getspecific(cpqueue->rng);
+    if(0 == x) {
+        /* Stack addresses differ between threads */
+        x = ((unsigned long)&x >> 4) & 0xffffffffUL;
+        if(0 == x) {
+            x = 0x9e3779b9UL;
+        }
+    }
+
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+
+    pthread_setspecific(cpqueue->rng, (void *)x);
+
+    return x;
+}
+
+static void cpqueue_destroy(CPQueue *cpqueue, unsigned int nqueues,
+        FreeFn freefn, int free_data)
+{
+    unsigned int i;
+
+    for(i = 0; i < nqueues; i++) {
+        if(free_data) {
+            heap_free_all(cpqueue->queues[i].heap, freefn);
+        } else {
+            heap_free(cpqueue->queues[i].heap);
+        }
+        pthread_mutex_destroy(&cpqueue->queues[i].lock);
+    }
+
+    pthread_key_delete(cpqueue->rng);
+    free(cpqueue->queues);
+    free(cpqueue);
+}
+
+/* In relaxed mode, nqueues is the number of heaps to spread items
+ * over; twice the number of threads sharing the pqueue is a good
+ * choice. It is ignored in strict mode.
+ */
+CPQueue* cpqueue_create(CompareFn comparefn, CPQUEUE_MODE mode,
+        unsigned int nqueues)
+{
+    CPQueue *new_cpqueue;
+    unsigned int i;
+    void *queues;
+
+    assert(comparefn != NULL);
+
+    if(CPQUEUE_STRICT == mode) {
+        nqueues = 1;
+    } else if(nqueues < 2) {
+        /* Two-choice pops need at least two heaps */
+        nqueues = 2;
+    }
+
+    new_cpqueue = malloc(sizeof(struct _cpqueue));
+    if(NULL == new_cpqueue) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    if(posix_memalign(&queues, CACHE_LINE_SIZE,
+                sizeof(struct cpq_queue) * nqueues)) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        free(new_cpqueue);
+        return NULL;
+    }
+    new_cpqueue->queues = queues;
+
+    if(pthread_key_create(&new_cpqueue->rng, NULL) != 0) {
+        fprintf(stderr, "Failed to create thread key (%s:%d)\n",
+                __FUNCTION__, __LINE__);
+        free(new_cpqueue->queues);
+        free(new_cpqueue);
+        return NULL;
+    }
+
+    new_cpqueue->mode = mode;
+    new_cpqueue->comparefn = comparefn;
+    new_cpqueue->nqueues = nqueues;
+
+    for(i = 0; i < nqueues; i++) {
+        new_cpqueue->queues[i].heap = heap_create(comparefn);
+        if(NULL == new_cpqueue->queues[i].heap) {
+            cpqueue_destroy(new_cpqueue, i, NULL, 0);
+            return NULL;
+        }
+        pthread_mutex_init(&new_cpqueue->queues[i].lock, NULL);
+    }
+
+    return new_cpqueue;
+}
+
+/* Complexity: O(q)
+ *
+ * Must not be called while other threads are still using the pqueue.
+ */
+void cpqueue_free(CPQueue *cpqueue)
+{
+    assert(cpqueue != NULL);
+
+    /* Only free the containers, not the data stored in the pqueue */
+    cpqueue_destroy(cpqueue, cpqueue->nqueues, NULL, 0);
+}
+
+/* Complexity: O(n + q) */
+void cpqueue_free_all(CPQueue *cpqueue, FreeFn freefn)
+{
+    assert(cpqueue != NULL);
+
+    cpqueue_destroy(cpqueue, cpqueue->nqueues, freefn, 1);
+}
+
+/* Complexity: O(log n)
+ *
+ * Relaxed pqueues push to a random heap, skipping heaps that are
+ * currently locked by another thread.
+ */
+int cpqueue_push(CPQueue *cpqueue, void *data)
+{
+    struct cpq_queue *queue;
+    unsigned int attempts;
+    int ret;
+
+    assert(cpqueue != NULL);
+
+    if(CPQUEUE_STRICT == cpqueue->mode) {
+        queue = &cpqueue->queues[0];
+        pthread_mutex_lock(&queue->lock);
+    } else {
+        attempts = 0;
+        for(;;) {
+            queue = &cpqueue->queues[cpqueue_random(cpqueue) % cpqueue->nqueues];
+            if(0 == pthread_mutex_trylock(&queue->lock)) {
+                break;
+            }
+
+            if(++attempts >= MAX_PUSH_ATTEMPTS(cpqueue)) {
+                pthread_mutex_lock(&queue->lock);
+                break;
+            }
+        }
+    }
+
+    ret = heap_push(queue->heap, data);
+    pthread_mutex_unlock(&queue->lock);
+
+    return ret;
+}
+
+/* Pop from the first non-empty heap, starting at a random one. Used
+ * when two-choice pops keep finding empty heaps, so that a NULL result
+ * really does mean that every heap was seen empty.
+ */
+static void* cpqueue_pop_scan(CPQueue *cpqueue)
+{
+    struct cpq_queue *queue;
+    unsigned int i, start;
+    void *data;
+
+    start = cpqueue_random(cpqueue) % cpqueue->nqueues;
+    for(i = 0; i < cpqueue->nqueues; i++) {
+        queue = &cpqueue->queues[(start + i) % cpqueue->nqueues];
+
+        pthread_mutex_lock(&queue->lock);
+        data = heap_pop(queue->heap);
+        pthread_mutex_unlock(&queue->lock);
+
+        if(data != NULL) {
+            return data;
+        }
+    }
+
+    return NULL;
+}
+
+/* Complexity: O(log n)
+ *
+ * Relaxed pqueues lock two distinct random heaps without blocking and
+ * pop the higher priority of their two tops. Both locks are taken with
+ * trylock, so there is no lock ordering to respect.
+ */
+void* cpqueue_pop(CPQueue *cpqueue)
+{
+    struct cpq_queue *a, *b;
+    unsigned int attempts, i, j;
+    void *top_a, *top_b, *data;
+
+    assert(cpqueue != NULL);
+
+    if(CPQUEUE_STRICT == cpqueue->mode) {
+        a = &cpqueue->queues[0];
+        pthread_mutex_lock(&a->lock);
+        data = heap_pop(a->heap);
+        pthread_mutex_unlock(&a->lock);
+        return data;
+    }
+
+    for(attempts = 0; attempts < MAX_POP_ATTEMPTS(cpqueue); attempts++) {
+        i = cpqueue_random(cpqueue) % cpqueue->nqueues;
+        j = cpqueue_random(cpqueue) % (cpqueue->nqueues - 1);
+        if(j >= i) {
+            j++;
+        }
+
+        a = &cpqueue->queues[i];
+        b = &cpqueue->queues[j];
+
+        if(pthread_mutex_trylock(&a->lock) != 0) {
+            continue;
+        }
+        if(pthread_mutex_trylock(&b->lock) != 0) {
+            pthread_mutex_unlock(&a->lock);
+            continue;
+        }
+
+        top_a = heap_top(a->heap);
+        top_b = heap_top(b->heap);
+
+        data = NULL;
+        if(top_a != NULL &&
+                (NULL == top_b || cpqueue->comparefn(top_a, top_b) >= 0)) {
+            data = heap_pop(a->heap);
+        } else if(top_b != NULL) {
+            data = heap_pop(b->heap);
+        }
+
+        pthread_mutex_unlock(&b->lock);
+        pthread_mutex_unlock(&a->lock);
+
+        if(data != NULL) {
+            return data;
+        }
+    }
+
+    return cpqueue_pop_scan(cpqueue);
+}
+
+/* Complexity: O(q)
+ *
+ * The result is a snapshot: other threads may change it at any time.
+ */
+unsigned long cpqueue_size(CPQueue *cpqueue)
+{
+    unsigned long size = 0;
+    unsigned int i;
+
+    assert(cpqueue != NULL);
+
+    for(i = 0; i < cpqueue->nqueues; i++) {
+        pthread_mutex_lock(&cpqueue->queues[i].lock);
+        size += heap_size(cpqueue->queues[i].heap);
+        pthread_mutex_unlock(&cpqueue->queues[i].lock);
+    }
+
+    return size;
+}
+
+/* Complexity: O(q) */
+int cpqueue_is_empty(CPQueue *cpqueue)
+{
+    assert(cpqueue != NULL);
+
+    return (cpqueue_size(cpqueue) == 0);
+}
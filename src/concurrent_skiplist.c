@@ -0,0 +1,808 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A lock-free skip list, after Fraser, and Herlihy and Shavit.
+ *
+ * Each node is linked into levels 0 up to its height, as in skiplist.c.
+ * A node is removed by setting the low bit of each of its own links,
+ * from the top level down: marking level 0 is what removes its entry,
+ * and only one thread can do that. Any search that passes a marked node
+ * unlinks it from that level, with a compare-and-swap on the link of
+ * the node before it, which fails if that node was marked or changed
+ * meanwhile. A node is inserted by linking it into level 0, which adds
+ * its entry, and then into the levels above one at a time. Searches
+ * only need level 0 to be right; the others just make them faster.
+ *
+ * A node removed while its inserter is still linking it into the upper
+ * levels may be linked into one of them after the remover unlinked it.
+ * Whichever of the two threads finishes last, as decided by a
+ * compare-and-swap on the node's state, searches for it once more to
+ * unlink it from every level, and then retires it.
+ *
+ * Retired nodes are freed with epoch-based reclamation. Every thread
+ * has a record of whether it is in an operation, and of the global
+ * epoch it saw when that operation started. The global epoch only moves
+ * on once every thread in an operation has seen its current value. A
+ * node is retired with the global epoch as it was after the node was
+ * unlinked; every thread that could still reach it started before that,
+ * so once the epoch has moved on twice more, they have all finished and
+ * the node is freed. Each thread keeps the nodes it retired on a list of
+ * its own, and frees them in batches.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/concurrent_skiplist.h>
+
+#include "atomic.h"
+
+#define CACHE_LINE_SIZE 64
+
+/* Enough for 4^16 entries at the expected density */
+#define CSKIPLIST_MAX_LEVEL     16
+
+/* Nodes a thread retires between attempts to free them */
+#define CSKIPLIST_RECLAIM_BATCH 64
+
+/* The links of a node being removed have their low bit set */
+#define IS_MARKED(p)    ((unsigned long)(p) & 1UL)
+#define MARK(p)     ((struct _cskiplist_node *)((unsigned long)(p) | 1UL))
+#define UNMARK(p)   ((struct _cskiplist_node *)((unsigned long)(p) & ~1UL))
+
+/* Node states. A node removed while still being linked is REMOVED, and
+ * its inserter retires it; otherwise its remover does.
+ */
+#define CSL_LINKING     0
+#define CSL_LINKED      1
+#define CSL_REMOVED     2
+
+struct _cskiplist_node {
+    const void *key;
+    void *value;
+    unsigned long state;
+    unsigned int level;
+
+    /* Set when the node is retired */
+    unsigned long epoch;
+    struct _cskiplist_node *retired_next;
+
+    /* Allocated with as many links as the node has levels */
+    struct _cskiplist_node *next[1];
+};
+
+/* Each record sits in its own cache line, as the global epoch is moved
+ * on by reading all of them. A record outlives its thread, and is taken
+ * over by the next thread to use the list, along with the nodes it had
+ * still to free.
+ */
+struct _cskiplist_thread {
+    unsigned long active;
+    unsigned long epoch;
+    unsigned long in_use;
+
+    /* Entries inserted less entries removed, which may wrap */
+    unsigned long count;
+
+    /* Nesting of operations, as scan callbacks may use the list */
+    unsigned long depth;
+    unsigned long seed;
+
+    /* Retired nodes, oldest first */
+    struct _cskiplist_node *retired_head;
+    struct _cskiplist_node *retired_tail;
+    unsigned long nretired;
+
+    struct _cskiplist_thread *next;
+    char pad[CACHE_LINE_SIZE -
+        (7 * sizeof(unsigned long) + 3 * sizeof(void *)) % CACHE_LINE_SIZE];
+};
+
+struct _cskiplist {
+    /* Holds no entry, and has every level */
+    struct _cskiplist_node *head;
+    unsigned long level;
+
+    unsigned long epoch;
+    struct _cskiplist_thread *threads;
+    unsigned long nthreads;
+    pthread_key_t thread_key;
+
+    CompareFn comparefn;
+};
+
+static struct _cskiplist_node* _node_create(const void *key, void *value,
+        unsigned int level)
+{
+    struct _cskiplist_node *node;
+    unsigned int i;
+
+    node = malloc(sizeof(struct _cskiplist_node) +
+            (level - 1) * sizeof(struct _cskiplist_node *));
+    if(NULL == node) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    node->key = key;
+    node->value = value;
+    node->state = CSL_LINKING;
+    node->level = level;
+    for(i = 0; i < level; i++) {
+        node->next[i] = NULL;
+    }
+
+    return node;
+}
+
+/* Destructor of the thread key, run when a thread exits */
+static void _thread_exit(void *arg)
+{
+    struct _cskiplist_thread *thread = arg;
+
+    atomic_store_release(&thread->in_use, 0);
+}
+
+/* Returns the record of the calling thread, which is created, or taken
+ * over from a thread that has exited, on its first use of the list.
+ */
+static struct _cskiplist_thread* _thread_record(CSkipList *list)
+{
+    struct _cskiplist_thread *thread, *head;
+    void *mem;
+
+    thread = pthread_getspecific(list->thread_key);
+    if(thread != NULL) {
+        return thread;
+    }
+
+    for(thread = atomic_load_acquire(&list->threads); thread != NULL;
+            thread = thread->next) {
+        if(0 == atomic_load(&thread->in_use) &&
+                atomic_cas(&thread->in_use, 0, 1)) {
+            break;
+        }
+    }
+
+    if(NULL == thread) {
+        if(posix_memalign(&mem, CACHE_LINE_SIZE,
+                    sizeof(struct _cskiplist_thread))) {
+            fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__,
+                    __LINE__);
+            return NULL;
+        }
+
+        thread = mem;
+        thread->active = 0;
+        thread->epoch = 0;
+        thread->in_use = 1;
+        thread->count = 0;
+        thread->depth = 0;
+        thread->seed = 2463534242UL + atomic_fetch_add(&list->nthreads, 1);
+        thread->retired_head = NULL;
+        thread->retired_tail = NULL;
+        thread->nretired = 0;
+
+        for(;;) {
+            head = atomic_load(&list->threads);
+            thread->next = head;
+            if(atomic_cas(&list->threads, head, thread)) {
+                break;
+            }
+        }
+    }
+
+    if(pthread_setspecific(list->thread_key, thread) != 0) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        atomic_store_release(&thread->in_use, 0);
+        return NULL;
+    }
+
+    return thread;
+}
+
+/* Starts an operation. Nodes reachable from the list, or retired after
+ * this point, will not be freed before the matching _epoch_exit.
+ *
+ * Complexity: O(1), but O(t) on a thread's first use of the list
+ */
+static struct _cskiplist_thread* _epoch_enter(CSkipList *list)
+{
+    struct _cskiplist_thread *thread;
+
+    thread = _thread_record(list);
+    if(NULL == thread) {
+        return NULL;
+    }
+
+    if(0 == thread->depth++) {
+        /* Whoever moves the epoch on must see this before it looks at
+         * the list
+         */
+        atomic_store(&thread->active, 1);
+        atomic_fence();
+        atomic_store(&thread->epoch, atomic_load_acquire(&list->epoch));
+    }
+
+    return thread;
+}
+
+static void _epoch_exit(struct _cskiplist_thread *thread)
+{
+    if(0 == --thread->depth) {
+        atomic_store_release(&thread->active, 0);
+    }
+}
+
+/* Moves the global epoch on, if every thread in an operation has seen
+ * its current value.
+ *
+ * Complexity: O(t)
+ */
+static void _try_advance(CSkipList *list)
+{
+    struct _cskiplist_thread *thread;
+    unsigned long epoch;
+
+    epoch = atomic_load_acquire(&list->epoch);
+    atomic_fence();
+
+    for(thread = atomic_load_acquire(&list->threads); thread != NULL;
+            thread = thread->next) {
+        if(atomic_load_acquire(&thread->active) &&
+                atomic_load(&thread->epoch) != epoch) {
+            return;
+        }
+    }
+
+    atomic_cas(&list->epoch, epoch, epoch + 1);
+}
+
+/* Frees the nodes thread retired at least two epochs ago */
+static void _reclaim(CSkipList *list, struct _cskiplist_thread *thread)
+{
+    struct _cskiplist_node *node;
+    unsigned long epoch;
+
+    epoch = atomic_load_acquire(&list->epoch);
+    while((node = thread->retired_head) != NULL && node->epoch + 2 <= epoch) {
+        thread->retired_head = node->retired_next;
+        free(node);
+    }
+
+    if(NULL == thread->retired_head) {
+        thread->retired_tail = NULL;
+    }
+}
+
+/* Hands over node, which must be unlinked from every level, to be freed
+ * once no thread can be reading it.
+ *
+ * Complexity: O(1), or O(t + CSKIPLIST_RECLAIM_BATCH) once per batch
+ */
+static void _retire(CSkipList *list, struct _cskiplist_thread *thread,
+        struct _cskiplist_node *node)
+{
+    node->epoch = atomic_load_acquire(&list->epoch);
+    node->retired_next = NULL;
+
+    if(thread->retired_tail != NULL) {
+        thread->retired_tail->retired_next = node;
+    } else {
+        thread->retired_head = node;
+    }
+    thread->retired_tail = node;
+
+    if(++thread->nretired >= CSKIPLIST_RECLAIM_BATCH) {
+        thread->nretired = 0;
+        _try_advance(list);
+        _reclaim(list, thread);
+    }
+}
+
+/* Complexity: O(1) expected */
+static unsigned int _random_level(struct _cskiplist_thread *thread)
+{
+    unsigned long x = thread->seed;
+    unsigned int level = 1;
+
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+    thread->seed = x;
+
+    /* Two bits per level, of the 32 the generator produces */
+    while(level < CSKIPLIST_MAX_LEVEL && 0 == (x & 3)) {
+        level++;
+        x >>= 2;
+    }
+
+    return level;
+}
+
+/* Makes searches start at least at level - 1 */
+static void _raise_level(CSkipList *list, unsigned long level)
+{
+    unsigned long current;
+
+    for(;;) {
+        current = atomic_load(&list->level);
+        if(current >= level || atomic_cas(&list->level, current, level)) {
+            return;
+        }
+    }
+}
+
+/* Stores, on each level, the last node whose key is less than key and
+ * the node after it, unlinking marked nodes on the way. Returns 1 if
+ * succs[0] holds key, 0 if not, or -1 if the search ran into a change
+ * and has to start over.
+ *
+ * Complexity: O(log n) expected
+ */
+static int _try_search(CSkipList *list, const void *key,
+        struct _cskiplist_node **preds, struct _cskiplist_node **succs)
+{
+    struct _cskiplist_node *pred, *curr = NULL, *next;
+    unsigned long level;
+    int c = 1;
+
+    pred = list->head;
+    for(level = atomic_load(&list->level); level-- > 0;) {
+        curr = UNMARK(atomic_load_acquire(&pred->next[level]));
+        while(curr != NULL) {
+            next = atomic_load_acquire(&curr->next[level]);
+            if(IS_MARKED(next)) {
+                if(!atomic_cas(&pred->next[level], curr, UNMARK(next))) {
+                    return -1;
+                }
+                curr = UNMARK(next);
+                continue;
+            }
+
+            c = list->comparefn(curr->key, key);
+            if(c >= 0) {
+                break;
+            }
+            pred = curr;
+            curr = next;
+        }
+
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+
+    return (curr != NULL && 0 == c);
+}
+
+/* Complexity: O(log n) expected */
+static int _search(CSkipList *list, const void *key,
+        struct _cskiplist_node **preds, struct _cskiplist_node **succs)
+{
+    int found;
+
+    do {
+        found = _try_search(list, key, preds, succs);
+    } while(found < 0);
+
+    return found;
+}
+
+/* Returns the first node whose key is not less than key, storing the
+ * result of comparing them in *c. Unlike _search, it only reads the
+ * list, stepping over marked nodes instead of unlinking them.
+ *
+ * Complexity: O(log n) expected
+ */
+static struct _cskiplist_node* _lower_bound(CSkipList *list,
+        const void *key, int *c)
+{
+    struct _cskiplist_node *pred, *curr = NULL, *next;
+    unsigned long level;
+
+    *c = 1;
+    pred = list->head;
+    for(level = atomic_load(&list->level); level-- > 0;) {
+        curr = UNMARK(atomic_load_acquire(&pred->next[level]));
+        while(curr != NULL) {
+            next = atomic_load_acquire(&curr->next[level]);
+            if(IS_MARKED(next)) {
+                curr = UNMARK(next);
+                continue;
+            }
+
+            *c = list->comparefn(curr->key, key);
+            if(*c >= 0) {
+                break;
+            }
+            pred = curr;
+            curr = next;
+        }
+    }
+
+    return curr;
+}
+
+/* Links node into level, searching again whenever the nodes around it
+ * change. Returns 0 if node was removed before it could be linked.
+ */
+static int _link_level(CSkipList *list, struct _cskiplist_node *node,
+        unsigned int level, struct _cskiplist_node **preds,
+        struct _cskiplist_node **succs)
+{
+    struct _cskiplist_node *next;
+
+    for(;;) {
+        next = atomic_load(&node->next[level]);
+        if(IS_MARKED(next)) {
+            return 0;
+        }
+
+        if(next != succs[level] &&
+                !atomic_cas(&node->next[level], next, succs[level])) {
+            continue;
+        }
+
+        if(atomic_cas(&preds[level]->next[level], succs[level], node)) {
+            return 1;
+        }
+
+        if(!_search(list, node->key, preds, succs) || succs[0] != node) {
+            return 0;
+        }
+    }
+}
+
+static void cskiplist_destroy(CSkipList *list, FreeFn freefn)
+{
+    struct _cskiplist_node *node, *next;
+    struct _cskiplist_thread *thread, *next_thread;
+
+    for(node = list->head->next[0]; node != NULL; node = next) {
+        next = UNMARK(node->next[0]);
+        if(freefn != NULL) {
+            freefn(node->value);
+        }
+        free(node);
+    }
+
+    for(thread = list->threads; thread != NULL; thread = next_thread) {
+        next_thread = thread->next;
+        for(node = thread->retired_head; node != NULL; node = next) {
+            next = node->retired_next;
+            free(node);
+        }
+        free(thread);
+    }
+
+    pthread_key_delete(list->thread_key);
+    free(list->head);
+    free(list);
+}
+
+/* Complexity: O(1) */
+CSkipList* cskiplist_create(CompareFn comparefn)
+{
+    CSkipList *new_list;
+
+    assert(comparefn != NULL);
+
+    new_list = malloc(sizeof(struct _cskiplist));
+    if(NULL == new_list) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_list->head = _node_create(NULL, NULL, CSKIPLIST_MAX_LEVEL);
+    if(NULL == new_list->head) {
+        free(new_list);
+        return NULL;
+    }
+
+    if(pthread_key_create(&new_list->thread_key, _thread_exit) != 0) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        free(new_list->head);
+        free(new_list);
+        return NULL;
+    }
+
+    new_list->level = 1;
+    new_list->epoch = 0;
+    new_list->threads = NULL;
+    new_list->nthreads = 0;
+    new_list->comparefn = comparefn;
+
+    return new_list;
+}
+
+/* Complexity: O(n + t)
+ *
+ * Must not be called while other threads are still using the list.
+ */
+void cskiplist_free(CSkipList *list)
+{
+    assert(list != NULL);
+
+    /* Only free the containers, not the data stored in the list */
+    cskiplist_destroy(list, NULL);
+}
+
+/* Complexity: O(n + t)
+ *
+ * Must not be called while other threads are still using the list.
+ */
+void cskiplist_free_all(CSkipList *list, FreeFn freefn)
+{
+    assert(list != NULL);
+
+    if(NULL == freefn) {
+        /* Default to free */
+        freefn = (FreeFn)free;
+    }
+
+    cskiplist_destroy(list, freefn);
+}
+
+/* Returns -1 if key is already in the list, or out of memory.
+ *
+ * Complexity: O(log n) expected
+ */
+int cskiplist_insert(CSkipList *list, const void *key, void *value)
+{
+    struct _cskiplist_node *preds[CSKIPLIST_MAX_LEVEL];
+    struct _cskiplist_node *succs[CSKIPLIST_MAX_LEVEL];
+    struct _cskiplist_node *node;
+    struct _cskiplist_thread *thread;
+    unsigned int i, level;
+    int retire = 0;
+
+    assert(list != NULL);
+    assert(key != NULL);
+
+    thread = _epoch_enter(list);
+    if(NULL == thread) {
+        return -1;
+    }
+
+    level = _random_level(thread);
+    node = _node_create(key, value, level);
+    if(NULL == node) {
+        _epoch_exit(thread);
+        return -1;
+    }
+    _raise_level(list, level);
+
+    for(;;) {
+        if(_search(list, key, preds, succs)) {
+            _epoch_exit(thread);
+            /* No other thread has seen it */
+            free(node);
+            return -1;
+        }
+
+        for(i = 0; i < level; i++) {
+            node->next[i] = succs[i];
+        }
+        if(atomic_cas(&preds[0]->next[0], succs[0], node)) {
+            break;
+        }
+    }
+
+    atomic_store(&thread->count, thread->count + 1);
+
+    for(i = 1; i < level; i++) {
+        if(!_link_level(list, node, i, preds, succs)) {
+            break;
+        }
+    }
+
+    if(!atomic_cas(&node->state, CSL_LINKING, CSL_LINKED)) {
+        /* Removed meanwhile, and maybe linked again since by us */
+        _search(list, key, preds, succs);
+        retire = 1;
+    }
+
+    _epoch_exit(thread);
+
+    if(retire) {
+        _retire(list, thread, node);
+    }
+
+    return 0;
+}
+
+/* Returns the value of the removed entry, or NULL if key was not found.
+ *
+ * Complexity: O(log n) expected
+ */
+void* cskiplist_remove(CSkipList *list, const void *key)
+{
+    struct _cskiplist_node *preds[CSKIPLIST_MAX_LEVEL];
+    struct _cskiplist_node *succs[CSKIPLIST_MAX_LEVEL];
+    struct _cskiplist_node *node, *next;
+    struct _cskiplist_thread *thread;
+    unsigned int i;
+    void *value;
+    int retire;
+
+    assert(list != NULL);
+    assert(key != NULL);
+
+    thread = _epoch_enter(list);
+    if(NULL == thread) {
+        return NULL;
+    }
+
+    if(!_search(list, key, preds, succs)) {
+        _epoch_exit(thread);
+        return NULL;
+    }
+
+    node = succs[0];
+    for(i = node->level; --i > 0;) {
+        do {
+            next = atomic_load(&node->next[i]);
+        } while(!IS_MARKED(next) &&
+                !atomic_cas(&node->next[i], next, MARK(next)));
+    }
+
+    for(;;) {
+        next = atomic_load(&node->next[0]);
+        if(IS_MARKED(next)) {
+            /* Another thread removed it first */
+            _epoch_exit(thread);
+            return NULL;
+        }
+
+        if(atomic_cas(&node->next[0], next, MARK(next))) {
+            break;
+        }
+    }
+
+    value = node->value;
+    atomic_store(&thread->count, thread->count - 1);
+
+    retire = !atomic_cas(&node->state, CSL_LINKING, CSL_REMOVED);
+    if(retire) {
+        /* Unlinks it from every level */
+        _search(list, key, preds, succs);
+    }
+
+    _epoch_exit(thread);
+
+    if(retire) {
+        _retire(list, thread, node);
+    }
+
+    return value;
+}
+
+/* Returns the value stored with key, or NULL if key was not found.
+ * Writes nothing shared but the calling thread's own record.
+ *
+ * Complexity: O(log n) expected
+ */
+void* cskiplist_get(CSkipList *list, const void *key)
+{
+    struct _cskiplist_node *node;
+    struct _cskiplist_thread *thread;
+    void *value = NULL;
+    int c;
+
+    assert(list != NULL);
+    assert(key != NULL);
+
+    thread = _epoch_enter(list);
+    if(NULL == thread) {
+        return NULL;
+    }
+
+    node = _lower_bound(list, key, &c);
+    if(node != NULL && 0 == c) {
+        value = node->value;
+    }
+
+    _epoch_exit(thread);
+
+    return value;
+}
+
+/* Complexity: O(t) */
+int cskiplist_is_empty(CSkipList *list)
+{
+    assert(list != NULL);
+
+    return (0 == cskiplist_size(list));
+}
+
+/* Only exact while no other thread is changing the list.
+ *
+ * Complexity: O(t), for the t threads that have used the list
+ */
+unsigned long cskiplist_size(CSkipList *list)
+{
+    struct _cskiplist_thread *thread;
+    unsigned long count = 0;
+
+    assert(list != NULL);
+
+    for(thread = atomic_load_acquire(&list->threads); thread != NULL;
+            thread = thread->next) {
+        count += atomic_load(&thread->count);
+    }
+
+    return count;
+}
+
+/* Complexity: O(log n + k) expected, for the k entries visited */
+unsigned long cskiplist_scan(CSkipList *list, const void *lo,
+        const void *hi, CSkipListVisitFn fn, void *data)
+{
+    struct _cskiplist_node *node, *next;
+    struct _cskiplist_thread *thread;
+    unsigned long n = 0;
+    int c;
+
+    assert(list != NULL);
+    assert(fn != NULL);
+
+    thread = _epoch_enter(list);
+    if(NULL == thread) {
+        return 0;
+    }
+
+    if(lo != NULL) {
+        node = _lower_bound(list, lo, &c);
+    } else {
+        node = UNMARK(atomic_load_acquire(&list->head->next[0]));
+    }
+
+    /* A removed node still leads on to greater keys */
+    for(; node != NULL; node = UNMARK(next)) {
+        next = atomic_load_acquire(&node->next[0]);
+        if(IS_MARKED(next)) {
+            continue;
+        }
+
+        if(hi != NULL && list->comparefn(node->key, hi) >= 0) {
+            break;
+        }
+
+        n++;
+        if(fn(node->key, node->value, data)) {
+            break;
+        }
+    }
+
+    _epoch_exit(thread);
+
+    return n;
+}
@@ -334,6 +334,19 @@ void* darray_index(const DArray *darray, unsigned long index)
     return (darray->data[index]);
 }
 
+/* Complexity: O(1)
+ *
+ * Returns the underlying contiguous storage so that callers can
+ * operate on the elements directly. The pointer is invalidated by
+ * any operation that changes the size of the darray.
+ */
+void** darray_data(const DArray *darray)
+{
+    assert(darray != NULL);
+
+    return darray->data;
+}
+
 /* Complexity: O(1) */
 int darray_replace(DArray *darray, unsigned long index, void *data)
 {
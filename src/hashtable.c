@@ -0,0 +1,513 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* An open addressing hash table with Robin Hood probing: an entry being
+ * inserted takes the slot of any entry closer to its home slot than it
+ * is to its own, which keeps probe sequences short and even, and lets a
+ * lookup stop as soon as it meets such an entry. Removal shifts the
+ * entries that follow back by one slot, so no tombstones are left.
+ *
+ * Growing is incremental. A new slot array of twice the size is
+ * allocated, and every insertion or removal afterwards moves a few of
+ * the old slots into it, in order, until the old array is empty and
+ * can be freed. Meanwhile, lookups search both arrays.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/hashtable.h>
+
+#define HASHTABLE_MIN_CAPACITY  16
+
+/* Grow when more than 4/5 of the slots are used. Growing doubles the
+ * capacity, so with MIGRATE_STEPS slots moved per operation the old
+ * array is emptied well before the new one fills up in turn.
+ */
+#define HASHTABLE_LOAD_NUM      4
+#define HASHTABLE_LOAD_DEN      5
+#define HASHTABLE_MIGRATE_STEPS 4
+
+struct _hashtable_slot {
+    /* 0 when the slot is empty; see _hash */
+    unsigned long hash;
+
+    /* In an empty slot, NULL, except in the sentinel that ends each
+     * array: it points to the first slot of the next array to iterate
+     * over, or to the sentinel itself after the last one.
+     */
+    const void *key;
+    void *value;
+};
+
+struct _hashtable {
+    /* capacity + 1 slots, the last being the sentinel */
+    struct _hashtable_slot *slots;
+    unsigned long capacity;
+
+    /* The array being migrated into slots, or NULL. Its slots below
+     * migrated have all been moved.
+     */
+    struct _hashtable_slot *old_slots;
+    unsigned long old_capacity;
+    unsigned long migrated;
+
+    unsigned long size;
+
+    HashFn hashfn;
+    CompareFn comparefn;
+};
+
+/* Hashes of 0 mark empty slots, so 0 is folded into 1 */
+static unsigned long _hash(HashTable *table, const void *key)
+{
+    unsigned long hash;
+
+    hash = table->hashfn(key);
+
+    return (hash != 0) ? hash : 1;
+}
+
+static struct _hashtable_slot* _slots_create(unsigned long capacity)
+{
+    struct _hashtable_slot *slots;
+
+    slots = calloc(capacity + 1, sizeof(struct _hashtable_slot));
+    if(NULL == slots) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    slots[capacity].key = &slots[capacity];
+
+    return slots;
+}
+
+/* Distance of the entry in slot i from its home slot */
+#define probe_distance(slots, i, mask) \
+    (((i) - ((slots)[(i)].hash & (mask))) & (mask))
+
+/* Finds key in slots, skipping those below skip, which have been
+ * migrated out. A probe sequence runs over contiguous slots, so the
+ * part at or above skip is still as it was.
+ *
+ * Complexity: O(1) expected
+ */
+static struct _hashtable_slot* _slots_find(HashTable *table,
+        struct _hashtable_slot *slots, unsigned long capacity,
+        unsigned long skip, unsigned long hash, const void *key)
+{
+    unsigned long i, dist, mask;
+
+    mask = capacity - 1;
+    i = hash & mask;
+
+    for(dist = 0; ; i = (i + 1) & mask, dist++) {
+        if(i < skip) {
+            dist += skip - i;
+            i = skip;
+        }
+
+        if(0 == slots[i].hash || dist > probe_distance(slots, i, mask)) {
+            return NULL;
+        }
+
+        if(slots[i].hash == hash && table->comparefn(slots[i].key, key) == 0) {
+            return &slots[i];
+        }
+    }
+}
+
+/* Complexity: O(1) expected */
+static void _slots_insert(struct _hashtable_slot *slots,
+        unsigned long capacity, unsigned long hash, const void *key,
+        void *value)
+{
+    struct _hashtable_slot entry, tmp;
+    unsigned long i, dist, mask, resident;
+
+    mask = capacity - 1;
+    entry.hash = hash;
+    entry.key = key;
+    entry.value = value;
+
+    for(i = hash & mask, dist = 0; ; i = (i + 1) & mask, dist++) {
+        if(0 == slots[i].hash) {
+            slots[i] = entry;
+            return;
+        }
+
+        /* Rob the richer entry of its slot */
+        resident = probe_distance(slots, i, mask);
+        if(resident < dist) {
+            tmp = slots[i];
+            slots[i] = entry;
+            entry = tmp;
+            dist = resident;
+        }
+    }
+}
+
+/* Empties slot i, shifting back the entries after it that are not in
+ * their home slot. Slots below skip have been migrated out and are
+ * passed over, as in _slots_find, so a probe sequence that wraps
+ * around the end of the array is shifted across them: an entry moves
+ * back into slot i as long as that is not before its home slot.
+ *
+ * Complexity: O(1) expected
+ */
+static void _slots_remove(struct _hashtable_slot *slots,
+        unsigned long capacity, unsigned long skip, unsigned long i)
+{
+    unsigned long next, mask;
+
+    mask = capacity - 1;
+
+    for(;;) {
+        next = (i + 1) & mask;
+        if(next < skip) {
+            next = skip;
+        }
+
+        if(next == i || 0 == slots[next].hash ||
+                probe_distance(slots, next, mask) < ((next - i) & mask)) {
+            break;
+        }
+
+        slots[i] = slots[next];
+        i = next;
+    }
+
+    slots[i].hash = 0;
+    slots[i].key = NULL;
+    slots[i].value = NULL;
+}
+
+/* Moves up to steps of the old slots into the current array */
+static void _hashtable_migrate(HashTable *table, unsigned long steps)
+{
+    struct _hashtable_slot *slot;
+
+    if(NULL == table->old_slots) {
+        return;
+    }
+
+    for(; steps > 0 && table->migrated < table->old_capacity; steps--) {
+        slot = &table->old_slots[table->migrated++];
+        if(slot->hash != 0) {
+            _slots_insert(table->slots, table->capacity, slot->hash,
+                    slot->key, slot->value);
+            slot->hash = 0;
+            slot->key = NULL;
+            slot->value = NULL;
+        }
+    }
+
+    if(table->migrated == table->old_capacity) {
+        free(table->old_slots);
+        table->old_slots = NULL;
+    }
+}
+
+/* Starts migrating into an array twice the size */
+static int _hashtable_grow(HashTable *table)
+{
+    struct _hashtable_slot *slots;
+
+    /* Only if the last migration was outpaced, which the load factor
+     * and step count should prevent.
+     */
+    _hashtable_migrate(table, (unsigned long)-1);
+
+    slots = _slots_create(table->capacity * 2);
+    if(NULL == slots) {
+        return -1;
+    }
+
+    table->old_slots = table->slots;
+    table->old_capacity = table->capacity;
+    table->migrated = 0;
+
+    /* Iteration continues from the old array into the new one */
+    table->old_slots[table->old_capacity].key = slots;
+
+    table->slots = slots;
+    table->capacity *= 2;
+
+    return 0;
+}
+
+static struct _hashtable_slot* _hashtable_find(HashTable *table,
+        unsigned long hash, const void *key)
+{
+    struct _hashtable_slot *slot;
+
+    slot = _slots_find(table, table->slots, table->capacity, 0, hash, key);
+    if(NULL == slot && table->old_slots != NULL) {
+        slot = _slots_find(table, table->old_slots, table->old_capacity,
+                table->migrated, hash, key);
+    }
+
+    return slot;
+}
+
+/* The first occupied slot at or after slot, following sentinels from
+ * one array to the next.
+ */
+static struct _hashtable_slot* _hashtable_scan(struct _hashtable_slot *slot)
+{
+    while(0 == slot->hash) {
+        if(NULL == slot->key) {
+            slot++;
+        } else if(slot->key == slot) {
+            return NULL;
+        } else {
+            slot = (struct _hashtable_slot *)slot->key;
+        }
+    }
+
+    return slot;
+}
+
+static void _slots_free_all(struct _hashtable_slot *slots,
+        unsigned long capacity, FreeFn freefn)
+{
+    unsigned long i;
+
+    if(NULL == slots) {
+        return;
+    }
+
+    if(freefn != NULL) {
+        for(i = 0; i < capacity; i++) {
+            if(slots[i].hash != 0) {
+                freefn(slots[i].value);
+            }
+        }
+    }
+
+    free(slots);
+}
+
+/* Complexity: O(1) */
+HashTable* hashtable_create(HashFn hashfn, CompareFn comparefn)
+{
+    HashTable *table;
+
+    assert(hashfn != NULL);
+    assert(comparefn != NULL);
+
+    table = malloc(sizeof(HashTable));
+    if(NULL == table) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    table->slots = _slots_create(HASHTABLE_MIN_CAPACITY);
+    if(NULL == table->slots) {
+        free(table);
+        return NULL;
+    }
+
+    table->capacity = HASHTABLE_MIN_CAPACITY;
+    table->old_slots = NULL;
+    table->old_capacity = 0;
+    table->migrated = 0;
+    table->size = 0;
+    table->hashfn = hashfn;
+    table->comparefn = comparefn;
+
+    return table;
+}
+
+/* Complexity: O(1) */
+void hashtable_free(HashTable *table)
+{
+    assert(table != NULL);
+
+    free(table->old_slots);
+    free(table->slots);
+    free(table);
+}
+
+/* Complexity: O(n) */
+void hashtable_free_all(HashTable *table, FreeFn freefn)
+{
+    assert(table != NULL);
+
+    if(NULL == freefn) {
+        /* Default to free */
+        freefn = (FreeFn)free;
+    }
+
+    /* Migrated old slots are empty, so nothing is freed twice */
+    _slots_free_all(table->old_slots, table->old_capacity, freefn);
+    _slots_free_all(table->slots, table->capacity, freefn);
+    free(table);
+}
+
+/* Keys are unique: returns -1 if key is already present, as well as
+ * when out of memory.
+ *
+ * Complexity: O(1) expected
+ */
+int hashtable_insert(HashTable *table, const void *key, void *value)
+{
+    unsigned long hash;
+
+    assert(table != NULL);
+
+    hash = _hash(table, key);
+    if(_hashtable_find(table, hash, key) != NULL) {
+        return -1;
+    }
+
+    if((table->size + 1) * HASHTABLE_LOAD_DEN >
+            table->capacity * HASHTABLE_LOAD_NUM) {
+        if(_hashtable_grow(table) < 0) {
+            return -1;
+        }
+    }
+
+    _hashtable_migrate(table, HASHTABLE_MIGRATE_STEPS);
+
+    _slots_insert(table->slots, table->capacity, hash, key, value);
+    table->size++;
+
+    return 0;
+}
+
+/* Complexity: O(1) expected */
+void* hashtable_remove(HashTable *table, const void *key)
+{
+    HashTableIterator *it;
+
+    assert(table != NULL);
+
+    it = _hashtable_find(table, _hash(table, key), key);
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return hashtable_remove_at(table, it);
+}
+
+/* Complexity: O(1) */
+int hashtable_is_empty(HashTable *table)
+{
+    assert(table != NULL);
+
+    return (table->size == 0);
+}
+
+/* Complexity: O(1) */
+unsigned long hashtable_size(HashTable *table)
+{
+    assert(table != NULL);
+
+    return table->size;
+}
+
+/* Complexity: O(1) expected */
+void* hashtable_remove_at(HashTable *table, HashTableIterator *it)
+{
+    void *value;
+
+    assert(table != NULL);
+    assert(it != NULL);
+
+    value = it->value;
+
+    if(it >= table->slots && it < table->slots + table->capacity) {
+        _slots_remove(table->slots, table->capacity, 0,
+                (unsigned long)(it - table->slots));
+    } else {
+        assert(table->old_slots != NULL);
+        _slots_remove(table->old_slots, table->old_capacity,
+                table->migrated, (unsigned long)(it - table->old_slots));
+    }
+    table->size--;
+
+    _hashtable_migrate(table, HASHTABLE_MIGRATE_STEPS);
+
+    return value;
+}
+
+/* Complexity: O(1) expected */
+HashTableIterator* hashtable_find(HashTable *table, const void *key)
+{
+    assert(table != NULL);
+
+    return _hashtable_find(table, _hash(table, key), key);
+}
+
+/* Complexity: O(capacity) */
+HashTableIterator* hashtable_begin(HashTable *table)
+{
+    assert(table != NULL);
+
+    if(0 == table->size) {
+        return NULL;
+    }
+
+    if(table->old_slots != NULL) {
+        return _hashtable_scan(table->old_slots);
+    }
+
+    return _hashtable_scan(table->slots);
+}
+
+/* Complexity: O(1) amortized over a full iteration */
+HashTableIterator* hashtable_next(HashTableIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return _hashtable_scan(it + 1);
+}
+
+/* Complexity: O(1) */
+const void* hashtable_get_key(HashTableIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->key;
+}
+
+/* Complexity: O(1) */
+void* hashtable_get_value(HashTableIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->value;
+}
@@ -32,93 +32,228 @@
 #include <libcore/heap.h>
 #include <libcore/darray.h>
 
+#include "heap_sift.h"
+
 struct _heap {
     DArray *h;
     CompareFn comparefn;
+    unsigned long arity_shift;  /* arity == 1 << arity_shift */
 };
 
-static unsigned long parent_of(unsigned long index)
-{
-    return ((index - 1) / 2);
-}
-
-static unsigned long left_child_of(unsigned index)
+/* The heap is stored as an implicit d-ary tree where d is a power of
+ * two, so the parent/child index math reduces to shifts. With d = 4
+ * or d = 8 the children of a node share one or two cache lines, and
+ * the tree is log2(d) times shallower than a binary heap.
+ */
+static unsigned long parent_of(const Heap *heap, unsigned long index)
 {
-    return ((2 * index) + 1);
+    return ((index - 1) >> heap->arity_shift);
 }
 
-static unsigned long right_child_of(unsigned index)
+static unsigned long first_child_of(const Heap *heap, unsigned long index)
 {
-    return ((2 * index) + 2);
+    return ((index << heap->arity_shift) + 1);
 }
 
-/* Complexity: O(log n) */
+/* Complexity: O(log n)
+ *
+ * Sifts with a hole rather than with swaps: the element being moved
+ * is held aside and written exactly once, at its final position.
+ */
 static void heapify_up(Heap *heap, unsigned long index)
 {
-    while(index > 0 &&
-            heap->comparefn(darray_index(heap->h, index),
-                            darray_index(heap->h, parent_of(index))) > 0) {
-        darray_swap(heap->h, index, parent_of(index));
-        index = parent_of(index);
+    void **data, *item;
+    unsigned long parent;
+
+    data = darray_data(heap->h);
+    item = data[index];
+
+    while(index > 0) {
+        parent = parent_of(heap, index);
+        if(heap->comparefn(item, data[parent]) <= 0) {
+            break;
+        }
+
+        data[index] = data[parent];
+        index = parent;
     }
+
+    data[index] = item;
 }
 
-/* Complexity: O(log n) */
+/* Complexity: O(d log n / log d) */
 static void heapify_down(Heap *heap, unsigned long index)
 {
-    unsigned long left, right, largest;
-    int done;
+    void **data, *item;
+    unsigned long size, child, last, largest;
 
-    done = 0;
+    data = darray_data(heap->h);
+    size = darray_size(heap->h);
+    item = data[index];
 
-    while(!done) {
-        left = left_child_of(index);
-        right = right_child_of(index);
+    for(;;) {
+        child = first_child_of(heap, index);
+        if(child >= size) {
+            break;
+        }
 
-        largest = index;
+        last = child + (1UL << heap->arity_shift);
+        if(last > size) {
+            last = size;
+        }
 
-        if(left < heap_size(heap) &&
-                heap->comparefn(darray_index(heap->h, left),
-                                darray_index(heap->h, index)) > 0) {
-            largest = left;
+        for(largest = child++; child < last; child++) {
+            if(heap->comparefn(data[child], data[largest]) > 0) {
+                largest = child;
+            }
         }
 
-        if(right < heap_size(heap) &&
-                heap->comparefn(darray_index(heap->h, right),
-                                darray_index(heap->h, largest)) > 0) {
-            largest = right;
+        if(heap->comparefn(data[largest], item) <= 0) {
+            break;
         }
 
-        if(largest != index) {
-            darray_swap(heap->h, index, largest);
-            index = largest;
+        data[index] = data[largest];
+        index = largest;
+    }
+
+    data[index] = item;
+}
+
+/* Removes the element at index by moving the last element into its
+ * place and restoring the heap property around it.
+ */
+static void* heap_remove_index(Heap *heap, unsigned long index)
+{
+    void **data, *ret, *last;
+
+    data = darray_data(heap->h);
+    ret = data[index];
+
+    last = darray_remove(heap->h, darray_size(heap->h) - 1);
+
+    if(index < darray_size(heap->h)) {
+        /* darray_remove may have shrunk the array */
+        data = darray_data(heap->h);
+        data[index] = last;
+
+        if(index > 0 &&
+                heap->comparefn(last, data[parent_of(heap, index)]) > 0) {
+            heapify_up(heap, index);
         } else {
-            done = 1;
+            heapify_down(heap, index);
         }
     }
+
+    return ret;
 }
 
-Heap* heap_create(CompareFn comparefn)
+/* Floyd's bottom-up construction. Each node is sifted down once,
+ * starting from the last parent, which is O(n) overall rather than
+ * the O(n log n) of n successive pushes.
+ */
+static void heap_build(Heap *heap)
 {
-    Heap *new_heap;
+    unsigned long i;
 
-    assert(comparefn != NULL);
+    if(heap_size(heap) < 2) {
+        return;
+    }
+
+    for(i = parent_of(heap, heap_size(heap) - 1); i > 0; i--) {
+        heapify_down(heap, i);
+    }
+    heapify_down(heap, 0); /* Edge-case for loop 0 index */
+}
+
+static int arity_to_shift(unsigned int arity, unsigned long *shift)
+{
+    switch(arity) {
+        case 2: *shift = 1; return 0;
+        case 4: *shift = 2; return 0;
+        case 8: *shift = 3; return 0;
+        default:
+            fprintf(stderr, "Unsupported heap arity %u (%s:%d)\n",
+                    arity, __FUNCTION__, __LINE__);
+            return -1;
+    }
+}
+
+/* Heap container around an existing darray */
+static Heap* heap_alloc(CompareFn comparefn, unsigned long shift, DArray *darray)
+{
+    Heap *new_heap;
 
-    /* Heap container */
     new_heap = malloc(sizeof(struct _heap));
     if(NULL == new_heap) {
         fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
         return NULL;
     }
 
-    new_heap->h = darray_create();
-    if(NULL == new_heap->h) {
+    new_heap->h = darray;
+    new_heap->comparefn = comparefn;
+    new_heap->arity_shift = shift;
+
+    return new_heap;
+}
+
+Heap* heap_create(CompareFn comparefn)
+{
+    return heap_create_dary(comparefn, 2);
+}
+
+/* Supported arities are 2, 4, and 8 */
+Heap* heap_create_dary(CompareFn comparefn, unsigned int arity)
+{
+    Heap *new_heap;
+    DArray *darray;
+    unsigned long shift;
+
+    assert(comparefn != NULL);
+
+    if(arity_to_shift(arity, &shift) < 0) {
+        return NULL;
+    }
+
+    darray = darray_create();
+    if(NULL == darray) {
         fprintf(stderr, "Heap creation failed (%s:%d)\n", __FUNCTION__, __LINE__);
-        free(new_heap);
         return NULL;
     }
 
-    new_heap->comparefn = comparefn;
+    new_heap = heap_alloc(comparefn, shift, darray);
+    if(NULL == new_heap) {
+        darray_free(darray);
+        return NULL;
+    }
+
+    return new_heap;
+}
+
+/* Complexity: O(n)
+ *
+ * The heap takes ownership of darray: its storage is heapified in
+ * place and is released by heap_free/heap_free_all. The caller must
+ * not use darray afterwards.
+ */
+Heap* heap_create_from_darray(CompareFn comparefn, unsigned int arity,
+        DArray *darray)
+{
+    Heap *new_heap;
+    unsigned long shift;
+
+    assert(comparefn != NULL);
+    assert(darray != NULL);
+
+    if(arity_to_shift(arity, &shift) < 0) {
+        return NULL;
+    }
+
+    new_heap = heap_alloc(comparefn, shift, darray);
+    if(NULL == new_heap) {
+        return NULL;
+    }
+
+    heap_build(new_heap);
 
     return new_heap;
 }
@@ -149,7 +284,10 @@ int heap_push(Heap *heap, void *data)
 {
     assert(heap != NULL);
 
-    darray_append(heap->h, data);
+    if(darray_append(heap->h, data) < 0) {
+        return -1;
+    }
+
     heapify_up(heap, darray_size(heap->h) - 1);
 
     return 0;
@@ -158,22 +296,13 @@ int heap_push(Heap *heap, void *data)
 /* Complexity: O(log n) */
 void* heap_pop(Heap *heap)
 {
-    void *ret = NULL;
-
     assert(heap != NULL);
 
     if(heap_is_empty(heap)) {
         return NULL;
     }
 
-    if(darray_swap(heap->h, 0, darray_size(heap->h) - 1) < 0) {
-        return NULL;
-    }
-
-    ret = darray_remove(heap->h, darray_size(heap->h) - 1);
-    heapify_down(heap, 0);
-
-    return ret;
+    return heap_remove_index(heap, 0);
 }
 
 /* Complexity: O(1) */
@@ -188,13 +317,14 @@ void* heap_top(Heap *heap)
     return darray_index(heap->h, 0);
 }
 
-/* Complexity: O(n log n), worst-case if data is located
+/* Complexity: O(n), worst-case if data is located
  * at the right-most leaf node on the lowest level of the
  * tree.
  */
 int heap_remove(Heap *heap, const void *data)
 {
-    unsigned long i;
+    unsigned long i, size;
+    void **items;
 
     assert(heap != NULL);
 
@@ -202,16 +332,12 @@ int heap_remove(Heap *heap, const void *data)
         return -1;
     }
 
-    for(i = 0; i < heap_size(heap); i++) {
-        if(darray_index(heap->h, i) == data) {
-            if(darray_swap(heap->h, i, darray_size(heap->h) - 1) < 0) {
-                return -1;
-            }
-
-            /* Don't care about the return value */
-            darray_remove(heap->h, darray_size(heap->h) - 1);
-            heapify_down(heap, i);
+    items = darray_data(heap->h);
+    size = darray_size(heap->h);
 
+    for(i = 0; i < size; i++) {
+        if(items[i] == data) {
+            heap_remove_index(heap, i);
             return 0;
         }
     }
@@ -222,8 +348,6 @@ int heap_remove(Heap *heap, const void *data)
 /* Complexity: O(size(heap1) + 2 * size(heap2)) => O(n) */
 int heap_merge(Heap *heap1, Heap* heap2)
 {
-    unsigned long i;
-
     assert(heap1 != NULL);
     assert(heap2 != NULL);
 
@@ -237,10 +361,130 @@ int heap_merge(Heap *heap1, Heap* heap2)
     }
 
     /* O(size(heap1) + size(heap2)) */
-    for(i = (darray_size(heap1->h) - 1) / 2; i > 0; i--) {
-        heapify_down(heap1, i);
+    heap_build(heap1);
+
+    return 0;
+}
+
+/* Complexity: O(k) amortized for k random items; worst-case O(n + k)
+ * when k >= n, and O(k log n) otherwise
+ *
+ * Pushes every item of items (which is left untouched). Individual
+ * sift-ups cost O(1) on average, but when the batch is at least as
+ * large as the heap a single bottom-up rebuild bounds the worst case.
+ */
+int heap_push_many(Heap *heap, DArray *items)
+{
+    unsigned long i, old_size;
+
+    assert(heap != NULL);
+    assert(items != NULL);
+
+    old_size = heap_size(heap);
+
+    if(darray_concat(heap->h, items) < 0) {
+        return -1;
+    }
+
+    if(darray_size(items) >= old_size) {
+        heap_build(heap);
+    } else {
+        for(i = old_size; i < heap_size(heap); i++) {
+            heapify_up(heap, i);
+        }
+    }
+
+    return 0;
+}
+
+/* Complexity: O(log n) */
+void heap_min_sift_up(void **data, unsigned long index, CompareFn comparefn)
+{
+    unsigned long parent;
+    void *item;
+
+    item = data[index];
+
+    while(index > 0) {
+        parent = (index - 1) / 2;
+        if(comparefn(item, data[parent]) >= 0) {
+            break;
+        }
+
+        data[index] = data[parent];
+        index = parent;
+    }
+
+    data[index] = item;
+}
+
+/* Complexity: O(log n) */
+void heap_min_sift_down(void **data, unsigned long index,
+        unsigned long size, CompareFn comparefn)
+{
+    unsigned long child;
+    void *item;
+
+    item = data[index];
+
+    while((child = (2 * index) + 1) < size) {
+        if(child + 1 < size && comparefn(data[child + 1], data[child]) < 0) {
+            child++;
+        }
+
+        if(comparefn(data[child], item) >= 0) {
+            break;
+        }
+
+        data[index] = data[child];
+        index = child;
+    }
+
+    data[index] = item;
+}
+
+/* Complexity: O(n) */
+void heap_min_build(void **data, unsigned long size, CompareFn comparefn)
+{
+    unsigned long i;
+
+    for(i = size / 2; i > 0; i--) {
+        heap_min_sift_down(data, i - 1, size, comparefn);
+    }
+}
+
+/* Complexity: O(n log n) in time, O(1) in space
+ *
+ * Sorts darray in place into the same order as darray_sort, i.e. from
+ * highest to lowest priority, so that darray_is_sorted holds afterwards.
+ * Unlike darray_sort, the sort is not stable.
+ */
+int heap_sort(DArray *darray, CompareFn comparefn)
+{
+    unsigned long i, size;
+    void **data, *tmp;
+
+    assert(darray != NULL);
+    assert(comparefn != NULL);
+
+    if(darray_is_empty(darray)) {
+        return -1;
+    }
+
+    data = darray_data(darray);
+    size = darray_size(darray);
+
+    /* The root holds the lowest-priority element, which is moved to
+     * the back of the array
+     */
+    heap_min_build(data, size, comparefn);
+
+    for(i = size - 1; i > 0; i--) {
+        tmp = data[0];
+        data[0] = data[i];
+        data[i] = tmp;
+        heap_min_sift_down(data, 0, i, comparefn);
     }
-    heapify_down(heap1, 0); /* Edge-case for loop 0 index */
 
     return 0;
 }
@@ -261,6 +505,7 @@ int heap_is_empty(Heap *heap)
 int heap_is_valid(Heap *heap)
 {
     unsigned long i;
+    void **data;
 
     assert(heap != NULL);
 
@@ -268,16 +513,15 @@ int heap_is_valid(Heap *heap)
         return 1;
     }
 
+    data = darray_data(heap->h);
+
     for(i = 1; i < heap_size(heap); i++) {
-        if(heap->comparefn(darray_index(heap->h, parent_of(i)),
-                           darray_index(heap->h, i)) < 0) {
+        if(heap->comparefn(data[parent_of(heap, i)], data[i]) < 0) {
             return 0;
         }
     }
 
     return 1;
-
-    /* return check_heap(heap, 0); */
 }
 
 /* Complexity: O(1) */
@@ -287,3 +531,11 @@ unsigned long heap_size(Heap *heap)
 
     return darray_size(heap->h);
 }
+
+/* Complexity: O(1) */
+unsigned int heap_arity(Heap *heap)
+{
+    assert(heap != NULL);
+
+    return (1U << heap->arity_shift);
+}
@@ -0,0 +1,336 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcore/keyheap.h>
+
+#define KEYHEAP_MIN_SIZE    32
+
+/* Each node has four children, entries 4i+1 to 4i+4. The array starts
+ * KEYHEAP_SKEW entries into a block aligned on a cache line, so that
+ * each set of siblings starts on a multiple of four entries. Where
+ * entries are 16 bytes, as on LP64 targets, a full set of siblings then
+ * fills exactly one 64-byte cache line.
+ */
+#define KEYHEAP_ARITY_SHIFT 2
+#define KEYHEAP_ARITY       (1UL << KEYHEAP_ARITY_SHIFT)
+#define KEYHEAP_SKEW        (KEYHEAP_ARITY - 1)
+#define CACHE_LINE_SIZE     64
+
+struct _keyheap_entry {
+    double key;
+    void *data;
+};
+
+struct _keyheap {
+    struct _keyheap_entry *entries;
+    unsigned long size;
+    unsigned long capacity;
+};
+
+#define parent_of(index)        (((index) - 1) >> KEYHEAP_ARITY_SHIFT)
+#define first_child_of(index)   (((index) << KEYHEAP_ARITY_SHIFT) + 1)
+
+static int keyheap_resize(KeyHeap *keyheap, unsigned long new_capacity)
+{
+    struct _keyheap_entry *new_entries;
+    void *mem;
+
+    if(posix_memalign(&mem, CACHE_LINE_SIZE, sizeof(struct _keyheap_entry) *
+                (KEYHEAP_SKEW + new_capacity))) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return -1;
+    }
+
+    new_entries = (struct _keyheap_entry *)mem + KEYHEAP_SKEW;
+    if(keyheap->entries != NULL) {
+        memcpy(new_entries, keyheap->entries,
+                sizeof(struct _keyheap_entry) * keyheap->size);
+        free(keyheap->entries - KEYHEAP_SKEW);
+    }
+
+    keyheap->entries = new_entries;
+    keyheap->capacity = new_capacity;
+
+    return 0;
+}
+
+/* Complexity: O(log n) */
+static void heapify_up(KeyHeap *keyheap, unsigned long index)
+{
+    struct _keyheap_entry *e, item;
+    unsigned long parent;
+
+    e = keyheap->entries;
+    item = e[index];
+
+    while(index > 0) {
+        parent = parent_of(index);
+        if(e[parent].key <= item.key) {
+            break;
+        }
+
+        e[index] = e[parent];
+        index = parent;
+    }
+
+    e[index] = item;
+}
+
+/* Complexity: O(log n) */
+static void heapify_down(KeyHeap *keyheap, unsigned long index)
+{
+    struct _keyheap_entry *e, item;
+    unsigned long child, last, smallest;
+
+    e = keyheap->entries;
+    item = e[index];
+
+    for(;;) {
+        child = first_child_of(index);
+        if(child >= keyheap->size) {
+            break;
+        }
+
+        last = child + KEYHEAP_ARITY;
+        if(last > keyheap->size) {
+            last = keyheap->size;
+        }
+
+        for(smallest = child++; child < last; child++) {
+            if(e[child].key < e[smallest].key) {
+                smallest = child;
+            }
+        }
+
+        if(e[smallest].key >= item.key) {
+            break;
+        }
+
+        e[index] = e[smallest];
+        index = smallest;
+    }
+
+    e[index] = item;
+}
+
+static void* keyheap_remove_index(KeyHeap *keyheap, unsigned long index,
+        double *key)
+{
+    struct _keyheap_entry *e;
+    void *ret;
+
+    e = keyheap->entries;
+    ret = e[index].data;
+    if(key != NULL) {
+        *key = e[index].key;
+    }
+
+    keyheap->size--;
+
+    if(index < keyheap->size) {
+        e[index] = e[keyheap->size];
+
+        if(index > 0 && e[index].key < e[parent_of(index)].key) {
+            heapify_up(keyheap, index);
+        } else {
+            heapify_down(keyheap, index);
+        }
+    }
+
+    /* Shrink only when well below capacity to avoid thrashing */
+    if(keyheap->capacity > KEYHEAP_MIN_SIZE &&
+            keyheap->size < (keyheap->capacity >> 2)) {
+        keyheap_resize(keyheap, keyheap->capacity >> 1);
+    }
+
+    return ret;
+}
+
+KeyHeap* keyheap_create(void)
+{
+    KeyHeap *new_keyheap;
+
+    new_keyheap = malloc(sizeof(struct _keyheap));
+    if(NULL == new_keyheap) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_keyheap->entries = NULL;
+    new_keyheap->size = 0;
+    new_keyheap->capacity = 0;
+
+    return new_keyheap;
+}
+
+/* Complexity: O(1) */
+void keyheap_free(KeyHeap *keyheap)
+{
+    assert(keyheap != NULL);
+
+    /* Only free the container, not the data stored in the heap */
+    if(keyheap->entries != NULL) {
+        free(keyheap->entries - KEYHEAP_SKEW);
+    }
+    free(keyheap);
+}
+
+/* Complexity: O(n) */
+void keyheap_free_all(KeyHeap *keyheap, FreeFn freefn)
+{
+    unsigned long i;
+
+    assert(keyheap != NULL);
+
+    if(NULL == freefn) {
+        /* Default to stdlib free */
+        freefn = (FreeFn)free;
+    }
+
+    for(i = 0; i < keyheap->size; i++) {
+        if(keyheap->entries[i].data != NULL) {
+            freefn(keyheap->entries[i].data);
+        }
+    }
+
+    keyheap_free(keyheap);
+}
+
+/* Complexity: O(log n), worst-case */
+int keyheap_push(KeyHeap *keyheap, double key, void *data)
+{
+    unsigned long new_capacity;
+
+    assert(keyheap != NULL);
+
+    if(keyheap->size == keyheap->capacity) {
+        new_capacity = keyheap->capacity << 1;
+        if(new_capacity < KEYHEAP_MIN_SIZE) {
+            new_capacity = KEYHEAP_MIN_SIZE;
+        }
+
+        if(keyheap_resize(keyheap, new_capacity) < 0) {
+            return -1;
+        }
+    }
+
+    keyheap->entries[keyheap->size].key = key;
+    keyheap->entries[keyheap->size].data = data;
+    keyheap->size++;
+
+    heapify_up(keyheap, keyheap->size - 1);
+
+    return 0;
+}
+
+/* Complexity: O(log n)
+ *
+ * Removes and returns the data with the smallest key. If key is not
+ * NULL, the key of the removed entry is stored there.
+ */
+void* keyheap_pop(KeyHeap *keyheap, double *key)
+{
+    assert(keyheap != NULL);
+
+    if(keyheap_is_empty(keyheap)) {
+        return NULL;
+    }
+
+    return keyheap_remove_index(keyheap, 0, key);
+}
+
+/* Complexity: O(1) */
+void* keyheap_top(KeyHeap *keyheap, double *key)
+{
+    assert(keyheap != NULL);
+
+    if(keyheap_is_empty(keyheap)) {
+        return NULL;
+    }
+
+    if(key != NULL) {
+        *key = keyheap->entries[0].key;
+    }
+
+    return keyheap->entries[0].data;
+}
+
+/* Complexity: O(n) */
+int keyheap_remove(KeyHeap *keyheap, const void *data)
+{
+    unsigned long i;
+
+    assert(keyheap != NULL);
+
+    for(i = 0; i < keyheap->size; i++) {
+        if(keyheap->entries[i].data == data) {
+            keyheap_remove_index(keyheap, i, NULL);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* Complexity: O(n) */
+int keyheap_is_valid(KeyHeap *keyheap)
+{
+    unsigned long i;
+
+    assert(keyheap != NULL);
+
+    for(i = 1; i < keyheap->size; i++) {
+        if(keyheap->entries[parent_of(i)].key > keyheap->entries[i].key) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Complexity: O(1) */
+int keyheap_is_empty(KeyHeap *keyheap)
+{
+    assert(keyheap != NULL);
+
+    return (keyheap->size == 0);
+}
+
+/* Complexity: O(1) */
+unsigned long keyheap_size(KeyHeap *keyheap)
+{
+    assert(keyheap != NULL);
+
+    return keyheap->size;
+}
@@ -29,9 +29,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <libcore/btree.h>
 #include <libcore/rbtree.h>
 #include <libcore/map.h>
 
+#include "btree_tag.h"
+
 struct _map {
     RBTree *m;
 };
@@ -46,12 +49,54 @@ Map* map_create(CompareFn comparefn)
     return (Map *)rbtree_create(comparefn);
 }
 
-/* Time Complexity: O(1) */
+/* A map backed by a B+ tree rather than a red-black tree. It packs
+ * many entries into each node, which makes lookups and iteration more
+ * cache friendly and takes less memory per entry, at the price of
+ * iterators being invalidated by any insertion or removal, and of
+ * map_select and map_rank taking O(|map|) time. See btree.h.
+ *
+ * Time Complexity: O(1)
+ */
+Map* map_create_btree(CompareFn comparefn)
+{
+    return btree_tag(btree_create(comparefn));
+}
+
+/* A map that stores values of up to the size of a pointer in its
+ * nodes rather than pointing to them. Values are passed in and out by
+ * address; see rbtree_create_inline.
+ *
+ * Time Complexity: O(1)
+ */
+Map* map_create_inline(CompareFn comparefn, unsigned long value_size)
+{
+    return (Map *)rbtree_create_inline(comparefn, value_size);
+}
+
+/* keys must be strictly ascending according to comparefn, and values
+ * must hold the value for each key at the same index. See
+ * rbtree_create_from_sorted.
+ *
+ * Time Complexity: O(|keys|)
+ */
+Map* map_create_from_sorted(CompareFn comparefn, const DArray *keys,
+        const DArray *values)
+{
+    assert(values != NULL);
+
+    return (Map *)rbtree_create_from_sorted(comparefn, keys, values, 0);
+}
+
+/* Time Complexity: O(|map|) */
 void map_free(Map *map)
 {
     assert(map != NULL);
 
-    rbtree_free((RBTree *)map);
+    if(is_btree(map)) {
+        btree_free(btree_untag(map));
+    } else {
+        rbtree_free((RBTree *)map);
+    }
 }
 
 /* Time Complexity: O(|map|)
@@ -61,7 +106,23 @@ void map_free_all(Map *map, FreeFn freefn)
 {
     assert(map != NULL);
 
-    rbtree_free_all((RBTree *)map, freefn);
+    if(is_btree(map)) {
+        btree_free_all(btree_untag(map), freefn);
+    } else {
+        rbtree_free_all((RBTree *)map, freefn);
+    }
+}
+
+static MapIterator* _map_find_or_insert(Map *map, const void *key,
+        void *value, int *inserted)
+{
+    if(is_btree(map)) {
+        return btree_tag(btree_find_or_insert(btree_untag(map), key, value,
+                    inserted));
+    }
+
+    return (MapIterator *)rbtree_find_or_insert((RBTree *)map, key, value,
+            inserted);
 }
 
 /* Time Complexity: O(log(|map|)) */
@@ -69,6 +130,10 @@ int map_insert(Map *map, const void *key, void *value)
 {
     assert(map != NULL);
 
+    if(is_btree(map)) {
+        return btree_insert(btree_untag(map), key, value);
+    }
+
     return rbtree_insert_unique((RBTree *)map, key, value);
 }
 
@@ -77,9 +142,91 @@ void* map_remove(Map *map, const void *key)
 {
     assert(map != NULL);
 
+    if(is_btree(map)) {
+        return btree_remove(btree_untag(map), key);
+    }
+
     return rbtree_remove((RBTree *)map, key);
 }
 
+/* Finds key, or inserts it with value, with one descent. Returns the
+ * value now stored with key, and sets *inserted, if not NULL, to 1 if
+ * key was inserted. Returns NULL if out of memory.
+ *
+ * Time Complexity: O(log(|map|))
+ */
+void* map_get_or_insert(Map *map, const void *key, void *value,
+        int *inserted)
+{
+    MapIterator *it;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    it = _map_find_or_insert(map, key, value, inserted);
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return map_get_value(it);
+}
+
+/* Stores fn(value, data) with key, where value is the one already
+ * stored with key, or NULL if key is new. Returns 1 if key was
+ * inserted, 0 if its value was replaced, and -1 if out of memory, in
+ * which case fn is not called.
+ *
+ * Time Complexity: O(log(|map|))
+ */
+int map_upsert(Map *map, const void *key, MapUpsertFn fn, void *data)
+{
+    MapIterator *it;
+    int inserted;
+
+    assert(map != NULL);
+    assert(key != NULL);
+    assert(fn != NULL);
+
+    it = _map_find_or_insert(map, key, NULL, &inserted);
+    if(NULL == it) {
+        return -1;
+    }
+
+    map_set_value(map, it, fn(inserted ? NULL : map_get_value(it), data));
+
+    return inserted;
+}
+
+/* Stores value with key, whether or not key is already present. If it
+ * is, the key already in the map is kept, and the replaced value is
+ * stored in *old_value, if not NULL. Returns 1 if key was inserted, 0
+ * if its value was replaced, and -1 if out of memory.
+ *
+ * Time Complexity: O(log(|map|))
+ */
+int map_insert_or_assign(Map *map, const void *key, void *value,
+        void **old_value)
+{
+    MapIterator *it;
+    void *replaced;
+    int inserted;
+
+    assert(map != NULL);
+    assert(key != NULL);
+
+    it = _map_find_or_insert(map, key, value, &inserted);
+    if(NULL == it) {
+        return -1;
+    }
+
+    replaced = inserted ? NULL : map_set_value(map, it, value);
+    if(old_value != NULL) {
+        *old_value = replaced;
+    }
+
+    return inserted;
+}
+
 /* Time Complexity: O(1) */
 int map_is_empty(Map *map)
 {
@@ -93,14 +240,38 @@ unsigned long map_size(Map *map)
 {
     assert(map != NULL);
 
+    if(is_btree(map)) {
+        return btree_size(btree_untag(map));
+    }
+
     return rbtree_size((RBTree *)map);
 }
 
+/* Number of keys in the map less than key
+ *
+ * Time Complexity: O(log(|map|)), O(|map|) with a B-tree backend
+ */
+unsigned long map_rank(Map *map, const void *key)
+{
+    assert(map != NULL);
+    assert(key != NULL);
+
+    if(is_btree(map)) {
+        return btree_rank(btree_untag(map), key);
+    }
+
+    return rbtree_rank((RBTree *)map, key);
+}
+
 /* Time Complexity: O(1) */
 CompareFn map_get_comparefn(Map *map)
 {
     assert(map != NULL);
 
+    if(is_btree(map)) {
+        return btree_get_comparefn(btree_untag(map));
+    }
+
     return rbtree_get_comparefn((RBTree *)map);
 }
 
@@ -110,6 +281,10 @@ void* map_remove_at(Map *map, MapIterator *it)
     assert(map != NULL);
     assert(it != NULL);
 
+    if(is_btree(map)) {
+        return btree_remove_at(btree_untag(map), btree_untag(it));
+    }
+
     return rbtree_remove_at((RBTree *)map, (RBTreeIterator *)it);
 }
 
@@ -119,46 +294,167 @@ MapIterator* map_find(Map *map, const void *key)
     assert(map != NULL);
     assert(key != NULL);
 
+    if(is_btree(map)) {
+        return btree_tag(btree_find(btree_untag(map), key));
+    }
+
     return (MapIterator *)rbtree_find((RBTree *)map, key);
 }
 
-/* Time Complexity: O(log(|map|)) */
+/* Finds each of the n keys, storing in its[i] the iterator map_find
+ * would return for keys[i], and returns the number of keys found. With
+ * the red-black tree backend, the lookups are interleaved so that
+ * their cache misses overlap; see rbtree_find_many.
+ *
+ * Time Complexity: O(n log(|map|))
+ */
+unsigned long map_find_many(Map *map, const void **keys, unsigned long n,
+        MapIterator **its)
+{
+    unsigned long i, found;
+
+    assert(map != NULL);
+    assert(n == 0 || (keys != NULL && its != NULL));
+
+    if(is_btree(map)) {
+        found = 0;
+        for(i = 0; i < n; i++) {
+            its[i] = btree_tag(btree_find(btree_untag(map), keys[i]));
+            if(its[i] != NULL) {
+                found++;
+            }
+        }
+        return found;
+    }
+
+    return rbtree_find_many((RBTree *)map, keys, n, (RBTreeIterator **)its);
+}
+
+/* Time Complexity: O(1), O(log(|map|)) with a B-tree backend */
 MapIterator* map_begin(Map *map)
 {
     assert(map != NULL);
 
+    if(is_btree(map)) {
+        return btree_tag(btree_begin(btree_untag(map)));
+    }
+
     return (MapIterator *)rbtree_begin((RBTree *)map);
 }
 
-/* Time Complexity: O(log(|map|)) */
+/* Time Complexity: O(1), O(log(|map|)) with a B-tree backend */
 MapIterator* map_end(Map *map)
 {
     assert(map != NULL);
 
+    if(is_btree(map)) {
+        return btree_tag(btree_end(btree_untag(map)));
+    }
+
     return (MapIterator *)rbtree_end((RBTree *)map);
 }
 
-/* Time Complexity: O(log(|map|)) */
+/* Time Complexity: O(1) */
 MapIterator* map_next(MapIterator *it)
 {
     assert(it != NULL);
 
+    if(is_btree(it)) {
+        return btree_tag(btree_next(btree_untag(it)));
+    }
+
     return (MapIterator *)rbtree_next((RBTreeIterator *)it);
 }
 
-/* Time Complexity: O(log(|map|)) */
+/* Time Complexity: O(log(|map|)), O(1) with a B-tree backend */
 MapIterator* map_prev(MapIterator *it)
 {
     assert(it != NULL);
 
+    if(is_btree(it)) {
+        return btree_tag(btree_prev(btree_untag(it)));
+    }
+
     return (MapIterator *)rbtree_prev((RBTreeIterator *)it);
 }
 
+/* The index-th key-value pair in iteration order, or NULL
+ *
+ * Time Complexity: O(log(|map|)), O(|map|) with a B-tree backend
+ */
+MapIterator* map_select(Map *map, unsigned long index)
+{
+    assert(map != NULL);
+
+    if(is_btree(map)) {
+        return btree_tag(btree_select(btree_untag(map), index));
+    }
+
+    return (MapIterator *)rbtree_select((RBTree *)map, index);
+}
+
+/* Time Complexity: O(log(|map|)) */
+MapIterator* map_lower_bound(Map *map, const void *key)
+{
+    assert(map != NULL);
+    assert(key != NULL);
+
+    if(is_btree(map)) {
+        return btree_tag(btree_lower_bound(btree_untag(map), key));
+    }
+
+    return (MapIterator *)rbtree_lower_bound((RBTree *)map, key);
+}
+
+/* Time Complexity: O(log(|map|)) */
+MapIterator* map_upper_bound(Map *map, const void *key)
+{
+    assert(map != NULL);
+    assert(key != NULL);
+
+    if(is_btree(map)) {
+        return btree_tag(btree_upper_bound(btree_untag(map), key));
+    }
+
+    return (MapIterator *)rbtree_upper_bound((RBTree *)map, key);
+}
+
+/* Time Complexity: O(log(|map|)) */
+void map_equal_range(Map *map, const void *key, MapIterator **first,
+        MapIterator **last)
+{
+    assert(first != NULL);
+    assert(last != NULL);
+
+    *first = map_lower_bound(map, key);
+    *last = map_upper_bound(map, key);
+}
+
+/* Returns the number of keys in [lo, hi).
+ *
+ * Time Complexity: O(log(|map|)), O(log(|map|) + k) with a B-tree
+ * backend, for k keys in the range
+ */
+unsigned long map_count_range(Map *map, const void *lo, const void *hi)
+{
+    assert(map != NULL);
+
+    if(is_btree(map)) {
+        return btree_count_range(btree_untag(map), lo, hi);
+    }
+
+    return rbtree_count_range((RBTree *)map, lo, hi);
+}
+
 /* Time Complexity: O(1) */
 const void* map_get_key(MapIterator *it)
 {
     assert(it != NULL);
 
+    if(is_btree(it)) {
+        return btree_get_key(btree_untag(it));
+    }
+
     return rbtree_get_key((RBTreeIterator *)it);
 }
 
@@ -167,5 +463,25 @@ void* map_get_value(MapIterator *it)
 {
     assert(it != NULL);
 
+    if(is_btree(it)) {
+        return btree_get_value(btree_untag(it));
+    }
+
     return rbtree_get_value((RBTreeIterator *)it);
 }
+
+/* Replaces the value of it, returning the old one.
+ *
+ * Time Complexity: O(1)
+ */
+void* map_set_value(Map *map, MapIterator *it, void *value)
+{
+    assert(map != NULL);
+    assert(it != NULL);
+
+    if(is_btree(it)) {
+        return btree_set_value(btree_untag(it), value);
+    }
+
+    return rbtree_set_value((RBTree *)map, (RBTreeIterator *)it, value);
+}
@@ -0,0 +1,390 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/darray.h>
+#include <libcore/minmax_heap.h>
+
+/* Min-max heap (Atkinson, Sack, Santoro, and Strothotte, 1986).
+ *
+ * The array is an implicit binary tree whose even levels (the root's
+ * included) are min levels and whose odd levels are max levels. A node
+ * on a min level is no greater than any of its descendants, and a node
+ * on a max level is no smaller. The minimum is thus the root, and the
+ * maximum is one of the root's children.
+ */
+struct _mmheap {
+    DArray *h;
+    CompareFn comparefn;
+};
+
+/* Direction of a level: MIN_LEVEL nodes must beat their descendants by
+ * being smaller, MAX_LEVEL nodes by being larger.
+ */
+#define MIN_LEVEL   (-1)
+#define MAX_LEVEL   (1)
+
+#define parent_of(index)        (((index) - 1) / 2)
+#define grandparent_of(index)   (((index) - 3) / 4)
+
+static int level_of(unsigned long index)
+{
+    int depth = 0;
+
+    for(index++; index > 1; index >>= 1) {
+        depth++;
+    }
+
+    return (depth & 1) ? MAX_LEVEL : MIN_LEVEL;
+}
+
+/* Non-zero if a must sit above b on a level of the given direction */
+static int beats(const MinMaxHeap *mmheap, const void *a, const void *b,
+        int dir)
+{
+    int result = mmheap->comparefn(a, b);
+
+    return (dir == MAX_LEVEL) ? (result > 0) : (result < 0);
+}
+
+static void swap(void **data, unsigned long a, unsigned long b)
+{
+    void *tmp;
+
+    tmp = data[a];
+    data[a] = data[b];
+    data[b] = tmp;
+}
+
+/* Complexity: O(log n)
+ *
+ * Moves data[index] up through the levels of direction dir, i.e. by
+ * grandparent steps.
+ */
+static void bubble_up_grandparents(MinMaxHeap *mmheap, void **data,
+        unsigned long index, int dir)
+{
+    unsigned long grandparent;
+    void *item;
+
+    item = data[index];
+
+    while(index > 2) {
+        grandparent = grandparent_of(index);
+        if(!beats(mmheap, item, data[grandparent], dir)) {
+            break;
+        }
+
+        data[index] = data[grandparent];
+        index = grandparent;
+    }
+
+    data[index] = item;
+}
+
+/* Complexity: O(log n) */
+static void bubble_up(MinMaxHeap *mmheap, unsigned long index)
+{
+    unsigned long parent;
+    void **data;
+    int dir;
+
+    if(index == 0) {
+        return;
+    }
+
+    data = darray_data(mmheap->h);
+    dir = level_of(index);
+    parent = parent_of(index);
+
+    /* The parent sits on a level of the opposite direction */
+    if(beats(mmheap, data[index], data[parent], -dir)) {
+        swap(data, index, parent);
+        bubble_up_grandparents(mmheap, data, parent, -dir);
+    } else {
+        bubble_up_grandparents(mmheap, data, index, dir);
+    }
+}
+
+/* Complexity: O(log n) */
+static void trickle_down(MinMaxHeap *mmheap, unsigned long index)
+{
+    unsigned long size, child, grandchild, best, i, last;
+    void **data;
+    int dir;
+
+    data = darray_data(mmheap->h);
+    size = darray_size(mmheap->h);
+    dir = level_of(index);
+
+    for(;;) {
+        child = (2 * index) + 1;
+        if(child >= size) {
+            break;
+        }
+
+        /* Find the best of the (up to) two children and four
+         * grandchildren
+         */
+        best = child;
+        if(child + 1 < size && beats(mmheap, data[child + 1], data[best], dir)) {
+            best = child + 1;
+        }
+
+        grandchild = (4 * index) + 3;
+        last = grandchild + 4;
+        if(last > size) {
+            last = size;
+        }
+        for(i = grandchild; i < last; i++) {
+            if(beats(mmheap, data[i], data[best], dir)) {
+                best = i;
+            }
+        }
+
+        if(!beats(mmheap, data[best], data[index], dir)) {
+            break;
+        }
+
+        swap(data, index, best);
+
+        if(best < grandchild) {
+            /* A child has no descendants of its own to disturb */
+            break;
+        }
+
+        /* The displaced item may now be on the wrong side of the
+         * grandchild's parent, which sits on an opposite level.
+         */
+        if(beats(mmheap, data[parent_of(best)], data[best], dir)) {
+            swap(data, best, parent_of(best));
+        }
+
+        index = best;
+    }
+}
+
+/* Removes the item at index, which must be the minimum or the maximum */
+static void* mmheap_remove_index(MinMaxHeap *mmheap, unsigned long index)
+{
+    void **data, *ret, *last;
+
+    data = darray_data(mmheap->h);
+    ret = data[index];
+
+    last = darray_remove(mmheap->h, darray_size(mmheap->h) - 1);
+
+    if(index < darray_size(mmheap->h)) {
+        /* darray_remove may have shrunk the array */
+        data = darray_data(mmheap->h);
+        data[index] = last;
+        trickle_down(mmheap, index);
+    }
+
+    return ret;
+}
+
+/* Index of the maximum in a non-empty heap */
+static unsigned long mmheap_max_index(MinMaxHeap *mmheap)
+{
+    unsigned long size;
+    void **data;
+
+    data = darray_data(mmheap->h);
+    size = darray_size(mmheap->h);
+
+    if(size == 1) {
+        return 0;
+    }
+
+    if(size == 2 || mmheap->comparefn(data[1], data[2]) >= 0) {
+        return 1;
+    }
+
+    return 2;
+}
+
+MinMaxHeap* mmheap_create(CompareFn comparefn)
+{
+    MinMaxHeap *new_mmheap;
+
+    assert(comparefn != NULL);
+
+    new_mmheap = malloc(sizeof(struct _mmheap));
+    if(NULL == new_mmheap) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_mmheap->h = darray_create();
+    if(NULL == new_mmheap->h) {
+        fprintf(stderr, "MinMaxHeap creation failed (%s:%d)\n",
+                __FUNCTION__, __LINE__);
+        free(new_mmheap);
+        return NULL;
+    }
+
+    new_mmheap->comparefn = comparefn;
+
+    return new_mmheap;
+}
+
+/* Complexity: O(1) */
+void mmheap_free(MinMaxHeap *mmheap)
+{
+    assert(mmheap != NULL);
+
+    /* Only free heap container and darray container,
+     * not the data stored in the heap */
+    darray_free(mmheap->h);
+    free(mmheap);
+}
+
+/* Complexity: O(n) */
+void mmheap_free_all(MinMaxHeap *mmheap, FreeFn freefn)
+{
+    assert(mmheap != NULL);
+
+    /* Free heap and darray containers, and all data */
+    darray_free_all(mmheap->h, freefn);
+    free(mmheap);
+}
+
+/* Complexity: O(log n), worst-case */
+int mmheap_push(MinMaxHeap *mmheap, void *data)
+{
+    assert(mmheap != NULL);
+
+    if(darray_append(mmheap->h, data) < 0) {
+        return -1;
+    }
+
+    bubble_up(mmheap, darray_size(mmheap->h) - 1);
+
+    return 0;
+}
+
+/* Complexity: O(log n) */
+void* mmheap_pop_min(MinMaxHeap *mmheap)
+{
+    assert(mmheap != NULL);
+
+    if(mmheap_is_empty(mmheap)) {
+        return NULL;
+    }
+
+    return mmheap_remove_index(mmheap, 0);
+}
+
+/* Complexity: O(log n) */
+void* mmheap_pop_max(MinMaxHeap *mmheap)
+{
+    assert(mmheap != NULL);
+
+    if(mmheap_is_empty(mmheap)) {
+        return NULL;
+    }
+
+    return mmheap_remove_index(mmheap, mmheap_max_index(mmheap));
+}
+
+/* Complexity: O(1) */
+void* mmheap_top_min(MinMaxHeap *mmheap)
+{
+    assert(mmheap != NULL);
+
+    if(mmheap_is_empty(mmheap)) {
+        return NULL;
+    }
+
+    return darray_index(mmheap->h, 0);
+}
+
+/* Complexity: O(1) */
+void* mmheap_top_max(MinMaxHeap *mmheap)
+{
+    assert(mmheap != NULL);
+
+    if(mmheap_is_empty(mmheap)) {
+        return NULL;
+    }
+
+    return darray_index(mmheap->h, mmheap_max_index(mmheap));
+}
+
+/* Complexity: O(n)
+ *
+ * Checks every node against its parent and grandparent, which by
+ * transitivity covers all of its ancestors.
+ */
+int mmheap_is_valid(MinMaxHeap *mmheap)
+{
+    unsigned long i, size;
+    void **data;
+
+    assert(mmheap != NULL);
+
+    size = darray_size(mmheap->h);
+    if(size < 2) {
+        return 1;
+    }
+
+    data = darray_data(mmheap->h);
+
+    for(i = 1; i < size; i++) {
+        if(beats(mmheap, data[i], data[parent_of(i)],
+                    level_of(parent_of(i)))) {
+            return 0;
+        }
+
+        if(i > 2 && beats(mmheap, data[i], data[grandparent_of(i)],
+                    level_of(grandparent_of(i)))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Complexity: O(1) */
+int mmheap_is_empty(MinMaxHeap *mmheap)
+{
+    assert(mmheap != NULL);
+
+    return darray_is_empty(mmheap->h);
+}
+
+/* Complexity: O(1) */
+unsigned long mmheap_size(MinMaxHeap *mmheap)
+{
+    assert(mmheap != NULL);
+
+    return darray_size(mmheap->h);
+}
@@ -0,0 +1,687 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A persistent map, as a weight-balanced tree with path copying.
+ *
+ * Nodes are reference counted, and may be shared between any number of
+ * versions. A node referenced only once, from a node or PMap that is
+ * itself only referenced once, belongs to a single version, and is
+ * changed in place. Any other node on the path of an insertion or
+ * removal is copied first, along with the children that a rotation
+ * would change; the copy takes a reference to each child, and drops
+ * its reference to the original. A snapshot therefore costs one
+ * reference, and the following update copies the nodes on its path.
+ *
+ * Every node holds the size of its subtree. The weight of a subtree is
+ * its size plus one, and neither child of a node may outweigh the other
+ * by more than PMAP_DELTA times. When one does after an update, single
+ * or double rotations restore the balance, depending on PMAP_GAMMA
+ * (Hirai and Yamamoto's parameters). Subtree sizes also give rank and
+ * select in O(log n).
+ *
+ * Copies may be needed for every node on the path, and for two more at
+ * each level if it rotates, so enough spare nodes for that are put
+ * aside before an update starts. Updates thus never fail halfway.
+ * Nodes that an update frees in place become spares for the next one,
+ * up to what that update reserved; the rest are freed, so that memory
+ * follows the size of the map rather than its peak.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/persistent_map.h>
+
+#include "atomic.h"
+
+#define PMAP_DELTA  3
+#define PMAP_GAMMA  2
+
+struct _pmap_node {
+    unsigned long refs;
+    unsigned long size;
+    const void *key;
+    void *value;
+    struct _pmap_node *left;
+    struct _pmap_node *right;
+};
+
+struct _pmap {
+    struct _pmap_node *root;
+    CompareFn comparefn;
+
+    /* Nodes put aside for the next update, linked through left */
+    struct _pmap_node *spares;
+    unsigned long nspares;
+};
+
+static unsigned long _size(const struct _pmap_node *node)
+{
+    return (node != NULL) ? node->size : 0;
+}
+
+static void _update_size(struct _pmap_node *node)
+{
+    node->size = _size(node->left) + _size(node->right) + 1;
+}
+
+/* Complexity: O(k), for k the number of nodes needed */
+static int _reserve(PMap *map, unsigned long count)
+{
+    struct _pmap_node *node;
+
+    while(map->nspares < count) {
+        node = malloc(sizeof(struct _pmap_node));
+        if(NULL == node) {
+            fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+            return -1;
+        }
+
+        node->left = map->spares;
+        map->spares = node;
+        map->nspares++;
+    }
+
+    return 0;
+}
+
+/* Frees the spare nodes beyond count */
+static void _trim(PMap *map, unsigned long count)
+{
+    struct _pmap_node *node;
+
+    while(map->nspares > count) {
+        node = map->spares;
+        map->spares = node->left;
+        map->nspares--;
+        free(node);
+    }
+}
+
+/* Takes a spare node, with a single reference, and its children
+ * references moved into it
+ */
+static struct _pmap_node* _node(PMap *map, const void *key, void *value,
+        struct _pmap_node *left, struct _pmap_node *right)
+{
+    struct _pmap_node *node;
+
+    assert(map->nspares > 0);
+
+    node = map->spares;
+    map->spares = node->left;
+    map->nspares--;
+
+    node->refs = 1;
+    node->key = key;
+    node->value = value;
+    node->left = left;
+    node->right = right;
+    _update_size(node);
+
+    return node;
+}
+
+/* Frees a node that belongs to map, whose children references have
+ * been moved elsewhere
+ */
+static void _node_recycle(PMap *map, struct _pmap_node *node)
+{
+    node->left = map->spares;
+    map->spares = node;
+    map->nspares++;
+}
+
+static struct _pmap_node* _retain(struct _pmap_node *node)
+{
+    if(node != NULL) {
+        atomic_fetch_add(&node->refs, 1);
+    }
+
+    return node;
+}
+
+/* Drops a reference to node, freeing it and dropping its references to
+ * its children if it was the last one.
+ *
+ * Complexity: O(1) amortized
+ */
+static void _release(struct _pmap_node *node)
+{
+    struct _pmap_node *right;
+
+    while(node != NULL && atomic_fetch_sub(&node->refs, 1) == 1) {
+        _release(node->left);
+        right = node->right;
+        free(node);
+        node = right;
+    }
+}
+
+/* Returns node, or a copy of it if it is shared, in which case the
+ * reference to node is moved to the copy. Either way, the result
+ * belongs to map alone.
+ */
+static struct _pmap_node* _own(PMap *map, struct _pmap_node *node)
+{
+    struct _pmap_node *copy;
+
+    if(atomic_load_acquire(&node->refs) == 1) {
+        return node;
+    }
+
+    copy = _node(map, node->key, node->value, _retain(node->left),
+            _retain(node->right));
+    _release(node);
+
+    return copy;
+}
+
+static struct _pmap_node* _rotate_left(struct _pmap_node *node)
+{
+    struct _pmap_node *right = node->right;
+
+    node->right = right->left;
+    right->left = node;
+    _update_size(node);
+    _update_size(right);
+
+    return right;
+}
+
+static struct _pmap_node* _rotate_right(struct _pmap_node *node)
+{
+    struct _pmap_node *left = node->left;
+
+    node->left = left->right;
+    left->right = node;
+    _update_size(node);
+    _update_size(left);
+
+    return left;
+}
+
+/* Restores the balance of node, which belongs to map, after one of its
+ * subtrees gained or lost a node. Returns the new root of the subtree.
+ *
+ * Complexity: O(1)
+ */
+static struct _pmap_node* _balance(PMap *map, struct _pmap_node *node)
+{
+    unsigned long wl, wr;
+    struct _pmap_node *child;
+
+    wl = _size(node->left) + 1;
+    wr = _size(node->right) + 1;
+
+    if(PMAP_DELTA * wl < wr) {
+        child = node->right = _own(map, node->right);
+        if(_size(child->left) + 1 >= PMAP_GAMMA * (_size(child->right) + 1)) {
+            child->left = _own(map, child->left);
+            node->right = _rotate_right(child);
+        }
+        return _rotate_left(node);
+    }
+
+    if(PMAP_DELTA * wr < wl) {
+        child = node->left = _own(map, node->left);
+        if(_size(child->right) + 1 >= PMAP_GAMMA * (_size(child->left) + 1)) {
+            child->right = _own(map, child->right);
+            node->left = _rotate_left(child);
+        }
+        return _rotate_right(node);
+    }
+
+    return node;
+}
+
+/* key must not be in the tree yet */
+static struct _pmap_node* _insert(PMap *map, struct _pmap_node *node,
+        const void *key, void *value)
+{
+    if(NULL == node) {
+        return _node(map, key, value, NULL, NULL);
+    }
+
+    node = _own(map, node);
+    if(map->comparefn(key, node->key) < 0) {
+        node->left = _insert(map, node->left, key, value);
+    } else {
+        node->right = _insert(map, node->right, key, value);
+    }
+    node->size++;
+
+    return _balance(map, node);
+}
+
+/* Moves the smallest key and value of the tree to *key and *value */
+static struct _pmap_node* _remove_min(PMap *map, struct _pmap_node *node,
+        const void **key, void **value)
+{
+    struct _pmap_node *right;
+
+    node = _own(map, node);
+    if(NULL == node->left) {
+        *key = node->key;
+        *value = node->value;
+        right = node->right;
+        _node_recycle(map, node);
+        return right;
+    }
+
+    node->left = _remove_min(map, node->left, key, value);
+    node->size--;
+
+    return _balance(map, node);
+}
+
+/* key must be in the tree */
+static struct _pmap_node* _remove(PMap *map, struct _pmap_node *node,
+        const void *key, void **value)
+{
+    struct _pmap_node *child;
+    int cmp;
+
+    node = _own(map, node);
+    cmp = map->comparefn(key, node->key);
+
+    if(cmp < 0) {
+        node->left = _remove(map, node->left, key, value);
+    } else if(cmp > 0) {
+        node->right = _remove(map, node->right, key, value);
+    } else {
+        *value = node->value;
+
+        if(NULL == node->left || NULL == node->right) {
+            child = (node->left != NULL) ? node->left : node->right;
+            _node_recycle(map, node);
+            return child;
+        }
+
+        /* Replace the key with its successor */
+        node->right = _remove_min(map, node->right, &node->key,
+                &node->value);
+    }
+    node->size--;
+
+    return _balance(map, node);
+}
+
+/* Returns the node holding key, or NULL, and stores the number of nodes
+ * on the path to it, or to where it would go, in *depth
+ */
+static struct _pmap_node* _find(PMap *map, const void *key,
+        unsigned long *depth)
+{
+    struct _pmap_node *node;
+    int cmp;
+
+    *depth = 0;
+    for(node = map->root; node != NULL;
+            node = (cmp < 0) ? node->left : node->right) {
+        (*depth)++;
+
+        cmp = map->comparefn(key, node->key);
+        if(0 == cmp) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+/* Visits the entries of the subtree at node with keys in [lo, hi), in
+ * order, counting them in *n. Returns non-zero once fn has.
+ */
+static int _scan(PMap *map, struct _pmap_node *node, const void *lo,
+        const void *hi, PMapVisitFn fn, void *data, unsigned long *n)
+{
+    int above_lo, below_hi;
+
+    while(node != NULL) {
+        above_lo = (NULL == lo || map->comparefn(node->key, lo) >= 0);
+        below_hi = (NULL == hi || map->comparefn(node->key, hi) < 0);
+
+        if(above_lo) {
+            if(_scan(map, node->left, lo, hi, fn, data, n)) {
+                return 1;
+            }
+
+            if(below_hi) {
+                (*n)++;
+                if(fn(node->key, node->value, data)) {
+                    return 1;
+                }
+            }
+        }
+
+        if(!below_hi) {
+            break;
+        }
+        node = node->right;
+    }
+
+    return 0;
+}
+
+static long _pmap_is_valid(PMap *map, struct _pmap_node *node,
+        const void *lo, const void *hi)
+{
+    long nl, nr;
+
+    if(NULL == node) {
+        return 0;
+    }
+
+    if(atomic_load(&node->refs) == 0 ||
+            (lo != NULL && map->comparefn(node->key, lo) <= 0) ||
+            (hi != NULL && map->comparefn(node->key, hi) >= 0)) {
+        assert(0);
+        return -1;
+    }
+
+    nl = _pmap_is_valid(map, node->left, lo, node->key);
+    nr = _pmap_is_valid(map, node->right, node->key, hi);
+    if(nl < 0 || nr < 0) {
+        return -1;
+    }
+
+    if(node->size != (unsigned long)(nl + nr + 1) ||
+            PMAP_DELTA * (nl + 1) < nr + 1 ||
+            PMAP_DELTA * (nr + 1) < nl + 1) {
+        assert(0);
+        return -1;
+    }
+
+    return nl + nr + 1;
+}
+
+/* The greatest height of a balanced tree of size nodes. The heavier
+ * child of a node weighs at most PMAP_DELTA / (PMAP_DELTA + 1) of it.
+ */
+static unsigned long _max_height(unsigned long size)
+{
+    unsigned long weight = size + 1, height = 0;
+
+    while(weight > 1) {
+        weight = weight / (PMAP_DELTA + 1) * PMAP_DELTA +
+            weight % (PMAP_DELTA + 1) * PMAP_DELTA / (PMAP_DELTA + 1);
+        height++;
+    }
+
+    return height;
+}
+
+static PMap* _pmap_create(CompareFn comparefn, struct _pmap_node *root)
+{
+    PMap *new_map;
+
+    new_map = malloc(sizeof(struct _pmap));
+    if(NULL == new_map) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_map->root = root;
+    new_map->comparefn = comparefn;
+    new_map->spares = NULL;
+    new_map->nspares = 0;
+
+    return new_map;
+}
+
+/* Complexity: O(1) */
+PMap* pmap_create(CompareFn comparefn)
+{
+    assert(comparefn != NULL);
+
+    return _pmap_create(comparefn, NULL);
+}
+
+/* Complexity: O(1) */
+PMap* pmap_snapshot(PMap *map)
+{
+    PMap *snapshot;
+
+    assert(map != NULL);
+
+    snapshot = _pmap_create(map->comparefn, map->root);
+    if(snapshot != NULL) {
+        _retain(snapshot->root);
+    }
+
+    return snapshot;
+}
+
+/* Complexity: O(n) for the nodes that no other version shares */
+void pmap_free(PMap *map)
+{
+    struct _pmap_node *node;
+
+    assert(map != NULL);
+
+    _release(map->root);
+
+    while(map->spares != NULL) {
+        node = map->spares;
+        map->spares = node->left;
+        free(node);
+    }
+
+    free(map);
+}
+
+/* Keys are unique: returns -1 if key is already present, as well as
+ * when out of memory.
+ *
+ * Complexity: O(log n)
+ */
+int pmap_insert(PMap *map, const void *key, void *value)
+{
+    unsigned long depth;
+
+    assert(map != NULL);
+
+    if(_find(map, key, &depth) != NULL) {
+        return -1;
+    }
+
+    /* The new node, and up to three nodes per level on the path */
+    if(_reserve(map, 3 * depth + 1) != 0) {
+        return -1;
+    }
+
+    map->root = _insert(map, map->root, key, value);
+    _trim(map, 3 * depth + 1);
+
+    return 0;
+}
+
+/* Returns the value of the removed key, or NULL if key was not found or
+ * out of memory.
+ *
+ * Complexity: O(log n)
+ */
+void* pmap_remove(PMap *map, const void *key)
+{
+    struct _pmap_node *node;
+    unsigned long depth;
+    void *value = NULL;
+
+    assert(map != NULL);
+
+    node = _find(map, key, &depth);
+    if(NULL == node) {
+        return NULL;
+    }
+
+    /* The path goes on down to the successor */
+    if(node->left != NULL) {
+        for(node = node->right; node != NULL; node = node->left) {
+            depth++;
+        }
+    }
+
+    if(_reserve(map, 3 * depth) != 0) {
+        return NULL;
+    }
+
+    map->root = _remove(map, map->root, key, &value);
+    _trim(map, 3 * depth);
+
+    return value;
+}
+
+/* Complexity: O(log n) */
+void* pmap_get(PMap *map, const void *key)
+{
+    struct _pmap_node *node;
+    unsigned long depth;
+
+    assert(map != NULL);
+
+    node = _find(map, key, &depth);
+
+    return (node != NULL) ? node->value : NULL;
+}
+
+/* Complexity: O(log n) */
+int pmap_contains(PMap *map, const void *key)
+{
+    unsigned long depth;
+
+    assert(map != NULL);
+
+    return (_find(map, key, &depth) != NULL);
+}
+
+/* Complexity: O(1) */
+int pmap_is_empty(PMap *map)
+{
+    assert(map != NULL);
+
+    return (NULL == map->root);
+}
+
+/* Complexity: O(n) */
+int pmap_is_valid(PMap *map)
+{
+    assert(map != NULL);
+
+    if(_pmap_is_valid(map, map->root, NULL, NULL) < 0) {
+        return 0;
+    }
+
+    /* Spares never outnumber what the last update reserved, on a tree
+     * that may have had one more node
+     */
+    return (map->nspares <= 3 * _max_height(_size(map->root) + 1) + 1);
+}
+
+/* Complexity: O(1) */
+unsigned long pmap_size(PMap *map)
+{
+    assert(map != NULL);
+
+    return _size(map->root);
+}
+
+/* Returns the number of keys smaller than key.
+ *
+ * Complexity: O(log n)
+ */
+unsigned long pmap_rank(PMap *map, const void *key)
+{
+    struct _pmap_node *node;
+    unsigned long rank = 0;
+    int cmp;
+
+    assert(map != NULL);
+
+    node = map->root;
+    while(node != NULL) {
+        cmp = map->comparefn(key, node->key);
+        if(cmp <= 0) {
+            if(0 == cmp) {
+                return rank + _size(node->left);
+            }
+            node = node->left;
+        } else {
+            rank += _size(node->left) + 1;
+            node = node->right;
+        }
+    }
+
+    return rank;
+}
+
+/* Complexity: O(log n) */
+int pmap_select(PMap *map, unsigned long index, const void **key,
+        void **value)
+{
+    struct _pmap_node *node;
+
+    assert(map != NULL);
+
+    if(index >= _size(map->root)) {
+        return -1;
+    }
+
+    node = map->root;
+    while(index != _size(node->left)) {
+        if(index < _size(node->left)) {
+            node = node->left;
+        } else {
+            index -= _size(node->left) + 1;
+            node = node->right;
+        }
+    }
+
+    if(key != NULL) {
+        *key = node->key;
+    }
+    if(value != NULL) {
+        *value = node->value;
+    }
+
+    return 0;
+}
+
+/* Complexity: O(log n + k), for the k entries visited */
+unsigned long pmap_scan(PMap *map, const void *lo, const void *hi,
+        PMapVisitFn fn, void *data)
+{
+    unsigned long n = 0;
+
+    assert(map != NULL);
+    assert(fn != NULL);
+
+    _scan(map, map->root, lo, hi, fn, data, &n);
+
+    return n;
+}
@@ -31,16 +31,84 @@
 
 #include <libcore/priority_queue.h>
 #include <libcore/heap.h>
+#include <libcore/radix_heap.h>
+
+typedef enum {
+    PQUEUE_TYPE_HEAP,   /* Comparison-based, highest priority first */
+    PQUEUE_TYPE_RADIX   /* Monotone integer keys, smallest key first */
+} PQUEUE_TYPE;
 
 struct _pqueue {
+    PQUEUE_TYPE type;
     Heap *h;
+    RadixHeap *r;
 };
 
+static PQueue* pqueue_alloc(PQUEUE_TYPE type)
+{
+    PQueue *new_pqueue;
+
+    new_pqueue = malloc(sizeof(struct _pqueue));
+    if(NULL == new_pqueue) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_pqueue->type = type;
+    new_pqueue->h = NULL;
+    new_pqueue->r = NULL;
+
+    return new_pqueue;
+}
+
 PQueue* pqueue_create(CompareFn comparefn)
 {
+    return pqueue_create_dary(comparefn, 2);
+}
+
+/* Wider heaps trade a few extra comparisons per level for a much
+ * shallower tree. Supported arities are 2, 4, and 8.
+ */
+PQueue* pqueue_create_dary(CompareFn comparefn, unsigned int arity)
+{
+    PQueue *new_pqueue;
+
     assert(comparefn != NULL);
 
-    return (PQueue *)heap_create(comparefn);
+    new_pqueue = pqueue_alloc(PQUEUE_TYPE_HEAP);
+    if(NULL == new_pqueue) {
+        return NULL;
+    }
+
+    new_pqueue->h = heap_create_dary(comparefn, arity);
+    if(NULL == new_pqueue->h) {
+        free(new_pqueue);
+        return NULL;
+    }
+
+    return new_pqueue;
+}
+
+/* A pqueue backed by a radix heap. Items are pushed with
+ * pqueue_push_key and popped in increasing key order. Keys must never
+ * be smaller than the key of the most recently popped item.
+ */
+PQueue* pqueue_create_radix(void)
+{
+    PQueue *new_pqueue;
+
+    new_pqueue = pqueue_alloc(PQUEUE_TYPE_RADIX);
+    if(NULL == new_pqueue) {
+        return NULL;
+    }
+
+    new_pqueue->r = radix_heap_create();
+    if(NULL == new_pqueue->r) {
+        free(new_pqueue);
+        return NULL;
+    }
+
+    return new_pqueue;
 }
 
 /* Complexity: O(1) */
@@ -50,7 +118,13 @@ void pqueue_free(PQueue *pqueue)
 
     /* Only free pqueue container and heap container,
      * not the data stored in the pqueue */
-    heap_free((Heap *)pqueue);
+    if(PQUEUE_TYPE_RADIX == pqueue->type) {
+        radix_heap_free(pqueue->r);
+    } else {
+        heap_free(pqueue->h);
+    }
+
+    free(pqueue);
 }
 
 /* Complexity: O(n) */
@@ -59,31 +133,83 @@ void pqueue_free_all(PQueue *pqueue, FreeFn freefn)
     assert(pqueue != NULL);
 
     /* Free pqueue and heap containers, and all data */
-    heap_free_all((Heap *)pqueue, freefn);
+    if(PQUEUE_TYPE_RADIX == pqueue->type) {
+        radix_heap_free_all(pqueue->r, freefn);
+    } else {
+        heap_free_all(pqueue->h, freefn);
+    }
+
+    free(pqueue);
 }
 
-/* Complexity: O(log n), worst-case */
+/* Complexity: O(log n), worst-case
+ *
+ * Only valid for comparison-based pqueues.
+ */
 int pqueue_push(PQueue *pqueue, void *data)
 {
     assert(pqueue != NULL);
 
-    return heap_push((Heap *)pqueue, data);
+    if(pqueue->type != PQUEUE_TYPE_HEAP) {
+        return -1;
+    }
+
+    return heap_push(pqueue->h, data);
+}
+
+/* Complexity: O(1)
+ *
+ * Only valid for radix pqueues. Fails if key is smaller than the key
+ * of the most recently popped item.
+ */
+int pqueue_push_key(PQueue *pqueue, unsigned long key, void *data)
+{
+    assert(pqueue != NULL);
+
+    if(pqueue->type != PQUEUE_TYPE_RADIX) {
+        return -1;
+    }
+
+    return radix_heap_push(pqueue->r, key, data);
 }
 
-/* Complexity: O(log n) */
+/* Complexity: O(k) amortized; O(n + k), worst-case
+ *
+ * Only valid for comparison-based pqueues.
+ */
+int pqueue_push_many(PQueue *pqueue, DArray *items)
+{
+    assert(pqueue != NULL);
+
+    if(pqueue->type != PQUEUE_TYPE_HEAP) {
+        return -1;
+    }
+
+    return heap_push_many(pqueue->h, items);
+}
+
+/* Complexity: O(log n); O(log C) amortized for radix pqueues */
 void* pqueue_pop(PQueue *pqueue)
 {
     assert(pqueue != NULL);
 
-    return heap_pop((Heap *)pqueue);
+    if(PQUEUE_TYPE_RADIX == pqueue->type) {
+        return radix_heap_pop(pqueue->r, NULL);
+    }
+
+    return heap_pop(pqueue->h);
 }
 
-/* Complexity: O(1) */
+/* Complexity: O(1); see radix_heap_top for radix pqueues */
 void* pqueue_top(PQueue *pqueue)
 {
     assert(pqueue != NULL);
 
-    return heap_top((Heap *)pqueue);
+    if(PQUEUE_TYPE_RADIX == pqueue->type) {
+        return radix_heap_top(pqueue->r, NULL);
+    }
+
+    return heap_top(pqueue->h);
 }
 
 /* Complexity: O(1) */
@@ -91,7 +217,11 @@ int pqueue_is_empty(PQueue *pqueue)
 {
     assert(pqueue != NULL);
 
-    return heap_is_empty((Heap *)pqueue);
+    if(PQUEUE_TYPE_RADIX == pqueue->type) {
+        return radix_heap_is_empty(pqueue->r);
+    }
+
+    return heap_is_empty(pqueue->h);
 }
 
 /* Complexity: O(1) */
@@ -99,5 +229,9 @@ unsigned long pqueue_size(PQueue *pqueue)
 {
     assert(pqueue != NULL);
 
-    return heap_size((Heap *)pqueue);
+    if(PQUEUE_TYPE_RADIX == pqueue->type) {
+        return radix_heap_size(pqueue->r);
+    }
+
+    return heap_size(pqueue->h);
 }
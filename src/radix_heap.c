@@ -0,0 +1,364 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/radix_heap.h>
+
+#define RADIX_HEAP_BUCKET_MIN_SIZE  16
+#define RADIX_HEAP_NUM_BUCKETS      (sizeof(unsigned long) * CHAR_BIT + 1)
+
+struct _radix_heap_entry {
+    unsigned long key;
+    void *data;
+};
+
+struct _radix_heap_bucket {
+    struct _radix_heap_entry *entries;
+    unsigned long size;
+    unsigned long capacity;
+};
+
+/* Bucket i holds the entries whose key differs from last in bit i-1
+ * at the highest position, i.e. bucket 0 holds keys equal to last and
+ * bucket i holds keys in [last + 2^(i-1), last + 2^i) modulo the lower
+ * bits. Popping redistributes a single bucket into strictly lower
+ * buckets, so each entry moves at most once per bit of the key.
+ */
+struct _radix_heap {
+    struct _radix_heap_bucket buckets[RADIX_HEAP_NUM_BUCKETS];
+    unsigned long last;
+    unsigned long size;
+};
+
+/* Number of significant bits in x, i.e. 0 for 0 and
+ * floor(log2(x)) + 1 otherwise.
+ */
+static unsigned int bit_length(unsigned long x)
+{
+#if defined(__GNUC__)
+    return (x == 0) ? 0 :
+        (unsigned int)(sizeof(unsigned long) * CHAR_BIT - __builtin_clzl(x));
+#else
+    unsigned int n = 0;
+
+    while(x != 0) {
+        x >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+/* Grows b to hold at least count entries */
+static int bucket_reserve(struct _radix_heap_bucket *b, unsigned long count)
+{
+    struct _radix_heap_entry *new_entries;
+    unsigned long new_capacity;
+
+    if(count <= b->capacity) {
+        return 0;
+    }
+
+    new_capacity = b->capacity << 1;
+    if(new_capacity < RADIX_HEAP_BUCKET_MIN_SIZE) {
+        new_capacity = RADIX_HEAP_BUCKET_MIN_SIZE;
+    }
+    while(new_capacity < count) {
+        new_capacity <<= 1;
+    }
+
+    new_entries = realloc(b->entries,
+            sizeof(struct _radix_heap_entry) * new_capacity);
+    if(NULL == new_entries) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return -1;
+    }
+
+    b->entries = new_entries;
+    b->capacity = new_capacity;
+
+    return 0;
+}
+
+static int bucket_append(struct _radix_heap_bucket *b, unsigned long key,
+        void *data)
+{
+    if(bucket_reserve(b, b->size + 1) < 0) {
+        return -1;
+    }
+
+    b->entries[b->size].key = key;
+    b->entries[b->size].data = data;
+    b->size++;
+
+    return 0;
+}
+
+/* Makes bucket 0 non-empty, assuming the heap is not empty. Returns -1
+ * if out of memory, leaving the heap as it was.
+ *
+ * Complexity: O(log C) amortized
+ */
+static int radix_heap_pull(RadixHeap *rheap)
+{
+    unsigned long counts[RADIX_HEAP_NUM_BUCKETS];
+    struct _radix_heap_bucket *b, *dest;
+    struct _radix_heap_entry *e;
+    unsigned long i, j, min;
+
+    if(rheap->buckets[0].size > 0) {
+        return 0;
+    }
+
+    for(i = 1; rheap->buckets[i].size == 0; i++) {
+        assert(i < RADIX_HEAP_NUM_BUCKETS - 1);
+    }
+
+    b = &rheap->buckets[i];
+
+    min = b->entries[0].key;
+    for(j = 1; j < b->size; j++) {
+        if(b->entries[j].key < min) {
+            min = b->entries[j].key;
+        }
+    }
+
+    /* Every entry lands in a bucket below i, and those are all empty.
+     * They are grown first, so that nothing has moved if one can't be.
+     */
+    for(j = 0; j < i; j++) {
+        counts[j] = 0;
+    }
+    for(j = 0; j < b->size; j++) {
+        counts[bit_length(b->entries[j].key ^ min)]++;
+    }
+    for(j = 0; j < i; j++) {
+        if(bucket_reserve(&rheap->buckets[j], counts[j]) < 0) {
+            return -1;
+        }
+    }
+
+    rheap->last = min;
+
+    for(j = 0; j < b->size; j++) {
+        e = &b->entries[j];
+        dest = &rheap->buckets[bit_length(e->key ^ min)];
+        dest->entries[dest->size++] = *e;
+    }
+
+    b->size = 0;
+
+    return 0;
+}
+
+RadixHeap* radix_heap_create(void)
+{
+    RadixHeap *new_rheap;
+    unsigned long i;
+
+    new_rheap = malloc(sizeof(struct _radix_heap));
+    if(NULL == new_rheap) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    for(i = 0; i < RADIX_HEAP_NUM_BUCKETS; i++) {
+        new_rheap->buckets[i].entries = NULL;
+        new_rheap->buckets[i].size = 0;
+        new_rheap->buckets[i].capacity = 0;
+    }
+
+    new_rheap->last = 0;
+    new_rheap->size = 0;
+
+    return new_rheap;
+}
+
+/* Complexity: O(1) */
+void radix_heap_free(RadixHeap *rheap)
+{
+    unsigned long i;
+
+    assert(rheap != NULL);
+
+    /* Only free the container, not the data stored in the heap */
+    for(i = 0; i < RADIX_HEAP_NUM_BUCKETS; i++) {
+        free(rheap->buckets[i].entries);
+    }
+
+    free(rheap);
+}
+
+/* Complexity: O(n) */
+void radix_heap_free_all(RadixHeap *rheap, FreeFn freefn)
+{
+    unsigned long i, j;
+    struct _radix_heap_bucket *b;
+
+    assert(rheap != NULL);
+
+    if(NULL == freefn) {
+        /* Default to stdlib free */
+        freefn = (FreeFn)free;
+    }
+
+    for(i = 0; i < RADIX_HEAP_NUM_BUCKETS; i++) {
+        b = &rheap->buckets[i];
+        for(j = 0; j < b->size; j++) {
+            if(b->entries[j].data != NULL) {
+                freefn(b->entries[j].data);
+            }
+        }
+    }
+
+    radix_heap_free(rheap);
+}
+
+/* Complexity: O(1)
+ *
+ * Fails if key is smaller than the most recently popped key.
+ */
+int radix_heap_push(RadixHeap *rheap, unsigned long key, void *data)
+{
+    assert(rheap != NULL);
+
+    if(key < rheap->last) {
+        return -1;
+    }
+
+    if(bucket_append(&rheap->buckets[bit_length(key ^ rheap->last)],
+                key, data) < 0) {
+        return -1;
+    }
+
+    rheap->size++;
+
+    return 0;
+}
+
+/* Complexity: O(log C) amortized
+ *
+ * Removes and returns the data with the smallest key. If key is not
+ * NULL, the key of the removed entry is stored there. Returns NULL,
+ * leaving the heap as it was, if out of memory.
+ */
+void* radix_heap_pop(RadixHeap *rheap, unsigned long *key)
+{
+    struct _radix_heap_bucket *b;
+
+    assert(rheap != NULL);
+
+    if(radix_heap_is_empty(rheap)) {
+        return NULL;
+    }
+
+    if(radix_heap_pull(rheap) < 0) {
+        return NULL;
+    }
+
+    b = &rheap->buckets[0];
+    b->size--;
+    rheap->size--;
+
+    if(key != NULL) {
+        *key = b->entries[b->size].key;
+    }
+
+    return b->entries[b->size].data;
+}
+
+/* Leaves the buckets alone: redistributing here would move last up to
+ * the minimum, and reject pushes below it before anything is popped.
+ * Among equal keys this finds the entry that pop would return.
+ *
+ * Complexity: O(log C + b), for b entries in the lowest bucket in use
+ */
+void* radix_heap_top(RadixHeap *rheap, unsigned long *key)
+{
+    struct _radix_heap_bucket *b;
+    unsigned long i, j, min;
+
+    assert(rheap != NULL);
+
+    if(radix_heap_is_empty(rheap)) {
+        return NULL;
+    }
+
+    for(i = 0; rheap->buckets[i].size == 0; i++) {
+        assert(i < RADIX_HEAP_NUM_BUCKETS - 1);
+    }
+
+    b = &rheap->buckets[i];
+
+    /* Bucket 0 holds only keys equal to last */
+    min = b->size - 1;
+    if(i > 0) {
+        for(j = 0; j < b->size; j++) {
+            if(b->entries[j].key <= b->entries[min].key) {
+                min = j;
+            }
+        }
+    }
+
+    if(key != NULL) {
+        *key = b->entries[min].key;
+    }
+
+    return b->entries[min].data;
+}
+
+/* Complexity: O(1) */
+int radix_heap_is_empty(RadixHeap *rheap)
+{
+    assert(rheap != NULL);
+
+    return (rheap->size == 0);
+}
+
+/* Complexity: O(1) */
+unsigned long radix_heap_size(RadixHeap *rheap)
+{
+    assert(rheap != NULL);
+
+    return rheap->size;
+}
+
+/* Complexity: O(1)
+ *
+ * Returns the lower bound for keys that may still be pushed.
+ */
+unsigned long radix_heap_last(RadixHeap *rheap)
+{
+    assert(rheap != NULL);
+
+    return rheap->last;
+}
@@ -26,34 +26,128 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <libcore/darray.h>
+#include <libcore/macros.h>
 #include <libcore/rbtree.h>
 
 typedef enum {RED, BLACK} _node_color;
 
+/* Nodes are at least 8-byte aligned, so the low bits of the parent
+ * pointer are free to hold the color and the flags below. With the
+ * value stored inline, value holds the bytes of the value itself.
+ *
+ * The tree is threaded: a node with no left child links to its
+ * predecessor in iteration order instead, and one with no right child
+ * to its successor, with the low bit of the link set to tell the two
+ * apart. The first and last nodes thread to NULL. Iteration thus
+ * follows links both ways without a word of its own, and a node takes
+ * 48 bytes on LP64 targets. The five pointer-sized fields before size
+ * take 40 bytes on their own, so no layout with a parent link gets
+ * down to 32.
+ */
 struct _rbtree_node {
-    _node_color color;
-    struct _rbtree_node *parent, *left, *right;
+    unsigned long parent_flags;
+
+    /* Children, or threads; see left_of and right_of */
+    struct _rbtree_node *left, *right;
+
     const void *key;
     void *value;
+
+    /* Number of nodes in the subtree rooted at this node */
+    unsigned long size;
+};
+
+/* Nodes of blocks taken out of a tree, kept for reuse by later
+ * insertions into it. They are linked through right.
+ */
+struct _rbtree_spares {
+    struct _rbtree_node *first, *last;
 };
 
 struct _rbtree {
-    /* TODO: maintain pointers to min and max nodes
-     * to make iterator begin and end operations O(1)
-     */
     struct _rbtree_node *root;
+
+    /* First and last nodes in iteration order, or NULL if empty */
+    struct _rbtree_node *min, *max;
+
     CompareFn comparefn;
     unsigned long size;
+
+    /* Blocks this tree may hold nodes from, in order of address, or
+     * NULL
+     */
+    DArray *blocks;
+    struct _rbtree_spares spares;
+
+    /* Size of the values stored inline in the nodes, or 0 if values
+     * are pointers. removed holds the last value taken out of a node.
+     */
+    unsigned long value_size;
+    void *removed;
 };
 
+/* Nodes allocated together by rbtree_create_from_sorted. Joins and
+ * splits move nodes between trees, so a block is shared by every tree
+ * that may hold its nodes, and freed with the last of them. Until
+ * then, its nodes are reused rather than freed.
+ */
+struct _rbtree_block {
+    unsigned long refs;
+    struct _rbtree_node *nodes;
+};
+
+/* Parallel set operations stop spawning threads below this size */
+#define RBTREE_PARALLEL_GRAIN   4096
+
+/* Lookups interleaved by rbtree_find_many */
+#define RBTREE_FIND_GROUP       8
+
 /* The insert and delete algorithms are based on those in
  * "Introduction to Algorithms" by Cormen, Leiserson, and
- * Rivest (MIT Press, 1990).
+ * Rivest (MIT Press, 1990). Nodes are augmented with subtree
+ * sizes for order-statistic queries, as described in the same
+ * book.
  */
 
+/* Color bit of parent_flags: clear for RED, set for BLACK */
+#define RB_BLACK            1UL
+
+/* Allocated as part of a block by rbtree_create_from_sorted */
+#define RB_IN_BLOCK         2UL
+
+/* The value is stored inline; see rbtree_create_inline */
+#define RB_INLINE           4UL
+
+#define RB_FLAGS            7UL
+
+#define parent_of(x)        ((struct _rbtree_node *)((x)->parent_flags & ~RB_FLAGS))
+#define set_parent(x, p)    ((x)->parent_flags = \
+                                (unsigned long)(p) | ((x)->parent_flags & RB_FLAGS))
+#define color_of(x)         ((_node_color)((x)->parent_flags & RB_BLACK))
+#define set_color(x, c)     ((x)->parent_flags = \
+                                ((x)->parent_flags & ~RB_BLACK) | (unsigned long)(c))
+#define in_block(x)         ((x)->parent_flags & RB_IN_BLOCK)
+#define is_inline(x)        ((x)->parent_flags & RB_INLINE)
+
+/* Low bit of a left or right link that is a thread */
+#define RB_THREAD           1UL
+
+#define is_thread(l)        ((unsigned long)(l) & RB_THREAD)
+#define thread_to(x)        ((struct _rbtree_node *) \
+                                ((unsigned long)(x) | RB_THREAD))
+#define thread_target(l)    ((struct _rbtree_node *) \
+                                ((unsigned long)(l) & ~RB_THREAD))
+#define left_of(x)          (is_thread((x)->left) ? NULL : (x)->left)
+#define right_of(x)         (is_thread((x)->right) ? NULL : (x)->right)
+
+#define subtree_size(x)     ((x) != NULL ? (x)->size : 0)
+
 static int _rbtree_is_valid(RBTree *rbtree, struct _rbtree_node *node)
 {
     unsigned long black_height_left, black_height_right;
@@ -61,8 +155,8 @@ static int _rbtree_is_valid(RBTree *rbtree, struct _rbtree_node *node)
     if(NULL == node) {
         return 1;
     } else {
-        black_height_left = _rbtree_is_valid(rbtree, node->left);
-        black_height_right = _rbtree_is_valid(rbtree, node->right);
+        black_height_left = _rbtree_is_valid(rbtree, left_of(node));
+        black_height_right = _rbtree_is_valid(rbtree, right_of(node));
 
         if(black_height_left == 0 || black_height_right == 0) {
             assert(0);
@@ -77,13 +171,21 @@ static int _rbtree_is_valid(RBTree *rbtree, struct _rbtree_node *node)
             return 0;
         }
 
+        /* Subtree sizes are consistent */
+        if(node->size != subtree_size(left_of(node)) +
+                subtree_size(right_of(node)) + 1) {
+            assert(0);
+            return 0;
+        }
+
         /* Every RED node has BLACK children */
-        if(RED == node->color) {
-            if((node->left != NULL) && (BLACK != node->left->color)) {
+        if(RED == color_of(node)) {
+            if((left_of(node) != NULL) && (BLACK != color_of(left_of(node)))) {
                 assert(0);
                 return 0;
             }
-            if((node->right != NULL) && (BLACK != node->right->color)) {
+            if((right_of(node) != NULL) &&
+                    (BLACK != color_of(right_of(node)))) {
                 assert(0);
                 return 0;
             }
@@ -92,7 +194,7 @@ static int _rbtree_is_valid(RBTree *rbtree, struct _rbtree_node *node)
         }
 
         /* Every node is either red or black */
-        if(node->color != BLACK) {
+        if(color_of(node) != BLACK) {
             assert(0);
             return 0;
         }
@@ -104,13 +206,13 @@ static int _rbtree_is_valid(RBTree *rbtree, struct _rbtree_node *node)
          * we only test if the left child's key is > the current node's
          * key.
          */
-        if((node->left != NULL) &&
-                (rbtree->comparefn(node->key, node->left->key) < 0)) {
+        if((left_of(node) != NULL) &&
+                (rbtree->comparefn(node->key, left_of(node)->key) < 0)) {
             assert(0);
             return 0;
         }
-        if((node->right != NULL) &&
-                (rbtree->comparefn(node->key, node->right->key) > 0)) {
+        if((right_of(node) != NULL) &&
+                (rbtree->comparefn(node->key, right_of(node)->key) > 0)) {
             assert(0);
             return 0;
         }
@@ -133,113 +235,125 @@ static void _rotate_left(RBTree *rbtree, struct _rbtree_node *x)
 {
     struct _rbtree_node *y;
 
-    assert(x->right != NULL);
+    assert(right_of(x) != NULL);
 
     y = x->right;
 
-    /* y's left subtree becomes node's right subtree */
-    x->right = y->left;
-    if(y->left != NULL) {
-        y->left->parent = x;
+    /* y's left subtree becomes node's right subtree. If it is empty, y
+     * comes right after x, which threads to it.
+     */
+    if(is_thread(y->left)) {
+        x->right = thread_to(y);
+    } else {
+        x->right = y->left;
+        set_parent(y->left, x);
     }
 
     /* Link x's parent to y */
-    y->parent = x->parent;
+    set_parent(y, parent_of(x));
 
     if(x == rbtree->root) {
         rbtree->root = y;
-    } else if(x == x->parent->left) {
-        x->parent->left = y;
+    } else if(x == parent_of(x)->left) {
+        parent_of(x)->left = y;
     } else {
-        x->parent->right = y;
+        parent_of(x)->right = y;
     }
 
     y->left = x;
-    x->parent = y;
+    set_parent(x, y);
+
+    y->size = x->size;
+    x->size = subtree_size(left_of(x)) + subtree_size(right_of(x)) + 1;
 }
 
 static void _rotate_right(RBTree *rbtree, struct _rbtree_node *y)
 {
     struct _rbtree_node *x;
 
-    assert(y->left != NULL);
+    assert(left_of(y) != NULL);
 
     x = y->left;
 
-    /* x's right subtree becomes y's left subtree */
-    y->left = x->right;
-    if(x->right != NULL) {
-        x->right->parent = y;
+    /* x's right subtree becomes y's left subtree, or a thread to x */
+    if(is_thread(x->right)) {
+        y->left = thread_to(x);
+    } else {
+        y->left = x->right;
+        set_parent(x->right, y);
     }
 
     /* Link y's parent to x */
-    x->parent = y->parent;
+    set_parent(x, parent_of(y));
 
     if(y == rbtree->root) {
         rbtree->root = x;
-    } else if(y == y->parent->left) {
-        y->parent->left = x;
+    } else if(y == parent_of(y)->left) {
+        parent_of(y)->left = x;
     } else {
-        y->parent->right = x;
+        parent_of(y)->right = x;
     }
 
     x->right = y;
-    y->parent = x;
+    set_parent(y, x);
+
+    x->size = y->size;
+    y->size = subtree_size(left_of(y)) + subtree_size(right_of(y)) + 1;
 }
 
-#define grandparent_of(x)   (x)->parent->parent
+#define grandparent_of(x)   parent_of(parent_of(x))
 
 static void _insert_fixup(RBTree *rbtree, struct _rbtree_node *node)
 {
     struct _rbtree_node *uncle;
 
-    while((node != rbtree->root) && (RED == node->parent->color)) {
-        if(node->parent == grandparent_of(node)->left) {
-            uncle = grandparent_of(node)->right;
+    while((node != rbtree->root) && (RED == color_of(parent_of(node)))) {
+        if(parent_of(node) == left_of(grandparent_of(node))) {
+            uncle = right_of(grandparent_of(node));
 
-            if((uncle != NULL) && (RED == uncle->color)) {
+            if((uncle != NULL) && (RED == color_of(uncle))) {
                 /* Case 1 */
-                node->parent->color = BLACK;
-                uncle->color = BLACK;
-                grandparent_of(node)->color = RED;
+                set_color(parent_of(node), BLACK);
+                set_color(uncle, BLACK);
+                set_color(grandparent_of(node), RED);
                 node = grandparent_of(node);
             } else {
-                if(node == node->parent->right) {
+                if(node == right_of(parent_of(node))) {
                     /* Case 2 */
-                    node = node->parent;
+                    node = parent_of(node);
                     _rotate_left(rbtree, node);
                 }
 
                 /* Case 3 */
-                node->parent->color = BLACK;
-                grandparent_of(node)->color = RED;
+                set_color(parent_of(node), BLACK);
+                set_color(grandparent_of(node), RED);
                 _rotate_right(rbtree, grandparent_of(node));
             }
         } else {
-            uncle = grandparent_of(node)->left;
+            uncle = left_of(grandparent_of(node));
 
-            if((uncle != NULL) && (RED == uncle->color)) {
+            if((uncle != NULL) && (RED == color_of(uncle))) {
                 /* Case 1 */
-                node->parent->color = BLACK;
-                uncle->color = BLACK;
-                grandparent_of(node)->color = RED;
+                set_color(parent_of(node), BLACK);
+                set_color(uncle, BLACK);
+                set_color(grandparent_of(node), RED);
                 node = grandparent_of(node);
             } else {
-                if(node == node->parent->left) {
+                if(node == left_of(parent_of(node))) {
                     /* Case 2 */
-                    node = node->parent;
+                    node = parent_of(node);
                     _rotate_right(rbtree, node);
                 }
 
                 /* Case 3 */
-                node->parent->color = BLACK;
-                grandparent_of(node)->color = RED;
+                set_color(parent_of(node), BLACK);
+                set_color(grandparent_of(node), RED);
                 _rotate_left(rbtree, grandparent_of(node));
             }
         }
     }
 
-    rbtree->root->color = BLACK;
+    set_color(rbtree->root, BLACK);
 }
 
 static void _remove_fixup(RBTree *rbtree, struct _rbtree_node *node,
@@ -247,82 +361,84 @@ static void _remove_fixup(RBTree *rbtree, struct _rbtree_node *node,
 {
     struct _rbtree_node *w;
 
-    while((node != rbtree->root) && ((node == NULL) || (BLACK == node->color))) {
+    while((node != rbtree->root) && ((node == NULL) || (BLACK == color_of(node)))) {
         assert(node_parent != NULL);
-        if(node == node_parent->left) {
-            w = node_parent->right;
+        if(node == left_of(node_parent)) {
+            w = right_of(node_parent);
             assert(w != NULL);
 
-            if(RED == w->color) {
+            if(RED == color_of(w)) {
                 /* Case 1 */
-                w->color = BLACK;
-                node_parent->color = RED;
+                set_color(w, BLACK);
+                set_color(node_parent, RED);
                 _rotate_left(rbtree, node_parent);
-                w = node_parent->right;
+                w = right_of(node_parent);
             }
 
             assert(w != NULL);
-            if(((w->left == NULL) || (BLACK == w->left->color)) &&
-                    ((w->right == NULL ) || (BLACK == w->right->color))) {
+            if(((left_of(w) == NULL) || (BLACK == color_of(left_of(w)))) &&
+                    ((right_of(w) == NULL ) ||
+                     (BLACK == color_of(right_of(w))))) {
                 /* Case 2 */
-                w->color = RED;
+                set_color(w, RED);
                 node = node_parent;
-                node_parent = node_parent->parent;
+                node_parent = parent_of(node_parent);
             } else {
-                if((w->right == NULL) || (BLACK == w->right->color)) {
+                if((right_of(w) == NULL) || (BLACK == color_of(right_of(w)))) {
                     /* Case 3 */
-                    assert(w->left != NULL);
-                    w->left->color = BLACK;
-                    w->color = RED;
+                    assert(left_of(w) != NULL);
+                    set_color(left_of(w), BLACK);
+                    set_color(w, RED);
                     _rotate_right(rbtree, w);
-                    w = node_parent->right;
+                    w = right_of(node_parent);
                     assert(w != NULL);
                 }
 
                 /* Case 4 */
-                w->color = node_parent->color;
-                node_parent->color = BLACK;
-                if(w->right != NULL) {
-                    w->right->color = BLACK;
+                set_color(w, color_of(node_parent));
+                set_color(node_parent, BLACK);
+                if(right_of(w) != NULL) {
+                    set_color(right_of(w), BLACK);
                 }
                 _rotate_left(rbtree, node_parent);
                 node = rbtree->root;
             }
         } else {
-            w = node_parent->left;
+            w = left_of(node_parent);
             assert(w != NULL);
 
-            if(RED == w->color) {
+            if(RED == color_of(w)) {
                 /* Case 1 */
-                w->color = BLACK;
-                node_parent->color = RED;
+                set_color(w, BLACK);
+                set_color(node_parent, RED);
                 _rotate_right(rbtree, node_parent);
-                w = node_parent->left;
+                w = left_of(node_parent);
             }
 
             assert(w != NULL);
-            if(((w->left == NULL) || (BLACK == w->left->color)) &&
-                    ((w->right == NULL ) || (BLACK == w->right->color))) {
+            if(((left_of(w) == NULL) || (BLACK == color_of(left_of(w)))) &&
+                    ((right_of(w) == NULL ) ||
+                     (BLACK == color_of(right_of(w))))) {
                 /* Case 2 */
-                w->color = RED;
+                set_color(w, RED);
                 node = node_parent;
-                node_parent = node_parent->parent;
+                node_parent = parent_of(node_parent);
             } else {
-                if((w->left == NULL) || (BLACK == w->left->color)) {
+                if((left_of(w) == NULL) || (BLACK == color_of(left_of(w)))) {
                     /* Case 3 */
-                    assert(w->right != NULL);
-                    w->right->color = BLACK;
-                    w->color = RED;
+                    assert(right_of(w) != NULL);
+                    set_color(right_of(w), BLACK);
+                    set_color(w, RED);
                     _rotate_left(rbtree, w);
-                    w = node_parent->left;
+                    w = left_of(node_parent);
                     assert(w != NULL);
                 }
 
                 /* Case 4 */
-                w->color = node_parent->color;
-                node_parent->color = BLACK;
-                if(w->left != NULL) {
-                    w->left->color = BLACK;
+                set_color(w, color_of(node_parent));
+                set_color(node_parent, BLACK);
+                if(left_of(w) != NULL) {
+                    set_color(left_of(w), BLACK);
                 }
                 _rotate_right(rbtree, node_parent);
                 node = rbtree->root;
@@ -331,14 +447,14 @@ static void _remove_fixup(RBTree *rbtree, struct _rbtree_node *node,
     }
 
     if(node != NULL) {
-        node->color = BLACK;
+        set_color(node, BLACK);
     }
 }
 
 static struct _rbtree_node* _tree_minimum(struct _rbtree_node *node)
 {
-    while(node->left != NULL) {
-        node = node->left;
+    while(left_of(node) != NULL) {
+        node = left_of(node);
     }
 
     return node;
@@ -346,35 +462,283 @@ static struct _rbtree_node* _tree_minimum(struct _rbtree_node *node)
 
 static struct _rbtree_node* _tree_maximum(struct _rbtree_node *node)
 {
-    while(node->right != NULL) {
-        node = node->right;
+    while(right_of(node) != NULL) {
+        node = right_of(node);
     }
 
     return node;
 }
 
+/* Successor of node found from the shape of the tree alone */
+static struct _rbtree_node* _tree_successor(struct _rbtree_node *node)
+{
+    struct _rbtree_node *parent;
+
+    if(right_of(node) != NULL) {
+        return _tree_minimum(right_of(node));
+    }
+
+    /* Successor is the lowest ancestor of node whose left child is
+     * also an ancestor of node. Go up the tree until we find a node
+     * that is the left child of its parent.
+     */
+    parent = parent_of(node);
+    while((parent != NULL) && (node == right_of(parent))) {
+        node = parent;
+        parent = parent_of(parent);
+    }
+
+    return parent;
+}
+
+/* Finds the first and last nodes of a tree put together by joins and
+ * splits, and ends the threads at them.
+ */
+static void _rbtree_find_ends(RBTree *rbtree)
+{
+    if(NULL == rbtree->root) {
+        rbtree->min = rbtree->max = NULL;
+        return;
+    }
+
+    rbtree->min = _tree_minimum(rbtree->root);
+    rbtree->max = _tree_maximum(rbtree->root);
+    rbtree->min->left = thread_to(NULL);
+    rbtree->max->right = thread_to(NULL);
+}
+
+static void _spares_push(struct _rbtree_spares *spares,
+        struct _rbtree_node *node)
+{
+    node->right = spares->first;
+    if(NULL == spares->first) {
+        spares->last = node;
+    }
+    spares->first = node;
+}
+
+/* Moves every node of from onto to */
+static void _spares_concat(struct _rbtree_spares *to,
+        struct _rbtree_spares *from)
+{
+    if(NULL == from->first) {
+        return;
+    }
+
+    from->last->right = to->first;
+    if(NULL == to->first) {
+        to->last = from->last;
+    }
+    to->first = from->first;
+    from->first = from->last = NULL;
+}
+
+/* Nodes from a block go on spares, if it is not NULL, and are
+ * otherwise released with the block.
+ */
+static void _rbtree_free_node(struct _rbtree_spares *spares,
+        struct _rbtree_node *node)
+{
+    if(!in_block(node)) {
+        free(node);
+    } else if(spares != NULL) {
+        _spares_push(spares, node);
+    }
+}
+
+/* Gives to a reference to every block of from that it does not
+ * already hold. Both lists of blocks are in order of address, so they
+ * are merged.
+ *
+ * Complexity: O(b1 + b2), for trees holding b1 and b2 blocks
+ */
+static int _rbtree_share_blocks(RBTree *from, RBTree *to)
+{
+    struct _rbtree_block *block;
+    DArray *merged;
+    void **from_data, **to_data;
+    unsigned long i, j, from_size, to_size;
+
+    if(NULL == from->blocks) {
+        return 0;
+    }
+
+    merged = darray_create();
+    if(NULL == merged) {
+        return -1;
+    }
+
+    from_data = darray_data(from->blocks);
+    from_size = darray_size(from->blocks);
+    to_data = (to->blocks != NULL) ? darray_data(to->blocks) : NULL;
+    to_size = (to->blocks != NULL) ? darray_size(to->blocks) : 0;
+
+    i = j = 0;
+    while(i < from_size || j < to_size) {
+        if(j == to_size || (i < from_size &&
+                    (unsigned long)from_data[i] < (unsigned long)to_data[j])) {
+            block = from_data[i++];
+        } else {
+            if(i < from_size && from_data[i] == to_data[j]) {
+                i++;
+            }
+            block = to_data[j++];
+        }
+
+        if(darray_append(merged, block) < 0) {
+            darray_free(merged);
+            return -1;
+        }
+    }
+
+    /* The blocks of to are in merged in the same order */
+    for(i = j = 0; i < darray_size(merged); i++) {
+        block = darray_index(merged, i);
+        if(j < to_size && to_data[j] == block) {
+            j++;
+        } else {
+            block->refs++;
+        }
+    }
+
+    darray_free(to->blocks);
+    to->blocks = merged;
+
+    return 0;
+}
+
+static void _rbtree_release_blocks(RBTree *rbtree)
+{
+    struct _rbtree_block *block;
+    unsigned long i;
+
+    if(NULL == rbtree->blocks) {
+        return;
+    }
+
+    for(i = 0; i < darray_size(rbtree->blocks); i++) {
+        block = darray_index(rbtree->blocks, i);
+        if(--block->refs == 0) {
+            free(block->nodes);
+            free(block);
+        }
+    }
+
+    darray_free(rbtree->blocks);
+    rbtree->blocks = NULL;
+}
+
+static struct _rbtree_node* _rbtree_node_create(RBTree *rbtree,
+        const void *key, void *value)
+{
+    struct _rbtree_node *node;
+
+    node = rbtree->spares.first;
+    if(node != NULL) {
+        rbtree->spares.first = node->right;
+        node->parent_flags = RED | RB_IN_BLOCK;
+    } else {
+        node = malloc(sizeof(struct _rbtree_node));
+        if(NULL == node) {
+            fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__,
+                    __LINE__);
+            return NULL;
+        }
+        node->parent_flags = RED;
+    }
+
+    node->key = key;
+    node->value = value;
+    node->left = node->right = thread_to(NULL);
+    node->size = 1;
+
+    if(rbtree->value_size > 0) {
+        node->parent_flags |= RB_INLINE;
+        if(value != NULL) {
+            memcpy(&node->value, value, rbtree->value_size);
+        }
+    }
+
+    return node;
+}
+
+/* Returns the value of node, copying an inline one out to
+ * rbtree->removed first so that it outlives the node.
+ */
+static void* _rbtree_take_value(RBTree *rbtree, struct _rbtree_node *node)
+{
+    if(!is_inline(node)) {
+        return node->value;
+    }
+
+    memcpy(&rbtree->removed, &node->value, rbtree->value_size);
+
+    return &rbtree->removed;
+}
+
+/* Links node in as the left child of parent if result < 0, and as its
+ * right child otherwise, then rebalances. parent is NULL only for the
+ * first node of the tree.
+ */
+static void _rbtree_link(RBTree *rbtree, struct _rbtree_node *node,
+        struct _rbtree_node *parent, int result)
+{
+    struct _rbtree_node *y;
+
+    set_parent(node, parent);
+
+    /* Thread node in. As a left child it comes right before its
+     * parent, and takes over the parent's thread to its predecessor;
+     * as a right child, it comes right after it.
+     */
+    if(NULL == parent) {
+        rbtree->root = node;
+        node->left = node->right = thread_to(NULL);
+        rbtree->min = rbtree->max = node;
+    } else if(result < 0) {
+        node->left = parent->left;
+        node->right = thread_to(parent);
+        parent->left = node;
+        if(parent == rbtree->min) {
+            rbtree->min = node;
+        }
+    } else {
+        node->left = thread_to(parent);
+        node->right = parent->right;
+        parent->right = node;
+        if(parent == rbtree->max) {
+            rbtree->max = node;
+        }
+    }
+
+    /* The insertion point may have been found starting from a hint
+     * rather than the root, so walk back up to account for the new node
+     * in every ancestor.
+     */
+    for(y = parent_of(node); y != NULL; y = parent_of(y)) {
+        y->size++;
+    }
+
+    /* Rebalance */
+    _insert_fixup(rbtree, node);
+
+    rbtree->size++;
+}
+
 static struct _rbtree_node* _rbtree_insert(RBTree *rbtree,
         struct _rbtree_node *x, const void *key, void *value,
         int duplicates_allowed)
 {
     struct _rbtree_node *node, *y;
-    int result;
+    int result = 0;
 
-    node = malloc(sizeof(struct _rbtree_node));
+    node = _rbtree_node_create(rbtree, key, value);
     if(NULL == node) {
-        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
         return NULL;
     }
 
-    node->color = RED;
-    node->key = key;
-    node->value = value;
-    node->parent = node->left = node->right = NULL;
-
-    if(NULL == rbtree->root) {
-        rbtree->root = node;
-    } else {
-        y = NULL;
+    y = NULL;
+    if(rbtree->root != NULL) {
         if(NULL == x) {
             x = rbtree->root;
         }
@@ -384,179 +748,767 @@ static struct _rbtree_node* _rbtree_insert(RBTree *rbtree,
             y = x;
             result = rbtree->comparefn(node->key, x->key);
             if(result < 0) {
-                x = x->left;
+                x = left_of(x);
             } else {
                 if(result == 0 && !duplicates_allowed) {
-                    free(node);
+                    _rbtree_free_node(&rbtree->spares, node);
                     return NULL;
                 }
-                x = x->right;
+                x = right_of(x);
             }
         }
-
-        node->parent = y;
-
-        if(NULL == y) {
-            rbtree->root = node;
-        } else if(result < 0) {
-            y->left = node;
-        } else {
-            y->right = node;
-        }
     }
 
-    /* Rebalance */
-    _insert_fixup(rbtree, node);
-
-    rbtree->size++;
+    _rbtree_link(rbtree, node, y, result);
 
     return node;
 }
 
 static void* _rbtree_remove(RBTree *rbtree, struct _rbtree_node *z)
 {
-    struct _rbtree_node *x, *x_parent, *y;
+    struct _rbtree_node *x, *x_parent, *y, *y_parent;
     _node_color y_color;
     void *ret;
 
-    x_parent = NULL;
-
-    if(NULL == z->left || NULL == z->right) {
-        /* z has at most one child */
-        y = z;
-    } else {
-        /* z has two children. Successor, y, has no left child */
-        y = rbtree_next(z);
+    if(z == rbtree->min) {
+        rbtree->min = rbtree_next(z);
     }
-
-    /* x is the child of y */
-    if(y->left != NULL) {
-        x = y->left;
-    } else {
-        x = y->right;
+    if(z == rbtree->max) {
+        rbtree->max = rbtree_prev(z);
     }
 
-    /* Splice out y, where y is either the node to be deleted,
-     * or it's successor
-     */
-    if(x != NULL) {
-        x->parent = y->parent;
-        x_parent = y->parent;
-    }
+    if(is_thread(z->left) || is_thread(z->right)) {
+        /* z has at most one child, x, which takes its place */
+        y = z;
+        x = (left_of(z) != NULL) ? left_of(z) : right_of(z);
+        x_parent = parent_of(z);
+
+        /* The node of x's subtree next to z threads past it */
+        if(x != NULL) {
+            set_parent(x, x_parent);
+            if(x == z->left) {
+                _tree_maximum(x)->right = z->right;
+            } else {
+                _tree_minimum(x)->left = z->left;
+            }
+        }
 
-    if(NULL == y->parent) {
-        /* y is the root node, so y's child has become the root */
-        rbtree->root = x;
-    } else {
-        /* Fix up y's parent to point to its new child, x */
-        if(y->parent->left == y) {
-            y->parent->left = x;
+        if(NULL == x_parent) {
+            rbtree->root = x;
+        } else if(x_parent->left == z) {
+            x_parent->left = (x != NULL) ? x : z->left;
         } else {
-            y->parent->right = x;
+            x_parent->right = (x != NULL) ? x : z->right;
         }
-    }
+    } else {
+        /* z has two children. Its successor, y, has no left child, and
+         * takes z's place, so z's predecessor threads to y instead.
+         */
+        y = _tree_minimum(z->right);
+        x = right_of(y);
+        _tree_maximum(z->left)->right = thread_to(y);
 
-    /* y is the successor of z, so it needs to be
-     * relinked in place of z
-     */
-    if(y != z) {
         /* Relink the successor, y, into the place of z
          * rather than copying over the contents of
          * the node (as described in Cormen, et al.).
          * This approach invalidates only those iterators
          * that refer to the deleted node.
          */
-        if(NULL == x) {
-            if(z != y->parent) {
-                x_parent = y->parent;
-            } else {
-                x_parent = y;
+        if(parent_of(y) == z) {
+            x_parent = y;
+        } else {
+            /* Splice y out, leaving x, or a thread to y, in its place */
+            x_parent = parent_of(y);
+            x_parent->left = (x != NULL) ? x : thread_to(y);
+            if(x != NULL) {
+                set_parent(x, x_parent);
             }
+
+            y->right = z->right;
+            set_parent(z->right, y);
         }
 
-        y->parent = z->parent;
         y->left = z->left;
-        y->right = z->right;
+        set_parent(z->left, y);
+
+        set_parent(y, parent_of(z));
+        if(NULL == parent_of(z)) {
+            /* z is the root. Update container to point to y */
+            rbtree->root = y;
+        } else if(parent_of(z)->left == z) {
+            parent_of(z)->left = y;
+        } else {
+            parent_of(z)->right = y;
+        }
+
+        y_color = color_of(y);
+        set_color(y, color_of(z));
+        set_color(z, y_color);
+
+        y->size = z->size;
+
+        y = z;
+    }
+
+    rbtree->size--;
+
+    /* Every node from the removal point up to the root lost one
+     * descendant. This must be done before rotating in the fixup.
+     */
+    for(y_parent = x_parent; y_parent != NULL;
+            y_parent = parent_of(y_parent)) {
+        y_parent->size--;
+    }
+
+    if(BLACK == color_of(y)) {
+        _remove_fixup(rbtree, x, x_parent);
+    }
+
+    ret = _rbtree_take_value(rbtree, z);
+    _rbtree_free_node(&rbtree->spares, z);
 
-        if(z->left != NULL) {
-            z->left->parent = y;
+    return ret;
+}
+
+/* Frees the nodes of a subtree, and their values too if freefn is not
+ * NULL. Nodes from blocks go on spares; see _rbtree_free_node.
+ */
+static void _rbtree_free_all(struct _rbtree_node *node, FreeFn freefn,
+        struct _rbtree_spares *spares)
+{
+    if(NULL != node) {
+        _rbtree_free_all(left_of(node), freefn, spares);
+        _rbtree_free_all(right_of(node), freefn, spares);
+        if(freefn != NULL && !is_inline(node)) {
+            freefn(node->value);
         }
-        if(z->right != NULL) {
-            z->right->parent = y;
+        _rbtree_free_node(spares, node);
+    }
+}
+
+/* Builds a perfectly balanced subtree over the sorted range [lo, hi),
+ * placing the node for position i at nodes[i]. Nodes on the deepest
+ * level are red, all others black, so that every path to a leaf has
+ * the same number of black nodes whether or not that level is full.
+ * Nodes thread to their neighbors in nodes, the last one past its end;
+ * see _rbtree_find_ends.
+ *
+ * Complexity: O(hi - lo) in time, O(log(hi - lo)) in space
+ */
+static struct _rbtree_node* _rbtree_build(struct _rbtree_node *nodes,
+        void **keys, void **values, unsigned long lo, unsigned long hi,
+        struct _rbtree_node *parent, unsigned long depth,
+        unsigned long red_depth)
+{
+    struct _rbtree_node *node;
+    unsigned long mid;
+
+    if(lo >= hi) {
+        return NULL;
+    }
+
+    mid = lo + (hi - lo) / 2;
+    node = &nodes[mid];
+
+    node->parent_flags = (unsigned long)parent | RB_IN_BLOCK;
+    set_color(node, (depth == red_depth && depth > 0) ? RED : BLACK);
+    node->key = keys[mid];
+    node->value = (values != NULL) ? values[mid] : keys[mid];
+    node->size = hi - lo;
+
+    node->left = _rbtree_build(nodes, keys, values, lo, mid, node,
+            depth + 1, red_depth);
+    if(NULL == node->left) {
+        node->left = thread_to((mid > 0) ? node - 1 : NULL);
+    }
+    node->right = _rbtree_build(nodes, keys, values, mid + 1, hi, node,
+            depth + 1, red_depth);
+    if(NULL == node->right) {
+        node->right = thread_to(node + 1);
+    }
+
+    return node;
+}
+
+/* Number of black nodes on any path from node down to a leaf */
+static unsigned long _black_height(struct _rbtree_node *node)
+{
+    unsigned long height = 0;
+
+    for(; node != NULL; node = left_of(node)) {
+        if(BLACK == color_of(node)) {
+            height++;
         }
+    }
 
-        if(NULL != z->parent) {
-            /* z is not the root. */
-            if(z->parent->left == z) {
-                z->parent->left = y;
-            } else {
-                z->parent->right = y;
+    return height;
+}
+
+/* Makes left and right the subtrees of x. On a side left empty, x
+ * keeps its thread, or threads past the end if it had a child there.
+ *
+ * Complexity: O(1)
+ */
+static void _set_subtrees(struct _rbtree_node *x, struct _rbtree_node *left,
+        struct _rbtree_node *right)
+{
+    if(left != NULL) {
+        x->left = left;
+        set_parent(left, x);
+    } else if(!is_thread(x->left)) {
+        x->left = thread_to(NULL);
+    }
+    if(right != NULL) {
+        x->right = right;
+        set_parent(right, x);
+    } else if(!is_thread(x->right)) {
+        x->right = thread_to(NULL);
+    }
+    x->size = subtree_size(left) + subtree_size(right) + 1;
+}
+
+/* Joins the subtrees rooted at left and right, with x between them.
+ * Every key in left must be <= x's key, and every key in right >= it.
+ * Returns the new root.
+ *
+ * The root of the taller tree's spine is followed down to a black node
+ * with the same black height as the shorter tree, which x replaces as
+ * a red node with the two as its children. Any red-red violation this
+ * causes is fixed up as after an insertion. The last node of left and
+ * the first node of right must already thread to x; see _thread.
+ *
+ * Complexity: O(|black height of left - black height of right| + 1)
+ */
+static struct _rbtree_node* _join(struct _rbtree_node *left,
+        struct _rbtree_node *x, struct _rbtree_node *right)
+{
+    struct _rbtree_node *c, *p, *a;
+    unsigned long left_height, right_height, height;
+    struct _rbtree tmp;
+
+    /* Any root may be recolored black */
+    if(left != NULL) {
+        set_parent(left, NULL);
+        set_color(left, BLACK);
+    }
+    if(right != NULL) {
+        set_parent(right, NULL);
+        set_color(right, BLACK);
+    }
+
+    left_height = _black_height(left);
+    right_height = _black_height(right);
+
+    if(left_height == right_height) {
+        set_color(x, BLACK);
+        set_parent(x, NULL);
+        _set_subtrees(x, left, right);
+
+        return x;
+    }
+
+    p = NULL;
+    if(left_height > right_height) {
+        /* Walk down the right spine of left */
+        for(c = left, height = left_height;
+                c != NULL && (RED == color_of(c) || height > right_height);
+                c = right_of(c)) {
+            if(BLACK == color_of(c)) {
+                height--;
             }
+            p = c;
+        }
+
+        _set_subtrees(x, c, right);
+        if(NULL == c) {
+            /* p is the last node of left */
+            x->left = thread_to(p);
+        }
+        p->right = x;
+        tmp.root = left;
+    } else {
+        /* Walk down the left spine of right */
+        for(c = right, height = right_height;
+                c != NULL && (RED == color_of(c) || height > left_height);
+                c = left_of(c)) {
+            if(BLACK == color_of(c)) {
+                height--;
+            }
+            p = c;
+        }
+
+        _set_subtrees(x, left, c);
+        if(NULL == c) {
+            /* p is the first node of right */
+            x->right = thread_to(p);
+        }
+        p->left = x;
+        tmp.root = right;
+    }
+
+    set_color(x, RED);
+    set_parent(x, p);
+
+    for(a = p; a != NULL; a = parent_of(a)) {
+        a->size = subtree_size(left_of(a)) + subtree_size(right_of(a)) + 1;
+    }
+
+    _insert_fixup(&tmp, x);
+
+    return tmp.root;
+}
+
+/* Threads the last node of left and the first node of right to x, and
+ * x back to them, before joining subtrees that were not next to each
+ * other. With x NULL, left and right are threaded to each other. Joins
+ * that keep nodes in their original order, as in splits, need none.
+ *
+ * Complexity: O(log n)
+ */
+static void _thread(struct _rbtree_node *left, struct _rbtree_node *x,
+        struct _rbtree_node *right)
+{
+    struct _rbtree_node *last, *first;
+
+    last = (left != NULL) ? _tree_maximum(left) : NULL;
+    first = (right != NULL) ? _tree_minimum(right) : NULL;
+    if(x != NULL) {
+        x->left = thread_to(last);
+        x->right = thread_to(first);
+        last = first = x;
+    }
+    if(left != NULL) {
+        _tree_maximum(left)->right = thread_to(first);
+    }
+    if(right != NULL) {
+        _tree_minimum(right)->left = thread_to(last);
+    }
+}
+
+/* Splits the subtree rooted at node into the keys less than key and
+ * the keys greater than key. A node whose key equals key is set aside
+ * in *match, which is left unchanged if there is none.
+ *
+ * Complexity: O(log n)
+ */
+static void _split(CompareFn comparefn, struct _rbtree_node *node,
+        const void *key, struct _rbtree_node **less,
+        struct _rbtree_node **greater, struct _rbtree_node **match)
+{
+    struct _rbtree_node *left, *right, *middle;
+    int result;
+
+    if(NULL == node) {
+        *less = *greater = NULL;
+        return;
+    }
+
+    left = left_of(node);
+    right = right_of(node);
+    if(left != NULL) {
+        set_parent(left, NULL);
+    }
+    if(right != NULL) {
+        set_parent(right, NULL);
+    }
+
+    result = comparefn(key, node->key);
+    if(result == 0) {
+        node->left = node->right = thread_to(NULL);
+        set_parent(node, NULL);
+        node->size = 1;
+        *less = left;
+        *greater = right;
+        *match = node;
+    } else if(result < 0) {
+        _split(comparefn, left, key, less, &middle, match);
+        *greater = _join(middle, node, right);
+    } else {
+        _split(comparefn, right, key, &middle, greater, match);
+        *less = _join(left, node, middle);
+    }
+}
+
+/* Removes the last node of the subtree rooted at node into *last, and
+ * returns the root of what remains.
+ *
+ * Complexity: O(log n)
+ */
+static struct _rbtree_node* _split_last(struct _rbtree_node *node,
+        struct _rbtree_node **last)
+{
+    struct _rbtree_node *left, *right;
+
+    left = left_of(node);
+    right = right_of(node);
+    if(left != NULL) {
+        set_parent(left, NULL);
+    }
+
+    if(NULL == right) {
+        node->left = thread_to(NULL);
+        set_parent(node, NULL);
+        node->size = 1;
+        *last = node;
+        return left;
+    }
+
+    set_parent(right, NULL);
+    right = _split_last(right, last);
+    if(NULL == right) {
+        /* node is now the last one before *last */
+        node->right = thread_to(*last);
+    }
+
+    return _join(left, node, right);
+}
+
+/* Joins two subtrees without a node between them */
+static struct _rbtree_node* _join2(struct _rbtree_node *left,
+        struct _rbtree_node *right)
+{
+    struct _rbtree_node *last;
+
+    if(NULL == left) {
+        return right;
+    }
+    if(NULL == right) {
+        return left;
+    }
+
+    left = _split_last(left, &last);
+
+    return _join(left, last, right);
+}
+
+typedef enum {
+    RBTREE_SET_UNION,
+    RBTREE_SET_INTERSECT,
+    RBTREE_SET_DIFF
+} RBTREE_SET_OP;
+
+struct _rbtree_set_op {
+    RBTREE_SET_OP op;
+    CompareFn comparefn;
+    FreeFn freefn;
+    unsigned int nthreads;
+
+    struct _rbtree_node *t1, *t2, *result;
+
+    /* Block nodes left out of the result. Each thread keeps its own,
+     * and they are gathered once it is done.
+     */
+    struct _rbtree_spares spares;
+};
+
+/* Frees a node that does not make it into a result */
+static void _drop_node(struct _rbtree_set_op *op, struct _rbtree_node *node)
+{
+    if(op->freefn != NULL && !is_inline(node)) {
+        op->freefn(node->value);
+    }
+    _rbtree_free_node(&op->spares, node);
+}
+
+static void _rbtree_set_op(struct _rbtree_set_op *op);
+
+static void* _rbtree_set_op_thread(void *arg)
+{
+    _rbtree_set_op(arg);
+
+    return NULL;
+}
+
+/* Divide and conquer over the root of one tree, the pivot: the other
+ * tree is split by the pivot's key, both halves are combined
+ * recursively, in parallel while there are threads to spare, and the
+ * results are joined back together. With m <= n the sizes of the
+ * smaller and larger trees, this is O(m log(n/m + 1)) work.
+ */
+static void _rbtree_set_op(struct _rbtree_set_op *op)
+{
+    struct _rbtree_set_op sub[2];
+    struct _rbtree_node *pivot, *other, *less, *greater, *match;
+    pthread_t thread;
+    int i, threaded;
+
+    /* Base cases */
+    if(NULL == op->t1 || NULL == op->t2) {
+        if(RBTREE_SET_UNION == op->op) {
+            op->result = (op->t1 != NULL) ? op->t1 : op->t2;
+        } else if(RBTREE_SET_DIFF == op->op) {
+            op->result = op->t1;
+            _rbtree_free_all(op->t2, op->freefn, &op->spares);
         } else {
-            /* z is the root. Update container to point to y */
-            rbtree->root = y;
+            op->result = NULL;
+            _rbtree_free_all(op->t1, op->freefn, &op->spares);
+            _rbtree_free_all(op->t2, op->freefn, &op->spares);
         }
+        return;
+    }
 
-        y_color = y->color;
-        y->color = z->color;
-        z->color = y_color;
+    /* The values of t1 are the ones kept, so a difference pivots on t2
+     * and splits t1 instead.
+     */
+    if(RBTREE_SET_DIFF == op->op) {
+        pivot = op->t2;
+        other = op->t1;
+    } else {
+        pivot = op->t1;
+        other = op->t2;
+    }
 
-        y = z;
+    match = NULL;
+    _split(op->comparefn, other, pivot->key, &less, &greater, &match);
+
+    for(i = 0; i < 2; i++) {
+        sub[i] = *op;
+        sub[i].spares.first = sub[i].spares.last = NULL;
+        if(RBTREE_SET_DIFF == op->op) {
+            sub[i].t1 = (0 == i) ? less : greater;
+            sub[i].t2 = (0 == i) ? left_of(pivot) : right_of(pivot);
+        } else {
+            sub[i].t1 = (0 == i) ? left_of(pivot) : right_of(pivot);
+            sub[i].t2 = (0 == i) ? less : greater;
+        }
+        if(sub[i].t1 != NULL) {
+            set_parent(sub[i].t1, NULL);
+        }
+        if(sub[i].t2 != NULL) {
+            set_parent(sub[i].t2, NULL);
+        }
+    }
+
+    threaded = 0;
+    if(op->nthreads > 1 && subtree_size(op->t1) + subtree_size(op->t2) >=
+            RBTREE_PARALLEL_GRAIN) {
+        sub[0].nthreads = op->nthreads / 2;
+        sub[1].nthreads = op->nthreads - sub[0].nthreads;
+        threaded = (pthread_create(&thread, NULL, _rbtree_set_op_thread,
+                    &sub[0]) == 0);
+    }
+
+    if(!threaded) {
+        _rbtree_set_op(&sub[0]);
+    }
+    _rbtree_set_op(&sub[1]);
+    if(threaded) {
+        pthread_join(thread, NULL);
+    }
+    _spares_concat(&op->spares, &sub[0].spares);
+    _spares_concat(&op->spares, &sub[1].spares);
+
+    set_parent(pivot, NULL);
+
+    if(RBTREE_SET_UNION == op->op) {
+        if(match != NULL) {
+            _drop_node(op, match);
+        }
+        _thread(sub[0].result, pivot, sub[1].result);
+        op->result = _join(sub[0].result, pivot, sub[1].result);
+    } else if(RBTREE_SET_INTERSECT == op->op) {
+        if(match != NULL) {
+            _drop_node(op, match);
+            _thread(sub[0].result, pivot, sub[1].result);
+            op->result = _join(sub[0].result, pivot, sub[1].result);
+        } else {
+            _drop_node(op, pivot);
+            _thread(sub[0].result, NULL, sub[1].result);
+            op->result = _join2(sub[0].result, sub[1].result);
+        }
     } else {
-        if(NULL == x) {
-            x_parent = y->parent;
+        if(match != NULL) {
+            _drop_node(op, match);
         }
+        _drop_node(op, pivot);
+        _thread(sub[0].result, NULL, sub[1].result);
+        op->result = _join2(sub[0].result, sub[1].result);
+    }
+}
+
+static RBTree* rbtree_set_op(RBTREE_SET_OP set_op, RBTree *rbtree1,
+        RBTree *rbtree2, unsigned int nthreads, FreeFn freefn)
+{
+    struct _rbtree_set_op op;
+
+    assert(rbtree1 != NULL);
+    assert(rbtree2 != NULL);
+    assert(rbtree1->comparefn == rbtree2->comparefn);
+    assert(rbtree1->value_size == rbtree2->value_size);
+
+    if(_rbtree_share_blocks(rbtree2, rbtree1) < 0) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
     }
 
-    rbtree->size--;
+    op.op = set_op;
+    op.comparefn = rbtree1->comparefn;
+    op.freefn = freefn;
+    op.nthreads = nthreads;
+    op.t1 = rbtree1->root;
+    op.t2 = rbtree2->root;
+    op.spares.first = op.spares.last = NULL;
+
+    _rbtree_set_op(&op);
+
+    rbtree1->root = op.result;
+    rbtree1->size = subtree_size(op.result);
+    _rbtree_find_ends(rbtree1);
+    if(op.result != NULL) {
+        set_color(op.result, BLACK);
+    }
+    _spares_concat(&rbtree1->spares, &op.spares);
+    _spares_concat(&rbtree1->spares, &rbtree2->spares);
 
-    if(BLACK == y->color) {
-        _remove_fixup(rbtree, x, x_parent);
+    _rbtree_release_blocks(rbtree2);
+    free(rbtree2);
+
+    return rbtree1;
+}
+
+
+RBTree* rbtree_create(CompareFn comparefn)
+{
+    RBTree *new_rbtree;
+
+    assert(comparefn != NULL);
+
+    /* RBTree container */
+    new_rbtree = malloc(sizeof(struct _rbtree));
+    if(NULL == new_rbtree) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
     }
 
-    ret = z->value;
-    free(z);
+    new_rbtree->root = NULL;
+    new_rbtree->comparefn = comparefn;
+    new_rbtree->size = 0;
+    new_rbtree->min = new_rbtree->max = NULL;
+    new_rbtree->blocks = NULL;
+    new_rbtree->spares.first = new_rbtree->spares.last = NULL;
+    new_rbtree->value_size = 0;
 
-    return ret;
+    return new_rbtree;
 }
 
-static void _rbtree_free_all(struct _rbtree_node *node, FreeFn freefn)
-{
-    if(NULL != node) {
-        _rbtree_free_all(node->left, freefn);
-        _rbtree_free_all(node->right, freefn);
-        freefn(node->value);
-        free(node);
+/* Creates a tree that stores values of value_size bytes, at most the
+ * size of a pointer, in the nodes themselves. Values are passed in and
+ * out by address: insertions copy the value_size bytes value points
+ * to, and rbtree_get_value returns the address of the copy in the
+ * node. Values returned by removals and rbtree_set_value are only
+ * valid until the next of those on the tree. free_all passes no
+ * values to freefn.
+ *
+ * Complexity: O(1)
+ */
+RBTree* rbtree_create_inline(CompareFn comparefn, unsigned long value_size)
+{
+    RBTree *new_rbtree;
+
+    assert(value_size > 0 && value_size <= sizeof(void *));
+
+    new_rbtree = rbtree_create(comparefn);
+    if(new_rbtree != NULL) {
+        new_rbtree->value_size = value_size;
+    }
+
+    return new_rbtree;
+}
+
+/* Builds a tree from keys sorted in iteration order, i.e. ascending
+ * according to comparefn. Note that this is the reverse of the order
+ * produced by darray_sort; call darray_reverse on a darray sorted that
+ * way first. If duplicates_allowed is 0, the keys must be strictly
+ * ascending.
+ *
+ * values holds the value for each key, at the same index. If it is
+ * NULL, each key is also its own value. Neither darray is modified or
+ * kept by the tree.
+ *
+ * Returns NULL if the keys are out of order, or the darrays differ in
+ * size.
+ *
+ * Complexity: O(n)
+ */
+RBTree* rbtree_create_from_sorted(CompareFn comparefn, const DArray *keys,
+        const DArray *values, int duplicates_allowed)
+{
+    struct _rbtree_block *block;
+    RBTree *new_rbtree;
+    void **key_data, **value_data;
+    unsigned long i, n, red_depth;
+    int result;
+
+    assert(comparefn != NULL);
+    assert(keys != NULL);
+
+    n = darray_size(keys);
+    key_data = darray_data(keys);
+    value_data = (values != NULL) ? darray_data(values) : NULL;
+
+    if(values != NULL && darray_size(values) != n) {
+        fprintf(stderr, "Keys and values differ in size (%s:%d)\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
     }
-}
 
+    for(i = 1; i < n; i++) {
+        result = comparefn(key_data[i - 1], key_data[i]);
+        if(result > 0 || (result == 0 && !duplicates_allowed)) {
+            fprintf(stderr, "Keys are not sorted (%s:%d)\n",
+                    __FUNCTION__, __LINE__);
+            return NULL;
+        }
+    }
 
-RBTree* rbtree_create(CompareFn comparefn)
-{
-    RBTree *new_rbtree;
+    new_rbtree = rbtree_create(comparefn);
+    if(NULL == new_rbtree || 0 == n) {
+        return new_rbtree;
+    }
 
-    assert(comparefn != NULL);
+    block = malloc(sizeof(struct _rbtree_block));
+    if(NULL == block) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        free(new_rbtree);
+        return NULL;
+    }
 
-    /* RBTree container */
-    new_rbtree = malloc(sizeof(struct _rbtree));
-    if(NULL == new_rbtree) {
+    block->refs = 1;
+    block->nodes = malloc(sizeof(struct _rbtree_node) * n);
+    new_rbtree->blocks = darray_create();
+    if(NULL == block->nodes || NULL == new_rbtree->blocks ||
+            darray_append(new_rbtree->blocks, block) < 0) {
         fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        darray_free(new_rbtree->blocks);
+        free(block->nodes);
+        free(block);
+        free(new_rbtree);
         return NULL;
     }
 
-    new_rbtree->root = NULL;
-    new_rbtree->comparefn = comparefn;
-    new_rbtree->size = 0;
+    /* Depth of the deepest level, floor(log2(n)) */
+    for(red_depth = 0, i = n; i > 1; i >>= 1) {
+        red_depth++;
+    }
+
+    new_rbtree->root = _rbtree_build(block->nodes, key_data, value_data,
+            0, n, NULL, 0, red_depth);
+    new_rbtree->size = n;
+
+    _rbtree_find_ends(new_rbtree);
 
     return new_rbtree;
 }
 
-/* Complexity: O(1) */
+/* Complexity: O(n) in time, O(log n) in space */
 void rbtree_free(RBTree *rbtree)
 {
     assert(rbtree != NULL);
 
     /* Free container and nodes only */
+    _rbtree_free_all(rbtree->root, NULL, NULL);
+
+    _rbtree_release_blocks(rbtree);
     free(rbtree);
 }
 
@@ -571,8 +1523,9 @@ void rbtree_free_all(RBTree *rbtree, FreeFn freefn)
     }
 
     /* Free container, nodes, keys, and values */
-    _rbtree_free_all(rbtree->root, freefn);
+    _rbtree_free_all(rbtree->root, freefn, NULL);
 
+    _rbtree_release_blocks(rbtree);
     free(rbtree);
 }
 
@@ -606,6 +1559,53 @@ int rbtree_insert_unique(RBTree *rbtree, const void *key, void *value)
     return ret;
 }
 
+/* Returns the node with key, inserting it with value first if there is
+ * none, in a single descent. *inserted, if not NULL, tells which
+ * happened. If the tree holds duplicates of key, any one of them may be
+ * returned. Returns NULL if out of memory.
+ *
+ * Complexity: O(log n)
+ */
+RBTreeIterator* rbtree_find_or_insert(RBTree *rbtree, const void *key,
+        void *value, int *inserted)
+{
+    struct _rbtree_node *node, *x, *y;
+    int result = 0;
+
+    assert(rbtree != NULL);
+
+    if(inserted != NULL) {
+        *inserted = 0;
+    }
+
+    y = NULL;
+    x = rbtree->root;
+    while(x != NULL) {
+        y = x;
+        result = rbtree->comparefn(key, x->key);
+        if(result < 0) {
+            x = left_of(x);
+        } else if(result > 0) {
+            x = right_of(x);
+        } else {
+            return x;
+        }
+    }
+
+    node = _rbtree_node_create(rbtree, key, value);
+    if(NULL == node) {
+        return NULL;
+    }
+
+    _rbtree_link(rbtree, node, y, result);
+
+    if(inserted != NULL) {
+        *inserted = 1;
+    }
+
+    return node;
+}
+
 /* Complexity: O(log n) */
 void* rbtree_remove(RBTree *rbtree, const void *key)
 {
@@ -633,26 +1633,38 @@ int rbtree_is_empty(RBTree *rbtree)
 /* Complexity: O(2n) in time, O(log n) in space */
 int rbtree_is_valid(RBTree *rbtree)
 {
-    RBTreeIterator *it, *prev;
+    RBTreeIterator *it, *prev, *next;
 
     assert(rbtree != NULL);
 
     if(rbtree_is_empty(rbtree)) {
-        return 1;
-    } else {
-        it = prev = NULL;
-        for(it = rbtree_begin(rbtree); it != NULL; it = rbtree_next(it)); {
-            if(prev != NULL) {
-                if(rbtree->comparefn(prev->key, it->key) > 0) {
-                    assert(0);
-                    return 0;
-                }
+        return (NULL == rbtree->min && NULL == rbtree->max);
+    }
+
+    /* The threads run through the nodes in order, both ways */
+    if(rbtree->min != _tree_minimum(rbtree->root) ||
+            rbtree->max != _tree_maximum(rbtree->root)) {
+        assert(0);
+        return 0;
+    }
+
+    prev = NULL;
+    for(it = rbtree->min; it != NULL; it = next) {
+        next = _tree_successor(it);
+        if(rbtree_next(it) != next || rbtree_prev(it) != prev) {
+            assert(0);
+            return 0;
+        }
+        if(prev != NULL) {
+            if(rbtree->comparefn(prev->key, it->key) > 0) {
+                assert(0);
+                return 0;
             }
-            prev = it;
         }
+        prev = it;
     }
 
-    if(rbtree->root->parent != NULL) {
+    if(parent_of(rbtree->root) != NULL) {
         assert(0);
         return 0;
     }
@@ -783,10 +1795,29 @@ void* rbtree_remove_at(RBTree *rbtree, RBTreeIterator *it)
     return _rbtree_remove(rbtree, it);
 }
 
+/* Tree could contain duplicates of the key of node. If so, returns the
+ * left-most one.
+ */
+static struct _rbtree_node* _leftmost_equal(RBTree *rbtree,
+        struct _rbtree_node *node, const void *key)
+{
+    struct _rbtree_node *save;
+
+    do {
+        save = node;
+        node = left_of(node);
+        while((node != NULL) && (rbtree->comparefn(key, node->key) != 0)) {
+            node = right_of(node);
+        }
+    } while(node != NULL);
+
+    return save;
+}
+
 /* Complexity: O(log n) */
 RBTreeIterator* rbtree_find(RBTree *rbtree, const void *key)
 {
-    struct _rbtree_node *node, *save;
+    struct _rbtree_node *node;
     int cmp_result;
 
     assert(rbtree != NULL);
@@ -797,21 +1828,11 @@ RBTreeIterator* rbtree_find(RBTree *rbtree, const void *key)
     while(node != NULL) {
         cmp_result = rbtree->comparefn(key, node->key);
         if(cmp_result < 0) {
-            node = node->left;
+            node = left_of(node);
         } else if(cmp_result > 0) {
-            node = node->right;
+            node = right_of(node);
         } else {
-            /* Tree could contain duplicates. If so, return
-             * the left-most one.
-             */
-            do {
-                save = node;
-                node = node->left;
-                while((node != NULL) && (rbtree->comparefn(key, node->key) != 0)) {
-                    node = node->right;
-                }
-            } while(node != NULL);
-            node = save;
+            node = _leftmost_equal(rbtree, node, key);
             break;
         }
     }
@@ -821,80 +1842,414 @@ RBTreeIterator* rbtree_find(RBTree *rbtree, const void *key)
     return node;
 }
 
-/* Complexity: O(log n) */
+/* Finds each of the n keys, storing in its[i] what rbtree_find would
+ * return for keys[i], and returns the number of keys found.
+ *
+ * A lookup spends most of its time waiting on cache misses at every
+ * level of the tree, two in a row: the node, and then the key it
+ * points to. The lookups are run RBTREE_FIND_GROUP at a time, and take
+ * turns at one step each. A lookup whose node was prefetched on its
+ * last turn prefetches the node's key, and one whose key was
+ * prefetched compares it and prefetches the next node. Either way, a
+ * whole turn of the group goes by before what was prefetched is
+ * needed, so the misses of the group overlap.
+ *
+ * Complexity: O(n log m), for m nodes in the tree
+ */
+unsigned long rbtree_find_many(RBTree *rbtree, const void **keys,
+        unsigned long n, RBTreeIterator **its)
+{
+    struct _rbtree_node *node[RBTREE_FIND_GROUP];
+    int key_fetched[RBTREE_FIND_GROUP];
+    unsigned long i, j, group, active, found;
+    int result;
+
+    assert(rbtree != NULL);
+    assert(n == 0 || (keys != NULL && its != NULL));
+
+    found = 0;
+    for(i = 0; i < n; i += group) {
+        group = MIN(n - i, RBTREE_FIND_GROUP);
+        for(j = 0; j < group; j++) {
+            node[j] = rbtree->root;
+            key_fetched[j] = 0;
+            its[i + j] = NULL;
+        }
+
+        active = (rbtree->root != NULL) ? group : 0;
+        while(active > 0) {
+            for(j = 0; j < group; j++) {
+                if(NULL == node[j]) {
+                    continue;
+                }
+
+                if(!key_fetched[j]) {
+                    LIBCORE_PREFETCH(node[j]->key);
+                    key_fetched[j] = 1;
+                    continue;
+                }
+
+                result = rbtree->comparefn(keys[i + j], node[j]->key);
+                if(result < 0) {
+                    node[j] = left_of(node[j]);
+                } else if(result > 0) {
+                    node[j] = right_of(node[j]);
+                } else {
+                    its[i + j] = _leftmost_equal(rbtree, node[j], keys[i + j]);
+                    found++;
+                    node[j] = NULL;
+                }
+
+                if(NULL == node[j]) {
+                    active--;
+                } else {
+                    LIBCORE_PREFETCH(node[j]);
+                    key_fetched[j] = 0;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+/* Complexity: O(1) */
 RBTreeIterator* rbtree_begin(RBTree *rbtree)
 {
-    if(NULL == rbtree || rbtree_is_empty(rbtree)) {
+    if(NULL == rbtree) {
         return NULL;
     }
 
-    return _tree_minimum(rbtree->root);
+    return rbtree->min;
 }
 
-/* Complexity: O(log n) */
+/* Complexity: O(1) */
 RBTreeIterator* rbtree_end(RBTree *rbtree)
 {
-    if(NULL == rbtree || rbtree_is_empty(rbtree)) {
+    if(NULL == rbtree) {
         return NULL;
     }
 
-    return _tree_maximum(rbtree->root);
+    return rbtree->max;
 }
 
-/* Complexity: O(log n) */
+/* Complexity: O(1) amortized over a full iteration, O(log n) worst */
 RBTreeIterator* rbtree_next(RBTreeIterator *it)
 {
-    struct _rbtree_node *node;
+    if(NULL == it) {
+        return NULL;
+    }
+
+    if(is_thread(it->right)) {
+        return thread_target(it->right);
+    }
+
+    return _tree_minimum(it->right);
+}
 
+/* Complexity: O(1) amortized over a full iteration, O(log n) worst */
+RBTreeIterator* rbtree_prev(RBTreeIterator *it)
+{
     if(NULL == it) {
         return NULL;
     }
 
-    if(it->right != NULL) {
-        return _tree_minimum(it->right);
+    if(is_thread(it->left)) {
+        return thread_target(it->left);
     }
 
-    node = it->parent;
+    return _tree_maximum(it->left);
+}
+
+/* Returns the node at position index, counting from 0, in the
+ * iteration order, or NULL if there is no such node.
+ *
+ * Complexity: O(log n)
+ */
+RBTreeIterator* rbtree_select(RBTree *rbtree, unsigned long index)
+{
+    struct _rbtree_node *node;
+    unsigned long left_size;
+
+    assert(rbtree != NULL);
 
-    /* Successor is the lowest ancestor of node 'it'
-     * whose left child is also an ancestor of node 'it'.
-     * Go up the tree until we find a node that is the
-     * left child of its parent
-     */
-    while((node != NULL) && (it == node->right)) {
-        it = node;
-        node = node->parent;
+    node = rbtree->root;
+
+    while(node != NULL) {
+        left_size = subtree_size(left_of(node));
+        if(index < left_size) {
+            node = left_of(node);
+        } else if(index == left_size) {
+            break;
+        } else {
+            index -= left_size + 1;
+            node = right_of(node);
+        }
     }
 
     return node;
 }
 
-/* Complexity: O(log n) */
-RBTreeIterator* rbtree_prev(RBTreeIterator *it)
+/* Returns the number of keys that compare less than key, which is
+ * also the position of the first node with that key, if any.
+ *
+ * Complexity: O(log n)
+ */
+unsigned long rbtree_rank(RBTree *rbtree, const void *key)
 {
     struct _rbtree_node *node;
+    unsigned long rank = 0;
 
-    if(NULL == it) {
+    assert(rbtree != NULL);
+
+    node = rbtree->root;
+
+    while(node != NULL) {
+        if(rbtree->comparefn(key, node->key) <= 0) {
+            node = left_of(node);
+        } else {
+            rank += subtree_size(left_of(node)) + 1;
+            node = right_of(node);
+        }
+    }
+
+    return rank;
+}
+
+/* Returns the first node whose key is not less than key, or NULL if
+ * there is none. With duplicates, this is the first of them.
+ *
+ * Complexity: O(log n)
+ */
+RBTreeIterator* rbtree_lower_bound(RBTree *rbtree, const void *key)
+{
+    struct _rbtree_node *node, *bound = NULL;
+
+    assert(rbtree != NULL);
+    assert(key != NULL);
+
+    node = rbtree->root;
+
+    while(node != NULL) {
+        if(rbtree->comparefn(node->key, key) >= 0) {
+            bound = node;
+            node = left_of(node);
+        } else {
+            node = right_of(node);
+        }
+    }
+
+    return bound;
+}
+
+/* Returns the first node whose key is greater than key, or NULL if
+ * there is none.
+ *
+ * Complexity: O(log n)
+ */
+RBTreeIterator* rbtree_upper_bound(RBTree *rbtree, const void *key)
+{
+    struct _rbtree_node *node, *bound = NULL;
+
+    assert(rbtree != NULL);
+    assert(key != NULL);
+
+    node = rbtree->root;
+
+    while(node != NULL) {
+        if(rbtree->comparefn(node->key, key) > 0) {
+            bound = node;
+            node = left_of(node);
+        } else {
+            node = right_of(node);
+        }
+    }
+
+    return bound;
+}
+
+/* Stores the first node with key in *first, and the first node past
+ * them in *last. When key is not in the tree, both are where it would
+ * be inserted.
+ *
+ * Complexity: O(log n)
+ */
+void rbtree_equal_range(RBTree *rbtree, const void *key,
+        RBTreeIterator **first, RBTreeIterator **last)
+{
+    assert(first != NULL);
+    assert(last != NULL);
+
+    *first = rbtree_lower_bound(rbtree, key);
+    *last = rbtree_upper_bound(rbtree, key);
+}
+
+/* Returns the number of keys in [lo, hi), counting duplicates.
+ *
+ * Complexity: O(log n)
+ */
+unsigned long rbtree_count_range(RBTree *rbtree, const void *lo,
+        const void *hi)
+{
+    assert(rbtree != NULL);
+    assert(lo != NULL);
+    assert(hi != NULL);
+
+    if(rbtree->comparefn(lo, hi) >= 0) {
+        return 0;
+    }
+
+    return rbtree_rank(rbtree, hi) - rbtree_rank(rbtree, lo);
+}
+
+/* Joins less, key and greater into a single tree, which is returned.
+ * Every key in less must be <= key, and every key in greater >= key.
+ * Both trees are consumed, even though the container of less is reused
+ * for the result. Returns NULL, leaving both trees intact, if out of
+ * memory.
+ *
+ * Complexity: O(log n)
+ */
+RBTree* rbtree_join(RBTree *less, const void *key, void *value,
+        RBTree *greater)
+{
+    struct _rbtree_node *node;
+
+    assert(less != NULL);
+    assert(greater != NULL);
+    assert(less->comparefn == greater->comparefn);
+    assert(less->value_size == greater->value_size);
+    assert(less->size == 0 ||
+            less->comparefn(rbtree_get_key(rbtree_end(less)), key) <= 0);
+    assert(greater->size == 0 ||
+            greater->comparefn(key, rbtree_get_key(rbtree_begin(greater))) <= 0);
+
+    node = _rbtree_node_create(less, key, value);
+    if(NULL == node) {
+        return NULL;
+    }
+
+    if(_rbtree_share_blocks(greater, less) < 0) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        _rbtree_free_node(&less->spares, node);
         return NULL;
     }
 
-    if(it->left != NULL) {
-        return _tree_maximum(it->left);
+    node->left = thread_to(less->max);
+    node->right = thread_to(greater->min);
+    if(NULL == less->max) {
+        less->min = node;
+    } else {
+        less->max->right = thread_to(node);
+    }
+    if(NULL == greater->min) {
+        less->max = node;
+    } else {
+        greater->min->left = thread_to(node);
+        less->max = greater->max;
     }
 
-    node = it->parent;
+    less->root = _join(less->root, node, greater->root);
+    less->size = less->root->size;
 
-    /* Predecessor is the greatest ancestor of node 'it'
-     * whose right child is also an ancestor of node 'it'.
-     * Go up the tree until we find a node that is the
-     * right child of its parent
-     */
-    while((node != NULL) && (it == node->left)) {
-        it = node;
-        node = node->parent;
+    _spares_concat(&less->spares, &greater->spares);
+    _rbtree_release_blocks(greater);
+    free(greater);
+
+    return less;
+}
+
+/* Splits rbtree, which is consumed, into *less, with the keys less than
+ * key, and *greater, with the keys greater than key. If a node with
+ * key is found, it is removed, its value is stored in *value and 1 is
+ * returned; otherwise 0 is returned. If the tree allows duplicates,
+ * other nodes with key may end up on either side. Returns -1, leaving
+ * rbtree intact, if out of memory.
+ *
+ * Complexity: O(log n)
+ */
+int rbtree_split(RBTree *rbtree, const void *key, RBTree **less,
+        RBTree **greater, void **value)
+{
+    struct _rbtree_node *left, *right, *match;
+    RBTree *new_rbtree;
+
+    assert(rbtree != NULL);
+    assert(less != NULL);
+    assert(greater != NULL);
+
+    new_rbtree = rbtree_create(rbtree->comparefn);
+    if(NULL == new_rbtree) {
+        return -1;
     }
+    new_rbtree->value_size = rbtree->value_size;
 
-    return node;
+    if(_rbtree_share_blocks(rbtree, new_rbtree) < 0) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        rbtree_free(new_rbtree);
+        return -1;
+    }
+
+    match = NULL;
+    _split(rbtree->comparefn, rbtree->root, key, &left, &right, &match);
+
+    if(left != NULL) {
+        set_color(left, BLACK);
+    }
+    if(right != NULL) {
+        set_color(right, BLACK);
+    }
+
+    rbtree->root = left;
+    rbtree->size = subtree_size(left);
+    new_rbtree->root = right;
+    new_rbtree->size = subtree_size(right);
+    _rbtree_find_ends(rbtree);
+    _rbtree_find_ends(new_rbtree);
+
+    *less = rbtree;
+    *greater = new_rbtree;
+
+    if(NULL == match) {
+        return 0;
+    }
+
+    if(value != NULL) {
+        *value = _rbtree_take_value(rbtree, match);
+    }
+    _rbtree_free_node(&rbtree->spares, match);
+
+    return 1;
+}
+
+/* The set operations below treat both trees as sets of unique keys,
+ * and consume them. The result, returned in the container of rbtree1,
+ * keeps the nodes and values of rbtree1; values of rbtree2, and of
+ * rbtree1 nodes left out of the result, are passed to freefn unless it
+ * is NULL. Up to nthreads threads are used. Returns NULL, leaving both
+ * trees intact, if out of memory.
+ *
+ * With m <= n the sizes of the two trees, these are
+ * Complexity: O(m log(n/m + 1)) work, O(log^2 n) span, plus freeing
+ *             the nodes left out of the result
+ */
+RBTree* rbtree_union(RBTree *rbtree1, RBTree *rbtree2, unsigned int nthreads,
+        FreeFn freefn)
+{
+    return rbtree_set_op(RBTREE_SET_UNION, rbtree1, rbtree2, nthreads, freefn);
+}
+
+RBTree* rbtree_intersect(RBTree *rbtree1, RBTree *rbtree2,
+        unsigned int nthreads, FreeFn freefn)
+{
+    return rbtree_set_op(RBTREE_SET_INTERSECT, rbtree1, rbtree2, nthreads,
+            freefn);
+}
+
+RBTree* rbtree_diff(RBTree *rbtree1, RBTree *rbtree2, unsigned int nthreads,
+        FreeFn freefn)
+{
+    return rbtree_set_op(RBTREE_SET_DIFF, rbtree1, rbtree2, nthreads, freefn);
 }
 
 /* Complexity: O(1) */
@@ -914,5 +2269,30 @@ void* rbtree_get_value(RBTreeIterator *it)
         return NULL;
     }
 
+    if(is_inline(it)) {
+        return &it->value;
+    }
+
     return it->value;
 }
+
+/* Replaces the value of it, returning the old one.
+ *
+ * Complexity: O(1)
+ */
+void* rbtree_set_value(RBTree *rbtree, RBTreeIterator *it, void *value)
+{
+    void *old_value;
+
+    assert(rbtree != NULL);
+    assert(it != NULL);
+
+    old_value = _rbtree_take_value(rbtree, it);
+    if(is_inline(it)) {
+        memcpy(&it->value, value, rbtree->value_size);
+    } else {
+        it->value = value;
+    }
+
+    return old_value;
+}
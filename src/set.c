@@ -29,9 +29,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <libcore/btree.h>
+#include <libcore/darray.h>
 #include <libcore/rbtree.h>
 #include <libcore/set.h>
 
+#include "btree_tag.h"
+
 struct _set {
     RBTree *s;
 };
@@ -46,12 +50,38 @@ Set* set_create(CompareFn comparefn)
     return (Set *)rbtree_create(comparefn);
 }
 
-/* Time Complexity: O(1) */
+/* A set backed by a B+ tree rather than a red-black tree. See
+ * map_create_btree. The set operations accept either kind, and return
+ * red-black tree sets, except for the parallel ones, which need
+ * red-black trees.
+ *
+ * Time Complexity: O(1)
+ */
+Set* set_create_btree(CompareFn comparefn)
+{
+    return btree_tag(btree_create(comparefn));
+}
+
+/* values must be strictly ascending according to comparefn. See
+ * rbtree_create_from_sorted.
+ *
+ * Time Complexity: O(|values|)
+ */
+Set* set_create_from_sorted(CompareFn comparefn, const DArray *values)
+{
+    return (Set *)rbtree_create_from_sorted(comparefn, values, NULL, 0);
+}
+
+/* Time Complexity: O(|set|) */
 void set_free(Set *set)
 {
     assert(set != NULL);
 
-    rbtree_free((RBTree *)set);
+    if(is_btree(set)) {
+        btree_free(btree_untag(set));
+    } else {
+        rbtree_free((RBTree *)set);
+    }
 }
 
 /* Time Complexity: O(|set|)
@@ -61,7 +91,11 @@ void set_free_all(Set *set, FreeFn freefn)
 {
     assert(set != NULL);
 
-    rbtree_free_all((RBTree *)set, freefn);
+    if(is_btree(set)) {
+        btree_free_all(btree_untag(set), freefn);
+    } else {
+        rbtree_free_all((RBTree *)set, freefn);
+    }
 }
 
 /* Time Complexity: O(log(|set|)) */
@@ -69,18 +103,104 @@ int set_insert(Set *set, void *value)
 {
     assert(set != NULL);
 
+    if(is_btree(set)) {
+        return btree_insert(btree_untag(set), value, value);
+    }
+
     return rbtree_insert_unique((RBTree *)set, value, value);
 }
 
+static CompareFn set_get_comparefn(Set *set)
+{
+    if(is_btree(set)) {
+        return btree_get_comparefn(btree_untag(set));
+    }
+
+    return rbtree_get_comparefn((RBTree *)set);
+}
+
 /* Time Complexity: O(log(|set|)) */
 void* set_remove(Set *set, const void *value)
 {
     assert(set != NULL);
 
+    if(is_btree(set)) {
+        return btree_remove(btree_untag(set), value);
+    }
+
     return rbtree_remove((RBTree *)set, value);
 }
 
-/* Time Complexity: O(|set1| * log(|set1|) + |set2| * log(|set1| + |set2|)) */
+/* Merges two sets that share a comparator, walking both in order and
+ * keeping the values found only in set1, in both, or only in set2, as
+ * selected. Values found in both are taken from set1. The merged values
+ * come out sorted, so the result is built directly rather than by
+ * repeated insertion.
+ *
+ * Time Complexity: O(|set1| + |set2|)
+ */
+static Set* set_merge(Set *set1, Set *set2, int keep_only1, int keep_both,
+        int keep_only2)
+{
+    SetIterator *it1, *it2;
+    CompareFn comparefn;
+    DArray *merged;
+    void *value;
+    int result;
+    Set *ret;
+
+    comparefn = set_get_comparefn(set1);
+
+    merged = darray_create();
+    if(NULL == merged) {
+        return NULL;
+    }
+
+    for(it1 = set_begin(set1), it2 = set_begin(set2);
+            it1 != NULL || it2 != NULL; ) {
+        if(NULL == it1) {
+            result = 1;
+        } else if(NULL == it2) {
+            result = -1;
+        } else {
+            result = comparefn(set_get_value(it1), set_get_value(it2));
+        }
+
+        value = NULL;
+        if(result == 0) {
+            if(keep_both) {
+                value = set_get_value(it1);
+            }
+            it1 = set_next(it1);
+            it2 = set_next(it2);
+        } else if(result < 0) {
+            if(keep_only1) {
+                value = set_get_value(it1);
+            }
+            it1 = set_next(it1);
+        } else {
+            if(keep_only2) {
+                value = set_get_value(it2);
+            }
+            it2 = set_next(it2);
+        }
+
+        if(value != NULL && darray_append(merged, value) < 0) {
+            darray_free(merged);
+            return NULL;
+        }
+    }
+
+    ret = set_create_from_sorted(comparefn, merged);
+    darray_free(merged);
+
+    return ret;
+}
+
+/* Time Complexity: O(|set1| + |set2|) if both sets share a comparator,
+ *                  O(|set1| * log(|set1|) + |set2| * log(|set1| + |set2|))
+ *                  otherwise
+ */
 Set* set_union(Set *set1, Set *set2)
 {
     SetIterator *it;
@@ -89,7 +209,13 @@ Set* set_union(Set *set1, Set *set2)
     assert(set1 != NULL);
     assert(set2 != NULL);
 
-    ret = set_create(rbtree_get_comparefn((RBTree *)set1));
+    /* A \cup B = {x : x \in A or x \in B}  */
+    if(set_get_comparefn(set1) ==
+            set_get_comparefn(set2)) {
+        return set_merge(set1, set2, 1, 1, 1);
+    }
+
+    ret = set_create(set_get_comparefn(set1));
     if(ret == NULL) {
         return NULL;
     }
@@ -104,160 +230,159 @@ Set* set_union(Set *set1, Set *set2)
     return ret;
 }
 
-/* Time Complexity: O(|set1| * log(|set2|)) */
+/* Time Complexity: O(|set1| + |set2|) if both sets share a comparator,
+ *                  O(|set1| * log(|set2|)) otherwise
+ */
 Set* set_intersect(Set *set1, Set *set2)
 {
     CompareFn comparefn1, comparefn2;
-    SetIterator *it1,*it2;
-    int result;
+    SetIterator *it1;
     Set *ret;
 
     assert(set1 != NULL);
     assert(set2 != NULL);
 
-    comparefn1 = rbtree_get_comparefn((RBTree *)set1);
-    comparefn2 = rbtree_get_comparefn((RBTree *)set2);
+    comparefn1 = set_get_comparefn(set1);
+    comparefn2 = set_get_comparefn(set2);
+
+    /* A \cap B = {x : x \in A and x \in B}  */
+    if(comparefn1 == comparefn2) {
+        return set_merge(set1, set2, 0, 1, 0);
+    }
 
     ret = set_create(comparefn1);
     if(ret == NULL) {
         return NULL;
     }
 
-    /* A \cap B = {x : x \in A and x \in B}  */
-    if(comparefn1 == comparefn2) {
-        /* O(|set1| + |set2|), supposedly... */
-        for(it1 = set_begin(set1), it2 = set_begin(set2);
-                it1 != NULL && it2 != NULL; ) {
-            result = comparefn1(set_get_value(it1), set_get_value(it2));
-            if(result == 0) {
-                set_insert(ret, set_get_value(it1));
-                it1 = set_next(it1);
-                it2 = set_next(it2);
-            } else if(result < 0) {
-                it1 = set_next(it1);
-            } else {
-                it2 = set_next(it2);
-            }
-        }
-    } else {
-        for(it1 = set_begin(set1); it1 != NULL; it1 = set_next(it1)) {
-            if(set_is_member(set2, set_get_value(it1))) {
-                set_insert(ret, set_get_value(it1));
-            }
+    for(it1 = set_begin(set1); it1 != NULL; it1 = set_next(it1)) {
+        if(set_is_member(set2, set_get_value(it1))) {
+            set_insert(ret, set_get_value(it1));
         }
     }
 
     return ret;
 }
 
-/* Time Complexity: O(|set1| * log(|set2|)) */
+/* Time Complexity: O(|set1| + |set2|) if both sets share a comparator,
+ *                  O(|set1| * log(|set2|)) otherwise
+ */
 Set* set_diff(Set *set1, Set *set2)
 {
-    SetIterator *it1, *it2;
     CompareFn comparefn1, comparefn2;
-    int result;
+    SetIterator *it1;
     Set *ret;
 
     assert(set1 != NULL);
     assert(set2 != NULL);
 
-    comparefn1 = rbtree_get_comparefn((RBTree *)set1);
-    comparefn2 = rbtree_get_comparefn((RBTree *)set2);
+    comparefn1 = set_get_comparefn(set1);
+    comparefn2 = set_get_comparefn(set2);
+
+    /* A - B = {x : x \in A and x \notin B}  */
+    if(comparefn1 == comparefn2) {
+        return set_merge(set1, set2, 1, 0, 0);
+    }
 
     ret = set_create(comparefn1);
     if(ret == NULL) {
         return NULL;
     }
 
-    /* A - B = {x : x \in A and x \notin B}  */
-    if(comparefn1 == comparefn2) {
-        /* O(|set1| + |set2|), supposedly... */
-        for(it1 = set_begin(set1), it2 = set_begin(set2);
-                it1 != NULL && it2 != NULL; ) {
-            result =  comparefn1(set_get_value(it1), set_get_value(it2));
-            if(result == 0) {
-                it1 = set_next(it1);
-                it2 = set_next(it2);
-            } else if(result < 0) {
-                set_insert(ret, set_get_value(it1));
-                it1 = set_next(it1);
-            } else {
-                it2 = set_next(it2);
-            }
-        }
-
-        while(it1 != NULL) {
+    for(it1 = set_begin(set1); it1 != NULL; it1 = set_next(it1)) {
+        if(!set_is_member(set2, set_get_value(it1))) {
             set_insert(ret, set_get_value(it1));
-            it1 = set_next(it1);
-        }
-    } else {
-        for(it1 = set_begin(set1); it1 != NULL; it1 = set_next(it1)) {
-            if(!set_is_member(set2, set_get_value(it1))) {
-                set_insert(ret, set_get_value(it1));
-            }
         }
     }
 
     return ret;
 }
 
-/* Time Complexity: O(|set2| * log(|set1|)) */
+/* Time Complexity: O(|set1| + |set2|) if both sets share a comparator,
+ *                  O((|set1| + |set2|) * log(|set1| + |set2|)) otherwise
+ */
 Set* set_symdiff(Set *set1, Set *set2)
 {
-    SetIterator *it1, *it2;
+    SetIterator *it1;
     CompareFn comparefn1, comparefn2;
-    int result;
     Set *ret;
 
     assert(set1 != NULL);
     assert(set2 != NULL);
 
-    comparefn1 = rbtree_get_comparefn((RBTree *)set1);
-    comparefn2 = rbtree_get_comparefn((RBTree *)set2);
+    comparefn1 = set_get_comparefn(set1);
+    comparefn2 = set_get_comparefn(set2);
 
     /* A \ominus B = (A - B) \cup (B - A)  */
     if(comparefn1 == comparefn2) {
-        ret = set_create(comparefn1);
-        if(ret == NULL) {
-            return NULL;
-        }
+        return set_merge(set1, set2, 1, 0, 1);
+    }
 
-        /* O(|set1| + |set2|), supposedly... */
-        for(it1 = set_begin(set1), it2 = set_begin(set2);
-                it1 != NULL && it2 != NULL; ) {
-            result =  comparefn1(set_get_value(it1), set_get_value(it2));
-            if(result == 0) {
-                it1 = set_next(it1);
-                it2 = set_next(it2);
-            } else if(result < 0) {
-                set_insert(ret, set_get_value(it1));
-                it1 = set_next(it1);
-            } else {
-                set_insert(ret, set_get_value(it2));
-                it2 = set_next(it2);
-            }
-        }
+    ret = set_diff(set1, set2);
+    if(ret == NULL) {
+        return NULL;
+    }
 
-        while(it1 != NULL) {
+    for(it1 = set_begin(set2); it1 != NULL; it1 = set_next(it1)) {
+        if(!set_is_member(set1, set_get_value(it1))) {
             set_insert(ret, set_get_value(it1));
-            it1 = set_next(it1);
         }
+    }
 
-        while(it2 != NULL) {
-            set_insert(ret, set_get_value(it2));
-            it2 = set_next(it2);
-        }
-    } else {
-        ret = set_diff(set1, set2);
+    return ret;
+}
 
-        for(it1 = set_begin(set2); it1 != NULL; it1 = set_next(it1)) {
-            if(!set_is_member(set1, set_get_value(it1))) {
-                set_insert(ret, set_get_value(it1));
-            }
-        }
+/* The parallel operations only exist for red-black trees */
+static int set_is_rbtree_pair(Set *set1, Set *set2)
+{
+    if(is_btree(set1) || is_btree(set2)) {
+        fprintf(stderr, "Sets must be red-black trees (%s:%d)\n",
+                __FUNCTION__, __LINE__);
+        return 0;
     }
 
-    return ret;
+    return 1;
+}
+
+/* The parallel versions below consume both sets, which must share a
+ * comparator, and return the result in the container of set1. Values
+ * that do not make it into the result, including those of set2 equal
+ * to one of set1, are passed to freefn unless it is NULL. Up to
+ * nthreads threads are used. See rbtree_union.
+ *
+ * Time Complexity: O(m * log(n/m + 1)) work, with m <= n the set sizes
+ */
+Set* set_union_parallel(Set *set1, Set *set2, unsigned int nthreads,
+        FreeFn freefn)
+{
+    if(!set_is_rbtree_pair(set1, set2)) {
+        return NULL;
+    }
+
+    return (Set *)rbtree_union((RBTree *)set1, (RBTree *)set2, nthreads,
+            freefn);
+}
+
+Set* set_intersect_parallel(Set *set1, Set *set2, unsigned int nthreads,
+        FreeFn freefn)
+{
+    if(!set_is_rbtree_pair(set1, set2)) {
+        return NULL;
+    }
+
+    return (Set *)rbtree_intersect((RBTree *)set1, (RBTree *)set2, nthreads,
+            freefn);
+}
+
+Set* set_diff_parallel(Set *set1, Set *set2, unsigned int nthreads,
+        FreeFn freefn)
+{
+    if(!set_is_rbtree_pair(set1, set2)) {
+        return NULL;
+    }
+
+    return (Set *)rbtree_diff((RBTree *)set1, (RBTree *)set2, nthreads,
+            freefn);
 }
 
 /* Time Complexity: O(|set2| * log(|set1|)) */
@@ -307,12 +432,12 @@ int set_is_subset(Set *set1, Set *set2)
 /* Time Complexity: O(log(|set|)) */
 int set_is_member(Set *set, void *value)
 {
-    RBTreeIterator *found;
+    SetIterator *found;
 
     assert(set != NULL);
     assert(value != NULL);
 
-    found = rbtree_find((RBTree *)set, value);
+    found = set_find(set, value);
     if(found != NULL) {
         return 1;
     }
@@ -333,15 +458,39 @@ unsigned long set_size(Set *set)
 {
     assert(set != NULL);
 
+    if(is_btree(set)) {
+        return btree_size(btree_untag(set));
+    }
+
     return rbtree_size((RBTree *)set);
 }
 
+/* Number of values in the set less than value
+ *
+ * Time Complexity: O(log(|set|)), O(|set|) with a B-tree backend
+ */
+unsigned long set_rank(Set *set, const void *value)
+{
+    assert(set != NULL);
+    assert(value != NULL);
+
+    if(is_btree(set)) {
+        return btree_rank(btree_untag(set), value);
+    }
+
+    return rbtree_rank((RBTree *)set, value);
+}
+
 /* Time Complexity: O(log(|set|)) */
 void* set_remove_at(Set *set, SetIterator *it)
 {
     assert(set != NULL);
     assert(it != NULL);
 
+    if(is_btree(set)) {
+        return btree_remove_at(btree_untag(set), btree_untag(it));
+    }
+
     return rbtree_remove_at((RBTree *)set, (RBTreeIterator *)it);
 }
 
@@ -351,45 +500,137 @@ SetIterator* set_find(Set *set, const void *value)
     assert(set != NULL);
     assert(value != NULL);
 
+    if(is_btree(set)) {
+        return btree_tag(btree_find(btree_untag(set), value));
+    }
+
     return (SetIterator *)rbtree_find((RBTree *)set, value);
 }
 
-/* Time Complexity: O(log(|set|)) */
+/* Time Complexity: O(1), O(log(|set|)) with a B-tree backend */
 SetIterator* set_begin(Set *set)
 {
     assert(set != NULL);
 
+    if(is_btree(set)) {
+        return btree_tag(btree_begin(btree_untag(set)));
+    }
+
     return (SetIterator *)rbtree_begin((RBTree *)set);
 }
 
-/* Time Complexity: O(log(|set|)) */
+/* Time Complexity: O(1), O(log(|set|)) with a B-tree backend */
 SetIterator* set_end(Set *set)
 {
     assert(set != NULL);
 
+    if(is_btree(set)) {
+        return btree_tag(btree_end(btree_untag(set)));
+    }
+
     return (SetIterator *)rbtree_end((RBTree *)set);
 }
 
-/* Time Complexity: O(log(|set|)) */
+/* Time Complexity: O(1) */
 SetIterator* set_next(SetIterator *it)
 {
     assert(it != NULL);
 
+    if(is_btree(it)) {
+        return btree_tag(btree_next(btree_untag(it)));
+    }
+
     return (SetIterator *)rbtree_next((RBTreeIterator *)it);
 }
 
-/* Time Complexity: O(log(|set|)) */
+/* Time Complexity: O(log(|set|)), O(1) with a B-tree backend */
 SetIterator* set_prev(SetIterator *it)
 {
     assert(it != NULL);
 
+    if(is_btree(it)) {
+        return btree_tag(btree_prev(btree_untag(it)));
+    }
+
     return (SetIterator *)rbtree_prev((RBTreeIterator *)it);
 }
 
+/* The index-th value in iteration order, or NULL
+ *
+ * Time Complexity: O(log(|set|)), O(|set|) with a B-tree backend
+ */
+SetIterator* set_select(Set *set, unsigned long index)
+{
+    assert(set != NULL);
+
+    if(is_btree(set)) {
+        return btree_tag(btree_select(btree_untag(set), index));
+    }
+
+    return (SetIterator *)rbtree_select((RBTree *)set, index);
+}
+
+/* Time Complexity: O(log(|set|)) */
+SetIterator* set_lower_bound(Set *set, const void *value)
+{
+    assert(set != NULL);
+    assert(value != NULL);
+
+    if(is_btree(set)) {
+        return btree_tag(btree_lower_bound(btree_untag(set), value));
+    }
+
+    return (SetIterator *)rbtree_lower_bound((RBTree *)set, value);
+}
+
+/* Time Complexity: O(log(|set|)) */
+SetIterator* set_upper_bound(Set *set, const void *value)
+{
+    assert(set != NULL);
+    assert(value != NULL);
+
+    if(is_btree(set)) {
+        return btree_tag(btree_upper_bound(btree_untag(set), value));
+    }
+
+    return (SetIterator *)rbtree_upper_bound((RBTree *)set, value);
+}
+
+/* Time Complexity: O(log(|set|)) */
+void set_equal_range(Set *set, const void *value, SetIterator **first,
+        SetIterator **last)
+{
+    assert(first != NULL);
+    assert(last != NULL);
+
+    *first = set_lower_bound(set, value);
+    *last = set_upper_bound(set, value);
+}
+
+/* Returns the number of values in [lo, hi).
+ *
+ * Time Complexity: O(log(|set|)), O(log(|set|) + k) with a B-tree
+ * backend, for k values in the range
+ */
+unsigned long set_count_range(Set *set, const void *lo, const void *hi)
+{
+    assert(set != NULL);
+
+    if(is_btree(set)) {
+        return btree_count_range(btree_untag(set), lo, hi);
+    }
+
+    return rbtree_count_range((RBTree *)set, lo, hi);
+}
+
 /* Time Complexity: O(1) */
 void* set_get_value(SetIterator *it)
 {
     assert(it != NULL);
 
+    if(is_btree(it)) {
+        return btree_get_value(btree_untag(it));
+    }
+
     return rbtree_get_value((RBTreeIterator *)it);
 }
@@ -0,0 +1,510 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Each node is linked into levels 0 up to some height, chosen at random
+ * when it is inserted: a node reaches level i + 1 with probability 1/4
+ * once it reaches level i. Level 0 links every node in order, and also
+ * back, so that iterators can step both ways. A search starts at the
+ * highest level in use and drops a level whenever the next node there
+ * would overshoot the key.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/skiplist.h>
+
+/* Enough for 4^16 entries at the expected density */
+#define SKIPLIST_MAX_LEVEL  16
+
+struct _skiplist_node {
+    const void *key;
+    void *value;
+    struct _skiplist_node *prev;
+
+    /* Allocated with as many links as the node has levels */
+    struct _skiplist_node *next[1];
+};
+
+struct _skiplist {
+    /* Holds no entry, and has every level */
+    struct _skiplist_node *head;
+    struct _skiplist_node *tail;
+
+    unsigned long size;
+    unsigned int level;
+
+    /* State of the generator for node heights */
+    unsigned long seed;
+
+    CompareFn comparefn;
+};
+
+static struct _skiplist_node* _node_create(const void *key, void *value,
+        unsigned int level)
+{
+    struct _skiplist_node *node;
+    unsigned int i;
+
+    node = malloc(sizeof(struct _skiplist_node) +
+            (level - 1) * sizeof(struct _skiplist_node *));
+    if(NULL == node) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    node->key = key;
+    node->value = value;
+    node->prev = NULL;
+    for(i = 0; i < level; i++) {
+        node->next[i] = NULL;
+    }
+
+    return node;
+}
+
+/* Complexity: O(1) expected */
+static unsigned int _random_level(SkipList *list)
+{
+    unsigned long x = list->seed;
+    unsigned int level = 1;
+
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+    list->seed = x;
+
+    /* Two bits per level, of the 32 the generator produces */
+    while(level < SKIPLIST_MAX_LEVEL && 0 == (x & 3)) {
+        level++;
+        x >>= 2;
+    }
+
+    return level;
+}
+
+/* Returns the first node whose key is not less than key, or, if
+ * past_equal is set, the first whose key is greater. If update is not
+ * NULL, stores the last node before it on each level in use.
+ *
+ * Complexity: O(log n) expected
+ */
+static struct _skiplist_node* _search(SkipList *list, const void *key,
+        int past_equal, struct _skiplist_node **update)
+{
+    struct _skiplist_node *x, *next, *last = NULL;
+    unsigned int i;
+    int c;
+
+    x = list->head;
+    for(i = list->level; i-- > 0;) {
+        /* A node that stopped the search on the level above stops it
+         * here too, without being compared again.
+         */
+        for(next = x->next[i]; next != NULL && next != last;
+                next = x->next[i]) {
+            c = list->comparefn(next->key, key);
+            if(c > 0 || (0 == c && !past_equal)) {
+                break;
+            }
+            x = next;
+        }
+
+        last = next;
+        if(update != NULL) {
+            update[i] = x;
+        }
+    }
+
+    return x->next[0];
+}
+
+/* Removes node, given the last node before it on each level */
+static void _unlink(SkipList *list, struct _skiplist_node *node,
+        struct _skiplist_node **update)
+{
+    unsigned int i;
+
+    for(i = 0; i < list->level && update[i]->next[i] == node; i++) {
+        update[i]->next[i] = node->next[i];
+    }
+
+    if(node->next[0] != NULL) {
+        node->next[0]->prev = node->prev;
+    } else {
+        list->tail = node->prev;
+    }
+
+    while(list->level > 1 && NULL == list->head->next[list->level - 1]) {
+        list->level--;
+    }
+
+    list->size--;
+    free(node);
+}
+
+static void skiplist_destroy(SkipList *list, FreeFn freefn)
+{
+    struct _skiplist_node *node, *next;
+
+    for(node = list->head->next[0]; node != NULL; node = next) {
+        next = node->next[0];
+        if(freefn != NULL) {
+            freefn(node->value);
+        }
+        free(node);
+    }
+
+    free(list->head);
+    free(list);
+}
+
+/* Complexity: O(1) */
+SkipList* skiplist_create(CompareFn comparefn)
+{
+    SkipList *new_list;
+
+    assert(comparefn != NULL);
+
+    new_list = malloc(sizeof(struct _skiplist));
+    if(NULL == new_list) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_list->head = _node_create(NULL, NULL, SKIPLIST_MAX_LEVEL);
+    if(NULL == new_list->head) {
+        free(new_list);
+        return NULL;
+    }
+
+    new_list->tail = NULL;
+    new_list->size = 0;
+    new_list->level = 1;
+    new_list->seed = 2463534242UL;
+    new_list->comparefn = comparefn;
+
+    return new_list;
+}
+
+/* Complexity: O(n) */
+void skiplist_free(SkipList *list)
+{
+    assert(list != NULL);
+
+    /* Only free the containers, not the data stored in the list */
+    skiplist_destroy(list, NULL);
+}
+
+/* Complexity: O(n) */
+void skiplist_free_all(SkipList *list, FreeFn freefn)
+{
+    assert(list != NULL);
+
+    if(NULL == freefn) {
+        /* Default to free */
+        freefn = (FreeFn)free;
+    }
+
+    skiplist_destroy(list, freefn);
+}
+
+/* Returns -1 if key is already in the list, or out of memory.
+ *
+ * Complexity: O(log n) expected
+ */
+int skiplist_insert(SkipList *list, const void *key, void *value)
+{
+    struct _skiplist_node *update[SKIPLIST_MAX_LEVEL];
+    struct _skiplist_node *node;
+    unsigned int i, level;
+
+    assert(list != NULL);
+    assert(key != NULL);
+
+    node = _search(list, key, 0, update);
+    if(node != NULL && list->comparefn(node->key, key) == 0) {
+        return -1;
+    }
+
+    level = _random_level(list);
+    node = _node_create(key, value, level);
+    if(NULL == node) {
+        return -1;
+    }
+
+    for(; list->level < level; list->level++) {
+        update[list->level] = list->head;
+    }
+
+    for(i = 0; i < level; i++) {
+        node->next[i] = update[i]->next[i];
+        update[i]->next[i] = node;
+    }
+
+    if(update[0] != list->head) {
+        node->prev = update[0];
+    }
+    if(node->next[0] != NULL) {
+        node->next[0]->prev = node;
+    } else {
+        list->tail = node;
+    }
+
+    list->size++;
+
+    return 0;
+}
+
+/* Returns the value of the removed entry, or NULL if key was not found.
+ *
+ * Complexity: O(log n) expected
+ */
+void* skiplist_remove(SkipList *list, const void *key)
+{
+    struct _skiplist_node *update[SKIPLIST_MAX_LEVEL];
+    struct _skiplist_node *node;
+    void *value;
+
+    assert(list != NULL);
+    assert(key != NULL);
+
+    node = _search(list, key, 0, update);
+    if(NULL == node || list->comparefn(node->key, key) != 0) {
+        return NULL;
+    }
+
+    value = node->value;
+    _unlink(list, node, update);
+
+    return value;
+}
+
+/* Returns the value of the removed entry. As nodes do not know what
+ * links to them on the levels above, it has to be searched for again.
+ *
+ * Complexity: O(log n) expected
+ */
+void* skiplist_remove_at(SkipList *list, SkipListIterator *it)
+{
+    struct _skiplist_node *update[SKIPLIST_MAX_LEVEL];
+    void *value;
+
+    assert(list != NULL);
+    assert(it != NULL);
+
+    /* Keys are unique, so the search ends at it */
+    _search(list, it->key, 0, update);
+
+    value = it->value;
+    _unlink(list, it, update);
+
+    return value;
+}
+
+/* Complexity: O(1) */
+int skiplist_is_empty(SkipList *list)
+{
+    assert(list != NULL);
+
+    return (0 == list->size);
+}
+
+/* Checks that every level is in order and only holds nodes of the
+ * level below, and that the back links, the tail and the size agree
+ * with level 0.
+ *
+ * Complexity: O(n)
+ */
+int skiplist_is_valid(SkipList *list)
+{
+    struct _skiplist_node *node, *below, *prev;
+    unsigned long n;
+    unsigned int i;
+
+    assert(list != NULL);
+
+    if(list->level < 1 || list->level > SKIPLIST_MAX_LEVEL) {
+        return 0;
+    }
+    for(i = list->level; i < SKIPLIST_MAX_LEVEL; i++) {
+        if(list->head->next[i] != NULL) {
+            return 0;
+        }
+    }
+
+    prev = NULL;
+    for(n = 0, node = list->head->next[0]; node != NULL;
+            n++, node = node->next[0]) {
+        if(node->prev != prev) {
+            return 0;
+        }
+        if(prev != NULL && list->comparefn(prev->key, node->key) >= 0) {
+            return 0;
+        }
+        prev = node;
+    }
+
+    if(n != list->size || list->tail != prev) {
+        return 0;
+    }
+
+    for(i = 1; i < list->level; i++) {
+        below = list->head->next[i - 1];
+        for(node = list->head->next[i]; node != NULL; node = node->next[i]) {
+            while(below != NULL && below != node) {
+                below = below->next[i - 1];
+            }
+            if(NULL == below) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/* Complexity: O(1) */
+unsigned long skiplist_size(SkipList *list)
+{
+    assert(list != NULL);
+
+    return list->size;
+}
+
+/* Complexity: O(log n) expected */
+SkipListIterator* skiplist_find(SkipList *list, const void *key)
+{
+    struct _skiplist_node *node;
+
+    assert(list != NULL);
+    assert(key != NULL);
+
+    node = _search(list, key, 0, NULL);
+    if(node != NULL && list->comparefn(node->key, key) == 0) {
+        return node;
+    }
+
+    return NULL;
+}
+
+/* Complexity: O(1) */
+SkipListIterator* skiplist_begin(SkipList *list)
+{
+    assert(list != NULL);
+
+    return list->head->next[0];
+}
+
+/* Complexity: O(1) */
+SkipListIterator* skiplist_end(SkipList *list)
+{
+    assert(list != NULL);
+
+    return list->tail;
+}
+
+/* Complexity: O(1) */
+SkipListIterator* skiplist_next(SkipListIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->next[0];
+}
+
+/* Complexity: O(1) */
+SkipListIterator* skiplist_prev(SkipListIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->prev;
+}
+
+/* Returns the first entry whose key is not less than key.
+ *
+ * Complexity: O(log n) expected
+ */
+SkipListIterator* skiplist_lower_bound(SkipList *list, const void *key)
+{
+    assert(list != NULL);
+    assert(key != NULL);
+
+    return _search(list, key, 0, NULL);
+}
+
+/* Returns the first entry whose key is greater than key.
+ *
+ * Complexity: O(log n) expected
+ */
+SkipListIterator* skiplist_upper_bound(SkipList *list, const void *key)
+{
+    assert(list != NULL);
+    assert(key != NULL);
+
+    return _search(list, key, 1, NULL);
+}
+
+/* Complexity: O(1) */
+const void* skiplist_get_key(SkipListIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->key;
+}
+
+/* Complexity: O(1) */
+void* skiplist_get_value(SkipListIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->value;
+}
+
+/* Replaces the value of it, returning the old one.
+ *
+ * Complexity: O(1)
+ */
+void* skiplist_set_value(SkipListIterator *it, void *value)
+{
+    void *old_value;
+
+    assert(it != NULL);
+
+    old_value = it->value;
+    it->value = value;
+
+    return old_value;
+}
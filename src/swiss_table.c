@@ -0,0 +1,552 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* An open addressing hash table after Google's SwissTable. Besides the
+ * flat array of key-value slots, each slot has a control byte: the low
+ * 7 bits of the key's hash (h2) when the slot is full, or a marker for
+ * an empty or deleted slot. Slots are probed in aligned groups of 16,
+ * and a group's control bytes are all compared against h2 at once, so
+ * a lookup usually touches one group of control bytes and one slot.
+ * The remaining bits of the hash (h1) pick the first group to probe.
+ *
+ * Groups are compared with SSE2 where available, and otherwise with
+ * portable SWAR (SIMD within a register) code on unsigned longs.
+ * Defining LIBCORE_NO_SSE2 forces the portable code.
+ *
+ * Keys must not be NULL, as empty slots are recognised by a NULL key
+ * during iteration.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(LIBCORE_NO_SSE2)
+#include <emmintrin.h>
+#define SWISS_TABLE_SSE2
+#endif
+
+#include <libcore/swiss_table.h>
+
+#define GROUP_SIZE          16
+#define SWISS_TABLE_MIN_CAPACITY    GROUP_SIZE
+
+/* Control bytes of slots that are not full. Both have the high bit
+ * set, which h2 never does.
+ */
+#define CTRL_EMPTY          0x80
+#define CTRL_DELETED        0xFE
+
+/* Slots that may be full before growing, counting deleted ones */
+#define max_load(capacity)  ((capacity) - (capacity) / 8)
+
+struct _swiss_table_slot {
+    const void *key;
+    void *value;
+};
+
+struct _swiss_table {
+    unsigned char *ctrl;
+
+    /* capacity + 1 slots; the last is a sentinel for iteration, whose
+     * key points to itself
+     */
+    struct _swiss_table_slot *slots;
+    unsigned long capacity;
+
+    unsigned long size;
+
+    /* Empty slots that may still be filled before growing */
+    unsigned long growth_left;
+
+    HashFn hashfn;
+    CompareFn comparefn;
+};
+
+#define h1(hash)    ((hash) >> 7)
+#define h2(hash)    ((unsigned char)((hash) & 0x7F))
+
+/* Index of the lowest set bit of x, which must not be 0 */
+static unsigned int _ctz(unsigned long x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzl(x);
+#else
+    unsigned int n = 0;
+
+    while(0 == (x & 1)) {
+        x >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+/* Group matching. _group_match returns a mask with bit i set for each
+ * slot i of the group whose control byte is h2.
+ */
+#ifdef SWISS_TABLE_SSE2
+
+static unsigned int _group_match(const unsigned char *ctrl, unsigned char h2)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+}
+
+static int _group_has_empty(const unsigned char *ctrl)
+{
+    return _group_match(ctrl, CTRL_EMPTY) != 0;
+}
+
+/* Index of the first empty or deleted slot, or -1 */
+static int _group_first_free(const unsigned char *ctrl)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    unsigned int mask;
+
+    mask = _mm_movemask_epi8(group);
+
+    return (mask != 0) ? (int)_ctz(mask) : -1;
+}
+
+#else
+
+#define WORD_SIZE   sizeof(unsigned long)
+#define LSBS        ((unsigned long)-1 / 0xFF)
+#define MSBS        (LSBS << 7)
+
+/* Loads bytes in order from the least significant, whatever the
+ * machine's byte order.
+ */
+static unsigned long _load_word(const unsigned char *ctrl)
+{
+    unsigned long word = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&word, ctrl, WORD_SIZE);
+#else
+    unsigned int i;
+
+    for(i = 0; i < WORD_SIZE; i++) {
+        word |= (unsigned long)ctrl[i] << (CHAR_BIT * i);
+    }
+#endif
+
+    return word;
+}
+
+/* Turns the high bit of each matching byte into one bit per slot */
+static unsigned int _compress(unsigned long bits, unsigned int first)
+{
+    unsigned int mask = 0;
+
+    while(bits != 0) {
+        mask |= 1U << (first + _ctz(bits) / CHAR_BIT);
+        bits &= bits - 1;
+    }
+
+    return mask;
+}
+
+/* A zero byte test on ctrl ^ h2. A borrow may flag the byte above a
+ * match as well, which costs an extra key comparison but no wrong
+ * answer.
+ */
+static unsigned int _group_match(const unsigned char *ctrl, unsigned char h2)
+{
+    unsigned long word;
+    unsigned int i, mask = 0;
+
+    for(i = 0; i < GROUP_SIZE; i += WORD_SIZE) {
+        word = _load_word(ctrl + i) ^ (LSBS * h2);
+        mask |= _compress((word - LSBS) & ~word & MSBS, i);
+    }
+
+    return mask;
+}
+
+/* Empty is the only control byte with the high bit set and bit 1
+ * clear; shifting by 6 lines bit 1 of each byte up with its high bit.
+ */
+static int _group_has_empty(const unsigned char *ctrl)
+{
+    unsigned long word, bits = 0;
+    unsigned int i;
+
+    for(i = 0; i < GROUP_SIZE; i += WORD_SIZE) {
+        word = _load_word(ctrl + i);
+        bits |= word & ~(word << 6) & MSBS;
+    }
+
+    return bits != 0;
+}
+
+static int _group_first_free(const unsigned char *ctrl)
+{
+    unsigned long bits;
+    unsigned int i;
+
+    for(i = 0; i < GROUP_SIZE; i += WORD_SIZE) {
+        bits = _load_word(ctrl + i) & MSBS;
+        if(bits != 0) {
+            return i + _ctz(bits) / CHAR_BIT;
+        }
+    }
+
+    return -1;
+}
+
+#endif
+
+/* Groups are probed in triangular steps, 1, 2, 3, ... groups apart,
+ * which visits every group of a power of 2 count.
+ */
+static struct _swiss_table_slot* _swiss_table_find(SwissTable *table,
+        unsigned long hash, const void *key)
+{
+    struct _swiss_table_slot *slot;
+    unsigned long group, step, mask;
+    unsigned int match;
+
+    mask = table->capacity / GROUP_SIZE - 1;
+    group = h1(hash) & mask;
+
+    for(step = 1; ; step++) {
+        match = _group_match(table->ctrl + group * GROUP_SIZE, h2(hash));
+        while(match != 0) {
+            slot = &table->slots[group * GROUP_SIZE + _ctz(match)];
+            if(table->comparefn(slot->key, key) == 0) {
+                return slot;
+            }
+            match &= match - 1;
+        }
+
+        /* An empty slot ends the probe sequence */
+        if(_group_has_empty(table->ctrl + group * GROUP_SIZE)) {
+            return NULL;
+        }
+
+        group = (group + step) & mask;
+    }
+}
+
+/* The first slot on hash's probe sequence that is empty or deleted */
+static unsigned long _find_free(SwissTable *table, unsigned long hash)
+{
+    unsigned long group, step, mask;
+    int i;
+
+    mask = table->capacity / GROUP_SIZE - 1;
+    group = h1(hash) & mask;
+
+    for(step = 1; ; step++) {
+        i = _group_first_free(table->ctrl + group * GROUP_SIZE);
+        if(i >= 0) {
+            return group * GROUP_SIZE + i;
+        }
+
+        group = (group + step) & mask;
+    }
+}
+
+/* Rehashes every entry into new arrays of capacity slots, which drops
+ * deleted markers as well.
+ *
+ * Complexity: O(capacity)
+ */
+static int _swiss_table_resize(SwissTable *table, unsigned long capacity)
+{
+    struct _swiss_table_slot *old_slots;
+    unsigned char *old_ctrl;
+    unsigned long i, old_capacity, hash, j;
+
+    old_ctrl = table->ctrl;
+    old_slots = table->slots;
+    old_capacity = table->capacity;
+
+    table->ctrl = malloc(capacity);
+    table->slots = calloc(capacity + 1, sizeof(struct _swiss_table_slot));
+    if(NULL == table->ctrl || NULL == table->slots) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        free(table->ctrl);
+        free(table->slots);
+        table->ctrl = old_ctrl;
+        table->slots = old_slots;
+        return -1;
+    }
+
+    memset(table->ctrl, CTRL_EMPTY, capacity);
+    table->slots[capacity].key = &table->slots[capacity];
+    table->capacity = capacity;
+    table->growth_left = max_load(capacity) - table->size;
+
+    for(i = 0; i < old_capacity; i++) {
+        if(old_ctrl[i] & 0x80) {
+            continue;
+        }
+
+        hash = table->hashfn(old_slots[i].key);
+        j = _find_free(table, hash);
+        table->ctrl[j] = h2(hash);
+        table->slots[j] = old_slots[i];
+    }
+
+    free(old_ctrl);
+    free(old_slots);
+
+    return 0;
+}
+
+/* Complexity: O(1) */
+SwissTable* swiss_table_create(HashFn hashfn, CompareFn comparefn)
+{
+    SwissTable *table;
+
+    assert(hashfn != NULL);
+    assert(comparefn != NULL);
+
+    table = malloc(sizeof(SwissTable));
+    if(NULL == table) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    table->ctrl = NULL;
+    table->slots = NULL;
+    table->capacity = 0;
+    table->size = 0;
+    table->hashfn = hashfn;
+    table->comparefn = comparefn;
+
+    if(_swiss_table_resize(table, SWISS_TABLE_MIN_CAPACITY) < 0) {
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+/* Complexity: O(1) */
+void swiss_table_free(SwissTable *table)
+{
+    assert(table != NULL);
+
+    free(table->ctrl);
+    free(table->slots);
+    free(table);
+}
+
+/* Complexity: O(capacity) */
+void swiss_table_free_all(SwissTable *table, FreeFn freefn)
+{
+    unsigned long i;
+
+    assert(table != NULL);
+
+    if(NULL == freefn) {
+        /* Default to free */
+        freefn = (FreeFn)free;
+    }
+
+    for(i = 0; i < table->capacity; i++) {
+        if(!(table->ctrl[i] & 0x80)) {
+            freefn(table->slots[i].value);
+        }
+    }
+
+    swiss_table_free(table);
+}
+
+/* Keys are unique: returns -1 if key is already present, as well as
+ * when out of memory.
+ *
+ * Complexity: O(1) expected, amortized
+ */
+int swiss_table_insert(SwissTable *table, const void *key, void *value)
+{
+    unsigned long hash, i, capacity;
+
+    assert(table != NULL);
+    assert(key != NULL);
+
+    hash = table->hashfn(key);
+    if(_swiss_table_find(table, hash, key) != NULL) {
+        return -1;
+    }
+
+    i = _find_free(table, hash);
+
+    /* Filling an empty slot takes from the growth budget; reusing a
+     * deleted one does not.
+     */
+    if(0 == table->growth_left && CTRL_EMPTY == table->ctrl[i]) {
+        /* Mostly deleted slots only need a rehash in place */
+        capacity = table->capacity;
+        if(table->size >= max_load(capacity) / 2) {
+            capacity *= 2;
+        }
+
+        if(_swiss_table_resize(table, capacity) < 0) {
+            return -1;
+        }
+        i = _find_free(table, hash);
+    }
+
+    if(CTRL_EMPTY == table->ctrl[i]) {
+        table->growth_left--;
+    }
+
+    table->ctrl[i] = h2(hash);
+    table->slots[i].key = key;
+    table->slots[i].value = value;
+    table->size++;
+
+    return 0;
+}
+
+/* Complexity: O(1) expected */
+void* swiss_table_remove(SwissTable *table, const void *key)
+{
+    SwissTableIterator *it;
+
+    assert(table != NULL);
+
+    it = _swiss_table_find(table, table->hashfn(key), key);
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return swiss_table_remove_at(table, it);
+}
+
+/* Complexity: O(1) */
+int swiss_table_is_empty(SwissTable *table)
+{
+    assert(table != NULL);
+
+    return (table->size == 0);
+}
+
+/* Complexity: O(1) */
+unsigned long swiss_table_size(SwissTable *table)
+{
+    assert(table != NULL);
+
+    return table->size;
+}
+
+/* A lookup stops at the first group with an empty slot, so if this
+ * slot's group has one, no probe sequence runs past it, and the slot
+ * can become empty too. Otherwise it must be marked deleted, to keep
+ * later probes going.
+ *
+ * Complexity: O(1)
+ */
+void* swiss_table_remove_at(SwissTable *table, SwissTableIterator *it)
+{
+    unsigned long i;
+    void *value;
+
+    assert(table != NULL);
+    assert(it != NULL);
+
+    i = (unsigned long)(it - table->slots);
+    value = it->value;
+
+    if(_group_has_empty(table->ctrl + i / GROUP_SIZE * GROUP_SIZE)) {
+        table->ctrl[i] = CTRL_EMPTY;
+        table->growth_left++;
+    } else {
+        table->ctrl[i] = CTRL_DELETED;
+    }
+
+    it->key = NULL;
+    it->value = NULL;
+    table->size--;
+
+    return value;
+}
+
+/* Complexity: O(1) expected */
+SwissTableIterator* swiss_table_find(SwissTable *table, const void *key)
+{
+    assert(table != NULL);
+    assert(key != NULL);
+
+    return _swiss_table_find(table, table->hashfn(key), key);
+}
+
+/* Skips over empty slots, up to the sentinel */
+static SwissTableIterator* _swiss_table_scan(SwissTableIterator *it)
+{
+    while(NULL == it->key) {
+        it++;
+    }
+
+    return (it->key == it) ? NULL : it;
+}
+
+/* Complexity: O(capacity) */
+SwissTableIterator* swiss_table_begin(SwissTable *table)
+{
+    assert(table != NULL);
+
+    return _swiss_table_scan(table->slots);
+}
+
+/* Complexity: O(1) amortized over a full iteration */
+SwissTableIterator* swiss_table_next(SwissTableIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return _swiss_table_scan(it + 1);
+}
+
+/* Complexity: O(1) */
+const void* swiss_table_get_key(SwissTableIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->key;
+}
+
+/* Complexity: O(1) */
+void* swiss_table_get_value(SwissTableIterator *it)
+{
+    if(NULL == it) {
+        return NULL;
+    }
+
+    return it->value;
+}
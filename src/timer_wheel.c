@@ -0,0 +1,471 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/timer_wheel.h>
+
+#define TIMER_WHEEL_BITS    5
+#define TIMER_WHEEL_SLOTS   (1UL << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_WIDTH   (sizeof(unsigned long) * CHAR_BIT)
+#define TIMER_WHEEL_LEVELS  \
+    ((TIMER_WHEEL_WIDTH + TIMER_WHEEL_BITS - 1) / TIMER_WHEEL_BITS)
+
+/* Pseudo-levels for timers that are not in a wheel slot */
+#define TIMER_WHEEL_DUE         TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_DETACHED    (TIMER_WHEEL_LEVELS + 1)
+
+struct _timer_link {
+    struct _timer_link *prev;
+    struct _timer_link *next;
+};
+
+/* The link must come first, so that a link can be cast to its timer */
+struct _timer_wheel_timer {
+    struct _timer_link link;
+    unsigned long deadline;
+    void *data;
+    unsigned int level;
+    unsigned int slot;
+};
+
+/* A timer that is due after now sits at the level of the highest
+ * base-32 digit in which its deadline differs from now, in the slot
+ * given by that digit of its deadline. Every non-empty slot therefore
+ * lies ahead of now's digit at its level. When now reaches a slot,
+ * its timers either fire or cascade to a lower level.
+ *
+ * Timers scheduled at or before now wait in the due list until the
+ * next advance.
+ */
+struct _timer_wheel {
+    struct _timer_link slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    unsigned long occupied[TIMER_WHEEL_LEVELS];
+    struct _timer_link due;
+    unsigned long now;
+    unsigned long size;
+};
+
+/* Number of significant bits in x, i.e. 0 for 0 and
+ * floor(log2(x)) + 1 otherwise.
+ */
+static unsigned int bit_length(unsigned long x)
+{
+#if defined(__GNUC__)
+    return (x == 0) ? 0 :
+        (unsigned int)(TIMER_WHEEL_WIDTH - __builtin_clzl(x));
+#else
+    unsigned int n = 0;
+
+    while(x != 0) {
+        x >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+/* Index of the lowest set bit of x, which must not be 0 */
+static unsigned int lowest_bit(unsigned long x)
+{
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_ctzl(x);
+#else
+    unsigned int n = 0;
+
+    while(!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+static void link_init(struct _timer_link *head)
+{
+    head->prev = head;
+    head->next = head;
+}
+
+static void link_append(struct _timer_link *head, struct _timer_link *link)
+{
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void link_remove(struct _timer_link *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+}
+
+static int link_is_empty(const struct _timer_link *head)
+{
+    return (head->next == head);
+}
+
+/* Complexity: O(1) */
+static void timer_wheel_place(TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    unsigned int level, slot;
+
+    if(timer->deadline <= wheel->now) {
+        timer->level = TIMER_WHEEL_DUE;
+        link_append(&wheel->due, &timer->link);
+        return;
+    }
+
+    level = (bit_length(timer->deadline ^ wheel->now) - 1) / TIMER_WHEEL_BITS;
+    slot = (timer->deadline >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+
+    timer->level = level;
+    timer->slot = slot;
+    link_append(&wheel->slots[level][slot], &timer->link);
+    wheel->occupied[level] |= 1UL << slot;
+}
+
+/* Complexity: O(1) */
+static void timer_wheel_unlink(TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    link_remove(&timer->link);
+
+    if(timer->level < TIMER_WHEEL_LEVELS &&
+            link_is_empty(&wheel->slots[timer->level][timer->slot])) {
+        wheel->occupied[timer->level] &= ~(1UL << timer->slot);
+    }
+}
+
+/* Finds the earliest time at which a slot must be processed, and the
+ * level of that slot. Returns 0 if the wheel holds no timers.
+ *
+ * Complexity: O(1)
+ */
+static int timer_wheel_next_event(TimerWheel *wheel, unsigned long *when,
+        unsigned int *level)
+{
+    unsigned long pending, base;
+    unsigned int l, shift, digit;
+
+    for(l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+        shift = l * TIMER_WHEEL_BITS;
+        digit = (wheel->now >> shift) & TIMER_WHEEL_MASK;
+
+        /* Slots behind now's digit are always empty */
+        pending = wheel->occupied[l] & ~((2UL << digit) - 1);
+        if(pending != 0) {
+            shift += TIMER_WHEEL_BITS;
+            base = (shift >= TIMER_WHEEL_WIDTH) ? 0 :
+                (wheel->now >> shift) << shift;
+
+            *when = base |
+                ((unsigned long)lowest_bit(pending) << (l * TIMER_WHEEL_BITS));
+            *level = l;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Releases every timer in expired and runs its callback. Callbacks may
+ * schedule, cancel, or reschedule timers, including the ones still
+ * waiting in expired.
+ */
+static unsigned long timer_wheel_fire(TimerWheel *wheel,
+        struct _timer_link *expired, TimerWheelExpireFn expire_fn,
+        void *userdata)
+{
+    TimerWheelTimer *timer;
+    unsigned long count = 0, deadline;
+    void *data;
+
+    while(!link_is_empty(expired)) {
+        timer = (TimerWheelTimer *)expired->next;
+        link_remove(&timer->link);
+
+        data = timer->data;
+        deadline = timer->deadline;
+        free(timer);
+        wheel->size--;
+        count++;
+
+        if(expire_fn != NULL) {
+            expire_fn(data, deadline, userdata);
+        }
+    }
+
+    return count;
+}
+
+TimerWheel* timer_wheel_create(unsigned long now)
+{
+    TimerWheel *new_wheel;
+    unsigned int l, s;
+
+    new_wheel = malloc(sizeof(struct _timer_wheel));
+    if(NULL == new_wheel) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    for(l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+        for(s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+            link_init(&new_wheel->slots[l][s]);
+        }
+        new_wheel->occupied[l] = 0;
+    }
+
+    link_init(&new_wheel->due);
+    new_wheel->now = now;
+    new_wheel->size = 0;
+
+    return new_wheel;
+}
+
+static void free_list(struct _timer_link *head, FreeFn freefn, int free_data)
+{
+    TimerWheelTimer *timer;
+
+    while(!link_is_empty(head)) {
+        timer = (TimerWheelTimer *)head->next;
+        link_remove(&timer->link);
+
+        if(free_data) {
+            freefn(timer->data);
+        }
+        free(timer);
+    }
+}
+
+/* Complexity: O(n) */
+void timer_wheel_free(TimerWheel *wheel)
+{
+    unsigned int l, s;
+
+    assert(wheel != NULL);
+
+    /* Free the timers, but not the data they carry */
+    for(l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+        for(s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+            free_list(&wheel->slots[l][s], NULL, 0);
+        }
+    }
+    free_list(&wheel->due, NULL, 0);
+
+    free(wheel);
+}
+
+/* Complexity: O(n) */
+void timer_wheel_free_all(TimerWheel *wheel, FreeFn freefn)
+{
+    unsigned int l, s;
+
+    assert(wheel != NULL);
+
+    if(NULL == freefn) {
+        freefn = free;
+    }
+
+    for(l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+        for(s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+            free_list(&wheel->slots[l][s], freefn, 1);
+        }
+    }
+    free_list(&wheel->due, freefn, 1);
+
+    free(wheel);
+}
+
+/* Complexity: O(1)
+ *
+ * A deadline at or before the current time fires on the next advance.
+ * The returned handle stays valid until the timer fires or is
+ * cancelled.
+ */
+TimerWheelTimer* timer_wheel_schedule(TimerWheel *wheel,
+        unsigned long deadline, void *data)
+{
+    TimerWheelTimer *new_timer;
+
+    assert(wheel != NULL);
+
+    new_timer = malloc(sizeof(struct _timer_wheel_timer));
+    if(NULL == new_timer) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    new_timer->deadline = deadline;
+    new_timer->data = data;
+    timer_wheel_place(wheel, new_timer);
+    wheel->size++;
+
+    return new_timer;
+}
+
+/* Complexity: O(1)
+ *
+ * Releases the timer without firing it and returns its data.
+ */
+void* timer_wheel_cancel(TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    void *data;
+
+    assert(wheel != NULL);
+    assert(timer != NULL);
+
+    timer_wheel_unlink(wheel, timer);
+    wheel->size--;
+
+    data = timer->data;
+    free(timer);
+
+    return data;
+}
+
+/* Complexity: O(1) */
+void timer_wheel_reschedule(TimerWheel *wheel, TimerWheelTimer *timer,
+        unsigned long deadline)
+{
+    assert(wheel != NULL);
+    assert(timer != NULL);
+
+    timer_wheel_unlink(wheel, timer);
+    timer->deadline = deadline;
+    timer_wheel_place(wheel, timer);
+}
+
+/* Moves the current time forward to now, firing every timer whose
+ * deadline has been reached, in order of deadline. Timers sharing a
+ * deadline fire in no particular order. While a callback runs,
+ * timer_wheel_now returns the deadline being fired. Callbacks must not
+ * advance the wheel themselves. Returns the number of timers fired.
+ *
+ * Complexity: O(k + c), for k fired timers and c cascaded timers
+ */
+unsigned long timer_wheel_advance(TimerWheel *wheel, unsigned long now,
+        TimerWheelExpireFn expire_fn, void *userdata)
+{
+    struct _timer_link expired, *slot;
+    TimerWheelTimer *timer;
+    unsigned long count, when;
+    unsigned int level, index;
+
+    assert(wheel != NULL);
+
+    /* Time never moves backwards */
+    if(now < wheel->now) {
+        now = wheel->now;
+    }
+
+    link_init(&expired);
+
+    while(!link_is_empty(&wheel->due)) {
+        timer = (TimerWheelTimer *)wheel->due.next;
+        link_remove(&timer->link);
+        timer->level = TIMER_WHEEL_DETACHED;
+        link_append(&expired, &timer->link);
+    }
+    count = timer_wheel_fire(wheel, &expired, expire_fn, userdata);
+
+    while(timer_wheel_next_event(wheel, &when, &level) && when <= now) {
+        wheel->now = when;
+
+        index = (when >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+        slot = &wheel->slots[level][index];
+        wheel->occupied[level] &= ~(1UL << index);
+
+        /* Fire the timers that are due, and cascade the rest to the
+         * lower levels, which now cover their deadlines.
+         */
+        while(!link_is_empty(slot)) {
+            timer = (TimerWheelTimer *)slot->next;
+            link_remove(&timer->link);
+
+            if(timer->deadline == when) {
+                timer->level = TIMER_WHEEL_DETACHED;
+                link_append(&expired, &timer->link);
+            } else {
+                timer_wheel_place(wheel, timer);
+            }
+        }
+
+        count += timer_wheel_fire(wheel, &expired, expire_fn, userdata);
+    }
+
+    wheel->now = now;
+
+    return count;
+}
+
+/* Complexity: O(1) */
+int timer_wheel_is_empty(TimerWheel *wheel)
+{
+    assert(wheel != NULL);
+
+    return (wheel->size == 0);
+}
+
+/* Complexity: O(1) */
+unsigned long timer_wheel_now(TimerWheel *wheel)
+{
+    assert(wheel != NULL);
+
+    return wheel->now;
+}
+
+/* Complexity: O(1) */
+unsigned long timer_wheel_size(TimerWheel *wheel)
+{
+    assert(wheel != NULL);
+
+    return wheel->size;
+}
+
+/* Complexity: O(1) */
+void* timer_wheel_get_data(TimerWheelTimer *timer)
+{
+    assert(timer != NULL);
+
+    return timer->data;
+}
+
+/* Complexity: O(1) */
+unsigned long timer_wheel_get_deadline(TimerWheelTimer *timer)
+{
+    assert(timer != NULL);
+
+    return timer->deadline;
+}
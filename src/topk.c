@@ -0,0 +1,361 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libcore/heap.h>
+#include <libcore/topk.h>
+
+#include "heap_sift.h"
+
+/* The k kept items form a min-heap in data[0, size): the root is the
+ * lowest-priority item kept so far, which is the admission threshold.
+ * The heap is maintained with the primitives heap_sort uses.
+ * topk_push_many stages qualifying items in data[k, 2k) and only
+ * restores the heap once per k staged items, via a linear-time
+ * selection followed by a bottom-up heapify.
+ */
+struct _topk {
+    void **data;
+    unsigned long size;
+    unsigned long k;
+    CompareFn comparefn;
+};
+
+static void swap(void **data, unsigned long a, unsigned long b)
+{
+    void *tmp;
+
+    tmp = data[a];
+    data[a] = data[b];
+    data[b] = tmp;
+}
+
+/* Complexity: O(n) expected
+ *
+ * Partially orders data[0, n) so that the k highest-priority items
+ * occupy data[0, k), in no particular order (Wirth's variant of
+ * Hoare's selection algorithm).
+ */
+static void select_top(void **data, unsigned long n, unsigned long k,
+        CompareFn comparefn)
+{
+    long lo, hi, i, j, target;
+    void *pivot;
+
+    lo = 0;
+    hi = (long)n - 1;
+    target = (long)k - 1;
+
+    while(lo < hi) {
+        pivot = data[target];
+        i = lo;
+        j = hi;
+
+        do {
+            while(comparefn(data[i], pivot) > 0) {
+                i++;
+            }
+            while(comparefn(pivot, data[j]) > 0) {
+                j--;
+            }
+            if(i <= j) {
+                swap(data, (unsigned long)i, (unsigned long)j);
+                i++;
+                j--;
+            }
+        } while(i <= j);
+
+        if(j < target) {
+            lo = i;
+        }
+        if(target < i) {
+            hi = j;
+        }
+    }
+}
+
+/* Reduce the kept and staged items back to a heap of the best k */
+static int topk_compact(TopK *topk, unsigned long staged, DArray *rejected)
+{
+    unsigned long i, n;
+    int ret;
+
+    ret = 0;
+    n = topk->size + staged;
+
+    if(n > topk->k) {
+        select_top(topk->data, n, topk->k, topk->comparefn);
+
+        if(rejected != NULL) {
+            for(i = topk->k; i < n; i++) {
+                if(darray_append(rejected, topk->data[i]) < 0) {
+                    ret = -1;
+                }
+            }
+        }
+
+        n = topk->k;
+    }
+
+    topk->size = n;
+    heap_min_build(topk->data, topk->size, topk->comparefn);
+
+    return ret;
+}
+
+/* Returns NULL when k is 0 */
+TopK* topk_create(CompareFn comparefn, unsigned long k)
+{
+    TopK *new_topk;
+
+    assert(comparefn != NULL);
+
+    if(0 == k) {
+        return NULL;
+    }
+
+    new_topk = malloc(sizeof(struct _topk));
+    if(NULL == new_topk) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    /* Room for k kept items plus up to k staged items */
+    new_topk->data = malloc(sizeof(void *) * 2 * k);
+    if(NULL == new_topk->data) {
+        fprintf(stderr, "Out of memory (%s:%d)\n", __FUNCTION__, __LINE__);
+        free(new_topk);
+        return NULL;
+    }
+
+    new_topk->size = 0;
+    new_topk->k = k;
+    new_topk->comparefn = comparefn;
+
+    return new_topk;
+}
+
+/* Complexity: O(1) */
+void topk_free(TopK *topk)
+{
+    assert(topk != NULL);
+
+    /* Only free the container, not the kept items */
+    free(topk->data);
+    free(topk);
+}
+
+/* Complexity: O(k) */
+void topk_free_all(TopK *topk, FreeFn freefn)
+{
+    unsigned long i;
+
+    assert(topk != NULL);
+
+    if(NULL == freefn) {
+        /* Default to stdlib free */
+        freefn = (FreeFn)free;
+    }
+
+    for(i = 0; i < topk->size; i++) {
+        if(topk->data[i] != NULL) {
+            freefn(topk->data[i]);
+        }
+    }
+
+    topk_free(topk);
+}
+
+/* Complexity: O(1) when rejected; O(log k) when kept
+ *
+ * Returns the item that left the collection as a result of the push:
+ * data itself if it didn't qualify, the previous threshold item if
+ * data displaced it, or NULL if the collection wasn't full yet. Ties
+ * with the threshold are rejected.
+ */
+void* topk_push(TopK *topk, void *data)
+{
+    void *ret;
+
+    assert(topk != NULL);
+
+    if(topk->size < topk->k) {
+        topk->data[topk->size++] = data;
+        heap_min_sift_up(topk->data, topk->size - 1, topk->comparefn);
+        return NULL;
+    }
+
+    if(topk->comparefn(data, topk->data[0]) <= 0) {
+        return data;
+    }
+
+    ret = topk->data[0];
+    topk->data[0] = data;
+    heap_min_sift_down(topk->data, 0, topk->size, topk->comparefn);
+
+    return ret;
+}
+
+/* Complexity: O(|items| + k) expected
+ *
+ * Pushes every item in items. Items that beat the current threshold are
+ * staged without any heap maintenance, and the heap is rebuilt with a
+ * linear-time selection whenever k items have been staged, so accepted
+ * items cost O(1) amortized rather than O(log k). Every item that ends
+ * up outside the collection, whether rejected outright or displaced, is
+ * appended to rejected unless it is NULL.
+ */
+int topk_push_many(TopK *topk, DArray *items, DArray *rejected)
+{
+    unsigned long i, n, staged;
+    void **src, *item;
+    int ret;
+
+    assert(topk != NULL);
+    assert(items != NULL);
+
+    ret = 0;
+    src = darray_data(items);
+    n = darray_size(items);
+
+    /* Fill up to k first so that there is a threshold to filter on */
+    for(i = 0; i < n && topk->size < topk->k; i++) {
+        topk->data[topk->size++] = src[i];
+    }
+    if(i > 0) {
+        heap_min_build(topk->data, topk->size, topk->comparefn);
+    }
+
+    staged = 0;
+    for(; i < n; i++) {
+        item = src[i];
+
+        if(topk->comparefn(item, topk->data[0]) <= 0) {
+            if(rejected != NULL && darray_append(rejected, item) < 0) {
+                ret = -1;
+            }
+            continue;
+        }
+
+        topk->data[topk->k + staged++] = item;
+
+        if(staged == topk->k) {
+            if(topk_compact(topk, staged, rejected) < 0) {
+                ret = -1;
+            }
+            staged = 0;
+        }
+    }
+
+    if(staged > 0 && topk_compact(topk, staged, rejected) < 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Complexity: O(1)
+ *
+ * Returns the lowest-priority kept item, which any new item must beat
+ * to be admitted, or NULL if the collection isn't full yet.
+ */
+void* topk_threshold(TopK *topk)
+{
+    assert(topk != NULL);
+
+    if(topk->size < topk->k) {
+        return NULL;
+    }
+
+    return topk->data[0];
+}
+
+/* Complexity: O(k log k)
+ *
+ * Returns a new DArray holding the kept items from highest to lowest
+ * priority (darray_sort order). The collection itself is unchanged.
+ */
+DArray* topk_to_darray(TopK *topk)
+{
+    DArray *ret;
+    unsigned long i;
+
+    assert(topk != NULL);
+
+    ret = darray_create();
+    if(NULL == ret) {
+        return NULL;
+    }
+
+    for(i = 0; i < topk->size; i++) {
+        if(darray_append(ret, topk->data[i]) < 0) {
+            darray_free(ret);
+            return NULL;
+        }
+    }
+
+    if(topk->size > 0) {
+        heap_sort(ret, topk->comparefn);
+    }
+
+    return ret;
+}
+
+/* Complexity: O(1) */
+int topk_is_full(TopK *topk)
+{
+    assert(topk != NULL);
+
+    return (topk->size == topk->k);
+}
+
+/* Complexity: O(1) */
+int topk_is_empty(TopK *topk)
+{
+    assert(topk != NULL);
+
+    return (topk->size == 0);
+}
+
+/* Complexity: O(1) */
+unsigned long topk_size(TopK *topk)
+{
+    assert(topk != NULL);
+
+    return topk->size;
+}
+
+/* Complexity: O(1) */
+unsigned long topk_capacity(TopK *topk)
+{
+    assert(topk != NULL);
+
+    return topk->k;
+}
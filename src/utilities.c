@@ -63,3 +63,53 @@ unsigned long util_pow2_prev(unsigned long x)
 
     return x - (x >> 1);
 }
+
+/* Mixes every bit of x into the low bits, which hash tables of power of
+ * 2 sizes index by. Where unsigned long is 64 bits this is the
+ * splitmix64 finalizer; a 32-bit mixer there would leave the high half
+ * reaching the low bits only through its shifts.
+ */
+static unsigned long util_hash_mix(unsigned long x)
+{
+#if ULONG_MAX > 0xffffffffUL
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9UL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebUL;
+    x ^= x >> 31;
+#else
+    x ^= x >> 16;
+    x *= 0x45d9f3bUL;
+    x ^= x >> 16;
+    x *= 0x45d9f3bUL;
+    x ^= x >> 16;
+#endif
+
+    return x;
+}
+
+/* Hashes the pointer itself */
+unsigned long util_hash_pointer(const void *p)
+{
+    return util_hash_mix((unsigned long)p);
+}
+
+/* Hashes the unsigned long p points to */
+unsigned long util_hash_ulong(const void *x)
+{
+    return util_hash_mix(*(const unsigned long *)x);
+}
+
+/* Hashes a NUL-terminated string (FNV-1a) */
+unsigned long util_hash_string(const void *s)
+{
+    const unsigned char *c;
+    unsigned long hash = 2166136261UL;
+
+    for(c = s; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619UL;
+    }
+
+    return util_hash_mix(hash);
+}
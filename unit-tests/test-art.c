@@ -0,0 +1,472 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/art.h>
+
+#define KEY_RANGE   5000
+#define NUM_STRINGS 1000
+#define MAX_STRING  24
+
+struct string_key {
+    unsigned char key[MAX_STRING];
+    unsigned long len;
+};
+
+static ART *test_art = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+static int string_key_compare(const void *a, const void *b)
+{
+    const struct string_key *x = a, *y = b;
+    int c;
+
+    c = memcmp(x->key, y->key, (x->len < y->len) ? x->len : y->len);
+    if(c != 0) {
+        return c;
+    }
+
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+/* Random strings over a small alphabet, half of them behind a shared
+ * prefix longer than the one nodes store, so that keys are often
+ * prefixes of each other.
+ */
+static void make_string_key(struct string_key *s)
+{
+    static const char shared[] = "shared-prefix-01";
+    unsigned long i, n;
+
+    s->len = 0;
+    if(rand() % 2) {
+        memcpy(s->key, shared, sizeof(shared) - 1);
+        s->len = sizeof(shared) - 1;
+    }
+
+    n = rand() % 7;
+    for(i = 0; i < n; i++) {
+        s->key[s->len++] = "abc"[rand() % 3];
+    }
+}
+
+static int has_prefix(ARTIterator *it, const struct string_key *prefix)
+{
+    return (art_get_key_len(it) >= prefix->len &&
+            memcmp(art_get_key(it), prefix->key, prefix->len) == 0);
+}
+
+/* Walks the tree both ways, checking it holds exactly the keys marked
+ * present, in order.
+ */
+static void check_contents(ART *art, const char *present,
+        unsigned long range)
+{
+    ARTIterator *it;
+    unsigned long key, n;
+
+    assert_true(art_is_valid(art));
+
+    it = art_begin(art);
+    for(n = 0, key = 0; key < range; key++) {
+        if(present[key]) {
+            assert_true(it != NULL);
+            assert_ulong_equal(key, art_get_key_ulong(it));
+            assert_ulong_equal(key, *(unsigned long *)art_get_value(it));
+            it = art_next(it);
+            n++;
+        }
+    }
+    assert_true(NULL == it);
+    assert_ulong_equal(n, art_size(art));
+
+    it = art_end(art);
+    for(key = range; key-- > 0;) {
+        if(present[key]) {
+            assert_ulong_equal(key, art_get_key_ulong(it));
+            it = art_prev(it);
+        }
+    }
+    assert_true(NULL == it);
+
+    /* Past either end, the iterator stays there */
+    assert_true(NULL == art_next(it));
+    assert_true(NULL == art_prev(it));
+    assert_true(NULL == art_get_key(it));
+    assert_ulong_equal(0, art_get_key_len(it));
+    assert_true(NULL == art_get_value(it));
+}
+
+
+void test_art_create(void)
+{
+    ARTIterator *first, *last;
+
+    test_art = art_create();
+
+    assert_true(test_art != NULL);
+    assert_ulong_equal(0, art_size(test_art));
+    assert_true(art_is_empty(test_art));
+    assert_true(art_is_valid(test_art));
+    assert_true(art_begin(test_art) == NULL);
+    assert_true(art_end(test_art) == NULL);
+    assert_true(art_find_ulong(test_art, 1) == NULL);
+    assert_true(art_find(test_art, "", 0) == NULL);
+    assert_true(art_lower_bound_ulong(test_art, 1) == NULL);
+    assert_true(art_remove_ulong(test_art, 1) == NULL);
+
+    art_prefix_range(test_art, "", 0, &first, &last);
+    assert_true(NULL == first);
+    assert_true(NULL == last);
+
+    art_free(test_art);
+    test_art = NULL;
+}
+
+void test_fixture_art_create(void)
+{
+    test_fixture_start();
+    run_test(test_art_create);
+    test_fixture_end();
+}
+
+
+/* The key range grows nodes to all four types, and the phases of
+ * mostly removals shrink them again.
+ */
+void test_art_random_insert_and_remove(void)
+{
+    static char present[KEY_RANGE];
+    ARTIterator *it;
+    unsigned long i, key, n, *val;
+
+    test_art = art_create();
+    memset(present, 0, sizeof(present));
+    n = 0;
+
+    for(i = 0; i < 100000; i++) {
+        key = rand() % KEY_RANGE;
+
+        if(rand() % 100 < ((i / 25000) % 2 ? 30 : 70)) {
+            val = make_ulong_ptr(key);
+            if(art_insert_ulong(test_art, key, val) == 0) {
+                assert_false(present[key]);
+                present[key] = 1;
+                n++;
+            } else {
+                assert_true(present[key]);
+                free(val);
+            }
+        } else if(rand() % 2) {
+            val = art_remove_ulong(test_art, key);
+            if(val != NULL) {
+                assert_true(present[key]);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        } else {
+            it = art_find_ulong(test_art, key);
+            if(it != NULL) {
+                assert_true(present[key]);
+                val = art_remove_at(test_art, it);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        }
+
+        assert_ulong_equal(n, art_size(test_art));
+        if(i % 10000 == 0) {
+            check_contents(test_art, present, KEY_RANGE);
+        }
+    }
+
+    check_contents(test_art, present, KEY_RANGE);
+
+    art_free_all(test_art, NULL);
+    test_art = NULL;
+}
+
+void test_fixture_art_random_insert_and_remove(void)
+{
+    test_fixture_start();
+    run_test(test_art_random_insert_and_remove);
+    test_fixture_end();
+}
+
+
+/* Bounds and prefix ranges agree with a scan of the sorted keys */
+void test_art_strings(void)
+{
+    static struct string_key keys[NUM_STRINGS];
+    static char present[NUM_STRINGS];
+    struct string_key query;
+    ARTIterator *it, *first, *last;
+    unsigned long i, j, n, num_keys;
+
+    test_art = art_create();
+    memset(present, 0, sizeof(present));
+
+    for(i = 0; i < NUM_STRINGS; i++) {
+        make_string_key(&keys[i]);
+    }
+    qsort(keys, NUM_STRINGS, sizeof(struct string_key), string_key_compare);
+    for(i = 1, num_keys = 1; i < NUM_STRINGS; i++) {
+        if(string_key_compare(&keys[num_keys - 1], &keys[i]) != 0) {
+            keys[num_keys++] = keys[i];
+        }
+    }
+
+    for(i = 0; i < 4 * num_keys; i++) {
+        j = rand() % num_keys;
+        if(i < num_keys || rand() % 2) {
+            if(art_insert(test_art, keys[j].key, keys[j].len,
+                        &keys[j]) == 0) {
+                assert_false(present[j]);
+                present[j] = 1;
+            } else {
+                assert_true(present[j]);
+            }
+        } else if(art_remove(test_art, keys[j].key, keys[j].len) != NULL) {
+            assert_true(present[j]);
+            present[j] = 0;
+        } else {
+            assert_false(present[j]);
+        }
+        assert_true((art_find(test_art, keys[j].key, keys[j].len) != NULL)
+                == present[j]);
+    }
+
+    assert_true(art_is_valid(test_art));
+
+    for(it = art_begin(test_art), i = 0, n = 0; i < num_keys; i++) {
+        if(present[i]) {
+            assert_true(it != NULL);
+            assert_true(art_get_value(it) == &keys[i]);
+            it = art_next(it);
+            n++;
+        }
+    }
+    assert_true(NULL == it);
+    assert_ulong_equal(n, art_size(test_art));
+
+    for(i = 0; i < 2 * num_keys; i++) {
+        if(i < num_keys) {
+            query = keys[i];
+        } else {
+            make_string_key(&query);
+        }
+
+        /* The first key present not less than the query */
+        for(j = 0; j < num_keys; j++) {
+            if(present[j] && string_key_compare(&keys[j], &query) >= 0) {
+                break;
+            }
+        }
+
+        it = art_lower_bound(test_art, query.key, query.len);
+        if(j < num_keys) {
+            assert_true(it == art_find(test_art, keys[j].key, keys[j].len));
+            if(string_key_compare(&keys[j], &query) == 0) {
+                it = art_next(it);
+            }
+        } else {
+            assert_true(NULL == it);
+        }
+        assert_true(it == art_upper_bound(test_art, query.key, query.len));
+
+        art_prefix_range(test_art, query.key, query.len, &first, &last);
+        assert_true(first == art_lower_bound(test_art, query.key,
+                    query.len));
+        for(it = first; it != last; it = art_next(it)) {
+            assert_true(has_prefix(it, &query));
+        }
+        assert_true(NULL == last || !has_prefix(last, &query));
+    }
+
+    art_free(test_art);
+    test_art = NULL;
+}
+
+void test_fixture_art_strings(void)
+{
+    test_fixture_start();
+    run_test(test_art_strings);
+    test_fixture_end();
+}
+
+
+/* Keys that are prefixes of others, down to the empty key */
+void test_art_prefix_keys(void)
+{
+    static const char key[] = "abcdefghijklmnopqrstuvwxyz";
+    ARTIterator *it, *first, *last;
+    unsigned long i, n = sizeof(key) - 1;
+
+    test_art = art_create();
+
+    for(i = n + 1; i-- > 0;) {
+        assert_int_equal(0, art_insert(test_art, key, i, (void *)key));
+        assert_int_equal(-1, art_insert(test_art, key, i, NULL));
+        assert_true(art_is_valid(test_art));
+    }
+    assert_ulong_equal(n + 1, art_size(test_art));
+
+    for(it = art_begin(test_art), i = 0; it != NULL; it = art_next(it)) {
+        assert_ulong_equal(i++, art_get_key_len(it));
+    }
+
+    art_prefix_range(test_art, key, 10, &first, &last);
+    assert_ulong_equal(10, art_get_key_len(first));
+    assert_true(NULL == last);
+    art_prefix_range(test_art, "abd", 3, &first, &last);
+    assert_true(first == last);
+    assert_true(NULL == first);
+    art_prefix_range(test_art, "ab", 3, &first, &last);
+    assert_true(first == last);
+    assert_true(art_find(test_art, key, 3) == first);
+
+    it = art_find(test_art, key, 3);
+    assert_true(art_set_value(it, NULL) == key);
+    assert_true(NULL == art_get_value(it));
+    art_set_value(it, (void *)key);
+
+    /* Every other key first, leaving nodes with both a leaf and a child,
+     * then the rest
+     */
+    for(i = 0; i <= n; i += 2) {
+        assert_true(art_remove(test_art, key, i) == key);
+        assert_true(art_is_valid(test_art));
+    }
+    for(i = 1; i <= n; i += 2) {
+        assert_true(art_remove(test_art, key, i) == key);
+        assert_true(art_is_valid(test_art));
+    }
+    assert_true(art_is_empty(test_art));
+
+    art_free(test_art);
+    test_art = NULL;
+}
+
+void test_fixture_art_prefix_keys(void)
+{
+    test_fixture_start();
+    run_test(test_art_prefix_keys);
+    test_fixture_end();
+}
+
+
+/* Sparse 64-bit keys, spread over all bytes, iterate in numerical order */
+void test_art_ulong_order(void)
+{
+    static unsigned long keys[10000];
+    ARTIterator *it;
+    unsigned long i, j, n, key, prev = 0;
+
+    test_art = art_create();
+
+    for(i = 0, n = 0; i < 10000; i++) {
+        key = 0;
+        for(j = 0; j < sizeof(unsigned long); j++) {
+            key = (key << 8) | (rand() % 4 ? rand() % 3 : rand() & 0xFF);
+        }
+        if(art_insert_ulong(test_art, key, &keys[n]) == 0) {
+            keys[n++] = key;
+        }
+    }
+    assert_true(art_is_valid(test_art));
+    assert_ulong_equal(n, art_size(test_art));
+
+    for(it = art_begin(test_art), i = 0; it != NULL; it = art_next(it), i++) {
+        key = art_get_key_ulong(it);
+        assert_ulong_equal(key, *(unsigned long *)art_get_value(it));
+        assert_true(0 == i || key > prev);
+        assert_true(art_lower_bound_ulong(test_art, key) == it);
+        prev = key;
+    }
+    assert_ulong_equal(n, i);
+
+    for(i = 0; i < n; i += 2) {
+        assert_true(art_remove_ulong(test_art, keys[i]) == &keys[i]);
+    }
+    assert_true(art_is_valid(test_art));
+    for(i = 0; i < n; i++) {
+        assert_true((art_find_ulong(test_art, keys[i]) != NULL) == (i % 2));
+    }
+
+    art_free(test_art);
+    test_art = NULL;
+}
+
+void test_fixture_art_ulong_order(void)
+{
+    test_fixture_start();
+    run_test(test_art_ulong_order);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_art_create();
+    test_fixture_art_random_insert_and_remove();
+    test_fixture_art_strings();
+    test_fixture_art_prefix_keys();
+    test_fixture_art_ulong_order();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,375 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/btree.h>
+#include <libcore/macros.h>
+
+#define KEY_RANGE   20000
+
+static BTree *test_tree = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Iterates both ways, checking order and the count */
+static void check_iteration(BTree *btree)
+{
+    BTreeIterator *it, *prev;
+    unsigned long n;
+
+    for(n = 0, prev = NULL, it = btree_begin(btree); it != NULL;
+            n++, prev = it, it = btree_next(it)) {
+        assert_true(btree_get_key(it) == btree_get_value(it));
+        if(prev != NULL) {
+            assert_true(ulong_compare(btree_get_key(prev),
+                        btree_get_key(it)) < 0);
+        }
+    }
+    assert_ulong_equal(btree_size(btree), n);
+    assert_true(prev == btree_end(btree));
+
+    for(n = 0, it = btree_end(btree); it != NULL; n++, it = btree_prev(it));
+    assert_ulong_equal(btree_size(btree), n);
+}
+
+
+void test_btree_create(void)
+{
+    test_tree = btree_create((CompareFn)ulong_compare);
+
+    assert_true(test_tree != NULL);
+    assert_ulong_equal(0, btree_size(test_tree));
+    assert_true(btree_is_empty(test_tree));
+    assert_true(btree_is_valid(test_tree));
+    assert_true(btree_begin(test_tree) == NULL);
+    assert_true(btree_end(test_tree) == NULL);
+    assert_true(btree_select(test_tree, 0) == NULL);
+
+    btree_free(test_tree);
+    test_tree = NULL;
+}
+
+void test_fixture_btree_create(void)
+{
+    test_fixture_start();
+    run_test(test_btree_create);
+    test_fixture_end();
+}
+
+
+/* Ascending, descending and random orders each split nodes
+ * differently.
+ */
+void test_btree_insert(void)
+{
+    unsigned long i, n, key, *val;
+    int order;
+
+    for(order = 0; order < 3; order++) {
+        test_tree = btree_create((CompareFn)ulong_compare);
+        n = 0;
+
+        for(i = 0; i < KEY_RANGE; i++) {
+            if(0 == order) {
+                key = i;
+            } else if(1 == order) {
+                key = KEY_RANGE - i;
+            } else {
+                key = rand() % KEY_RANGE;
+            }
+
+            val = make_ulong_ptr(key);
+            if(btree_insert(test_tree, val, val) == 0) {
+                n++;
+            } else {
+                /* Keys are unique */
+                assert_true(btree_find(test_tree, &key) != NULL);
+                free(val);
+            }
+        }
+
+        assert_ulong_equal(n, btree_size(test_tree));
+        assert_true(btree_is_valid(test_tree));
+        check_iteration(test_tree);
+
+        btree_free_all(test_tree, NULL);
+        test_tree = NULL;
+    }
+}
+
+/* The slot returned is right even when the insertion splits leaves */
+void test_btree_find_or_insert(void)
+{
+    BTreeIterator *it;
+    unsigned long i, key, *val;
+    int inserted;
+
+    test_tree = btree_create((CompareFn)ulong_compare);
+
+    for(i = 0; i < 40000; i++) {
+        key = rand() % KEY_RANGE;
+        val = make_ulong_ptr(key);
+
+        it = btree_find_or_insert(test_tree, val, val, &inserted);
+        assert_true(it != NULL);
+        assert_ulong_equal(key, *(const unsigned long *)btree_get_key(it));
+        if(inserted) {
+            assert_true(btree_get_value(it) == val);
+        } else {
+            assert_true(btree_get_value(it) != val);
+            free(val);
+        }
+        assert_true(btree_find(test_tree, &key) == it);
+    }
+
+    assert_true(btree_is_valid(test_tree));
+    check_iteration(test_tree);
+
+    it = btree_end(test_tree);
+    val = btree_set_value(it, NULL);
+    assert_true(btree_get_key(it) == val);
+    assert_true(btree_get_value(it) == NULL);
+    btree_set_value(it, val);
+
+    btree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+void test_fixture_btree_insert(void)
+{
+    test_fixture_start();
+    run_test(test_btree_insert);
+    run_test(test_btree_find_or_insert);
+    test_fixture_end();
+}
+
+
+/* Removed keys are freed straight away, so that a separator left
+ * pointing at one would be caught by a memory checker.
+ */
+void test_btree_random_insert_and_remove(void)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, key, n, *val;
+
+    test_tree = btree_create((CompareFn)ulong_compare);
+    for(i = 0; i < KEY_RANGE; i++) {
+        present[i] = 0;
+    }
+    n = 0;
+
+    for(i = 0; i < 200000; i++) {
+        key = rand() % KEY_RANGE;
+
+        /* Drift between mostly inserting and mostly removing, so that
+         * the tree both grows and shrinks by several levels.
+         */
+        if(rand() % 100 < ((i / 50000) % 2 ? 30 : 70)) {
+            val = make_ulong_ptr(key);
+            if(btree_insert(test_tree, val, val) == 0) {
+                assert_false(present[key]);
+                present[key] = 1;
+                n++;
+            } else {
+                assert_true(present[key]);
+                free(val);
+            }
+        } else {
+            val = btree_remove(test_tree, &key);
+            if(val != NULL) {
+                assert_true(present[key]);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        }
+
+        assert_ulong_equal(n, btree_size(test_tree));
+        if(i % 1000 == 0) {
+            assert_true(btree_is_valid(test_tree));
+        }
+    }
+
+    assert_true(btree_is_valid(test_tree));
+    check_iteration(test_tree);
+
+    for(key = 0; key < KEY_RANGE; key++) {
+        assert_true(present[key] == (btree_find(test_tree, &key) != NULL));
+    }
+
+    /* Empty it again through iterators */
+    while(!btree_is_empty(test_tree)) {
+        free(btree_remove_at(test_tree, btree_begin(test_tree)));
+    }
+    assert_true(btree_is_valid(test_tree));
+
+    btree_free(test_tree);
+    test_tree = NULL;
+}
+
+void test_fixture_btree_random_insert_and_remove(void)
+{
+    test_fixture_start();
+    run_test(test_btree_random_insert_and_remove);
+    test_fixture_end();
+}
+
+
+void test_btree_select_rank(void)
+{
+    BTreeIterator *it;
+    unsigned long i, key, *val;
+
+    test_tree = btree_create((CompareFn)ulong_compare);
+
+    /* Even keys only */
+    for(i = 0; i < 5000; i++) {
+        val = make_ulong_ptr(2 * i);
+        btree_insert(test_tree, val, val);
+    }
+
+    for(i = 0; i < 5000; i++) {
+        it = btree_select(test_tree, i);
+        assert_ulong_equal(2 * i, *(const unsigned long *)btree_get_key(it));
+
+        key = 2 * i;
+        assert_ulong_equal(i, btree_rank(test_tree, &key));
+        key = 2 * i + 1;
+        assert_ulong_equal(i + 1, btree_rank(test_tree, &key));
+    }
+    assert_true(btree_select(test_tree, 5000) == NULL);
+
+    btree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+/* Bounds land on the right key across leaf boundaries, and counts
+ * match a brute force count.
+ */
+void test_btree_range(void)
+{
+    BTreeIterator *it, *first, *last;
+    unsigned long i, key, lo, hi, n, *val;
+
+    test_tree = btree_create((CompareFn)ulong_compare);
+
+    key = 0;
+    assert_true(btree_lower_bound(test_tree, &key) == NULL);
+    assert_ulong_equal(0, btree_count_range(test_tree, &key, &key));
+
+    /* Even keys only */
+    for(i = 0; i < 5000; i++) {
+        val = make_ulong_ptr(2 * i);
+        btree_insert(test_tree, val, val);
+    }
+
+    for(key = 0; key < 10000; key++) {
+        it = btree_lower_bound(test_tree, &key);
+        assert_true(it == btree_select(test_tree, (key + 1) / 2));
+
+        it = btree_upper_bound(test_tree, &key);
+        assert_true(it == btree_select(test_tree, key / 2 + 1));
+
+        btree_equal_range(test_tree, &key, &first, &last);
+        if(key % 2 == 0) {
+            assert_true(first == btree_find(test_tree, &key));
+            assert_true(last == btree_next(first));
+        } else {
+            assert_true(first == last);
+        }
+    }
+
+    key = 10000;
+    assert_true(btree_lower_bound(test_tree, &key) == NULL);
+    assert_true(btree_upper_bound(test_tree, &key) == NULL);
+
+    for(i = 0; i < 1000; i++) {
+        lo = rand() % 10000;
+        hi = rand() % 10000;
+        n = (hi > lo) ? (hi + 1) / 2 - (lo + 1) / 2 : 0;
+        assert_ulong_equal(n, btree_count_range(test_tree, &lo, &hi));
+    }
+
+    btree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+void test_fixture_btree_select_rank(void)
+{
+    test_fixture_start();
+    run_test(test_btree_select_rank);
+    run_test(test_btree_range);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_btree_create();
+    test_fixture_btree_insert();
+    test_fixture_btree_random_insert_and_remove();
+    test_fixture_btree_select_rank();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,298 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/concurrent_hashmap.h>
+#include <libcore/utilities.h>
+
+#define KEY_RANGE           50000
+
+#define NUM_WRITERS         4
+#define NUM_READERS         2
+#define KEYS_PER_WRITER     20000
+#define STABLE_KEYS         5000
+
+static CHashMap *test_map = NULL;
+
+/* Keys written by each writer thread, followed by keys that are present
+ * throughout, which the reader threads look up.
+ */
+static unsigned long thread_keys[NUM_WRITERS * KEYS_PER_WRITER + STABLE_KEYS];
+/* Only accessed through the __atomic builtins, as readers poll it */
+static int writers_done;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static void check_contents(CHashMap *map, const char *present,
+        unsigned long range)
+{
+    unsigned long key, n, *val;
+
+    for(n = 0, key = 0; key < range; key++) {
+        val = chashmap_get(map, &key);
+        if(present[key]) {
+            assert_true(val != NULL);
+            assert_ulong_equal(key, *val);
+            n++;
+        } else {
+            assert_true(NULL == val);
+        }
+    }
+
+    assert_ulong_equal(n, chashmap_size(map));
+}
+
+
+void test_chashmap_create(void)
+{
+    unsigned long key = 1;
+
+    test_map = chashmap_create(util_hash_ulong, (CompareFn)ulong_compare);
+
+    assert_true(test_map != NULL);
+    assert_ulong_equal(0, chashmap_size(test_map));
+    assert_true(chashmap_is_empty(test_map));
+    assert_true(chashmap_get(test_map, &key) == NULL);
+    assert_true(chashmap_remove(test_map, &key) == NULL);
+
+    chashmap_free(test_map);
+    test_map = NULL;
+}
+
+void test_fixture_chashmap_create(void)
+{
+    test_fixture_start();
+    run_test(test_chashmap_create);
+    test_fixture_end();
+}
+
+
+/* Single threaded, through several rounds of growth */
+void test_chashmap_random_insert_and_remove(void)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, key, n, *val;
+
+    test_map = chashmap_create(util_hash_ulong, (CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+    n = 0;
+
+    for(i = 0; i < 400000; i++) {
+        key = rand() % KEY_RANGE;
+
+        if(rand() % 100 < ((i / 100000) % 2 ? 30 : 70)) {
+            val = make_ulong_ptr(key);
+            if(chashmap_insert(test_map, val, val) == 0) {
+                assert_false(present[key]);
+                present[key] = 1;
+                n++;
+            } else {
+                assert_true(present[key]);
+                free(val);
+            }
+        } else {
+            val = chashmap_remove(test_map, &key);
+            if(val != NULL) {
+                assert_true(present[key]);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        }
+
+        assert_ulong_equal(n, chashmap_size(test_map));
+        if(i % 40000 == 0) {
+            check_contents(test_map, present, KEY_RANGE);
+        }
+    }
+
+    check_contents(test_map, present, KEY_RANGE);
+
+    chashmap_free_all(test_map, NULL);
+    test_map = NULL;
+}
+
+void test_fixture_chashmap_random_insert_and_remove(void)
+{
+    test_fixture_start();
+    run_test(test_chashmap_random_insert_and_remove);
+    test_fixture_end();
+}
+
+
+/* Each writer inserts its own keys, removes every other one, and puts
+ * back every fourth, growing the map all the while.
+ */
+static void* chashmap_writer(void *arg)
+{
+    unsigned long i, first, failures = 0;
+
+    first = (unsigned long)(size_t)arg * KEYS_PER_WRITER;
+
+    for(i = first; i < first + KEYS_PER_WRITER; i++) {
+        failures += (chashmap_insert(test_map, &thread_keys[i],
+                    &thread_keys[i]) != 0);
+    }
+
+    for(i = first; i < first + KEYS_PER_WRITER; i += 2) {
+        failures += (chashmap_remove(test_map, &thread_keys[i]) !=
+                &thread_keys[i]);
+    }
+
+    for(i = first; i < first + KEYS_PER_WRITER; i += 4) {
+        failures += (chashmap_insert(test_map, &thread_keys[i],
+                    &thread_keys[i]) != 0);
+    }
+
+    return (void *)(size_t)failures;
+}
+
+/* Stable keys must be found at every moment, whatever the writers are
+ * doing to their stripes and to the table.
+ */
+static void* chashmap_reader(void *arg)
+{
+    unsigned long i, key, failures = 0;
+
+    do {
+        for(i = 0; i < STABLE_KEYS; i++) {
+            key = NUM_WRITERS * KEYS_PER_WRITER + i;
+            failures += (chashmap_get(test_map, &key) !=
+                    &thread_keys[key]);
+        }
+    } while(!__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE));
+
+    return (void *)(size_t)failures;
+}
+
+void test_chashmap_threads(void)
+{
+    pthread_t writers[NUM_WRITERS], readers[NUM_READERS];
+    unsigned long i, n;
+    void *failures;
+
+    test_map = chashmap_create(util_hash_ulong, (CompareFn)ulong_compare);
+    assert_true(test_map != NULL);
+
+    for(i = 0; i < NUM_WRITERS * KEYS_PER_WRITER + STABLE_KEYS; i++) {
+        thread_keys[i] = i;
+    }
+    for(i = 0; i < STABLE_KEYS; i++) {
+        n = NUM_WRITERS * KEYS_PER_WRITER + i;
+        assert_int_equal(0, chashmap_insert(test_map, &thread_keys[n],
+                    &thread_keys[n]));
+    }
+
+    __atomic_store_n(&writers_done, 0, __ATOMIC_RELEASE);
+    for(i = 0; i < NUM_READERS; i++) {
+        assert_true(pthread_create(&readers[i], NULL, chashmap_reader,
+                    NULL) == 0);
+    }
+    for(i = 0; i < NUM_WRITERS; i++) {
+        assert_true(pthread_create(&writers[i], NULL, chashmap_writer,
+                    (void *)(size_t)i) == 0);
+    }
+
+    for(i = 0; i < NUM_WRITERS; i++) {
+        pthread_join(writers[i], &failures);
+        assert_true(NULL == failures);
+    }
+    __atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+    for(i = 0; i < NUM_READERS; i++) {
+        pthread_join(readers[i], &failures);
+        assert_true(NULL == failures);
+    }
+
+    /* Only keys that are 2 mod 4 have gone, besides the stable ones */
+    for(n = 0, i = 0; i < NUM_WRITERS * KEYS_PER_WRITER + STABLE_KEYS; i++) {
+        if(i >= NUM_WRITERS * KEYS_PER_WRITER || i % 4 != 2) {
+            assert_true(chashmap_get(test_map, &i) == &thread_keys[i]);
+            n++;
+        } else {
+            assert_true(chashmap_get(test_map, &i) == NULL);
+        }
+    }
+    assert_ulong_equal(n, chashmap_size(test_map));
+
+    chashmap_free(test_map);
+    test_map = NULL;
+}
+
+void test_fixture_chashmap_threads(void)
+{
+    test_fixture_start();
+    run_test(test_chashmap_threads);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_chashmap_create();
+    test_fixture_chashmap_random_insert_and_remove();
+    test_fixture_chashmap_threads();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,273 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/concurrent_pqueue.h>
+
+#define NUM_THREADS         4
+#define ITEMS_PER_THREAD    20000
+
+static CPQueue *test_cpqueue = NULL;
+
+/* Items pushed by the worker threads, and how often each was popped */
+static unsigned long thread_items[NUM_THREADS * ITEMS_PER_THREAD];
+static unsigned long times_popped[NUM_THREADS * ITEMS_PER_THREAD];
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Test fixture setup and teardown */
+
+void cpqueue_setup_strict(void)
+{
+    unsigned long i;
+
+    test_cpqueue = cpqueue_create((CompareFn)ulong_compare, CPQUEUE_STRICT, 0);
+    assert_true(test_cpqueue != NULL);
+
+    for(i = 0; i < 10000; i++) {
+        cpqueue_push(test_cpqueue, make_ulong_ptr(rand() % 10000));
+    }
+
+    assert_true(cpqueue_size(test_cpqueue) == 10000);
+}
+
+void cpqueue_setup_relaxed(void)
+{
+    unsigned long i;
+
+    test_cpqueue = cpqueue_create((CompareFn)ulong_compare, CPQUEUE_RELAXED,
+            2 * NUM_THREADS);
+    assert_true(test_cpqueue != NULL);
+
+    for(i = 0; i < 10000; i++) {
+        cpqueue_push(test_cpqueue, make_ulong_ptr(rand() % 10000));
+    }
+
+    assert_true(cpqueue_size(test_cpqueue) == 10000);
+}
+
+void cpqueue_teardown(void)
+{
+    cpqueue_free_all(test_cpqueue, NULL);
+    test_cpqueue = NULL;
+}
+
+
+void test_cpqueue_create(void)
+{
+    CPQUEUE_MODE modes[2] = { CPQUEUE_STRICT, CPQUEUE_RELAXED };
+    int i;
+
+    for(i = 0; i < 2; i++) {
+        test_cpqueue = cpqueue_create((CompareFn)ulong_compare, modes[i], 0);
+
+        assert_true(test_cpqueue != NULL);
+        assert_true(cpqueue_size(test_cpqueue) == 0);
+        assert_true(cpqueue_is_empty(test_cpqueue));
+        assert_true(cpqueue_pop(test_cpqueue) == NULL);
+
+        cpqueue_free(test_cpqueue);
+        test_cpqueue = NULL;
+    }
+}
+
+void test_fixture_cpqueue_create(void)
+{
+    test_fixture_start();
+    run_test(test_cpqueue_create);
+    test_fixture_end();
+}
+
+
+/* A strict pqueue behaves exactly like a PQueue */
+void test_cpqueue_strict_pop_until_empty(void)
+{
+    unsigned long *val, old_val = 10000;
+
+    while(!cpqueue_is_empty(test_cpqueue)) {
+        val = cpqueue_pop(test_cpqueue);
+        assert_true(val != NULL);
+        assert_true(*val <= old_val);
+        old_val = *val;
+        free(val);
+    }
+
+    assert_true(cpqueue_pop(test_cpqueue) == NULL);
+}
+
+/* A relaxed pqueue returns every item exactly once, and is never
+ * reported empty while it still holds items.
+ */
+void test_cpqueue_relaxed_pop_until_empty(void)
+{
+    unsigned long *val, count = 0;
+
+    while((val = cpqueue_pop(test_cpqueue)) != NULL) {
+        assert_true(*val < 10000);
+        count++;
+        free(val);
+    }
+
+    assert_true(count == 10000);
+    assert_true(cpqueue_is_empty(test_cpqueue));
+}
+
+void test_fixture_cpqueue_pop(void)
+{
+    test_fixture_start();
+
+    fixture_setup(cpqueue_setup_strict);
+    fixture_teardown(cpqueue_teardown);
+    run_test(test_cpqueue_strict_pop_until_empty);
+
+    fixture_setup(cpqueue_setup_relaxed);
+    run_test(test_cpqueue_relaxed_pop_until_empty);
+
+    test_fixture_end();
+}
+
+
+/* Each thread pushes its own slice of thread_items, interleaving pops
+ * of whatever any thread has pushed.
+ */
+static void* cpqueue_worker(void *arg)
+{
+    unsigned long i, first, *val;
+
+    first = (unsigned long)(size_t)arg * ITEMS_PER_THREAD;
+
+    for(i = first; i < first + ITEMS_PER_THREAD; i++) {
+        cpqueue_push(test_cpqueue, &thread_items[i]);
+
+        if(i % 2 == 0) {
+            val = cpqueue_pop(test_cpqueue);
+            if(val != NULL) {
+                times_popped[val - thread_items]++;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void test_cpqueue_threads(CPQUEUE_MODE mode)
+{
+    pthread_t threads[NUM_THREADS];
+    unsigned long i, *val;
+
+    test_cpqueue = cpqueue_create((CompareFn)ulong_compare, mode,
+            2 * NUM_THREADS);
+    assert_true(test_cpqueue != NULL);
+
+    for(i = 0; i < NUM_THREADS * ITEMS_PER_THREAD; i++) {
+        thread_items[i] = rand() % 100000;
+        times_popped[i] = 0;
+    }
+
+    for(i = 0; i < NUM_THREADS; i++) {
+        assert_true(pthread_create(&threads[i], NULL, cpqueue_worker,
+                    (void *)(size_t)i) == 0);
+    }
+
+    for(i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    while((val = cpqueue_pop(test_cpqueue)) != NULL) {
+        times_popped[val - thread_items]++;
+    }
+
+    /* Nothing lost, nothing duplicated */
+    for(i = 0; i < NUM_THREADS * ITEMS_PER_THREAD; i++) {
+        assert_true(times_popped[i] == 1);
+    }
+
+    cpqueue_free(test_cpqueue);
+    test_cpqueue = NULL;
+}
+
+void test_cpqueue_threads_strict(void)
+{
+    test_cpqueue_threads(CPQUEUE_STRICT);
+}
+
+void test_cpqueue_threads_relaxed(void)
+{
+    test_cpqueue_threads(CPQUEUE_RELAXED);
+}
+
+void test_fixture_cpqueue_threads(void)
+{
+    test_fixture_start();
+    run_test(test_cpqueue_threads_strict);
+    run_test(test_cpqueue_threads_relaxed);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_cpqueue_create();
+    test_fixture_cpqueue_pop();
+    test_fixture_cpqueue_threads();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
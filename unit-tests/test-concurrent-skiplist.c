@@ -0,0 +1,499 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/concurrent_skiplist.h>
+
+#define KEY_RANGE           5000
+
+#define NUM_WRITERS         4
+#define NUM_READERS         2
+#define KEYS_PER_WRITER     20000
+#define STABLE_KEYS         5000
+
+#define NUM_TOGGLERS        4
+#define TOGGLE_KEYS         64
+#define TOGGLES             100000
+
+static CSkipList *test_list = NULL;
+
+/* Keys written by each writer thread, followed by keys that are present
+ * throughout, which the reader threads look up and scan.
+ */
+static unsigned long thread_keys[NUM_WRITERS * KEYS_PER_WRITER + STABLE_KEYS];
+/* Only accessed through the __atomic builtins, as readers poll it */
+static int writers_done;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+struct scan_state {
+    unsigned long last;
+    unsigned long count;
+    unsigned long stop_after;
+    int check_found;
+    int in_order;
+};
+
+static void scan_init(struct scan_state *state, unsigned long stop_after)
+{
+    state->last = 0;
+    state->count = 0;
+    state->stop_after = stop_after;
+    state->check_found = 1;
+    state->in_order = 1;
+}
+
+/* Checks keys come in increasing order, and, unless other threads may
+ * be removing them, that each is still found while the scan is on.
+ */
+static int scan_visit(const void *key, void *value, void *data)
+{
+    struct scan_state *state = data;
+    unsigned long k = *(const unsigned long *)key;
+
+    if((state->count > 0 && k <= state->last) ||
+            (state->check_found && cskiplist_get(test_list, key) != value)) {
+        state->in_order = 0;
+    }
+
+    state->last = k;
+    state->count++;
+
+    return (state->count == state->stop_after);
+}
+
+static void check_contents(CSkipList *list, const char *present,
+        unsigned long range)
+{
+    struct scan_state state;
+    unsigned long key, n, *val;
+
+    for(n = 0, key = 0; key < range; key++) {
+        val = cskiplist_get(list, &key);
+        if(present[key]) {
+            assert_true(val != NULL);
+            assert_ulong_equal(key, *val);
+            n++;
+        } else {
+            assert_true(NULL == val);
+        }
+    }
+
+    assert_ulong_equal(n, cskiplist_size(list));
+
+    scan_init(&state, 0);
+    assert_ulong_equal(n, cskiplist_scan(list, NULL, NULL, scan_visit,
+                &state));
+    assert_true(state.in_order);
+}
+
+
+void test_cskiplist_create(void)
+{
+    unsigned long key = 1;
+    struct scan_state state;
+
+    test_list = cskiplist_create((CompareFn)ulong_compare);
+
+    assert_true(test_list != NULL);
+    assert_ulong_equal(0, cskiplist_size(test_list));
+    assert_true(cskiplist_is_empty(test_list));
+    assert_true(cskiplist_get(test_list, &key) == NULL);
+    assert_true(cskiplist_remove(test_list, &key) == NULL);
+
+    scan_init(&state, 0);
+    assert_ulong_equal(0, cskiplist_scan(test_list, NULL, NULL, scan_visit,
+                &state));
+
+    cskiplist_free(test_list);
+    test_list = NULL;
+}
+
+void test_fixture_cskiplist_create(void)
+{
+    test_fixture_start();
+    run_test(test_cskiplist_create);
+    test_fixture_end();
+}
+
+
+/* Single threaded, with enough removals for nodes to be freed */
+void test_cskiplist_random_insert_and_remove(void)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, key, n, *val;
+
+    test_list = cskiplist_create((CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+    n = 0;
+
+    for(i = 0; i < 100000; i++) {
+        key = rand() % KEY_RANGE;
+
+        if(rand() % 100 < ((i / 25000) % 2 ? 30 : 70)) {
+            val = make_ulong_ptr(key);
+            if(cskiplist_insert(test_list, val, val) == 0) {
+                assert_false(present[key]);
+                present[key] = 1;
+                n++;
+            } else {
+                assert_true(present[key]);
+                free(val);
+            }
+        } else {
+            val = cskiplist_remove(test_list, &key);
+            if(val != NULL) {
+                assert_true(present[key]);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        }
+
+        assert_ulong_equal(n, cskiplist_size(test_list));
+        if(i % 10000 == 0) {
+            check_contents(test_list, present, KEY_RANGE);
+        }
+    }
+
+    check_contents(test_list, present, KEY_RANGE);
+
+    cskiplist_free_all(test_list, NULL);
+    test_list = NULL;
+}
+
+void test_fixture_cskiplist_random_insert_and_remove(void)
+{
+    test_fixture_start();
+    run_test(test_cskiplist_random_insert_and_remove);
+    test_fixture_end();
+}
+
+
+void test_cskiplist_scan(void)
+{
+    static unsigned long keys[1000];
+    struct scan_state state;
+    unsigned long i, lo, hi, n;
+
+    test_list = cskiplist_create((CompareFn)ulong_compare);
+
+    /* Only even keys */
+    for(i = 0; i < 1000; i++) {
+        keys[i] = 2 * i;
+        assert_int_equal(0, cskiplist_insert(test_list, &keys[i],
+                    &keys[i]));
+    }
+
+    for(i = 0; i < 1000; i++) {
+        lo = rand() % 2000;
+        hi = rand() % 2000;
+        n = (hi > lo) ? (hi + 1) / 2 - (lo + 1) / 2 : 0;
+
+        scan_init(&state, 0);
+        assert_ulong_equal(n, cskiplist_scan(test_list, &lo, &hi,
+                    scan_visit, &state));
+        assert_true(state.in_order);
+        if(n > 0) {
+            assert_ulong_equal(2 * ((hi + 1) / 2) - 2, state.last);
+        }
+    }
+
+    lo = 1001;
+    scan_init(&state, 0);
+    assert_ulong_equal(499, cskiplist_scan(test_list, &lo, NULL,
+                scan_visit, &state));
+    assert_ulong_equal(1998, state.last);
+
+    scan_init(&state, 0);
+    assert_ulong_equal(501, cskiplist_scan(test_list, NULL, &lo,
+                scan_visit, &state));
+    assert_ulong_equal(1000, state.last);
+
+    /* Stopped by the callback */
+    scan_init(&state, 10);
+    assert_ulong_equal(10, cskiplist_scan(test_list, NULL, NULL,
+                scan_visit, &state));
+    assert_ulong_equal(18, state.last);
+
+    cskiplist_free(test_list);
+    test_list = NULL;
+}
+
+void test_fixture_cskiplist_scan(void)
+{
+    test_fixture_start();
+    run_test(test_cskiplist_scan);
+    test_fixture_end();
+}
+
+
+/* Each writer inserts its own keys, removes every other one, and puts
+ * back every fourth.
+ */
+static void* cskiplist_writer(void *arg)
+{
+    unsigned long i, first, failures = 0;
+
+    first = (unsigned long)(size_t)arg * KEYS_PER_WRITER;
+
+    for(i = first; i < first + KEYS_PER_WRITER; i++) {
+        failures += (cskiplist_insert(test_list, &thread_keys[i],
+                    &thread_keys[i]) != 0);
+    }
+
+    for(i = first; i < first + KEYS_PER_WRITER; i += 2) {
+        failures += (cskiplist_remove(test_list, &thread_keys[i]) !=
+                &thread_keys[i]);
+    }
+
+    for(i = first; i < first + KEYS_PER_WRITER; i += 4) {
+        failures += (cskiplist_insert(test_list, &thread_keys[i],
+                    &thread_keys[i]) != 0);
+    }
+
+    return (void *)(size_t)failures;
+}
+
+/* Stable keys must be found at every moment, by lookups and by scans of
+ * their range, whatever the writers are doing.
+ */
+static void* cskiplist_reader(void *arg)
+{
+    struct scan_state state;
+    unsigned long i, key, failures = 0;
+
+    do {
+        for(i = 0; i < STABLE_KEYS; i++) {
+            key = NUM_WRITERS * KEYS_PER_WRITER + i;
+            failures += (cskiplist_get(test_list, &key) !=
+                    &thread_keys[key]);
+        }
+
+        scan_init(&state, 0);
+        key = NUM_WRITERS * KEYS_PER_WRITER;
+        failures += (cskiplist_scan(test_list, &key, NULL, scan_visit,
+                    &state) != STABLE_KEYS);
+        failures += !state.in_order;
+
+        /* Whatever the writers leave, a full scan is in order */
+        scan_init(&state, 0);
+        state.check_found = 0;
+        cskiplist_scan(test_list, NULL, NULL, scan_visit, &state);
+        failures += !state.in_order;
+    } while(!__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE));
+
+    return (void *)(size_t)failures;
+}
+
+void test_cskiplist_threads(void)
+{
+    pthread_t writers[NUM_WRITERS], readers[NUM_READERS];
+    unsigned long i, n;
+    void *failures;
+
+    test_list = cskiplist_create((CompareFn)ulong_compare);
+    assert_true(test_list != NULL);
+
+    for(i = 0; i < NUM_WRITERS * KEYS_PER_WRITER + STABLE_KEYS; i++) {
+        thread_keys[i] = i;
+    }
+    for(i = 0; i < STABLE_KEYS; i++) {
+        n = NUM_WRITERS * KEYS_PER_WRITER + i;
+        assert_int_equal(0, cskiplist_insert(test_list, &thread_keys[n],
+                    &thread_keys[n]));
+    }
+
+    __atomic_store_n(&writers_done, 0, __ATOMIC_RELEASE);
+    for(i = 0; i < NUM_READERS; i++) {
+        assert_true(pthread_create(&readers[i], NULL, cskiplist_reader,
+                    NULL) == 0);
+    }
+    for(i = 0; i < NUM_WRITERS; i++) {
+        assert_true(pthread_create(&writers[i], NULL, cskiplist_writer,
+                    (void *)(size_t)i) == 0);
+    }
+
+    for(i = 0; i < NUM_WRITERS; i++) {
+        pthread_join(writers[i], &failures);
+        assert_true(NULL == failures);
+    }
+    __atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+    for(i = 0; i < NUM_READERS; i++) {
+        pthread_join(readers[i], &failures);
+        assert_true(NULL == failures);
+    }
+
+    /* Only keys that are 2 mod 4 have gone, besides the stable ones */
+    for(n = 0, i = 0; i < NUM_WRITERS * KEYS_PER_WRITER + STABLE_KEYS; i++) {
+        if(i >= NUM_WRITERS * KEYS_PER_WRITER || i % 4 != 2) {
+            assert_true(cskiplist_get(test_list, &i) == &thread_keys[i]);
+            n++;
+        } else {
+            assert_true(cskiplist_get(test_list, &i) == NULL);
+        }
+    }
+    assert_ulong_equal(n, cskiplist_size(test_list));
+
+    cskiplist_free(test_list);
+    test_list = NULL;
+}
+
+void test_fixture_cskiplist_threads(void)
+{
+    test_fixture_start();
+    run_test(test_cskiplist_threads);
+    test_fixture_end();
+}
+
+
+struct toggler {
+    pthread_t thread;
+    unsigned long seed;
+
+    /* Successful insertions less successful removals, per key */
+    long net[TOGGLE_KEYS];
+};
+
+/* Threads insert and remove the same few keys, so that removals often
+ * catch nodes still being linked.
+ */
+static void* cskiplist_toggler(void *arg)
+{
+    struct toggler *t = arg;
+    unsigned long i, k;
+
+    for(i = 0; i < TOGGLES; i++) {
+        t->seed = t->seed * 1103515245UL + 12345UL;
+        k = (t->seed >> 16) % TOGGLE_KEYS;
+
+        if(t->seed & 0x10000000UL) {
+            t->net[k] += (cskiplist_insert(test_list, &thread_keys[k],
+                        &thread_keys[k]) == 0);
+        } else {
+            t->net[k] -= (cskiplist_remove(test_list, &thread_keys[k]) !=
+                    NULL);
+        }
+    }
+
+    return NULL;
+}
+
+void test_cskiplist_contention(void)
+{
+    static struct toggler togglers[NUM_TOGGLERS];
+    unsigned long i, k, n;
+    long net;
+
+    test_list = cskiplist_create((CompareFn)ulong_compare);
+
+    for(k = 0; k < TOGGLE_KEYS; k++) {
+        thread_keys[k] = k;
+    }
+
+    for(i = 0; i < NUM_TOGGLERS; i++) {
+        memset(togglers[i].net, 0, sizeof(togglers[i].net));
+        togglers[i].seed = rand();
+        assert_true(pthread_create(&togglers[i].thread, NULL,
+                    cskiplist_toggler, &togglers[i]) == 0);
+    }
+    for(i = 0; i < NUM_TOGGLERS; i++) {
+        pthread_join(togglers[i].thread, NULL);
+    }
+
+    /* Every key ends up inserted once more than removed, or as often */
+    for(n = 0, k = 0; k < TOGGLE_KEYS; k++) {
+        for(net = 0, i = 0; i < NUM_TOGGLERS; i++) {
+            net += togglers[i].net[k];
+        }
+
+        assert_true(0 == net || 1 == net);
+        assert_true((cskiplist_get(test_list, &k) != NULL) == (1 == net));
+        n += net;
+    }
+    assert_ulong_equal(n, cskiplist_size(test_list));
+
+    cskiplist_free(test_list);
+    test_list = NULL;
+}
+
+void test_fixture_cskiplist_contention(void)
+{
+    test_fixture_start();
+    run_test(test_cskiplist_contention);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_cskiplist_create();
+    test_fixture_cskiplist_random_insert_and_remove();
+    test_fixture_cskiplist_scan();
+    test_fixture_cskiplist_threads();
+    test_fixture_cskiplist_contention();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,314 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/hashtable.h>
+#include <libcore/macros.h>
+#include <libcore/utilities.h>
+
+#define ARRAY_LEN(x)    sizeof((x)) / sizeof((x)[0])
+
+#define KEY_RANGE   50000
+
+static HashTable *test_table = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Only 64 distinct hashes, for long probe sequences */
+unsigned long ulong_hash_poor(const unsigned long *x)
+{
+    return *x % 64;
+}
+
+/* Home slots at the end of the array whatever its size, so that probe
+ * sequences wrap around to the start
+ */
+unsigned long ulong_hash_wrap(const unsigned long *x)
+{
+    return ~(*x % 64);
+}
+
+/* Iteration visits each of present once, and nothing else */
+static void check_contents(HashTable *table, const char *present,
+        unsigned long range)
+{
+    static char seen[KEY_RANGE];
+    HashTableIterator *it;
+    unsigned long key, n;
+
+    memset(seen, 0, sizeof(seen));
+
+    for(n = 0, it = hashtable_begin(table); it != NULL;
+            n++, it = hashtable_next(it)) {
+        key = *(const unsigned long *)hashtable_get_key(it);
+        assert_true(hashtable_get_key(it) == hashtable_get_value(it));
+        assert_true(present[key]);
+        assert_false(seen[key]);
+        seen[key] = 1;
+    }
+    assert_ulong_equal(hashtable_size(table), n);
+
+    for(key = 0; key < range; key++) {
+        assert_true(present[key] == (hashtable_find(table, &key) != NULL));
+    }
+}
+
+
+void test_hashtable_create(void)
+{
+    test_table = hashtable_create(util_hash_ulong, (CompareFn)ulong_compare);
+
+    assert_true(test_table != NULL);
+    assert_ulong_equal(0, hashtable_size(test_table));
+    assert_true(hashtable_is_empty(test_table));
+    assert_true(hashtable_begin(test_table) == NULL);
+
+    hashtable_free(test_table);
+    test_table = NULL;
+}
+
+void test_fixture_hashtable_create(void)
+{
+    test_fixture_start();
+    run_test(test_hashtable_create);
+    test_fixture_end();
+}
+
+
+/* Inserts and removals interleave with incremental growth; removed
+ * keys are freed straight away so that a memory checker catches any
+ * stale slot.
+ */
+static void random_insert_and_remove(HashFn hashfn, unsigned long range,
+        unsigned long count)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, key, n, *val;
+
+    test_table = hashtable_create(hashfn, (CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+    n = 0;
+
+    for(i = 0; i < count; i++) {
+        key = rand() % range;
+
+        if(rand() % 100 < ((i / (count / 4)) % 2 ? 30 : 70)) {
+            val = make_ulong_ptr(key);
+            if(hashtable_insert(test_table, val, val) == 0) {
+                assert_false(present[key]);
+                present[key] = 1;
+                n++;
+            } else {
+                assert_true(present[key]);
+                free(val);
+            }
+        } else {
+            val = hashtable_remove(test_table, &key);
+            if(val != NULL) {
+                assert_true(present[key]);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        }
+
+        assert_ulong_equal(n, hashtable_size(test_table));
+        if(i % (count / 10) == 0) {
+            check_contents(test_table, present, range);
+        }
+    }
+
+    check_contents(test_table, present, range);
+
+    /* Empty it again through iterators */
+    while(!hashtable_is_empty(test_table)) {
+        free(hashtable_remove_at(test_table, hashtable_begin(test_table)));
+    }
+
+    hashtable_free(test_table);
+    test_table = NULL;
+}
+
+void test_hashtable_random_insert_and_remove(void)
+{
+    random_insert_and_remove(util_hash_ulong, KEY_RANGE, 400000);
+}
+
+void test_hashtable_poor_hash(void)
+{
+    random_insert_and_remove((HashFn)ulong_hash_poor, 2000, 20000);
+}
+
+void test_hashtable_wrapping_hash(void)
+{
+    random_insert_and_remove((HashFn)ulong_hash_wrap, 2000, 20000);
+}
+
+/* Removing from the old array while its wrapped probe sequences are
+ * partly migrated
+ */
+void test_hashtable_wrapping_remove(void)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, key, *val;
+
+    test_table = hashtable_create((HashFn)ulong_hash_wrap,
+            (CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+
+    /* Every key in one sequence from the last slot, and the last key
+     * starts growing
+     */
+    for(i = 1; i <= 13; i++) {
+        val = make_ulong_ptr(i * 64);
+        assert_int_equal(0, hashtable_insert(test_table, val, val));
+        present[i * 64] = 1;
+    }
+
+    for(i = 1; i <= 13; i++) {
+        key = i * 64;
+        val = hashtable_remove(test_table, &key);
+        assert_true(val != NULL);
+        free(val);
+        present[key] = 0;
+        check_contents(test_table, present, 14 * 64);
+    }
+
+    hashtable_free(test_table);
+    test_table = NULL;
+}
+
+void test_fixture_hashtable_random_insert_and_remove(void)
+{
+    test_fixture_start();
+    run_test(test_hashtable_random_insert_and_remove);
+    run_test(test_hashtable_poor_hash);
+    run_test(test_hashtable_wrapping_hash);
+    run_test(test_hashtable_wrapping_remove);
+    test_fixture_end();
+}
+
+
+/* Every step of a migration leaves the table consistent */
+void test_hashtable_growth(void)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, *val;
+
+    test_table = hashtable_create(util_hash_ulong, (CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+
+    for(i = 0; i < 2000; i++) {
+        val = make_ulong_ptr(i);
+        assert_int_equal(0, hashtable_insert(test_table, val, val));
+        present[i] = 1;
+        check_contents(test_table, present, i + 1);
+    }
+
+    hashtable_free_all(test_table, NULL);
+    test_table = NULL;
+}
+
+void test_hashtable_string_keys(void)
+{
+    char *words[] = {"alpha", "beta", "gamma", "delta", "epsilon"};
+    char key[16];
+    unsigned long i;
+
+    test_table = hashtable_create(util_hash_string, (CompareFn)strcmp);
+
+    for(i = 0; i < ARRAY_LEN(words); i++) {
+        assert_int_equal(0, hashtable_insert(test_table, words[i], words[i]));
+    }
+
+    for(i = 0; i < ARRAY_LEN(words); i++) {
+        /* A copy hashes and compares the same */
+        strcpy(key, words[i]);
+        assert_true(hashtable_get_value(hashtable_find(test_table, key)) ==
+                words[i]);
+    }
+    assert_true(hashtable_find(test_table, "zeta") == NULL);
+
+    hashtable_free(test_table);
+    test_table = NULL;
+}
+
+void test_fixture_hashtable_growth(void)
+{
+    test_fixture_start();
+    run_test(test_hashtable_growth);
+    run_test(test_hashtable_string_keys);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_hashtable_create();
+    test_fixture_hashtable_random_insert_and_remove();
+    test_fixture_hashtable_growth();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -548,6 +548,207 @@ void test_fixture_heap_merge(void)
 }
 
 
+void test_heap_create_dary_invalid(void)
+{
+    assert_true(heap_create_dary((CompareFn)ulong_compare, 0) == NULL);
+    assert_true(heap_create_dary((CompareFn)ulong_compare, 3) == NULL);
+    assert_true(heap_create_dary((CompareFn)ulong_compare, 16) == NULL);
+}
+
+static void check_dary_push_pop(unsigned int arity)
+{
+    unsigned long i, *val, *mid, old_val;
+
+    test_heap = heap_create_dary((CompareFn)ulong_compare, arity);
+    assert_true(test_heap != NULL);
+    assert_true(heap_arity(test_heap) == arity);
+
+    mid = NULL;
+    for(i = 0; i < 100000; i++) {
+        val = make_ulong_ptr(rand() % 100000);
+        if(val != NULL) {
+            assert_true(heap_push(test_heap, val) == 0);
+            if(i == 50000) {
+                mid = val;
+            }
+        }
+    }
+
+    assert_true(heap_is_valid(test_heap));
+    assert_true(heap_size(test_heap) == 100000);
+
+    /* Remove an interior element; the heap must stay valid */
+    assert_true(heap_remove(test_heap, mid) == 0);
+    assert_true(heap_is_valid(test_heap));
+    assert_true(heap_size(test_heap) == 99999);
+    free(mid);
+
+    old_val = *(unsigned long *)heap_top(test_heap);
+    while(!heap_is_empty(test_heap)) {
+        val = heap_pop(test_heap);
+        assert_true(val != NULL);
+        assert_true(ulong_compare(&old_val, val) >= 0);
+        old_val = *val;
+        free(val);
+    }
+
+    assert_true(heap_size(test_heap) == 0);
+
+    heap_free(test_heap);
+    test_heap = NULL;
+}
+
+void test_heap_dary_4(void)
+{
+    check_dary_push_pop(4);
+}
+
+void test_heap_dary_8(void)
+{
+    check_dary_push_pop(8);
+}
+
+void test_heap_dary_merge(void)
+{
+    unsigned long i, *val;
+
+    test_heap = heap_create_dary((CompareFn)ulong_compare, 4);
+    test_heap2 = heap_create_dary((CompareFn)ulong_compare, 4);
+
+    for(i = 0; i < 1000; i++) {
+        heap_push(test_heap, make_ulong_ptr(rand() % 1000));
+        heap_push(test_heap2, make_ulong_ptr(rand() % 1000));
+    }
+
+    assert_true(heap_merge(test_heap, test_heap2) == 0);
+    assert_true(heap_is_valid(test_heap));
+    assert_true(heap_size(test_heap) == 2000);
+
+    val = heap_pop(test_heap);
+    assert_true(heap_is_valid(test_heap));
+    free(val);
+
+    heap_free_all(test_heap, NULL);
+    heap_free(test_heap2);
+    test_heap = test_heap2 = NULL;
+}
+
+void test_fixture_heap_dary(void)
+{
+    test_fixture_start();
+
+    run_test(test_heap_create_dary_invalid);
+    run_test(test_heap_dary_4);
+    run_test(test_heap_dary_8);
+    run_test(test_heap_dary_merge);
+
+    test_fixture_end();
+}
+
+
+void test_heap_create_from_darray(void)
+{
+    unsigned long i, *val, old_val;
+    DArray *items;
+
+    items = darray_create();
+    for(i = 0; i < 100000; i++) {
+        darray_append(items, make_ulong_ptr(rand() % 100000));
+    }
+
+    test_heap = heap_create_from_darray((CompareFn)ulong_compare, 4, items);
+    assert_true(test_heap != NULL);
+    assert_true(heap_size(test_heap) == 100000);
+    assert_true(heap_is_valid(test_heap));
+
+    old_val = *(unsigned long *)heap_top(test_heap);
+    while(!heap_is_empty(test_heap)) {
+        val = heap_pop(test_heap);
+        assert_true(ulong_compare(&old_val, val) >= 0);
+        old_val = *val;
+        free(val);
+    }
+
+    /* Frees items as well */
+    heap_free(test_heap);
+    test_heap = NULL;
+}
+
+void test_heap_push_many_small(void)
+{
+    unsigned long i, old_size;
+    DArray *items;
+
+    old_size = heap_size(test_heap);
+
+    items = darray_create();
+    for(i = 0; i < 100; i++) {
+        darray_append(items, make_ulong_ptr(rand() % 100000));
+    }
+
+    assert_true(heap_push_many(test_heap, items) == 0);
+    assert_true(heap_size(test_heap) == old_size + 100);
+    assert_true(heap_is_valid(test_heap));
+
+    /* The items are now owned by the heap */
+    darray_free(items);
+}
+
+void test_heap_push_many_large(void)
+{
+    unsigned long i, old_size;
+    DArray *items;
+
+    old_size = heap_size(test_heap);
+
+    items = darray_create();
+    for(i = 0; i < 200000; i++) {
+        darray_append(items, make_ulong_ptr(rand() % 100000));
+    }
+
+    assert_true(heap_push_many(test_heap, items) == 0);
+    assert_true(heap_size(test_heap) == old_size + 200000);
+    assert_true(heap_is_valid(test_heap));
+
+    darray_free(items);
+}
+
+void test_heap_sort(void)
+{
+    unsigned long i;
+    DArray *items;
+
+    items = darray_create();
+    assert_true(heap_sort(items, (CompareFn)ulong_compare) == -1);
+
+    for(i = 0; i < 100000; i++) {
+        darray_append(items, make_ulong_ptr(rand() % 100000));
+    }
+
+    assert_true(heap_sort(items, (CompareFn)ulong_compare) == 0);
+    assert_true(darray_size(items) == 100000);
+    assert_true(darray_is_sorted(items, (CompareFn)ulong_compare));
+
+    darray_free_all(items, NULL);
+}
+
+void test_fixture_heap_bulk(void)
+{
+    test_fixture_start();
+
+    run_test(test_heap_create_from_darray);
+    run_test(test_heap_sort);
+
+    fixture_setup(heap_setup_ints_random);
+    fixture_teardown(heap_teardown);
+
+    run_test(test_heap_push_many_small);
+    run_test(test_heap_push_many_large);
+
+    test_fixture_end();
+}
+
+
 void all_tests(void)
 {
     test_fixture_heap_create();
@@ -556,6 +757,8 @@ void all_tests(void)
     test_fixture_heap_top();
     test_fixture_heap_remove();
     test_fixture_heap_merge();
+    test_fixture_heap_dary();
+    test_fixture_heap_bulk();
 }
 
 int main(int argc, char *argv[])
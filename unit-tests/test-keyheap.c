@@ -0,0 +1,180 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/keyheap.h>
+
+static KeyHeap *test_heap = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* Test fixture setup and teardown */
+
+void keyheap_setup_random(void)
+{
+    unsigned long i, *val;
+
+    test_heap = keyheap_create();
+    assert_true(test_heap != NULL);
+    assert_true(keyheap_is_empty(test_heap));
+
+    for(i = 0; i < 100000; i++) {
+        val = make_ulong_ptr(rand() % 100000);
+        if(val != NULL) {
+            keyheap_push(test_heap, (double)*val, val);
+        }
+    }
+
+    assert_true(keyheap_is_valid(test_heap));
+    assert_true(keyheap_size(test_heap) == 100000);
+}
+
+void keyheap_teardown(void)
+{
+    keyheap_free_all(test_heap, NULL);
+    test_heap = NULL;
+}
+
+
+void test_keyheap_create(void)
+{
+    test_heap = keyheap_create();
+
+    assert_true(test_heap != NULL);
+    assert_true(keyheap_size(test_heap) == 0);
+    assert_true(keyheap_is_empty(test_heap));
+    assert_true(keyheap_top(test_heap, NULL) == NULL);
+    assert_true(keyheap_pop(test_heap, NULL) == NULL);
+
+    keyheap_free(test_heap);
+    test_heap = NULL;
+}
+
+void test_fixture_keyheap_create(void)
+{
+    test_fixture_start();
+    run_test(test_keyheap_create);
+    test_fixture_end();
+}
+
+
+void test_keyheap_push_existing(void)
+{
+    unsigned long *val, old_size;
+    double key;
+
+    old_size = keyheap_size(test_heap);
+
+    val = make_ulong_ptr(0);
+    assert_true(keyheap_push(test_heap, -1.5, val) == 0);
+
+    assert_true(keyheap_size(test_heap) == old_size + 1);
+    assert_true(keyheap_is_valid(test_heap));
+    assert_true(keyheap_top(test_heap, &key) == val);
+    assert_double_equal(-1.5, key, 0.0);
+}
+
+void test_keyheap_pop_until_empty(void)
+{
+    unsigned long *val;
+    double key, old_key;
+
+    keyheap_top(test_heap, &old_key);
+    while(!keyheap_is_empty(test_heap)) {
+        val = keyheap_pop(test_heap, &key);
+
+        assert_true(val != NULL);
+        assert_true(old_key <= key);
+        assert_double_equal((double)*val, key, 0.0);
+
+        old_key = key;
+        free(val);
+    }
+
+    assert_true(keyheap_size(test_heap) == 0);
+}
+
+void test_keyheap_remove(void)
+{
+    unsigned long *val, old_size;
+
+    old_size = keyheap_size(test_heap);
+
+    val = make_ulong_ptr(42);
+    assert_true(keyheap_remove(test_heap, val) == -1);
+
+    keyheap_push(test_heap, 42.0, val);
+    assert_true(keyheap_remove(test_heap, val) == 0);
+    assert_true(keyheap_size(test_heap) == old_size);
+    assert_true(keyheap_is_valid(test_heap));
+
+    free(val);
+}
+
+void test_fixture_keyheap_operations(void)
+{
+    test_fixture_start();
+
+    fixture_setup(keyheap_setup_random);
+    fixture_teardown(keyheap_teardown);
+
+    run_test(test_keyheap_push_existing);
+    run_test(test_keyheap_pop_until_empty);
+    run_test(test_keyheap_remove);
+
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_keyheap_create();
+    test_fixture_keyheap_operations();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
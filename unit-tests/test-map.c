@@ -0,0 +1,310 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/map.h>
+
+#define KEY_RANGE   5000
+
+static unsigned long key_pool[KEY_RANGE];
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Counts in a freshly allocated counter for new keys */
+static void* count_upsert(void *value, void *data)
+{
+    unsigned long *count = value;
+
+    if(NULL == count) {
+        count = make_ulong_ptr(0);
+        (*(unsigned long *)data)++;
+    }
+    (*count)++;
+
+    return count;
+}
+
+/* Counting with each of the three calls gives the same counts */
+static void check_counting(Map* (*create)(CompareFn))
+{
+    static unsigned long expected[KEY_RANGE];
+    Map *map1, *map2, *map3;
+    unsigned long i, key, new_keys, *count, *zero;
+    void *old_value;
+    int inserted, ret;
+
+    for(i = 0; i < KEY_RANGE; i++) {
+        key_pool[i] = i;
+        expected[i] = 0;
+    }
+
+    map1 = create((CompareFn)ulong_compare);
+    map2 = create((CompareFn)ulong_compare);
+    map3 = create((CompareFn)ulong_compare);
+    new_keys = 0;
+
+    for(i = 0; i < 4 * KEY_RANGE; i++) {
+        key = rand() % KEY_RANGE;
+        expected[key]++;
+
+        zero = make_ulong_ptr(0);
+        count = map_get_or_insert(map1, &key_pool[key], zero, &inserted);
+        assert_int_equal(1 == expected[key], inserted);
+        assert_true(inserted == (count == zero));
+        if(!inserted) {
+            free(zero);
+        }
+        (*count)++;
+
+        ret = map_upsert(map2, &key_pool[key], count_upsert, &new_keys);
+        assert_int_equal(1 == expected[key], ret);
+
+        ret = map_insert_or_assign(map3, &key_pool[key],
+                make_ulong_ptr(expected[key]), &old_value);
+        assert_int_equal(1 == expected[key], ret);
+        if(ret) {
+            assert_true(NULL == old_value);
+        } else {
+            assert_ulong_equal(expected[key] - 1,
+                    *(unsigned long *)old_value);
+            free(old_value);
+        }
+    }
+
+    assert_ulong_equal(map_size(map1), new_keys);
+    assert_ulong_equal(map_size(map1), map_size(map2));
+    assert_ulong_equal(map_size(map1), map_size(map3));
+
+    for(key = 0; key < KEY_RANGE; key++) {
+        if(0 == expected[key]) {
+            assert_true(map_find(map1, &key) == NULL);
+            continue;
+        }
+
+        assert_ulong_equal(expected[key],
+                *(unsigned long *)map_get_value(map_find(map1, &key)));
+        assert_ulong_equal(expected[key],
+                *(unsigned long *)map_get_value(map_find(map2, &key)));
+        assert_ulong_equal(expected[key],
+                *(unsigned long *)map_get_value(map_find(map3, &key)));
+
+        /* The key first inserted stays */
+        assert_true(map_get_key(map_find(map1, &key)) == &key_pool[key]);
+    }
+
+    for(i = 0; i < map_size(map1); i++) {
+        free(map_get_value(map_select(map1, i)));
+        free(map_get_value(map_select(map2, i)));
+        free(map_get_value(map_select(map3, i)));
+    }
+    map_free(map1);
+    map_free(map2);
+    map_free(map3);
+}
+
+void test_map_counting_rbtree(void)
+{
+    check_counting(map_create);
+}
+
+void test_map_counting_btree(void)
+{
+    check_counting(map_create_btree);
+}
+
+/* Batched lookups find the same iterators as single ones */
+static void check_find_many(Map* (*create)(CompareFn))
+{
+    static unsigned long keys[KEY_RANGE];
+    static const void *key_ptrs[KEY_RANGE];
+    static MapIterator *its[KEY_RANGE];
+    Map *map;
+    unsigned long i, found;
+
+    map = create((CompareFn)ulong_compare);
+    assert_ulong_equal(0, map_find_many(map, key_ptrs, 0, its));
+
+    for(i = 0; i < KEY_RANGE; i++) {
+        key_pool[i] = 2 * i;
+        map_insert(map, &key_pool[i], &key_pool[i]);
+    }
+
+    for(i = 0; i < KEY_RANGE; i++) {
+        keys[i] = rand() % (2 * KEY_RANGE);
+        key_ptrs[i] = &keys[i];
+    }
+
+    found = map_find_many(map, key_ptrs, KEY_RANGE, its);
+    for(i = 0; i < KEY_RANGE; i++) {
+        assert_true(its[i] == map_find(map, &keys[i]));
+        if(its[i] != NULL) {
+            found--;
+        }
+    }
+    assert_ulong_equal(0, found);
+
+    map_free(map);
+}
+
+void test_map_find_many_rbtree(void)
+{
+    check_find_many(map_create);
+}
+
+void test_map_find_many_btree(void)
+{
+    check_find_many(map_create_btree);
+}
+
+void test_fixture_map_get_or_insert(void)
+{
+    test_fixture_start();
+    run_test(test_map_counting_rbtree);
+    run_test(test_map_counting_btree);
+    test_fixture_end();
+}
+
+void test_fixture_map_find_many(void)
+{
+    test_fixture_start();
+    run_test(test_map_find_many_rbtree);
+    run_test(test_map_find_many_btree);
+    test_fixture_end();
+}
+
+/* Adds one to the count stored inline */
+static void* count_inline(void *value, void *data)
+{
+    unsigned long *count = data;
+
+    *count = (NULL == value) ? 1 : *(unsigned long *)value + 1;
+
+    return count;
+}
+
+void test_map_inline(void)
+{
+    static unsigned long expected[KEY_RANGE];
+    Map *map;
+    MapIterator *it;
+    unsigned long i, key, count, *value;
+
+    for(i = 0; i < KEY_RANGE; i++) {
+        key_pool[i] = i;
+        expected[i] = 0;
+    }
+
+    map = map_create_inline((CompareFn)ulong_compare, sizeof(unsigned long));
+
+    for(i = 0; i < 4 * KEY_RANGE; i++) {
+        key = rand() % KEY_RANGE;
+        expected[key]++;
+        assert_int_equal(1 == expected[key],
+                map_upsert(map, &key_pool[key], count_inline, &count));
+    }
+
+    /* Values are copied in and out, so count can be reused */
+    for(key = 0; key < KEY_RANGE; key++) {
+        it = map_find(map, &key);
+        if(0 == expected[key]) {
+            assert_true(NULL == it);
+            count = key;
+            assert_int_equal(0, map_insert(map, &key_pool[key], &count));
+            continue;
+        }
+
+        value = map_get_value(it);
+        assert_ulong_equal(expected[key], *value);
+
+        count = 0;
+        value = map_set_value(map, it, &count);
+        assert_ulong_equal(expected[key], *value);
+        assert_ulong_equal(0, *(unsigned long *)map_get_value(it));
+    }
+
+    assert_ulong_equal(KEY_RANGE, map_size(map));
+
+    for(key = 0; key < KEY_RANGE; key++) {
+        value = map_remove(map, &key);
+        assert_true(value != NULL);
+        assert_ulong_equal(0 == expected[key] ? key : 0, *value);
+    }
+
+    assert_ulong_equal(0, map_size(map));
+
+    map_free_all(map, NULL);
+}
+
+void test_fixture_map_inline(void)
+{
+    test_fixture_start();
+    run_test(test_map_inline);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_map_get_or_insert();
+    test_fixture_map_find_many();
+    test_fixture_map_inline();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,232 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/minmax_heap.h>
+
+static MinMaxHeap *test_heap = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Test fixture setup and teardown */
+
+void mmheap_setup_ints_random(void)
+{
+    unsigned long i, *val;
+
+    test_heap = mmheap_create((CompareFn)ulong_compare);
+    assert_true(test_heap != NULL);
+    assert_true(mmheap_is_empty(test_heap));
+
+    for(i = 0; i < 100000; i++) {
+        val = make_ulong_ptr(rand() % 100000);
+        if(val != NULL) {
+            mmheap_push(test_heap, val);
+        }
+    }
+
+    assert_true(mmheap_is_valid(test_heap));
+    assert_true(mmheap_size(test_heap) == 100000);
+}
+
+void mmheap_teardown(void)
+{
+    mmheap_free_all(test_heap, NULL);
+    test_heap = NULL;
+}
+
+
+void test_mmheap_create(void)
+{
+    test_heap = mmheap_create((CompareFn)ulong_compare);
+
+    assert_true(test_heap != NULL);
+    assert_true(mmheap_size(test_heap) == 0);
+    assert_true(mmheap_is_empty(test_heap));
+    assert_true(mmheap_is_valid(test_heap));
+    assert_true(mmheap_top_min(test_heap) == NULL);
+    assert_true(mmheap_top_max(test_heap) == NULL);
+    assert_true(mmheap_pop_min(test_heap) == NULL);
+    assert_true(mmheap_pop_max(test_heap) == NULL);
+
+    mmheap_free(test_heap);
+    test_heap = NULL;
+}
+
+void test_fixture_mmheap_create(void)
+{
+    test_fixture_start();
+    run_test(test_mmheap_create);
+    test_fixture_end();
+}
+
+
+void test_mmheap_pop_min_until_empty(void)
+{
+    unsigned long *val, old_val;
+
+    old_val = *(unsigned long *)mmheap_top_min(test_heap);
+    while(!mmheap_is_empty(test_heap)) {
+        val = mmheap_pop_min(test_heap);
+        assert_true(val != NULL);
+        assert_true(old_val <= *val);
+        old_val = *val;
+        free(val);
+    }
+}
+
+void test_mmheap_pop_max_until_empty(void)
+{
+    unsigned long *val, old_val;
+
+    old_val = *(unsigned long *)mmheap_top_max(test_heap);
+    while(!mmheap_is_empty(test_heap)) {
+        val = mmheap_pop_max(test_heap);
+        assert_true(val != NULL);
+        assert_true(old_val >= *val);
+        old_val = *val;
+        free(val);
+    }
+}
+
+/* Pop from both ends, and push in between, checking that the extremes
+ * are always the true minimum and maximum.
+ */
+void test_mmheap_mixed(void)
+{
+    unsigned long i, *val, *min, *max;
+
+    for(i = 0; i < 50000; i++) {
+        min = mmheap_top_min(test_heap);
+        max = mmheap_top_max(test_heap);
+        assert_true(*min <= *max);
+
+        switch(rand() % 3) {
+            case 0:
+                val = mmheap_pop_min(test_heap);
+                assert_true(val == min);
+                free(val);
+                break;
+            case 1:
+                val = mmheap_pop_max(test_heap);
+                assert_true(val == max);
+                free(val);
+                break;
+            default:
+                mmheap_push(test_heap, make_ulong_ptr(rand() % 100000));
+                break;
+        }
+
+        if(i % 1000 == 0) {
+            assert_true(mmheap_is_valid(test_heap));
+        }
+    }
+
+    assert_true(mmheap_is_valid(test_heap));
+}
+
+void test_mmheap_small(void)
+{
+    unsigned long a = 1, b = 2, c = 3;
+
+    test_heap = mmheap_create((CompareFn)ulong_compare);
+
+    mmheap_push(test_heap, &b);
+    assert_true(mmheap_top_min(test_heap) == &b);
+    assert_true(mmheap_top_max(test_heap) == &b);
+
+    mmheap_push(test_heap, &c);
+    mmheap_push(test_heap, &a);
+    assert_true(mmheap_top_min(test_heap) == &a);
+    assert_true(mmheap_top_max(test_heap) == &c);
+
+    assert_true(mmheap_pop_max(test_heap) == &c);
+    assert_true(mmheap_pop_max(test_heap) == &b);
+    assert_true(mmheap_pop_min(test_heap) == &a);
+    assert_true(mmheap_is_empty(test_heap));
+
+    mmheap_free(test_heap);
+    test_heap = NULL;
+}
+
+void test_fixture_mmheap_pop(void)
+{
+    test_fixture_start();
+
+    run_test(test_mmheap_small);
+
+    fixture_setup(mmheap_setup_ints_random);
+    fixture_teardown(mmheap_teardown);
+
+    run_test(test_mmheap_pop_min_until_empty);
+    run_test(test_mmheap_pop_max_until_empty);
+    run_test(test_mmheap_mixed);
+
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_mmheap_create();
+    test_fixture_mmheap_pop();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,456 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/macros.h>
+#include <libcore/persistent_map.h>
+
+#define KEY_RANGE       2000
+#define NUM_SNAPSHOTS   20
+
+#define NUM_READERS     3
+#define WINDOW          100
+#define WRITER_STEPS    20000
+
+static PMap *test_pmap = NULL;
+
+static unsigned long keys[WRITER_STEPS];
+
+/* The latest snapshot of the writer's map, for readers to pick up */
+static PMap *published = NULL;
+static pthread_mutex_t published_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Only accessed through the __atomic builtins, as readers poll it */
+static int writer_done;
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Entries seen by a scan, which must come in key order */
+struct visited {
+    unsigned long keys[KEY_RANGE];
+    unsigned long n;
+    unsigned long stop_after;
+};
+
+static int visit(const void *key, void *value, void *data)
+{
+    struct visited *visited = data;
+
+    assert_true(key == value);
+    if(visited->n > 0) {
+        assert_true(visited->keys[visited->n - 1] <
+                *(const unsigned long *)key);
+    }
+    visited->keys[visited->n++] = *(const unsigned long *)key;
+
+    return (visited->n == visited->stop_after);
+}
+
+/* Keys come out of select and scan in order, each of present exactly
+ * once
+ */
+static void check_contents(PMap *map, const char *present)
+{
+    static struct visited visited;
+    const void *key;
+    void *value;
+    unsigned long k, n;
+
+    assert_true(pmap_is_valid(map));
+
+    visited.n = 0;
+    visited.stop_after = 0;
+    assert_ulong_equal(pmap_size(map),
+            pmap_scan(map, NULL, NULL, visit, &visited));
+    for(n = 0, k = 0; k < KEY_RANGE; k++) {
+        if(present[k]) {
+            assert_ulong_equal(k, visited.keys[n]);
+            n++;
+        }
+    }
+
+    for(n = 0, k = 0; k < KEY_RANGE; k++) {
+        assert_true(present[k] == pmap_contains(map, &k));
+        if(present[k]) {
+            assert_ulong_equal(n, pmap_rank(map, &k));
+            assert_int_equal(0, pmap_select(map, n, &key, &value));
+            assert_ulong_equal(k, *(const unsigned long *)key);
+            assert_true(key == value);
+            assert_true(pmap_get(map, &k) == value);
+            n++;
+        }
+    }
+
+    assert_ulong_equal(n, pmap_size(map));
+    assert_int_equal(-1, pmap_select(map, n, NULL, NULL));
+}
+
+
+void test_pmap_create(void)
+{
+    unsigned long key = 1;
+
+    test_pmap = pmap_create((CompareFn)ulong_compare);
+
+    assert_true(test_pmap != NULL);
+    assert_ulong_equal(0, pmap_size(test_pmap));
+    assert_true(pmap_is_empty(test_pmap));
+    assert_true(pmap_is_valid(test_pmap));
+    assert_true(pmap_get(test_pmap, &key) == NULL);
+    assert_true(pmap_remove(test_pmap, &key) == NULL);
+    assert_int_equal(-1, pmap_select(test_pmap, 0, NULL, NULL));
+
+    pmap_free(test_pmap);
+    test_pmap = NULL;
+}
+
+void test_fixture_pmap_create(void)
+{
+    test_fixture_start();
+    run_test(test_pmap_create);
+    test_fixture_end();
+}
+
+
+/* Snapshots taken along the way keep their contents while the map
+ * keeps changing, and are freed in random order.
+ */
+void test_pmap_snapshots(void)
+{
+    static char present[KEY_RANGE];
+    static char snapshot_present[NUM_SNAPSHOTS][KEY_RANGE];
+    static unsigned long values[KEY_RANGE];
+    PMap *snapshots[NUM_SNAPSHOTS];
+    unsigned long i, j, key, n;
+
+    test_pmap = pmap_create((CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+    for(key = 0; key < KEY_RANGE; key++) {
+        values[key] = key;
+    }
+    n = 0;
+
+    for(i = 0; i < NUM_SNAPSHOTS * 1000; i++) {
+        key = rand() % KEY_RANGE;
+
+        if(rand() % 100 < ((i / 5000) % 2 ? 30 : 70)) {
+            if(pmap_insert(test_pmap, &values[key], &values[key]) == 0) {
+                assert_false(present[key]);
+                present[key] = 1;
+                n++;
+            } else {
+                assert_true(present[key]);
+            }
+        } else {
+            if(pmap_remove(test_pmap, &key) != NULL) {
+                assert_true(present[key]);
+                present[key] = 0;
+                n--;
+            } else {
+                assert_false(present[key]);
+            }
+        }
+        assert_ulong_equal(n, pmap_size(test_pmap));
+
+        if(i % 1000 == 0) {
+            j = i / 1000;
+            snapshots[j] = pmap_snapshot(test_pmap);
+            memcpy(snapshot_present[j], present, KEY_RANGE);
+            check_contents(test_pmap, present);
+        }
+    }
+
+    check_contents(test_pmap, present);
+    for(j = 0; j < NUM_SNAPSHOTS; j++) {
+        check_contents(snapshots[j], snapshot_present[j]);
+    }
+
+    /* Changing a snapshot leaves the map alone */
+    key = 0;
+    j = 0;
+    if(snapshot_present[j][key]) {
+        assert_true(pmap_remove(snapshots[j], &key) == &values[key]);
+    } else {
+        assert_int_equal(0, pmap_insert(snapshots[j], &values[key],
+                    &values[key]));
+    }
+    snapshot_present[j][key] = !snapshot_present[j][key];
+    check_contents(snapshots[j], snapshot_present[j]);
+    check_contents(test_pmap, present);
+
+    pmap_free(test_pmap);
+    test_pmap = NULL;
+
+    for(i = 0; i < NUM_SNAPSHOTS; i++) {
+        j = rand() % (NUM_SNAPSHOTS - i);
+        check_contents(snapshots[j], snapshot_present[j]);
+        pmap_free(snapshots[j]);
+        snapshots[j] = snapshots[NUM_SNAPSHOTS - i - 1];
+        memcpy(snapshot_present[j], snapshot_present[NUM_SNAPSHOTS - i - 1],
+                KEY_RANGE);
+    }
+}
+
+/* Ascending and descending runs exercise the rotations */
+void test_pmap_sequential(void)
+{
+    static char present[KEY_RANGE];
+    static unsigned long values[KEY_RANGE];
+    PMap *snapshot;
+    unsigned long key;
+
+    test_pmap = pmap_create((CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+
+    for(key = 0; key < KEY_RANGE; key++) {
+        values[key] = key;
+        assert_int_equal(0, pmap_insert(test_pmap, &values[key],
+                    &values[key]));
+        present[key] = 1;
+    }
+    check_contents(test_pmap, present);
+
+    snapshot = pmap_snapshot(test_pmap);
+    for(key = KEY_RANGE; key-- > 0; ) {
+        if(key % 3 != 0) {
+            assert_true(pmap_remove(test_pmap, &key) == &values[key]);
+            present[key] = 0;
+        }
+    }
+    check_contents(test_pmap, present);
+
+    memset(present, 1, sizeof(present));
+    check_contents(snapshot, present);
+
+    pmap_free(snapshot);
+    pmap_free(test_pmap);
+    test_pmap = NULL;
+}
+
+/* Removals recycle nodes as spares; those beyond what the next update
+ * needs are freed, so an emptied map holds on to next to nothing.
+ */
+void test_pmap_spares_bounded(void)
+{
+    static unsigned long values[100000];
+    unsigned long i;
+
+    test_pmap = pmap_create((CompareFn)ulong_compare);
+
+    for(i = 0; i < 100000; i++) {
+        values[i] = i;
+        assert_int_equal(0, pmap_insert(test_pmap, &values[i], &values[i]));
+    }
+    for(i = 0; i < 100000; i += 2) {
+        assert_true(pmap_remove(test_pmap, &values[i]) == &values[i]);
+    }
+    assert_true(pmap_is_valid(test_pmap));
+
+    for(i = 1; i < 100000; i += 2) {
+        assert_true(pmap_remove(test_pmap, &values[i]) == &values[i]);
+    }
+    assert_true(pmap_is_empty(test_pmap));
+    assert_true(pmap_is_valid(test_pmap));
+
+    pmap_free(test_pmap);
+    test_pmap = NULL;
+}
+
+/* Scans of part of a snapshot, while the map goes on changing */
+void test_pmap_scan(void)
+{
+    static unsigned long values[KEY_RANGE];
+    static struct visited visited;
+    PMap *snapshot;
+    unsigned long i, key, lo, hi, n;
+
+    test_pmap = pmap_create((CompareFn)ulong_compare);
+
+    /* Even keys only */
+    for(key = 0; key < KEY_RANGE; key++) {
+        values[key] = key;
+        if(key % 2 == 0) {
+            assert_int_equal(0, pmap_insert(test_pmap, &values[key],
+                        &values[key]));
+        }
+    }
+
+    snapshot = pmap_snapshot(test_pmap);
+    for(key = 0; key < KEY_RANGE; key += 4) {
+        pmap_remove(test_pmap, &values[key]);
+    }
+
+    for(i = 0; i < 100; i++) {
+        lo = rand() % KEY_RANGE;
+        hi = rand() % KEY_RANGE;
+
+        visited.n = 0;
+        visited.stop_after = 0;
+        n = pmap_scan(snapshot, &values[lo], &values[hi], visit, &visited);
+        assert_ulong_equal(visited.n, n);
+        assert_ulong_equal((lo < hi) ? (hi + 1) / 2 - (lo + 1) / 2 : 0, n);
+        if(n > 0) {
+            assert_ulong_equal(lo + lo % 2, visited.keys[0]);
+        }
+
+        /* Stopped early, and open at the lower end */
+        visited.n = 0;
+        visited.stop_after = 3;
+        n = pmap_scan(snapshot, NULL, &values[hi], visit, &visited);
+        assert_ulong_equal(MIN((hi + 1) / 2, 3), n);
+    }
+
+    pmap_free(snapshot);
+    pmap_free(test_pmap);
+    test_pmap = NULL;
+}
+
+void test_fixture_pmap_snapshots(void)
+{
+    test_fixture_start();
+    run_test(test_pmap_snapshots);
+    run_test(test_pmap_spares_bounded);
+    run_test(test_pmap_sequential);
+    run_test(test_pmap_scan);
+    test_fixture_end();
+}
+
+
+/* Every published snapshot holds a window of consecutive keys, which
+ * the readers check while the writer moves the window along.
+ */
+static void* pmap_reader(void *arg)
+{
+    PMap *snapshot;
+    const void *key;
+    unsigned long i, first, size, failures = 0;
+
+    do {
+        pthread_mutex_lock(&published_lock);
+        snapshot = pmap_snapshot(published);
+        pthread_mutex_unlock(&published_lock);
+
+        size = pmap_size(snapshot);
+        if(pmap_select(snapshot, 0, &key, NULL) == 0) {
+            first = *(const unsigned long *)key;
+            for(i = first; i < first + size; i++) {
+                failures += (pmap_get(snapshot, &keys[i]) != &keys[i]);
+            }
+            failures += (size > WINDOW);
+        }
+
+        pmap_free(snapshot);
+    } while(!__atomic_load_n(&writer_done, __ATOMIC_ACQUIRE));
+
+    return (void *)(size_t)failures;
+}
+
+void test_pmap_threads(void)
+{
+    pthread_t readers[NUM_READERS];
+    unsigned long i;
+    void *failures;
+
+    for(i = 0; i < WRITER_STEPS; i++) {
+        keys[i] = i;
+    }
+
+    test_pmap = pmap_create((CompareFn)ulong_compare);
+    published = pmap_snapshot(test_pmap);
+    __atomic_store_n(&writer_done, 0, __ATOMIC_RELEASE);
+
+    for(i = 0; i < NUM_READERS; i++) {
+        assert_true(pthread_create(&readers[i], NULL, pmap_reader,
+                    NULL) == 0);
+    }
+
+    for(i = 0; i < WRITER_STEPS; i++) {
+        assert_int_equal(0, pmap_insert(test_pmap, &keys[i], &keys[i]));
+        if(i >= WINDOW) {
+            assert_true(pmap_remove(test_pmap, &keys[i - WINDOW]) ==
+                    &keys[i - WINDOW]);
+        }
+
+        pthread_mutex_lock(&published_lock);
+        pmap_free(published);
+        published = pmap_snapshot(test_pmap);
+        pthread_mutex_unlock(&published_lock);
+    }
+
+    __atomic_store_n(&writer_done, 1, __ATOMIC_RELEASE);
+    for(i = 0; i < NUM_READERS; i++) {
+        pthread_join(readers[i], &failures);
+        assert_true(NULL == failures);
+    }
+
+    assert_true(pmap_is_valid(test_pmap));
+    assert_ulong_equal(WINDOW, pmap_size(test_pmap));
+
+    pmap_free(published);
+    published = NULL;
+    pmap_free(test_pmap);
+    test_pmap = NULL;
+}
+
+void test_fixture_pmap_threads(void)
+{
+    test_fixture_start();
+    run_test(test_pmap_threads);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_pmap_create();
+    test_fixture_pmap_snapshots();
+    test_fixture_pmap_threads();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -365,12 +365,116 @@ void test_fixture_pqueue_top(void)
 }
 
 
+void test_pqueue_dary_pop_until_empty(void)
+{
+    unsigned long i, *val, old_val;
+
+    test_pq = pqueue_create_dary((CompareFn)ulong_compare, 4);
+    assert_true(test_pq != NULL);
+
+    for(i = 0; i < 100000; i++) {
+        pqueue_push(test_pq, make_ulong_ptr(rand() % 100000));
+    }
+
+    assert_true(pqueue_size(test_pq) == 100000);
+
+    old_val = *(unsigned long *)pqueue_top(test_pq);
+    while(!pqueue_is_empty(test_pq)) {
+        val = pqueue_pop(test_pq);
+        assert_true(val != NULL);
+        assert_true(ulong_compare(&old_val, val) >= 0);
+        old_val = *val;
+        free(val);
+    }
+
+    pqueue_free(test_pq);
+    test_pq = NULL;
+}
+
+void test_pqueue_push_many(void)
+{
+    unsigned long i, *val, old_val;
+    DArray *items;
+
+    items = darray_create();
+    for(i = 0; i < 1000; i++) {
+        darray_append(items, make_ulong_ptr(rand() % 100000));
+    }
+
+    assert_true(pqueue_push_many(test_pq, items) == 0);
+    assert_true(pqueue_size(test_pq) == 101000);
+    darray_free(items);
+
+    old_val = *(unsigned long *)pqueue_top(test_pq);
+    while(!pqueue_is_empty(test_pq)) {
+        val = pqueue_pop(test_pq);
+        assert_true(ulong_compare(&old_val, val) >= 0);
+        old_val = *val;
+        free(val);
+    }
+}
+
+void test_pqueue_radix(void)
+{
+    unsigned long i, *val, old_val;
+
+    test_pq = pqueue_create_radix();
+    assert_true(test_pq != NULL);
+
+    for(i = 0; i < 100000; i++) {
+        val = make_ulong_ptr(rand() % 100000);
+        assert_true(pqueue_push_key(test_pq, *val, val) == 0);
+    }
+
+    /* Radix pqueues need a key, comparison pqueues can't take one */
+    assert_true(pqueue_push(test_pq, NULL) == -1);
+    assert_true(pqueue_size(test_pq) == 100000);
+
+    old_val = *(unsigned long *)pqueue_top(test_pq);
+    while(!pqueue_is_empty(test_pq)) {
+        val = pqueue_pop(test_pq);
+        assert_true(old_val <= *val);
+        old_val = *val;
+        free(val);
+    }
+
+    pqueue_free(test_pq);
+    test_pq = NULL;
+}
+
+void test_fixture_pqueue_radix(void)
+{
+    test_fixture_start();
+    run_test(test_pqueue_radix);
+    test_fixture_end();
+}
+
+void test_fixture_pqueue_dary(void)
+{
+    test_fixture_start();
+    run_test(test_pqueue_dary_pop_until_empty);
+    test_fixture_end();
+}
+
+void test_fixture_pqueue_push_many(void)
+{
+    test_fixture_start();
+    fixture_setup(pqueue_setup_ints_random);
+    fixture_teardown(pqueue_teardown);
+    run_test(test_pqueue_push_many);
+    test_fixture_end();
+}
+
+
 void all_tests(void)
 {
     test_fixture_pqueue_create();
     test_fixture_pqueue_push();
     test_fixture_pqueue_pop();
     test_fixture_pqueue_top();
+    test_fixture_pqueue_dary();
+    test_fixture_pqueue_push_many();
+    test_fixture_pqueue_radix();
 }
 
 int main(int argc, char *argv[])
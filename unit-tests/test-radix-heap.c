@@ -0,0 +1,210 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/radix_heap.h>
+
+static RadixHeap *test_heap = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* Test fixture setup and teardown */
+
+void radix_heap_setup_random(void)
+{
+    unsigned long i, *val;
+
+    test_heap = radix_heap_create();
+    assert_true(test_heap != NULL);
+    assert_true(radix_heap_is_empty(test_heap));
+
+    for(i = 0; i < 100000; i++) {
+        val = make_ulong_ptr(rand() % 100000);
+        if(val != NULL) {
+            radix_heap_push(test_heap, *val, val);
+        }
+    }
+
+    assert_true(radix_heap_size(test_heap) == 100000);
+}
+
+void radix_heap_teardown(void)
+{
+    radix_heap_free_all(test_heap, NULL);
+    test_heap = NULL;
+}
+
+
+void test_radix_heap_create(void)
+{
+    test_heap = radix_heap_create();
+
+    assert_true(test_heap != NULL);
+    assert_true(radix_heap_size(test_heap) == 0);
+    assert_true(radix_heap_is_empty(test_heap));
+    assert_true(radix_heap_top(test_heap, NULL) == NULL);
+    assert_true(radix_heap_pop(test_heap, NULL) == NULL);
+
+    radix_heap_free(test_heap);
+    test_heap = NULL;
+}
+
+void test_fixture_radix_heap_create(void)
+{
+    test_fixture_start();
+    run_test(test_radix_heap_create);
+    test_fixture_end();
+}
+
+
+void test_radix_heap_pop_until_empty(void)
+{
+    unsigned long *val, *top, key, top_key, old_key;
+
+    radix_heap_top(test_heap, &old_key);
+    while(!radix_heap_is_empty(test_heap)) {
+        top = radix_heap_top(test_heap, &top_key);
+        val = radix_heap_pop(test_heap, &key);
+
+        assert_true(val != NULL);
+        assert_true(val == top);
+        assert_ulong_equal(top_key, key);
+        assert_true(old_key <= key);
+        assert_ulong_equal(*val, key);
+
+        old_key = key;
+        free(val);
+    }
+
+    assert_true(radix_heap_size(test_heap) == 0);
+}
+
+/* Interleave pops with pushes of keys at or above the last popped
+ * key, as Dijkstra's algorithm does.
+ */
+void test_radix_heap_monotone_interleaved(void)
+{
+    unsigned long i, *val, key, old_key;
+
+    old_key = 0;
+    for(i = 0; i < 100000 && !radix_heap_is_empty(test_heap); i++) {
+        val = radix_heap_pop(test_heap, &key);
+        assert_true(old_key <= key);
+        assert_ulong_equal(*val, key);
+        old_key = key;
+
+        *val = key + (rand() % 1000);
+        assert_true(radix_heap_push(test_heap, *val, val) == 0);
+    }
+
+    /* Keys below the last popped key are rejected */
+    if(radix_heap_last(test_heap) > 0) {
+        assert_true(radix_heap_push(test_heap,
+                    radix_heap_last(test_heap) - 1, NULL) == -1);
+    }
+
+    assert_true(radix_heap_size(test_heap) == 100000);
+}
+
+/* top does not move the floor for pushes, only pop does */
+void test_radix_heap_top_keeps_last(void)
+{
+    RadixHeap *rheap;
+    unsigned long key, a = 10, b = 5, c = 7;
+
+    rheap = radix_heap_create();
+
+    assert_true(radix_heap_push(rheap, a, &a) == 0);
+    assert_true(radix_heap_top(rheap, &key) == &a);
+    assert_ulong_equal(10, key);
+    assert_ulong_equal(0, radix_heap_last(rheap));
+
+    assert_true(radix_heap_push(rheap, b, &b) == 0);
+    assert_true(radix_heap_top(rheap, &key) == &b);
+    assert_ulong_equal(5, key);
+
+    assert_true(radix_heap_pop(rheap, &key) == &b);
+    assert_ulong_equal(5, radix_heap_last(rheap));
+    assert_true(radix_heap_push(rheap, c, &c) == 0);
+    assert_true(radix_heap_top(rheap, NULL) == &c);
+    assert_true(radix_heap_pop(rheap, NULL) == &c);
+    assert_true(radix_heap_pop(rheap, NULL) == &a);
+    assert_true(radix_heap_is_empty(rheap));
+
+    radix_heap_free(rheap);
+}
+
+void test_fixture_radix_heap_top(void)
+{
+    test_fixture_start();
+    run_test(test_radix_heap_top_keeps_last);
+    test_fixture_end();
+}
+
+void test_fixture_radix_heap_operations(void)
+{
+    test_fixture_start();
+
+    fixture_setup(radix_heap_setup_random);
+    fixture_teardown(radix_heap_teardown);
+
+    run_test(test_radix_heap_pop_until_empty);
+    run_test(test_radix_heap_monotone_interleaved);
+
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_radix_heap_create();
+    test_fixture_radix_heap_operations();
+    test_fixture_radix_heap_top();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
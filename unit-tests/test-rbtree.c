@@ -26,6 +26,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
 #include <seatest.h>
@@ -173,6 +174,7 @@ void test_rbtree_random_insert_and_remove(void)
     unsigned long i, old_size, *val, *remove_val;
     unsigned long count = 100000;
     unsigned long max_size = 0, inserts = 0, removes = 0;
+    RBTreeIterator *it;
 
     test_tree = rbtree_create((CompareFn)ulong_compare);
     assert_true(test_tree != NULL);
@@ -207,6 +209,16 @@ void test_rbtree_random_insert_and_remove(void)
     printf("Inserts: %lu\n", inserts);
     printf("Removes: %lu\n", removes);
 
+    /* Walking back from the end visits every node, in reverse order */
+    i = 0;
+    for(it = rbtree_end(test_tree); it != NULL; it = rbtree_prev(it)) {
+        assert_true(rbtree_prev(it) == NULL ||
+                *(const unsigned long *)rbtree_get_key(rbtree_prev(it)) <=
+                *(const unsigned long *)rbtree_get_key(it));
+        i++;
+    }
+    assert_ulong_equal(rbtree_size(test_tree), i);
+
     rbtree_free_all(test_tree, free);
     test_tree = NULL;
 }
@@ -218,12 +230,538 @@ void test_fixture_rbtree_random_insert_and_remove(void)
     test_fixture_end();
 }
 
+/* Walk the tree in order, checking select and rank against position */
+static void check_select_rank(RBTree *rbtree)
+{
+    RBTreeIterator *it, *prev = NULL;
+    unsigned long i = 0, missing;
+
+    for(it = rbtree_begin(rbtree); it != NULL; it = rbtree_next(it), i++) {
+        assert_true(rbtree_select(rbtree, i) == it);
+
+        /* Duplicates share the rank of the first of them */
+        if(NULL == prev || ulong_compare(rbtree_get_key(prev),
+                    rbtree_get_key(it)) < 0) {
+            assert_ulong_equal(i, rbtree_rank(rbtree, rbtree_get_key(it)));
+        } else {
+            assert_true(rbtree_rank(rbtree, rbtree_get_key(it)) < i);
+        }
+        prev = it;
+    }
+
+    assert_true(rbtree_select(rbtree, rbtree_size(rbtree)) == NULL);
+
+    missing = 1000000;
+    assert_ulong_equal(rbtree_size(rbtree), rbtree_rank(rbtree, &missing));
+}
+
+void test_rbtree_select_rank(void)
+{
+    unsigned long i, key, *val;
+
+    check_select_rank(test_tree);
+
+    /* Hinted inserts find their position without starting at the root */
+    for(i = 0; i < 1000; i++) {
+        val = make_ulong_ptr(10000 + i);
+        rbtree_insert_equal_at(test_tree, rbtree_end(test_tree), val, val,
+                NULL);
+    }
+
+    for(i = 0; i < 1000; i++) {
+        key = rand() % 10000;
+        free(rbtree_remove(test_tree, &key));
+    }
+
+    assert_true(rbtree_is_valid(test_tree));
+    check_select_rank(test_tree);
+}
+
+void test_fixture_rbtree_select_rank(void)
+{
+    test_fixture_start();
+    fixture_setup(rbtree_setup_ints);
+    fixture_teardown(rbtree_teardown);
+    run_test(test_rbtree_select_rank);
+    test_fixture_end();
+}
+
+/* Sorted keys 0, 0, 1, 1, ... with duplicates */
+static DArray* make_sorted_keys(unsigned long n)
+{
+    DArray *keys;
+    unsigned long i;
+
+    keys = darray_create();
+    for(i = 0; i < n; i++) {
+        darray_append(keys, make_ulong_ptr(i / 2));
+    }
+
+    return keys;
+}
+
+void test_rbtree_create_from_sorted(void)
+{
+    RBTreeIterator *it;
+    DArray *keys;
+    unsigned long i, n;
+
+    /* Every size up to a few full levels, both full and partial */
+    for(n = 0; n < 300; n++) {
+        keys = make_sorted_keys(n);
+
+        test_tree = rbtree_create_from_sorted((CompareFn)ulong_compare,
+                keys, NULL, 1);
+        assert_true(test_tree != NULL);
+        assert_ulong_equal(n, rbtree_size(test_tree));
+        assert_true(rbtree_is_valid(test_tree));
+
+        for(i = 0, it = rbtree_begin(test_tree); it != NULL;
+                i++, it = rbtree_next(it)) {
+            assert_true(rbtree_get_key(it) == darray_index(keys, i));
+            assert_true(rbtree_get_value(it) == darray_index(keys, i));
+        }
+        assert_ulong_equal(n, i);
+
+        rbtree_free_all(test_tree, NULL);
+        darray_free(keys);
+    }
+}
+
+/* Nodes from the block and nodes allocated later mix freely */
+void test_rbtree_create_from_sorted_then_modify(void)
+{
+    unsigned long i, key, *val;
+    DArray *keys;
+
+    keys = make_sorted_keys(10000);
+    test_tree = rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+            NULL, 1);
+    darray_free(keys);
+    assert_true(test_tree != NULL);
+
+    for(i = 0; i < 20000; i++) {
+        key = rand() % 6000;
+        if(rand() % 2) {
+            val = make_ulong_ptr(key);
+            rbtree_insert_equal(test_tree, val, val);
+        } else {
+            free(rbtree_remove(test_tree, &key));
+        }
+    }
+
+    assert_true(rbtree_is_valid(test_tree));
+    check_select_rank(test_tree);
+
+    rbtree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+/* A node removed from the block is reused by the next insertion */
+void test_rbtree_create_from_sorted_reuse(void)
+{
+    RBTreeIterator *it;
+    unsigned long key, *val;
+    DArray *keys;
+
+    keys = make_sorted_keys(100);
+    test_tree = rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+            NULL, 1);
+    darray_free(keys);
+    assert_true(test_tree != NULL);
+
+    it = rbtree_begin(test_tree);
+    free(rbtree_remove_at(test_tree, it));
+
+    key = 1000;
+    val = make_ulong_ptr(key);
+    assert_int_equal(0, rbtree_insert_equal(test_tree, val, val));
+    assert_true(rbtree_find(test_tree, &key) == it);
+    assert_true(rbtree_is_valid(test_tree));
+
+    rbtree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+void test_rbtree_create_from_sorted_invalid(void)
+{
+    DArray *keys, *values;
+
+    keys = make_sorted_keys(10);
+    values = darray_create();
+
+    /* Duplicates, when they are not allowed */
+    assert_true(rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+                NULL, 0) == NULL);
+
+    /* Mismatched values */
+    assert_true(rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+                values, 1) == NULL);
+
+    /* Descending, as produced by darray_sort */
+    darray_reverse(keys);
+    assert_true(rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+                NULL, 1) == NULL);
+
+    darray_free_all(keys, NULL);
+    darray_free(values);
+}
+
+void test_fixture_rbtree_create_from_sorted(void)
+{
+    test_fixture_start();
+    run_test(test_rbtree_create_from_sorted);
+    run_test(test_rbtree_create_from_sorted_then_modify);
+    run_test(test_rbtree_create_from_sorted_reuse);
+    run_test(test_rbtree_create_from_sorted_invalid);
+    test_fixture_end();
+}
+
+/* Keys first, first + step, first + 2 * step, ... */
+static DArray* make_key_range(unsigned long first, unsigned long n,
+        unsigned long step)
+{
+    DArray *keys;
+    unsigned long i;
+
+    keys = darray_create();
+    for(i = 0; i < n; i++) {
+        darray_append(keys, make_ulong_ptr(first + i * step));
+    }
+
+    return keys;
+}
+
+/* Keys of less are all below key, and keys of greater all above it */
+static void check_split(RBTree *less, const unsigned long *key,
+        RBTree *greater)
+{
+    RBTreeIterator *it;
+
+    assert_true(rbtree_is_valid(less));
+    assert_true(rbtree_is_valid(greater));
+
+    it = rbtree_end(less);
+    assert_true(it == NULL ||
+            *(const unsigned long *)rbtree_get_key(it) < *key);
+    it = rbtree_begin(greater);
+    assert_true(it == NULL ||
+            *(const unsigned long *)rbtree_get_key(it) > *key);
+}
+
+void test_rbtree_join(void)
+{
+    RBTree *less, *greater;
+    RBTreeIterator *it;
+    DArray *keys;
+    unsigned long i, a, b, *val;
+
+    /* Trees of unrelated heights, one built in a block, one not */
+    for(i = 0; i < 50; i++) {
+        a = rand() % 1000;
+        b = rand() % 1000;
+
+        keys = make_key_range(0, a, 1);
+        less = rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+                NULL, 0);
+        darray_free(keys);
+
+        greater = rbtree_create((CompareFn)ulong_compare);
+        while(rbtree_size(greater) < b) {
+            val = make_ulong_ptr(a + 1 + rand() % b);
+            if(rbtree_insert_unique(greater, val, val) != 0) {
+                free(val);
+            }
+        }
+
+        val = make_ulong_ptr(a);
+        test_tree = rbtree_join(less, val, val, greater);
+        assert_true(test_tree != NULL);
+        assert_true(rbtree_is_valid(test_tree));
+        assert_ulong_equal(a + b + 1, rbtree_size(test_tree));
+        check_select_rank(test_tree);
+
+        for(a = 0, it = rbtree_begin(test_tree); it != NULL;
+                a++, it = rbtree_next(it)) {
+            assert_ulong_equal(a, *(const unsigned long *)rbtree_get_key(it));
+        }
+
+        rbtree_free_all(test_tree, NULL);
+        test_tree = NULL;
+    }
+}
+
+/* Splitting and joining back again gives the same set of keys */
+void test_rbtree_split_and_join(void)
+{
+    RBTree *less, *greater;
+    DArray *keys;
+    unsigned long i, j, n, size, key, *val;
+    void *value;
+    int found;
+
+    for(i = 0; i < 20; i++) {
+        n = rand() % 2000;
+
+        /* Even keys from a block, odd keys inserted */
+        keys = make_key_range(0, n, 2);
+        test_tree = rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+                NULL, 0);
+        darray_free(keys);
+        for(j = 0; j < n / 2; j++) {
+            val = make_ulong_ptr(2 * (rand() % (n + 1)) + 1);
+            if(rbtree_insert_unique(test_tree, val, val) != 0) {
+                free(val);
+            }
+        }
+
+        for(j = 0; j < 20; j++) {
+            size = rbtree_size(test_tree);
+            key = rand() % (2 * n + 3);
+
+            found = rbtree_split(test_tree, &key, &less, &greater, &value);
+            assert_true(found == 0 || found == 1);
+            check_split(less, &key, greater);
+            assert_ulong_equal(size - found,
+                    rbtree_size(less) + rbtree_size(greater));
+            if(found) {
+                assert_ulong_equal(key, *(unsigned long *)value);
+                free(value);
+            }
+
+            val = make_ulong_ptr(key);
+            test_tree = rbtree_join(less, val, val, greater);
+            assert_true(test_tree != NULL);
+            assert_true(rbtree_is_valid(test_tree));
+            assert_ulong_equal(size + 1 - found, rbtree_size(test_tree));
+            assert_true(rbtree_find(test_tree, &key) != NULL);
+        }
+
+        check_select_rank(test_tree);
+
+        rbtree_free_all(test_tree, NULL);
+        test_tree = NULL;
+    }
+}
+
+/* Trees holding nodes from several blocks split and join back */
+void test_rbtree_join_blocks(void)
+{
+    RBTree *less, *greater;
+    DArray *keys;
+    unsigned long i, key, *val;
+    void *value;
+
+    /* Blocks of keys i * 101 up to i * 101 + 99, joined by the keys
+     * left out between them
+     */
+    test_tree = NULL;
+    for(i = 0; i < 8; i++) {
+        keys = make_key_range(i * 101, 100, 1);
+        greater = rbtree_create_from_sorted((CompareFn)ulong_compare, keys,
+                NULL, 0);
+        darray_free(keys);
+
+        if(NULL == test_tree) {
+            test_tree = greater;
+        } else {
+            val = make_ulong_ptr(i * 101 - 1);
+            test_tree = rbtree_join(test_tree, val, val, greater);
+        }
+        assert_true(test_tree != NULL);
+    }
+
+    assert_true(rbtree_is_valid(test_tree));
+    assert_ulong_equal(8 * 100 + 7, rbtree_size(test_tree));
+
+    for(i = 0; i < 20; i++) {
+        key = rand() % (8 * 101);
+        if(rbtree_split(test_tree, &key, &less, &greater, &value) == 1) {
+            free(value);
+        }
+        check_split(less, &key, greater);
+
+        val = make_ulong_ptr(key);
+        test_tree = rbtree_join(less, val, val, greater);
+        assert_true(test_tree != NULL);
+        assert_true(rbtree_is_valid(test_tree));
+    }
+
+    rbtree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+void test_fixture_rbtree_join_split(void)
+{
+    test_fixture_start();
+    run_test(test_rbtree_join);
+    run_test(test_rbtree_split_and_join);
+    run_test(test_rbtree_join_blocks);
+    test_fixture_end();
+}
+
+
+/* Bounds and counts match a brute force count over the keys, which
+ * include runs of duplicates.
+ */
+void test_rbtree_range(void)
+{
+    static unsigned long counts[1000];
+    RBTreeIterator *it, *first, *last;
+    unsigned long i, key, lo, hi, below, n, *val;
+
+    test_tree = rbtree_create((CompareFn)ulong_compare);
+    memset(counts, 0, sizeof(counts));
+
+    for(i = 0; i < 3000; i++) {
+        key = 2 * (rand() % 500);
+        val = make_ulong_ptr(key);
+        rbtree_insert_equal(test_tree, val, val);
+        counts[key]++;
+    }
+
+    for(below = 0, key = 0; key < 1000; below += counts[key], key++) {
+        it = rbtree_lower_bound(test_tree, &key);
+        assert_true(it == rbtree_select(test_tree, below));
+        if(it != NULL) {
+            assert_true(*(const unsigned long *)rbtree_get_key(it) >= key);
+            assert_true(rbtree_prev(it) == NULL ||
+                    *(const unsigned long *)rbtree_get_key(rbtree_prev(it)) <
+                    key);
+        }
+
+        it = rbtree_upper_bound(test_tree, &key);
+        assert_true(it == rbtree_select(test_tree, below + counts[key]));
+
+        rbtree_equal_range(test_tree, &key, &first, &last);
+        for(n = 0, it = first; it != last; n++, it = rbtree_next(it)) {
+            assert_ulong_equal(key, *(const unsigned long *)rbtree_get_key(it));
+        }
+        assert_ulong_equal(counts[key], n);
+        if(counts[key] > 0) {
+            assert_true(first == rbtree_find(test_tree, &key));
+        }
+    }
+
+    key = 1000;
+    assert_true(rbtree_lower_bound(test_tree, &key) == NULL);
+    assert_true(rbtree_upper_bound(test_tree, &key) == NULL);
+
+    for(i = 0; i < 1000; i++) {
+        lo = rand() % 1000;
+        hi = rand() % 1000;
+        for(n = 0, key = lo; key < hi; key++) {
+            n += counts[key];
+        }
+        assert_ulong_equal(n, rbtree_count_range(test_tree, &lo, &hi));
+    }
+
+    rbtree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+/* Batched lookups agree with single ones, duplicates included */
+void test_rbtree_find_many(void)
+{
+    static unsigned long keys[3000];
+    static const void *key_ptrs[3000];
+    static RBTreeIterator *its[3000];
+    unsigned long i, n, found, *val;
+
+    test_tree = rbtree_create((CompareFn)ulong_compare);
+
+    for(i = 0; i < 3000; i++) {
+        val = make_ulong_ptr(2 * (rand() % 1000));
+        rbtree_insert_equal(test_tree, val, val);
+    }
+
+    /* Batches of every size up to a few groups, half of the keys odd */
+    for(n = 0; n < 40; n++) {
+        for(i = 0; i < n; i++) {
+            keys[i] = rand() % 2000;
+            key_ptrs[i] = &keys[i];
+        }
+
+        found = rbtree_find_many(test_tree, key_ptrs, n, its);
+        for(i = 0; i < n; i++) {
+            assert_true(its[i] == rbtree_find(test_tree, &keys[i]));
+            if(its[i] != NULL) {
+                found--;
+            }
+        }
+        assert_ulong_equal(0, found);
+    }
+
+    rbtree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+void test_fixture_rbtree_range(void)
+{
+    test_fixture_start();
+    run_test(test_rbtree_range);
+    run_test(test_rbtree_find_many);
+    test_fixture_end();
+}
+
+
+/* One descent either finds the key or inserts it where it belongs */
+void test_rbtree_find_or_insert(void)
+{
+    RBTreeIterator *it;
+    unsigned long i, key, *val;
+    int inserted;
+
+    test_tree = rbtree_create((CompareFn)ulong_compare);
+
+    for(i = 0; i < 20000; i++) {
+        key = rand() % 5000;
+        val = make_ulong_ptr(key);
+
+        it = rbtree_find_or_insert(test_tree, val, val, &inserted);
+        assert_true(it != NULL);
+        assert_ulong_equal(key, *(const unsigned long *)rbtree_get_key(it));
+        if(inserted) {
+            assert_true(rbtree_get_value(it) == val);
+        } else {
+            assert_true(rbtree_get_value(it) != val);
+            free(val);
+        }
+        assert_true(rbtree_find(test_tree, &key) == it);
+    }
+
+    assert_true(rbtree_is_valid(test_tree));
+    check_select_rank(test_tree);
+
+    /* Replacing a value leaves the key in place */
+    it = rbtree_begin(test_tree);
+    val = rbtree_set_value(test_tree, it, NULL);
+    assert_true(rbtree_get_key(it) == val);
+    assert_true(rbtree_get_value(it) == NULL);
+    rbtree_set_value(test_tree, it, val);
+
+    rbtree_free_all(test_tree, NULL);
+    test_tree = NULL;
+}
+
+void test_fixture_rbtree_find_or_insert(void)
+{
+    test_fixture_start();
+    run_test(test_rbtree_find_or_insert);
+    test_fixture_end();
+}
+
 void all_tests(void)
 {
     test_fixture_rbtree_create();
     test_fixture_rbtree_insert();
     test_fixture_rbtree_remove();
     test_fixture_rbtree_random_insert_and_remove();
+    test_fixture_rbtree_select_rank();
+    test_fixture_rbtree_create_from_sorted();
+    test_fixture_rbtree_join_split();
+    test_fixture_rbtree_range();
+    test_fixture_rbtree_find_or_insert();
 }
 
 int main(int argc, char *argv[])
@@ -30,6 +30,7 @@
 
 #include <seatest.h>
 #include <libcore/macros.h>
+#include <libcore/rbtree.h>
 #include <libcore/set.h>
 
 #define ARRAY_LEN(x)    sizeof((x)) / sizeof((x)[0])
@@ -423,6 +424,383 @@ void test_fixture_set_symdiff(void)
     test_fixture_end();
 }
 
+void test_set_select_rank(void)
+{
+    unsigned long i, key;
+
+    /* test_set1 = { 0, 1, 2, 3, 4, 6, 9, 10 } */
+    assert_ulong_equal(6, *(unsigned long *)set_get_value(
+                set_select(test_set1, 5)));
+    assert_true(set_select(test_set1, 8) == NULL);
+
+    key = 5;
+    assert_ulong_equal(5, set_rank(test_set1, &key));
+    key = 6;
+    assert_ulong_equal(5, set_rank(test_set1, &key));
+    key = 11;
+    assert_ulong_equal(8, set_rank(test_set1, &key));
+
+    for(i = 0; i < set_size(test_set2); i++) {
+        assert_ulong_equal(i, set_rank(test_set2,
+                    set_get_value(set_select(test_set2, i))));
+    }
+}
+
+void test_fixture_set_select_rank(void)
+{
+    test_fixture_start();
+    fixture_setup(set_setup_known_ints);
+    fixture_teardown(set_teardown_known_ints);
+    run_test(test_set_select_rank);
+    test_fixture_end();
+}
+
+
+void test_set_create_from_sorted(void)
+{
+    DArray *values;
+    Set *set, *expected;
+    unsigned long i;
+
+    values = darray_create();
+    for(i = 0; i < ARRAY_LEN(union_td1_td2); i++) {
+        darray_append(values, &union_td1_td2[i]);
+    }
+
+    set = set_create_from_sorted((CompareFn)ulong_compare, values);
+    assert_true(set != NULL);
+    assert_true(contents_match(set, union_td1_td2, ARRAY_LEN(union_td1_td2)));
+
+    expected = set_union(test_set1, test_set2);
+    assert_true(set_is_equal(set, expected));
+    set_free(expected);
+
+    /* The set is an ordinary set afterwards */
+    assert_true(set_remove(set, &union_td1_td2[0]) == &union_td1_td2[0]);
+    assert_true(set_insert(set, &union_td1_td2[0]) == 0);
+    assert_true(contents_match(set, union_td1_td2, ARRAY_LEN(union_td1_td2)));
+    set_free(set);
+
+    /* Duplicates are rejected */
+    darray_append(values, &union_td1_td2[ARRAY_LEN(union_td1_td2) - 1]);
+    assert_true(set_create_from_sorted((CompareFn)ulong_compare, values)
+            == NULL);
+
+    darray_free(values);
+}
+
+void test_fixture_set_create_from_sorted(void)
+{
+    test_fixture_start();
+    fixture_setup(set_setup_known_ints);
+    fixture_teardown(set_teardown_known_ints);
+    run_test(test_set_create_from_sorted);
+    test_fixture_end();
+}
+
+
+/* Same ordering as ulong_compare, but a distinct comparator, which
+ * forces the set operations onto their lookup-based paths.
+ */
+int ulong_compare_other(const unsigned long *a, const unsigned long *b)
+{
+    return ulong_compare(a, b);
+}
+
+/* The linear merge and the lookup-based paths agree */
+void test_set_ops_merge_matches_lookup(void)
+{
+    Set *other, *merged, *looked_up;
+    SetIterator *it;
+    Set* (*ops[4])(Set *, Set *);
+    int i;
+
+    ops[0] = set_union;
+    ops[1] = set_intersect;
+    ops[2] = set_diff;
+    ops[3] = set_symdiff;
+
+    /* test_set1 holds random values; build a random, overlapping set2 */
+    test_set2 = set_create((CompareFn)ulong_compare);
+    other = set_create((CompareFn)ulong_compare_other);
+    for(i = 0; i < 20000; i++) {
+        set_insert(test_set2, make_ulong_ptr(rand() % 50000));
+    }
+    for(it = set_begin(test_set2); it != NULL; it = set_next(it)) {
+        set_insert(other, set_get_value(it));
+    }
+
+    for(i = 0; i < 4; i++) {
+        merged = ops[i](test_set1, test_set2);
+        looked_up = ops[i](test_set1, other);
+
+        assert_true(merged != NULL);
+        assert_true(looked_up != NULL);
+        assert_true(rbtree_is_valid((RBTree *)merged));
+        assert_true(set_is_equal(merged, looked_up));
+
+        set_free(merged);
+        set_free(looked_up);
+    }
+
+    set_free(other);
+    set_free_all(test_set2, NULL);
+    test_set2 = NULL;
+}
+
+void test_fixture_set_ops_merge(void)
+{
+    test_fixture_start();
+    fixture_setup(set_setup_ints);
+    fixture_teardown(set_teardown);
+    run_test(test_set_ops_merge_matches_lookup);
+    test_fixture_end();
+}
+
+
+static unsigned long value_pool[50000];
+/* Values are dropped from several threads, so this is only updated
+ * through the __atomic builtins
+ */
+static unsigned long values_dropped;
+
+void count_dropped(void *value)
+{
+    __atomic_fetch_add(&values_dropped, 1, __ATOMIC_RELAXED);
+}
+
+/* A random subset of value_pool, built by insertion or from sorted */
+static Set* make_pool_set(unsigned long n)
+{
+    DArray *values;
+    Set *set;
+    unsigned long i;
+
+    set = set_create((CompareFn)ulong_compare);
+    for(i = 0; i < n; i++) {
+        set_insert(set, &value_pool[rand() % ARRAY_LEN(value_pool)]);
+    }
+
+    if(rand() % 2) {
+        values = darray_create();
+        for(i = 0; i < set_size(set); i++) {
+            darray_append(values, set_get_value(set_select(set, i)));
+        }
+        set_free(set);
+        set = set_create_from_sorted((CompareFn)ulong_compare, values);
+        darray_free(values);
+    }
+
+    return set;
+}
+
+/* The parallel operations agree with the merge-based ones, and pass
+ * every value left out of the result to freefn.
+ */
+void test_set_ops_parallel(void)
+{
+    Set *set1, *set2, *expected, *result;
+    Set* (*ops[3])(Set *, Set *);
+    Set* (*parallel_ops[3])(Set *, Set *, unsigned int, FreeFn);
+    unsigned long i, size1, size2;
+    unsigned int nthreads;
+    int op;
+
+    for(i = 0; i < ARRAY_LEN(value_pool); i++) {
+        value_pool[i] = i;
+    }
+
+    ops[0] = set_union;
+    ops[1] = set_intersect;
+    ops[2] = set_diff;
+    parallel_ops[0] = set_union_parallel;
+    parallel_ops[1] = set_intersect_parallel;
+    parallel_ops[2] = set_diff_parallel;
+
+    for(op = 0; op < 3; op++) {
+        for(nthreads = 1; nthreads <= 8; nthreads *= 2) {
+            /* Sizes from tiny to most of the pool, and lopsided */
+            set1 = make_pool_set(rand() % 30000);
+            set2 = make_pool_set(rand() % (rand() % 2 ? 30000 : 100));
+            size1 = set_size(set1);
+            size2 = set_size(set2);
+
+            expected = ops[op](set1, set2);
+
+            values_dropped = 0;
+            result = parallel_ops[op](set1, set2, nthreads, count_dropped);
+            assert_true(result != NULL);
+            assert_true(rbtree_is_valid((RBTree *)result));
+            assert_ulong_equal(set_size(expected), set_size(result));
+            assert_true(set_is_equal(result, expected));
+            assert_ulong_equal(size1 + size2,
+                    set_size(result) + values_dropped);
+            for(i = 0; i < set_size(result); i++) {
+                assert_ulong_equal(i, set_rank(result,
+                            set_get_value(set_select(result, i))));
+            }
+
+            set_free(expected);
+            set_free(result);
+        }
+    }
+}
+
+void test_fixture_set_ops_parallel(void)
+{
+    test_fixture_start();
+    run_test(test_set_ops_parallel);
+    test_fixture_end();
+}
+
+
+/* A B-tree backed set behaves like a red-black tree one, including in
+ * set operations that mix the two.
+ */
+void test_set_btree_matches_rbtree(void)
+{
+    Set *btree_set, *expected, *result;
+    Set* (*ops[4])(Set *, Set *);
+    SetIterator *it1, *it2;
+    unsigned long i, value;
+    int op;
+
+    for(i = 0; i < ARRAY_LEN(value_pool); i++) {
+        value_pool[i] = i;
+    }
+
+    ops[0] = set_union;
+    ops[1] = set_intersect;
+    ops[2] = set_diff;
+    ops[3] = set_symdiff;
+
+    test_set1 = set_create((CompareFn)ulong_compare);
+    btree_set = set_create_btree((CompareFn)ulong_compare);
+    assert_true(btree_set != NULL);
+
+    for(i = 0; i < 100000; i++) {
+        value = rand() % 20000;
+        if(rand() % 3) {
+            assert_int_equal(set_insert(test_set1, &value_pool[value]),
+                    set_insert(btree_set, &value_pool[value]));
+        } else {
+            assert_true(set_remove(test_set1, &value) ==
+                    set_remove(btree_set, &value));
+        }
+    }
+
+    assert_ulong_equal(set_size(test_set1), set_size(btree_set));
+    for(it1 = set_begin(test_set1), it2 = set_begin(btree_set);
+            it1 != NULL; it1 = set_next(it1), it2 = set_next(it2)) {
+        assert_true(set_get_value(it1) == set_get_value(it2));
+    }
+    assert_true(it2 == NULL);
+
+    value = 10000;
+    assert_ulong_equal(set_rank(test_set1, &value),
+            set_rank(btree_set, &value));
+    assert_true(set_get_value(set_select(test_set1, 100)) ==
+            set_get_value(set_select(btree_set, 100)));
+
+    test_set2 = make_pool_set(10000);
+    for(op = 0; op < 4; op++) {
+        expected = ops[op](test_set1, test_set2);
+        result = ops[op](btree_set, test_set2);
+        assert_true(set_is_equal(result, expected));
+        set_free(result);
+        result = ops[op](test_set2, btree_set);
+        set_free(expected);
+        expected = ops[op](test_set2, test_set1);
+        assert_true(set_is_equal(result, expected));
+        set_free(result);
+        set_free(expected);
+    }
+
+    /* The parallel operations need red-black trees */
+    assert_true(set_union_parallel(btree_set, test_set2, 2, NULL) == NULL);
+
+    set_free(btree_set);
+    set_free(test_set1);
+    set_free(test_set2);
+    test_set1 = test_set2 = NULL;
+}
+
+void test_fixture_set_btree(void)
+{
+    test_fixture_start();
+    run_test(test_set_btree_matches_rbtree);
+    test_fixture_end();
+}
+
+
+/* Range queries agree between the two backends */
+void test_set_range(void)
+{
+    Set *btree_set;
+    SetIterator *first1, *last1, *first2, *last2;
+    unsigned long i, lo, hi;
+
+    for(i = 0; i < ARRAY_LEN(value_pool); i++) {
+        value_pool[i] = i;
+    }
+
+    test_set1 = set_create((CompareFn)ulong_compare);
+    btree_set = set_create_btree((CompareFn)ulong_compare);
+
+    for(i = 0; i < 5000; i++) {
+        lo = rand() % 20000;
+        set_insert(test_set1, &value_pool[lo]);
+        set_insert(btree_set, &value_pool[lo]);
+    }
+
+    for(i = 0; i < 2000; i++) {
+        lo = rand() % 20001;
+        hi = rand() % 20001;
+
+        first1 = set_lower_bound(test_set1, &lo);
+        first2 = set_lower_bound(btree_set, &lo);
+        assert_true((NULL == first1) == (NULL == first2));
+        if(first1 != NULL) {
+            assert_true(set_get_value(first1) == set_get_value(first2));
+            assert_ulong_equal(set_rank(test_set1, &lo),
+                    set_rank(test_set1, set_get_value(first1)));
+        }
+
+        first1 = set_upper_bound(test_set1, &lo);
+        first2 = set_upper_bound(btree_set, &lo);
+        assert_true((NULL == first1) == (NULL == first2));
+        if(first1 != NULL) {
+            assert_true(*(unsigned long *)set_get_value(first1) > lo);
+            assert_true(set_get_value(first1) == set_get_value(first2));
+        }
+
+        set_equal_range(test_set1, &lo, &first1, &last1);
+        set_equal_range(btree_set, &lo, &first2, &last2);
+        assert_int_equal(set_is_member(test_set1, &lo), first1 != last1);
+        assert_int_equal(set_is_member(btree_set, &lo), first2 != last2);
+
+        assert_ulong_equal(set_count_range(test_set1, &lo, &hi),
+                set_count_range(btree_set, &lo, &hi));
+        if(lo < hi) {
+            assert_ulong_equal(set_rank(test_set1, &hi) -
+                    set_rank(test_set1, &lo),
+                    set_count_range(test_set1, &lo, &hi));
+        }
+    }
+
+    set_free(btree_set);
+    set_free(test_set1);
+    test_set1 = NULL;
+}
+
+void test_fixture_set_range(void)
+{
+    test_fixture_start();
+    run_test(test_set_range);
+    test_fixture_end();
+}
+
+
 void all_tests(void)
 {
     test_fixture_set_create();
@@ -436,6 +814,12 @@ void all_tests(void)
     test_fixture_set_intersect();
     test_fixture_set_diff();
     test_fixture_set_symdiff();
+    test_fixture_set_select_rank();
+    test_fixture_set_create_from_sorted();
+    test_fixture_set_ops_merge();
+    test_fixture_set_ops_parallel();
+    test_fixture_set_btree();
+    test_fixture_set_range();
 }
 
 int main(int argc, char *argv[])
@@ -0,0 +1,280 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/skiplist.h>
+
+#define KEY_RANGE   5000
+
+static SkipList *test_list = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Walks the list both ways, checking it holds exactly the keys marked
+ * present, in order.
+ */
+static void check_contents(SkipList *list, const char *present,
+        unsigned long range)
+{
+    SkipListIterator *it;
+    unsigned long key, n;
+
+    assert_true(skiplist_is_valid(list));
+
+    it = skiplist_begin(list);
+    for(n = 0, key = 0; key < range; key++) {
+        if(present[key]) {
+            assert_true(it != NULL);
+            assert_ulong_equal(key,
+                    *(const unsigned long *)skiplist_get_key(it));
+            assert_ulong_equal(key, *(unsigned long *)skiplist_get_value(it));
+            it = skiplist_next(it);
+            n++;
+        }
+    }
+    assert_true(NULL == it);
+    assert_ulong_equal(n, skiplist_size(list));
+
+    it = skiplist_end(list);
+    for(key = range; key-- > 0;) {
+        if(present[key]) {
+            assert_ulong_equal(key,
+                    *(const unsigned long *)skiplist_get_key(it));
+            it = skiplist_prev(it);
+        }
+    }
+    assert_true(NULL == it);
+
+    /* Past either end, the iterator stays there */
+    assert_true(NULL == skiplist_next(it));
+    assert_true(NULL == skiplist_prev(it));
+    assert_true(NULL == skiplist_get_key(it));
+    assert_true(NULL == skiplist_get_value(it));
+}
+
+
+void test_skiplist_create(void)
+{
+    unsigned long key = 1;
+
+    test_list = skiplist_create((CompareFn)ulong_compare);
+
+    assert_true(test_list != NULL);
+    assert_ulong_equal(0, skiplist_size(test_list));
+    assert_true(skiplist_is_empty(test_list));
+    assert_true(skiplist_is_valid(test_list));
+    assert_true(skiplist_begin(test_list) == NULL);
+    assert_true(skiplist_end(test_list) == NULL);
+    assert_true(skiplist_find(test_list, &key) == NULL);
+    assert_true(skiplist_lower_bound(test_list, &key) == NULL);
+    assert_true(skiplist_remove(test_list, &key) == NULL);
+
+    skiplist_free(test_list);
+    test_list = NULL;
+}
+
+void test_fixture_skiplist_create(void)
+{
+    test_fixture_start();
+    run_test(test_skiplist_create);
+    test_fixture_end();
+}
+
+
+void test_skiplist_random_insert_and_remove(void)
+{
+    static char present[KEY_RANGE];
+    SkipListIterator *it;
+    unsigned long i, key, n, *val;
+
+    test_list = skiplist_create((CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+    n = 0;
+
+    for(i = 0; i < 100000; i++) {
+        key = rand() % KEY_RANGE;
+
+        if(rand() % 100 < ((i / 25000) % 2 ? 30 : 70)) {
+            val = make_ulong_ptr(key);
+            if(skiplist_insert(test_list, val, val) == 0) {
+                assert_false(present[key]);
+                present[key] = 1;
+                n++;
+            } else {
+                assert_true(present[key]);
+                free(val);
+            }
+        } else if(rand() % 2) {
+            val = skiplist_remove(test_list, &key);
+            if(val != NULL) {
+                assert_true(present[key]);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        } else {
+            it = skiplist_find(test_list, &key);
+            if(it != NULL) {
+                assert_true(present[key]);
+                val = skiplist_remove_at(test_list, it);
+                assert_ulong_equal(key, *val);
+                present[key] = 0;
+                n--;
+                free(val);
+            } else {
+                assert_false(present[key]);
+            }
+        }
+
+        assert_ulong_equal(n, skiplist_size(test_list));
+        if(i % 10000 == 0) {
+            check_contents(test_list, present, KEY_RANGE);
+        }
+    }
+
+    check_contents(test_list, present, KEY_RANGE);
+
+    skiplist_free_all(test_list, NULL);
+    test_list = NULL;
+}
+
+void test_fixture_skiplist_random_insert_and_remove(void)
+{
+    test_fixture_start();
+    run_test(test_skiplist_random_insert_and_remove);
+    test_fixture_end();
+}
+
+
+/* Bounds agree with a scan of the keys present */
+void test_skiplist_range(void)
+{
+    static unsigned long keys[1000];
+    static char present[2000];
+    SkipListIterator *it;
+    unsigned long i, key, next_key, old_value;
+
+    test_list = skiplist_create((CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+
+    /* Only even keys */
+    for(i = 0; i < 1000; i++) {
+        keys[i] = 2 * i;
+    }
+    for(i = 0; i < 1000; i++) {
+        key = rand() % 1000;
+        skiplist_insert(test_list, &keys[key], &keys[key]);
+        present[keys[key]] = 1;
+    }
+
+    for(key = 0; key < 2000; key++) {
+        next_key = key;
+        while(next_key < 2000 && !present[next_key]) {
+            next_key++;
+        }
+
+        it = skiplist_lower_bound(test_list, &key);
+        if(next_key < 2000) {
+            assert_true(it != NULL);
+            assert_ulong_equal(next_key,
+                    *(const unsigned long *)skiplist_get_key(it));
+        } else {
+            assert_true(NULL == it);
+        }
+
+        if(present[key]) {
+            assert_true(it == skiplist_find(test_list, &key));
+            it = skiplist_next(it);
+        } else {
+            assert_true(skiplist_find(test_list, &key) == NULL);
+        }
+        assert_true(it == skiplist_upper_bound(test_list, &key));
+    }
+
+    it = skiplist_begin(test_list);
+    old_value = *(unsigned long *)skiplist_set_value(it, &keys[999]);
+    assert_ulong_equal(*(const unsigned long *)skiplist_get_key(it),
+            old_value);
+    assert_true(skiplist_get_value(it) == &keys[999]);
+
+    skiplist_free(test_list);
+    test_list = NULL;
+}
+
+void test_fixture_skiplist_range(void)
+{
+    test_fixture_start();
+    run_test(test_skiplist_range);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_skiplist_create();
+    test_fixture_skiplist_random_insert_and_remove();
+    test_fixture_skiplist_range();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,220 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/swiss_table.h>
+#include <libcore/utilities.h>
+
+#define KEY_RANGE   50000
+
+static SwissTable *test_table = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Every key probes the same groups, from the same first group on */
+unsigned long ulong_hash_constant(const unsigned long *x)
+{
+    return 0;
+}
+
+/* Iteration visits each of present once, and nothing else */
+static void check_contents(SwissTable *table, const char *present,
+        unsigned long range)
+{
+    static char seen[KEY_RANGE];
+    SwissTableIterator *it;
+    unsigned long key, n;
+
+    memset(seen, 0, sizeof(seen));
+
+    for(n = 0, it = swiss_table_begin(table); it != NULL;
+            n++, it = swiss_table_next(it)) {
+        key = *(const unsigned long *)swiss_table_get_key(it);
+        assert_true(swiss_table_get_key(it) == swiss_table_get_value(it));
+        assert_true(present[key]);
+        assert_false(seen[key]);
+        seen[key] = 1;
+    }
+    assert_ulong_equal(swiss_table_size(table), n);
+
+    for(key = 0; key < range; key++) {
+        assert_true(present[key] == (swiss_table_find(table, &key) != NULL));
+    }
+}
+
+
+void test_swiss_table_create(void)
+{
+    test_table = swiss_table_create(util_hash_ulong, (CompareFn)ulong_compare);
+
+    assert_true(test_table != NULL);
+    assert_ulong_equal(0, swiss_table_size(test_table));
+    assert_true(swiss_table_is_empty(test_table));
+    assert_true(swiss_table_begin(test_table) == NULL);
+
+    swiss_table_free(test_table);
+    test_table = NULL;
+}
+
+void test_fixture_swiss_table_create(void)
+{
+    test_fixture_start();
+    run_test(test_swiss_table_create);
+    test_fixture_end();
+}
+
+
+/* With every key on one probe sequence, the first groups are full, so
+ * removals there leave deleted markers that later lookups must probe
+ * past, and that inserts may then reuse.
+ */
+void test_swiss_table_group_full_removal(void)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, key, *val;
+
+    test_table = swiss_table_create((HashFn)ulong_hash_constant,
+            (CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+
+    for(i = 0; i < 100; i++) {
+        val = make_ulong_ptr(i);
+        assert_int_equal(0, swiss_table_insert(test_table, val, val));
+        present[i] = 1;
+    }
+    check_contents(test_table, present, 100);
+
+    for(i = 0; i < 100; i += 2) {
+        key = (i * 37) % 100;
+        free(swiss_table_remove(test_table, &key));
+        present[key] = 0;
+        check_contents(test_table, present, 100);
+    }
+
+    for(i = 0; i < 100; i++) {
+        if(!present[i]) {
+            val = make_ulong_ptr(i);
+            assert_int_equal(0, swiss_table_insert(test_table, val, val));
+            present[i] = 1;
+        }
+        assert_int_equal(-1, swiss_table_insert(test_table, &i, &i));
+    }
+    assert_ulong_equal(100, swiss_table_size(test_table));
+    check_contents(test_table, present, 100);
+
+    /* Empty it again through iterators */
+    while(!swiss_table_is_empty(test_table)) {
+        free(swiss_table_remove_at(test_table, swiss_table_begin(test_table)));
+    }
+    assert_true(swiss_table_begin(test_table) == NULL);
+
+    swiss_table_free(test_table);
+    test_table = NULL;
+}
+
+/* A sliding window of keys leaves a trail of deleted slots behind,
+ * which rehashing in place must clear.
+ */
+void test_swiss_table_churn(void)
+{
+    static char present[KEY_RANGE];
+    unsigned long i, key, *val;
+
+    test_table = swiss_table_create(util_hash_ulong, (CompareFn)ulong_compare);
+    memset(present, 0, sizeof(present));
+
+    for(i = 0; i < 10 * KEY_RANGE; i++) {
+        key = i % KEY_RANGE;
+        val = make_ulong_ptr(key);
+        assert_int_equal(0, swiss_table_insert(test_table, val, val));
+        present[key] = 1;
+
+        if(i >= 100) {
+            key = (i - 100) % KEY_RANGE;
+            free(swiss_table_remove(test_table, &key));
+            present[key] = 0;
+        }
+    }
+
+    assert_ulong_equal(100, swiss_table_size(test_table));
+    check_contents(test_table, present, KEY_RANGE);
+
+    swiss_table_free_all(test_table, NULL);
+    test_table = NULL;
+}
+
+void test_fixture_swiss_table_deleted_slots(void)
+{
+    test_fixture_start();
+    run_test(test_swiss_table_group_full_removal);
+    run_test(test_swiss_table_churn);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_swiss_table_create();
+    test_fixture_swiss_table_deleted_slots();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
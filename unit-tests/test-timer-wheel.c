@@ -0,0 +1,330 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/timer_wheel.h>
+
+#define NUM_TIMERS  20000
+
+static TimerWheel *test_wheel = NULL;
+static TimerWheelTimer *test_timers[NUM_TIMERS];
+
+/* What the expire callback has seen so far */
+struct expire_log {
+    unsigned long count;
+    unsigned long last_deadline;
+    int in_order;
+    int on_time;
+    unsigned long *fired;
+};
+
+static void log_expire(void *data, unsigned long deadline, void *userdata)
+{
+    struct expire_log *log = userdata;
+    unsigned long index = *(unsigned long *)data;
+
+    if(deadline < log->last_deadline) {
+        log->in_order = 0;
+    }
+    if(timer_wheel_now(test_wheel) != deadline) {
+        log->on_time = 0;
+    }
+
+    log->last_deadline = deadline;
+    log->fired[index]++;
+    log->count++;
+    test_timers[index] = NULL;
+}
+
+static void log_init(struct expire_log *log, unsigned long *fired)
+{
+    unsigned long i;
+
+    log->count = 0;
+    log->last_deadline = 0;
+    log->in_order = 1;
+    log->on_time = 1;
+    log->fired = fired;
+
+    for(i = 0; i < NUM_TIMERS; i++) {
+        fired[i] = 0;
+    }
+}
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* Test fixture setup and teardown */
+
+/* Timers spread over a wide range of deadlines, so that all of them
+ * start out on the higher levels and cascade down.
+ */
+void timer_wheel_setup_random(void)
+{
+    unsigned long i;
+
+    test_wheel = timer_wheel_create(1000);
+    assert_true(test_wheel != NULL);
+
+    for(i = 0; i < NUM_TIMERS; i++) {
+        test_timers[i] = timer_wheel_schedule(test_wheel,
+                1001 + ((unsigned long)rand() * 7919UL) % 5000000UL,
+                make_ulong_ptr(i));
+        assert_true(test_timers[i] != NULL);
+    }
+
+    assert_true(timer_wheel_size(test_wheel) == NUM_TIMERS);
+}
+
+void timer_wheel_teardown(void)
+{
+    timer_wheel_free_all(test_wheel, NULL);
+    test_wheel = NULL;
+}
+
+
+void test_timer_wheel_create(void)
+{
+    test_wheel = timer_wheel_create(42);
+
+    assert_true(test_wheel != NULL);
+    assert_true(timer_wheel_is_empty(test_wheel));
+    assert_true(timer_wheel_size(test_wheel) == 0);
+    assert_true(timer_wheel_now(test_wheel) == 42);
+
+    assert_true(timer_wheel_advance(test_wheel, 1000000, NULL, NULL) == 0);
+    assert_true(timer_wheel_now(test_wheel) == 1000000);
+
+    /* Time never moves backwards */
+    timer_wheel_advance(test_wheel, 10, NULL, NULL);
+    assert_true(timer_wheel_now(test_wheel) == 1000000);
+
+    timer_wheel_free(test_wheel);
+    test_wheel = NULL;
+}
+
+void test_fixture_timer_wheel_create(void)
+{
+    test_fixture_start();
+    run_test(test_timer_wheel_create);
+    test_fixture_end();
+}
+
+
+/* Every timer fires exactly once, in order, at its own deadline */
+void test_timer_wheel_advance_in_steps(void)
+{
+    struct expire_log log;
+    unsigned long fired[NUM_TIMERS];
+    unsigned long i, now, count = 0;
+
+    log_init(&log, fired);
+
+    for(now = 1000; !timer_wheel_is_empty(test_wheel); ) {
+        now += 1 + rand() % 20000;
+        count += timer_wheel_advance(test_wheel, now, log_expire, &log);
+        assert_true(log.last_deadline <= now);
+        assert_true(timer_wheel_now(test_wheel) == now);
+    }
+
+    assert_true(count == NUM_TIMERS);
+    assert_true(log.count == NUM_TIMERS);
+    assert_true(log.in_order);
+    assert_true(log.on_time);
+
+    for(i = 0; i < NUM_TIMERS; i++) {
+        assert_true(fired[i] == 1);
+    }
+}
+
+/* One large advance fires everything, in order */
+void test_timer_wheel_advance_all(void)
+{
+    struct expire_log log;
+    unsigned long fired[NUM_TIMERS];
+
+    log_init(&log, fired);
+
+    assert_true(timer_wheel_advance(test_wheel, ULONG_MAX, log_expire, &log)
+            == NUM_TIMERS);
+    assert_true(log.in_order);
+    assert_true(log.on_time);
+    assert_true(timer_wheel_is_empty(test_wheel));
+}
+
+/* Cancelled timers never fire, rescheduled timers fire at their new
+ * deadline.
+ */
+void test_timer_wheel_cancel_reschedule(void)
+{
+    struct expire_log log;
+    unsigned long fired[NUM_TIMERS];
+    unsigned long i, *val, now, cancelled = 0;
+
+    log_init(&log, fired);
+
+    for(i = 0; i < NUM_TIMERS; i += 3) {
+        val = timer_wheel_cancel(test_wheel, test_timers[i]);
+        assert_true(*val == i);
+        free(val);
+        test_timers[i] = NULL;
+        cancelled++;
+    }
+
+    for(i = 1; i < NUM_TIMERS; i += 3) {
+        timer_wheel_reschedule(test_wheel, test_timers[i],
+                2000000 + (unsigned long)rand() % 1000);
+        assert_true(timer_wheel_get_deadline(test_timers[i]) >= 2000000);
+    }
+
+    assert_true(timer_wheel_size(test_wheel) == NUM_TIMERS - cancelled);
+
+    for(now = 1000; !timer_wheel_is_empty(test_wheel); ) {
+        now += 1 + rand() % 50000;
+        timer_wheel_advance(test_wheel, now, log_expire, &log);
+
+        /* Cancel some timers that have not fired yet */
+        for(i = 2; i < NUM_TIMERS; i += 30) {
+            if(test_timers[i] != NULL) {
+                free(timer_wheel_cancel(test_wheel, test_timers[i]));
+                test_timers[i] = NULL;
+                fired[i] = 1;
+            }
+        }
+    }
+
+    assert_true(log.in_order);
+    assert_true(log.on_time);
+
+    for(i = 0; i < NUM_TIMERS; i++) {
+        assert_true(fired[i] == (i % 3 != 0));
+    }
+}
+
+void test_fixture_timer_wheel_advance(void)
+{
+    test_fixture_start();
+
+    fixture_setup(timer_wheel_setup_random);
+    fixture_teardown(timer_wheel_teardown);
+
+    run_test(test_timer_wheel_advance_in_steps);
+    run_test(test_timer_wheel_advance_all);
+    run_test(test_timer_wheel_cancel_reschedule);
+
+    test_fixture_end();
+}
+
+
+static unsigned long rearm_count;
+
+/* Periodic timer: each firing schedules the next one */
+static void rearm(void *data, unsigned long deadline, void *userdata)
+{
+    rearm_count++;
+
+    if(rearm_count < 100) {
+        timer_wheel_schedule(test_wheel, deadline + 1000, data);
+    }
+}
+
+void test_timer_wheel_rearm(void)
+{
+    test_wheel = timer_wheel_create(0);
+    assert_true(test_wheel != NULL);
+
+    rearm_count = 0;
+    timer_wheel_schedule(test_wheel, 1000, NULL);
+
+    assert_true(timer_wheel_advance(test_wheel, 50500, rearm, NULL) == 50);
+    assert_true(timer_wheel_size(test_wheel) == 1);
+    assert_true(timer_wheel_advance(test_wheel, ULONG_MAX, rearm, NULL) == 50);
+    assert_true(timer_wheel_is_empty(test_wheel));
+
+    timer_wheel_free(test_wheel);
+    test_wheel = NULL;
+}
+
+/* Deadlines at or before now fire on the next advance */
+void test_timer_wheel_past_deadline(void)
+{
+    test_wheel = timer_wheel_create(ULONG_MAX - 10);
+    assert_true(test_wheel != NULL);
+
+    timer_wheel_schedule(test_wheel, 5, NULL);
+    timer_wheel_schedule(test_wheel, ULONG_MAX - 10, NULL);
+    timer_wheel_schedule(test_wheel, ULONG_MAX, NULL);
+
+    assert_true(timer_wheel_advance(test_wheel, ULONG_MAX - 10, NULL, NULL)
+            == 2);
+    assert_true(timer_wheel_advance(test_wheel, ULONG_MAX - 1, NULL, NULL)
+            == 0);
+    assert_true(timer_wheel_advance(test_wheel, ULONG_MAX, NULL, NULL) == 1);
+    assert_true(timer_wheel_is_empty(test_wheel));
+
+    timer_wheel_free(test_wheel);
+    test_wheel = NULL;
+}
+
+void test_fixture_timer_wheel_callbacks(void)
+{
+    test_fixture_start();
+    run_test(test_timer_wheel_rearm);
+    run_test(test_timer_wheel_past_deadline);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_timer_wheel_create();
+    test_fixture_timer_wheel_advance();
+    test_fixture_timer_wheel_callbacks();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,258 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/topk.h>
+
+#define STREAM_LEN  100000
+#define TOP_K       100
+
+static TopK *test_topk = NULL;
+static DArray *test_stream = NULL;
+
+unsigned long* make_ulong_ptr(unsigned long value)
+{
+    unsigned long *val = NULL;
+
+    val = malloc(sizeof(unsigned long));
+    if(val != NULL) {
+        *val = value;
+    }
+
+    return val;
+}
+
+/* a is greater than b if a is numerically greater than b */
+int ulong_compare(const unsigned long *a, const unsigned long *b)
+{
+    if(*a > *b) {
+        return 1;
+    } else if(*a == *b) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Checks that the collection holds exactly STREAM_LEN - 1 down to
+ * STREAM_LEN - TOP_K, in that order.
+ */
+static void check_top_values(TopK *topk)
+{
+    unsigned long i;
+    DArray *top;
+
+    top = topk_to_darray(topk);
+    assert_true(top != NULL);
+    assert_ulong_equal(TOP_K, darray_size(top));
+
+    for(i = 0; i < darray_size(top); i++) {
+        assert_ulong_equal(STREAM_LEN - 1 - i,
+                *(unsigned long *)darray_index(top, i));
+    }
+
+    darray_free(top);
+}
+
+/* Test fixture setup and teardown */
+
+/* A shuffled permutation of 0 .. STREAM_LEN - 1 */
+void topk_setup_stream(void)
+{
+    unsigned long i, j;
+    void **data, *tmp;
+
+    test_topk = topk_create((CompareFn)ulong_compare, TOP_K);
+    assert_true(test_topk != NULL);
+
+    test_stream = darray_create();
+    for(i = 0; i < STREAM_LEN; i++) {
+        darray_append(test_stream, make_ulong_ptr(i));
+    }
+
+    data = darray_data(test_stream);
+    for(i = STREAM_LEN - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        tmp = data[i];
+        data[i] = data[j];
+        data[j] = tmp;
+    }
+}
+
+void topk_teardown(void)
+{
+    topk_free_all(test_topk, NULL);
+    darray_free(test_stream);
+    test_topk = NULL;
+    test_stream = NULL;
+}
+
+
+void test_topk_create(void)
+{
+    assert_true(topk_create((CompareFn)ulong_compare, 0) == NULL);
+
+    test_topk = topk_create((CompareFn)ulong_compare, 10);
+    assert_true(test_topk != NULL);
+    assert_true(topk_is_empty(test_topk));
+    assert_false(topk_is_full(test_topk));
+    assert_ulong_equal(0, topk_size(test_topk));
+    assert_ulong_equal(10, topk_capacity(test_topk));
+    assert_true(topk_threshold(test_topk) == NULL);
+
+    topk_free(test_topk);
+    test_topk = NULL;
+}
+
+void test_fixture_topk_create(void)
+{
+    test_fixture_start();
+    run_test(test_topk_create);
+    test_fixture_end();
+}
+
+
+void test_topk_push(void)
+{
+    unsigned long i, evicted;
+    void *out;
+
+    evicted = 0;
+    for(i = 0; i < darray_size(test_stream); i++) {
+        out = topk_push(test_topk, darray_index(test_stream, i));
+        if(out != NULL) {
+            evicted++;
+            free(out);
+        }
+    }
+
+    assert_true(topk_is_full(test_topk));
+    assert_ulong_equal(STREAM_LEN - TOP_K, evicted);
+    assert_ulong_equal(STREAM_LEN - TOP_K,
+            *(unsigned long *)topk_threshold(test_topk));
+
+    check_top_values(test_topk);
+}
+
+void test_topk_push_many(void)
+{
+    DArray *rejected, *batch;
+    unsigned long i;
+
+    rejected = darray_create();
+
+    /* Feed the stream in uneven batches */
+    batch = darray_create();
+    for(i = 0; i < darray_size(test_stream); i++) {
+        darray_append(batch, darray_index(test_stream, i));
+        if(darray_size(batch) == 1 + (i % 997)) {
+            assert_true(topk_push_many(test_topk, batch, rejected) == 0);
+            darray_free(batch);
+            batch = darray_create();
+        }
+    }
+    assert_true(topk_push_many(test_topk, batch, rejected) == 0);
+    darray_free(batch);
+
+    assert_ulong_equal(STREAM_LEN - TOP_K, darray_size(rejected));
+    check_top_values(test_topk);
+
+    darray_free_all(rejected, NULL);
+}
+
+void test_topk_push_many_small_stream(void)
+{
+    DArray *rejected, *batch;
+    unsigned long i;
+
+    rejected = darray_create();
+    batch = darray_create();
+    for(i = 0; i < TOP_K / 2; i++) {
+        darray_append(batch, darray_index(test_stream, i));
+    }
+
+    assert_true(topk_push_many(test_topk, batch, rejected) == 0);
+    assert_ulong_equal(TOP_K / 2, topk_size(test_topk));
+    assert_ulong_equal(0, darray_size(rejected));
+    assert_false(topk_is_full(test_topk));
+
+    /* The rest of the stream, one at a time, owned by the stream */
+    for(i = TOP_K / 2; i < darray_size(test_stream); i++) {
+        topk_push(test_topk, darray_index(test_stream, i));
+    }
+
+    check_top_values(test_topk);
+
+    darray_free(batch);
+    darray_free(rejected);
+}
+
+void topk_teardown_shared(void)
+{
+    /* Items are owned by the stream */
+    topk_free(test_topk);
+    darray_free_all(test_stream, NULL);
+    test_topk = NULL;
+    test_stream = NULL;
+}
+
+void test_fixture_topk_push(void)
+{
+    test_fixture_start();
+
+    fixture_setup(topk_setup_stream);
+    fixture_teardown(topk_teardown);
+
+    run_test(test_topk_push);
+    run_test(test_topk_push_many);
+
+    fixture_teardown(topk_teardown_shared);
+
+    run_test(test_topk_push_many_small_stream);
+
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_topk_create();
+    test_fixture_topk_push();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
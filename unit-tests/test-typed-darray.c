@@ -0,0 +1,123 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/typed_darray.h>
+
+LIBCORE_DEFINE_DARRAY(ULongArray, unsigned long)
+
+static ULongArray *test_darray = NULL;
+
+void test_typed_darray_append(void)
+{
+    unsigned long i;
+
+    test_darray = ULongArray_create();
+    assert_true(test_darray != NULL);
+    assert_true(ULongArray_is_empty(test_darray));
+
+    for(i = 0; i < 1000; i++) {
+        assert_int_equal(0, ULongArray_append(test_darray, i));
+    }
+
+    assert_ulong_equal(1000, ULongArray_size(test_darray));
+    for(i = 0; i < 1000; i++) {
+        assert_ulong_equal(i, ULongArray_index(test_darray, i));
+        assert_ulong_equal(i, ULongArray_data(test_darray)[i]);
+    }
+
+    ULongArray_replace(test_darray, 500, 0);
+    assert_ulong_equal(0, ULongArray_index(test_darray, 500));
+
+    ULongArray_free(test_darray);
+    test_darray = NULL;
+}
+
+/* Inserting and removing at random positions matches a plain array */
+void test_typed_darray_insert_remove(void)
+{
+    static unsigned long expected[2000];
+    unsigned long i, index, size;
+
+    test_darray = ULongArray_create();
+
+    for(size = 0; size < 2000; size++) {
+        index = rand() % (size + 1);
+        for(i = size; i > index; i--) {
+            expected[i] = expected[i - 1];
+        }
+        expected[index] = rand();
+        assert_int_equal(0,
+                ULongArray_insert(test_darray, index, expected[index]));
+    }
+
+    while(size > 0) {
+        index = rand() % size;
+        assert_ulong_equal(expected[index],
+                ULongArray_remove(test_darray, index));
+        for(i = index, size--; i < size; i++) {
+            expected[i] = expected[i + 1];
+        }
+
+        assert_ulong_equal(size, ULongArray_size(test_darray));
+        for(i = 0; i < size; i++) {
+            assert_ulong_equal(expected[i], ULongArray_index(test_darray, i));
+        }
+    }
+
+    assert_true(ULongArray_is_empty(test_darray));
+
+    ULongArray_free(test_darray);
+    test_darray = NULL;
+}
+
+void test_fixture_typed_darray(void)
+{
+    test_fixture_start();
+    run_test(test_typed_darray_append);
+    run_test(test_typed_darray_insert_remove);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_typed_darray();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,110 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/typed_heap.h>
+
+#define ulong_cmp(a, b)     (((a) > (b)) - ((a) < (b)))
+
+LIBCORE_DEFINE_HEAP(ULongHeap, unsigned long, ulong_cmp)
+
+static ULongHeap *test_heap = NULL;
+
+void test_typed_heap_empty(void)
+{
+    unsigned long top;
+
+    test_heap = ULongHeap_create();
+    assert_true(test_heap != NULL);
+    assert_true(ULongHeap_is_empty(test_heap));
+    assert_int_equal(-1, ULongHeap_top(test_heap, &top));
+    assert_int_equal(-1, ULongHeap_pop(test_heap, &top));
+
+    ULongHeap_free(test_heap);
+    test_heap = NULL;
+
+    assert_true(ULongHeap_create_dary(3) == NULL);
+}
+
+/* Pops come out in descending order for every arity */
+void test_typed_heap_push_pop(void)
+{
+    unsigned int arity;
+    unsigned long i, n, item, top, prev;
+
+    for(arity = 2; arity <= 8; arity *= 2) {
+        test_heap = ULongHeap_create_dary(arity);
+        assert_true(test_heap != NULL);
+
+        n = (rand() % 5000) + 1;
+        for(i = 0; i < n; i++) {
+            assert_int_equal(0, ULongHeap_push(test_heap, rand() % 1000));
+        }
+        assert_true(ULongHeap_is_valid(test_heap));
+        assert_ulong_equal(n, ULongHeap_size(test_heap));
+
+        prev = 1000;
+        for(i = 0; i < n; i++) {
+            assert_int_equal(0, ULongHeap_top(test_heap, &top));
+            assert_int_equal(0, ULongHeap_pop(test_heap, &item));
+            assert_ulong_equal(top, item);
+            assert_true(item <= prev);
+            prev = item;
+        }
+        assert_true(ULongHeap_is_empty(test_heap));
+
+        ULongHeap_free(test_heap);
+        test_heap = NULL;
+    }
+}
+
+void test_fixture_typed_heap(void)
+{
+    test_fixture_start();
+    run_test(test_typed_heap_empty);
+    run_test(test_typed_heap_push_pop);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_typed_heap();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}
@@ -0,0 +1,147 @@
+/* Copyright (c) 2012, Chris Winter <wintercni@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <seatest.h>
+#include <libcore/typed_map.h>
+
+#define KEY_RANGE   5000
+
+#define ulong_cmp(a, b)     (((a) > (b)) - ((a) < (b)))
+
+LIBCORE_DEFINE_MAP(ULongMap, unsigned long, unsigned long, ulong_cmp)
+
+static ULongMap *test_map = NULL;
+
+void test_typed_map_empty(void)
+{
+    unsigned long key = 1;
+
+    test_map = ULongMap_create();
+    assert_true(test_map != NULL);
+    assert_true(ULongMap_is_valid(test_map));
+    assert_ulong_equal(0, ULongMap_size(test_map));
+    assert_true(ULongMap_begin(test_map) == NULL);
+    assert_true(ULongMap_end(test_map) == NULL);
+    assert_true(ULongMap_find(test_map, key) == NULL);
+    assert_int_equal(-1, ULongMap_remove(test_map, key, NULL));
+
+    ULongMap_free(test_map);
+    test_map = NULL;
+}
+
+/* Random inserts and removes match a table of which keys are present */
+void test_typed_map_insert_remove(void)
+{
+    static int present[KEY_RANGE];
+    ULongMap_node *it;
+    unsigned long i, key, value, size, *valp;
+
+    test_map = ULongMap_create();
+    size = 0;
+    for(key = 0; key < KEY_RANGE; key++) {
+        present[key] = 0;
+    }
+
+    for(i = 0; i < 4 * KEY_RANGE; i++) {
+        key = rand() % KEY_RANGE;
+        if(rand() % 3 != 0) {
+            assert_int_equal(present[key] ? -1 : 0,
+                    ULongMap_insert(test_map, key, 2 * key));
+            if(!present[key]) {
+                present[key] = 1;
+                size++;
+            }
+        } else {
+            assert_int_equal(present[key] ? 0 : -1,
+                    ULongMap_remove(test_map, key, &value));
+            if(present[key]) {
+                assert_ulong_equal(2 * key, value);
+                present[key] = 0;
+                size--;
+            }
+        }
+    }
+
+    assert_true(ULongMap_is_valid(test_map));
+    assert_ulong_equal(size, ULongMap_size(test_map));
+
+    /* Iteration visits the present keys in order, both ways */
+    it = ULongMap_begin(test_map);
+    for(key = 0; key < KEY_RANGE; key++) {
+        valp = ULongMap_get(test_map, key);
+        if(!present[key]) {
+            assert_true(NULL == valp);
+            continue;
+        }
+        assert_true(valp != NULL && *valp == 2 * key);
+        assert_true(it != NULL && it->key == key);
+        it = ULongMap_next(it);
+    }
+    assert_true(NULL == it);
+
+    for(it = ULongMap_end(test_map), i = 0; it != NULL;
+            it = ULongMap_prev(it), i++) {
+        assert_true(present[it->key]);
+    }
+    assert_ulong_equal(size, i);
+
+    while(ULongMap_begin(test_map) != NULL) {
+        ULongMap_remove_at(test_map, ULongMap_begin(test_map), NULL);
+    }
+    assert_true(ULongMap_is_valid(test_map));
+    assert_ulong_equal(0, ULongMap_size(test_map));
+
+    ULongMap_free(test_map);
+    test_map = NULL;
+}
+
+void test_fixture_typed_map(void)
+{
+    test_fixture_start();
+    run_test(test_typed_map_empty);
+    run_test(test_typed_map_insert_remove);
+    test_fixture_end();
+}
+
+
+void all_tests(void)
+{
+    test_fixture_typed_map();
+}
+
+int main(int argc, char *argv[])
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    srand(tv.tv_usec * tv.tv_sec);
+
+    return seatest_testrunner(argc, argv, all_tests, NULL, NULL);
+}